@@ -201,6 +201,25 @@ public bool NeedsReconstruct
 				get { throw new NotImplementedException();}
 			}
 
+			/// <summary/>
+			public void BeginPropChangedBatch()
+			{
+				throw new NotImplementedException();
+			}
+
+			/// <summary/>
+			public void EndPropChangedBatch()
+			{
+				throw new NotImplementedException();
+			}
+
+			/// <summary/>
+			public bool RememberFragmentHeights
+			{
+				get { throw new NotImplementedException(); }
+				set { throw new NotImplementedException(); }
+			}
+
 			/// <summary/>
 			public void PropChanged(int hvo, int tag, int ivMin, int cvIns, int cvDel)
 			{
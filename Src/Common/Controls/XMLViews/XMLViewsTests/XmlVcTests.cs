@@ -642,6 +642,14 @@ public bool IsParagraphOpen()
 			throw new NotImplementedException();
 		}
 
+		/// <summary>
+		/// Perform a buffer of simple IVwEnv instructions.
+		/// </summary>
+		public void AddInstructions(int[] rgn, int cn, IVwViewConstructor vc)
+		{
+			throw new NotImplementedException();
+		}
+
 		/// <summary>
 		/// Start a normal paragraph.
 		/// </summary>
@@ -7,4 +7,6 @@
 
 // [assembly: AssemblyTitle("FieldWorks Base RootSite")] // Sanitized by convert_generate_assembly_info
 
-// [assembly: System.Runtime.InteropServices.ComVisible(false)] // Sanitized by convert_generate_assembly_info
\ No newline at end of file
+// [assembly: System.Runtime.InteropServices.ComVisible(false)] // Sanitized by convert_generate_assembly_info
+
+[assembly: InternalsVisibleTo("RootSiteTests")]
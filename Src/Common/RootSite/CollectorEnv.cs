@@ -1635,6 +1635,17 @@ public bool IsParagraphOpen()
 			return m_fIsParaOpen;
 		}
 
+		/// ------------------------------------------------------------------------------------
+		/// <summary>
+		/// Perform a buffer of instructions by calling our own methods, so subclasses see
+		/// each of them just as if it had been called directly.
+		/// </summary>
+		/// ------------------------------------------------------------------------------------
+		public virtual void AddInstructions(int[] rgn, int cn, IVwViewConstructor vc)
+		{
+			VwEnvInstructionBuilder.Replay(this, rgn, cn, vc);
+		}
+
 		#endregion
 	}
 	#endregion // CollectorEnv
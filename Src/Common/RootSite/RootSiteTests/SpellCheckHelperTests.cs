@@ -0,0 +1,50 @@
+// Copyright (c) 2026 SIL International
+// This software is licensed under the LGPL, version 2.1 or later
+// (http://www.gnu.org/licenses/lgpl-2.1.html)
+
+using Moq;
+using NUnit.Framework;
+using SIL.FieldWorks.Common.ViewsInterfaces;
+using SIL.LCModel.Core.KernelInterfaces;
+using SIL.LCModel.Core.SpellChecking;
+
+namespace SIL.FieldWorks.Common.RootSites
+{
+	/// ----------------------------------------------------------------------------------------
+	/// <summary>
+	/// Tests for the spell-checking menu items.
+	/// </summary>
+	/// ----------------------------------------------------------------------------------------
+	[TestFixture]
+	public class SpellCheckHelperTests
+	{
+		/// ------------------------------------------------------------------------------------
+		/// <summary>
+		/// Adding a word to the dictionary must make the views forget what they remembered
+		/// about it, or the word keeps its squiggle.
+		/// </summary>
+		/// ------------------------------------------------------------------------------------
+		[Test]
+		public void AddWordToDictionary_RestartsSpellChecking()
+		{
+			var dictMock = new Mock<ISpellEngine>();
+			var sdaMock = new Mock<ISilDataAccess>();
+			sdaMock.Setup(sda => sda.GetActionHandler()).Returns((IActionHandler)null);
+			var rootbMock = new Mock<IVwRootBox>();
+			rootbMock.Setup(r => r.DataAccess).Returns(sdaMock.Object);
+			var sequence = new MockSequence();
+			rootbMock.InSequence(sequence).Setup(r => r.RestartSpellChecking());
+			rootbMock.InSequence(sequence).Setup(r => r.PropChanged(17, 42, 0, 1, 1));
+
+			using (var item = new AddToDictMenuItem(dictMock.Object, "wrod", rootbMock.Object,
+				17, 42, 0, 1, "Add to dictionary", null))
+			{
+				item.AddWordToDictionary();
+			}
+
+			dictMock.Verify(d => d.SetStatus("wrod", true), Times.Once());
+			rootbMock.Verify(r => r.RestartSpellChecking(), Times.Once());
+			rootbMock.Verify(r => r.PropChanged(17, 42, 0, 1, 1), Times.Once());
+		}
+	}
+}
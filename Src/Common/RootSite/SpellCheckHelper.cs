@@ -613,6 +613,8 @@ public void AddWordToDictionary()
 				m_rootb.DataAccess.GetActionHandler().AddAction(new UndoAddToSpellDictAction(m_wsText, m_word, m_rootb,
 				m_hvoObj, m_tag, m_wsAlt));
 			AddToSpellDict(m_dict, m_word, m_wsText);
+			// The views remember what the dictionary said about each word.
+			m_rootb.RestartSpellChecking();
 			m_rootb.PropChanged(m_hvoObj, m_tag, m_wsAlt, 1, 1);
 			m_rootb.DataAccess.EndUndoTask();
 		}
@@ -717,6 +719,7 @@ public bool Redo()
 			if (m_rootb != null && m_dataAccess != null)
 			{
 				SpellingHelper.SetSpellingStatus(m_word, m_wsText, m_dataAccess.WritingSystemFactory, true);
+				m_rootb.RestartSpellChecking();
 				m_rootb.PropChanged(m_hvoObj, m_tag, m_wsAlt, 1, 1);
 				return true;
 			}
@@ -734,6 +737,7 @@ public bool Undo()
 			if (m_rootb != null && m_dataAccess != null)
 			{
 				SpellingHelper.SetSpellingStatus(m_word, m_wsText, m_dataAccess.WritingSystemFactory, false);
+				m_rootb.RestartSpellChecking();
 				m_rootb.PropChanged(m_hvoObj, m_tag, m_wsAlt, 1, 1);
 				return true;
 			}
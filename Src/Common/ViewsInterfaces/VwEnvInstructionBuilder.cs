@@ -0,0 +1,132 @@
+// Copyright (c) 2026 SIL International
+// This software is licensed under the LGPL, version 2.1 or later
+// (http://www.gnu.org/licenses/lgpl-2.1.html)
+
+using System;
+using System.Collections.Generic;
+
+namespace SIL.FieldWorks.Common.ViewsInterfaces
+{
+	/// ----------------------------------------------------------------------------------------
+	/// <summary>
+	/// Builds an instruction buffer for IVwEnv.AddInstructions, which lets a view constructor
+	/// make one interop call for a run of simple IVwEnv calls (flow objects, integer
+	/// properties and basic property displays) instead of one call each.
+	/// </summary>
+	/// ----------------------------------------------------------------------------------------
+	public class VwEnvInstructionBuilder
+	{
+		private readonly List<int> m_instructions = new List<int>();
+
+		/// <summary>Number of ints in the buffer so far.</summary>
+		public int Count => m_instructions.Count;
+
+		/// <summary>Discard the instructions built so far.</summary>
+		public void Clear()
+		{
+			m_instructions.Clear();
+		}
+
+		/// <summary>Equivalent to IVwEnv.OpenParagraph.</summary>
+		public void OpenParagraph() => Add(VwEnvOp.kveopOpenParagraph);
+		/// <summary>Equivalent to IVwEnv.CloseParagraph.</summary>
+		public void CloseParagraph() => Add(VwEnvOp.kveopCloseParagraph);
+		/// <summary>Equivalent to IVwEnv.OpenDiv.</summary>
+		public void OpenDiv() => Add(VwEnvOp.kveopOpenDiv);
+		/// <summary>Equivalent to IVwEnv.CloseDiv.</summary>
+		public void CloseDiv() => Add(VwEnvOp.kveopCloseDiv);
+		/// <summary>Equivalent to IVwEnv.OpenInnerPile.</summary>
+		public void OpenInnerPile() => Add(VwEnvOp.kveopOpenInnerPile);
+		/// <summary>Equivalent to IVwEnv.CloseInnerPile.</summary>
+		public void CloseInnerPile() => Add(VwEnvOp.kveopCloseInnerPile);
+		/// <summary>Equivalent to IVwEnv.OpenSpan.</summary>
+		public void OpenSpan() => Add(VwEnvOp.kveopOpenSpan);
+		/// <summary>Equivalent to IVwEnv.CloseSpan.</summary>
+		public void CloseSpan() => Add(VwEnvOp.kveopCloseSpan);
+		/// <summary>Equivalent to IVwEnv.set_IntProperty.</summary>
+		public void set_IntProperty(int tpt, int tpv, int nValue) => Add(VwEnvOp.kveopIntProperty, tpt, tpv, nValue);
+		/// <summary>Equivalent to IVwEnv.AddStringProp, using the view constructor passed to AddInstructions.</summary>
+		public void AddStringProp(int tag) => Add(VwEnvOp.kveopStringProp, tag);
+		/// <summary>Equivalent to IVwEnv.AddUnicodeProp, using the view constructor passed to AddInstructions.</summary>
+		public void AddUnicodeProp(int tag, int ws) => Add(VwEnvOp.kveopUnicodeProp, tag, ws);
+		/// <summary>Equivalent to IVwEnv.AddStringAltMember, using the view constructor passed to AddInstructions.</summary>
+		public void AddStringAltMember(int tag, int ws) => Add(VwEnvOp.kveopStringAltMember, tag, ws);
+		/// <summary>Equivalent to IVwEnv.AddIntProp.</summary>
+		public void AddIntProp(int tag) => Add(VwEnvOp.kveopIntProp, tag);
+		/// <summary>Equivalent to IVwEnv.AddObjProp, using the view constructor passed to AddInstructions.</summary>
+		public void AddObjProp(int tag, int frag) => Add(VwEnvOp.kveopObjProp, tag, frag);
+		/// <summary>Equivalent to IVwEnv.AddObjVecItems, using the view constructor passed to AddInstructions.</summary>
+		public void AddObjVecItems(int tag, int frag) => Add(VwEnvOp.kveopObjVecItems, tag, frag);
+		/// <summary>Equivalent to IVwEnv.AddObj, using the view constructor passed to AddInstructions.</summary>
+		public void AddObj(int hvo, int frag) => Add(VwEnvOp.kveopObj, hvo, frag);
+
+		/// <summary>
+		/// Send the instructions built so far to the environment in one call, and clear them.
+		/// </summary>
+		public void Flush(IVwEnv vwenv, IVwViewConstructor vc)
+		{
+			if (m_instructions.Count == 0)
+				return;
+			var instructions = m_instructions.ToArray();
+			m_instructions.Clear();
+			vwenv.AddInstructions(instructions, instructions.Length, vc);
+		}
+
+		private void Add(VwEnvOp op, params int[] operands)
+		{
+			m_instructions.Add((int)op);
+			m_instructions.AddRange(operands);
+		}
+
+		/// ------------------------------------------------------------------------------------
+		/// <summary>
+		/// Perform the instructions by calling the corresponding methods of vwenv one at a
+		/// time. Managed implementations of IVwEnv use this to implement AddInstructions.
+		/// </summary>
+		/// ------------------------------------------------------------------------------------
+		public static void Replay(IVwEnv vwenv, int[] instructions, int count, IVwViewConstructor vc)
+		{
+			int i = 0;
+			while (i < count)
+			{
+				var op = (VwEnvOp)instructions[i++];
+				int operandCount = OperandCount(op);
+				if (i + operandCount > count)
+					throw new ArgumentException("Instruction buffer ends inside an instruction", nameof(instructions));
+				int a = i;
+				i += operandCount;
+				switch (op)
+				{
+					case VwEnvOp.kveopOpenParagraph: vwenv.OpenParagraph(); break;
+					case VwEnvOp.kveopCloseParagraph: vwenv.CloseParagraph(); break;
+					case VwEnvOp.kveopOpenDiv: vwenv.OpenDiv(); break;
+					case VwEnvOp.kveopCloseDiv: vwenv.CloseDiv(); break;
+					case VwEnvOp.kveopOpenInnerPile: vwenv.OpenInnerPile(); break;
+					case VwEnvOp.kveopCloseInnerPile: vwenv.CloseInnerPile(); break;
+					case VwEnvOp.kveopOpenSpan: vwenv.OpenSpan(); break;
+					case VwEnvOp.kveopCloseSpan: vwenv.CloseSpan(); break;
+					case VwEnvOp.kveopIntProperty:
+						vwenv.set_IntProperty(instructions[a], instructions[a + 1], instructions[a + 2]);
+						break;
+					case VwEnvOp.kveopStringProp: vwenv.AddStringProp(instructions[a], vc); break;
+					case VwEnvOp.kveopUnicodeProp: vwenv.AddUnicodeProp(instructions[a], instructions[a + 1], vc); break;
+					case VwEnvOp.kveopStringAltMember: vwenv.AddStringAltMember(instructions[a], instructions[a + 1], vc); break;
+					case VwEnvOp.kveopIntProp: vwenv.AddIntProp(instructions[a]); break;
+					case VwEnvOp.kveopObjProp: vwenv.AddObjProp(instructions[a], vc, instructions[a + 1]); break;
+					case VwEnvOp.kveopObjVecItems: vwenv.AddObjVecItems(instructions[a], vc, instructions[a + 1]); break;
+					case VwEnvOp.kveopObj: vwenv.AddObj(instructions[a], vc, instructions[a + 1]); break;
+					default:
+						throw new ArgumentException("Unknown VwEnvOp " + op, nameof(instructions));
+				}
+			}
+		}
+
+		/// <summary>
+		/// The number of operands following op; VwEnvOp encodes it in the opcode itself.
+		/// </summary>
+		private static int OperandCount(VwEnvOp op)
+		{
+			return (int)((uint)op >> (int)VwEnvOp.kveopOperandShift);
+		}
+	}
+}
@@ -299,6 +299,15 @@ public bool IsParagraphOpen()
 			throw new NotImplementedException();
 		}
 
+		/// <summary>
+		/// Perform a buffer of instructions through our own methods, so they get reordered
+		/// like any others when the row is right-to-left.
+		/// </summary>
+		public virtual void AddInstructions(int[] rgn, int cn, IVwViewConstructor vc)
+		{
+			VwEnvInstructionBuilder.Replay(this, rgn, cn, vc);
+		}
+
 		public virtual void OpenParagraph()
 		{
 			if (!IsRtL)
@@ -27,6 +27,10 @@ Last reviewed: Not yet.
 template class ComHashMap<VwPropertyStore::IntPropKey, VwPropertyStore>; // MapIPKPropStore (VwPropertyStore.h)
 template class ComHashMap<int, VwPropertyStore>; // MapEncPropStore (VwPropertyStore.h)
 template class Vector<VwPropertyStore::StrPropRec>; // VecStrProps (VwPropertyStore.h)
+template class HashMap<CachedProps, VwPropertyStore::SharedChrpRec *>; // SharedChrpMap (VwPropertyStore.h)
+template class Vector<VwWsStyleTable::WsRec>; // VwWsStyleTable::m_vwsr (VwPropertyStore.h)
+template class Vector<VwWsStyleTable::StrPropRec>; // VwWsStyleTable::m_vspr (VwPropertyStore.h)
+template class Vector<VwWsStyleTable::IntPropRec>; // VwWsStyleTable::m_vipr (VwPropertyStore.h)
 template class Vector<VwBox *>; // BoxVec (Main.h)
 template class HashMap<VwBox *, Rect>; //FixupMap (Main.h)
 template class Vector<VwGroupBox *>; // GroupBoxVec (Main.h)
@@ -42,14 +46,24 @@ template class Vector<HVO>; // HvoVec (main.h) - same as Vector<int>
 #endif
 template class Vector<long>; // LongVec (VwLazyBox.h)
 template class Vector<VwNotifier::PropBoxRec>; // PropBoxList (VwNotifier.h)
-template class ComHashMapStrUni<ITsTextProps>; // MapStrTtp; (VwPropertyStore.h)
+template class HashMapStrUni<int>; // VwStylesheet::m_hmsuistyle, VwNamedStyleCache::m_hmsuistyle (VwPropertyStore.h)
 template class Vector<VwColumnSpec>; // ColSpecs (VwTable.h)
 template class Vector<VwTableCellBox *>; //VwTable.h
 template class ComMultiMap<VwBox *, VwAbstractNotifier>; // NotifierMap; (Main.h)
 template class ComVector<IVwViewConstructor>; //VwVcVec; (VwRootBox.h)
 template class ComMultiMap<HVO, VwAbstractNotifier>; // ObjNoteMap(VwRootBox.h)
+template class MultiMap<HVO, VwRootBox::FragHeightRec>; // FragHeightMap (VwRootBox.h)
+template class Vector<VwRootBox::LineBand>; // LineBandVec (VwRootBox.h)
+template class Vector<VwRootBox::PendingPropChange>; // PendingPropChangeVec (VwRootBox.h)
+template class HashMap<HvoTagRec, int>; // VwRootBox::m_hmhtippc
+template class HashMapStrUni<bool>; // VwCachedCheckWord::m_hmsufGood (VwRootBox.h)
+template class ComHashMapStrUni<VwCachedCheckWord>; // CachedCheckWordMap (VwRootBox.h)
 template class ComVector<ITsString>; // StringVec (VwEnv.h)
 template class Vector<VpsTssRec>; // VpsTssVec; (VwTxtSrc.h)
+template class Vector<RunPropsRec>; // RunPropsVec; (VwTxtSrc.h)
+template class Vector<DepObjRec>; // DepObjVec; (VwTxtSrc.h)
+template class Vector<VwOverlayTxtSrc::OverlayTagProps>; // OverlayTagPropsVec (VwTxtSrc.h)
+template class HashMap<ITsTextProps *, VwOverlayTxtSrc::OverlayTagRange>; // OverlayTagMap (VwTxtSrc.h)
 template class ComHashMap<ITsTextProps *, VwPropertyStore>; // MapTtpPropStore;
 template class ComVector<ITsTextProps>; // TtpVec
 template class ComVector<IVwPropertyStore>; // VwPropsVec;
@@ -65,6 +79,7 @@ template class Vector<wchar>;
 template class Vector<GUID>;
 template class GpHashMap<int, VwPage>;
 template class MultiMap<VwBox *, int>; // BoxIntMultiMap; // Hungarian mmbi;
+template class MultiMap<int, VwParagraphBox *>; // VwRootBox::LayoutDonorMap
 template class Vector<VwPage *>;
 template class Vector<VwMoveablePileBox *>;
 template class Vector<PageLine>; // PageLineVec; // Hungarian vln;
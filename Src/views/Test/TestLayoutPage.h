@@ -1909,6 +1909,145 @@ text so that it continues on the next page.");
 				dysUsedHeight1 <= 66);
 		}
 
+		// Tests the index of dependent objects kept by a paragraph's text source, and that it
+		// follows changes to the paragraph contents.
+		void testDependentObjectIndex()
+		{
+			CreateStringsWithFootnotes();
+			CreateTestStTexts(2);
+			SetupRootWithoutMargins();
+			DummyLayoutMgrPtr qlayoutMgr;
+			qlayoutMgr.Attach(NewObj DummyLayoutMgr());
+			m_qlay->SetManager(qlayoutMgr);
+			m_qlay->Layout(m_qvg32, 200);
+
+			VwParagraphBox * pvpbox = dynamic_cast<VwParagraphBox *>(
+				dynamic_cast<VwGroupBox *>(m_qlay->FirstBox())->FirstBox());
+			unitpp::assert_true("First box should be a paragraph", pvpbox);
+			Vector<GUID> vguid;
+			pvpbox->Source()->GetDependentObjects(0, pvpbox->Source()->Cch(), vguid);
+			unitpp::assert_eq("Whole paragraph has three footnotes", 3, vguid.Size());
+			unitpp::assert_true("First footnote", kguidDummyFootnote1 == vguid[0]);
+			unitpp::assert_true("Second footnote", kguidDummyFootnote2 == vguid[1]);
+			unitpp::assert_true("Third footnote", kguidDummyFootnote3 == vguid[2]);
+			vguid.Clear();
+			pvpbox->Source()->GetDependentObjects(5, 7, vguid);
+			unitpp::assert_eq("Only the second footnote is in the range", 1, vguid.Size());
+			unitpp::assert_true("Second footnote in range", kguidDummyFootnote2 == vguid[0]);
+
+			// Replace the contents with a string that has no footnotes.
+			int cchOld = pvpbox->Source()->Cch();
+			StrUni stuPara1(L"No footnotes here");
+			ITsStringPtr qtss;
+			m_qtsf->MakeString(stuPara1.Bstr(), g_wsEng, &qtss);
+			m_qcda->CacheStringProp(khvoTlpPara1, kflidStTxtPara_Contents, qtss);
+			m_qlay->PropChanged(khvoTlpPara1, kflidStTxtPara_Contents, 0, stuPara1.Length(), cchOld);
+
+			pvpbox = dynamic_cast<VwParagraphBox *>(
+				dynamic_cast<VwGroupBox *>(m_qlay->FirstBox())->FirstBox());
+			vguid.Clear();
+			pvpbox->Source()->GetDependentObjects(0, pvpbox->Source()->Cch(), vguid);
+			unitpp::assert_eq("Changed paragraph has no footnotes", 0, vguid.Size());
+		}
+
+		// Tests that laying a page out again reports whether its end moved, and that only pages
+		// that are new or laid out differently are reported as changed.
+		void testRepaginationDetectsUnchangedPageEnd()
+		{
+			CreateBoringStrings();
+			CreateTestStTexts(2);
+			SetupRootWithoutMargins();
+			DummyParaVc * pdvc = dynamic_cast<DummyParaVc *>(m_qvc.Ptr());
+			pdvc->m_dympLineSpace = -10000;
+
+			DummyLayoutMgrPtr qlayoutMgr;
+			qlayoutMgr.Attach(NewObj DummyLayoutMgr());
+			m_qlay->SetManager(qlayoutMgr);
+
+			int dysUsedHeight, ysStartNextPage1, ysStartNextPage2;
+			int ysStartThisPage = 0;
+			m_qlay->LayoutPage(m_qvg32, 100, 100, &ysStartThisPage, 0, 1, &dysUsedHeight,
+				&ysStartNextPage1);
+			ysStartThisPage = ysStartNextPage1;
+			m_qlay->LayoutPage(m_qvg32, 100, 100, &ysStartThisPage, 1, 1, &dysUsedHeight,
+				&ysStartNextPage2);
+
+			ComBool fUnchanged;
+			m_qlay->PageEndUnchanged(0, &fUnchanged);
+			unitpp::assert_true("A page laid out for the first time has no previous end", !fUnchanged);
+			int rghPage[3];
+			int chPage;
+			m_qlay->GetChangedPages(0, NULL, &chPage);
+			unitpp::assert_eq("Both new pages should count as changed", 2, chPage);
+			m_qlay->GetChangedPages(3, rghPage, &chPage);
+			unitpp::assert_eq("Both new pages should be reported", 2, chPage);
+			unitpp::assert_eq("First changed page", 0, rghPage[0]);
+			unitpp::assert_eq("Second changed page", 1, rghPage[1]);
+
+			// Laying the first page out again the same way finds the same boundary.
+			ysStartThisPage = 0;
+			int ysStartNextPage;
+			m_qlay->LayoutPage(m_qvg32, 100, 100, &ysStartThisPage, 0, 1, &dysUsedHeight,
+				&ysStartNextPage);
+			unitpp::assert_eq("Same page should end at the same place", ysStartNextPage1,
+				ysStartNextPage);
+			m_qlay->PageEndUnchanged(0, &fUnchanged);
+			unitpp::assert_true("Page end should be recognized as unchanged", fUnchanged);
+			m_qlay->GetChangedPages(3, rghPage, &chPage);
+			unitpp::assert_eq("Nothing should have changed", 0, chPage);
+
+			// A shorter page ends earlier, so it (and only it) has changed.
+			ysStartThisPage = 0;
+			m_qlay->LayoutPage(m_qvg32, 100, 50, &ysStartThisPage, 0, 1, &dysUsedHeight,
+				&ysStartNextPage);
+			unitpp::assert_true("Shorter page should end earlier", ysStartNextPage < ysStartNextPage1);
+			m_qlay->PageEndUnchanged(0, &fUnchanged);
+			unitpp::assert_true("Page end should have moved", !fUnchanged);
+			m_qlay->GetChangedPages(3, rghPage, &chPage);
+			unitpp::assert_eq("Only the shorter page should have changed", 1, chPage);
+			unitpp::assert_eq("Changed page", 0, rghPage[0]);
+		}
+
+		// Tests that a page laid out straight after the previous one (which starts searching
+		// where that page ended) comes out the same as one laid out from scratch.
+		void testSequentialPagesMatchPagesLaidOutOnTheirOwn()
+		{
+			CreateBoringStrings();
+			CreateTestStTexts(2);
+			SetupRootWithoutMargins();
+			DummyParaVc * pdvc = dynamic_cast<DummyParaVc *>(m_qvc.Ptr());
+			pdvc->m_dympLineSpace = -10000;
+
+			DummyLayoutMgrPtr qlayoutMgr;
+			qlayoutMgr.Attach(NewObj DummyLayoutMgr());
+			m_qlay->SetManager(qlayoutMgr);
+
+			const int kcpage = 3;
+			int rgysStart[kcpage];
+			int rgysNext[kcpage];
+			int rgdysUsed[kcpage];
+			int ysStartThisPage = 0;
+			for (int ipage = 0; ipage < kcpage; ipage++)
+			{
+				rgysStart[ipage] = ysStartThisPage;
+				m_qlay->LayoutPage(m_qvg32, 100, 50, &ysStartThisPage, ipage, 1, &rgdysUsed[ipage],
+					&rgysNext[ipage]);
+				unitpp::assert_true("Test needs enough material for several pages", rgysNext[ipage] > 0);
+				ysStartThisPage = rgysNext[ipage];
+			}
+
+			// Lay the pages out again, last first, so none of them follows on from the one before.
+			for (int ipage = kcpage - 1; ipage >= 0; ipage--)
+			{
+				int dysUsedHeight, ysStartNextPage;
+				ysStartThisPage = rgysStart[ipage];
+				m_qlay->LayoutPage(m_qvg32, 100, 50, &ysStartThisPage, ipage, 1, &dysUsedHeight,
+					&ysStartNextPage);
+				unitpp::assert_eq("Same used height", rgdysUsed[ipage], dysUsedHeight);
+				unitpp::assert_eq("Same start of next page", rgysNext[ipage], ysStartNextPage);
+			}
+		}
+
 	public:
 		virtual void Setup()
 		{
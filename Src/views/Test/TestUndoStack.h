@@ -27,6 +27,11 @@ namespace TestViews
 		{
 			return m_viMarks[m_viMarks.Size() - 1];
 		}
+		// Gets the most recently added action
+		IUndoAction * LastAction()
+		{
+			return m_vquact[m_vquact.Size() - 1];
+		}
 	};
 	DEFINE_COM_PTR(DummyActionHandler);
 
@@ -905,6 +910,54 @@ namespace TestViews
 			unitpp::assert_true("Should have tasks to redo", fTasksRedo);
 		}
 
+		/*--------------------------------------------------------------------------------------
+			Test that when a memory limit is set, ending a task commits and drops the oldest
+			sequences until the stack fits, but never the most recent one.
+		--------------------------------------------------------------------------------------*/
+		void testMemoryLimit()
+		{
+			// StubUndoAction doesn't implement IUndoActionSize, so each counts as the default.
+			IUndoStackMemoryPtr qusm;
+			CheckHr(m_qacth->QueryInterface(IID_IUndoStackMemory, (void **)&qusm));
+			CheckHr(qusm->put_MemoryLimit(3 * ActionHandler::kcbDefaultAction));
+			StubUndoActionPtr rgqsua[5];
+			for (int i = 0; i < 5; i++)
+			{
+				m_qacth->BeginUndoTask(NULL, NULL);
+				rgqsua[i].Attach(NewObj StubUndoAction());
+				m_qacth->AddAction(rgqsua[i]);
+				unitpp::assert_true("Last action of the open task",
+					m_qacth->IsLastActionOfOpenTask(rgqsua[i]));
+				m_qacth->EndUndoTask();
+				unitpp::assert_true("No open task once it has ended",
+					!m_qacth->IsLastActionOfOpenTask(rgqsua[i]));
+			}
+			int cseq;
+			m_qacth->get_UndoableSequenceCount(&cseq);
+			unitpp::assert_eq("Oldest sequences dropped", 3, cseq);
+			int cb;
+			CheckHr(qusm->get_MemoryUsed(&cb));
+			unitpp::assert_eq("Memory used within limit", 3 * ActionHandler::kcbDefaultAction, cb);
+			unitpp::assert_true("Dropped actions committed",
+				rgqsua[0]->m_fCommitted && rgqsua[1]->m_fCommitted);
+			unitpp::assert_true("Kept actions not committed", !rgqsua[2]->m_fCommitted);
+
+			// Undo still works on what is left.
+			UndoResult ures;
+			m_qacth->Undo(&ures);
+			unitpp::assert_true("Most recent action undone", !rgqsua[4]->m_fDone);
+
+			// However big the last sequence is, it is kept.
+			CheckHr(qusm->put_MemoryLimit(1));
+			m_qacth->BeginUndoTask(NULL, NULL);
+			StubUndoActionPtr qsua;
+			qsua.Attach(NewObj StubUndoAction());
+			m_qacth->AddAction(qsua);
+			m_qacth->EndUndoTask();
+			m_qacth->get_UndoableSequenceCount(&cseq);
+			unitpp::assert_eq("Most recent sequence kept", 1, cseq);
+		}
+
 		/*--------------------------------------------------------------------------------------
 			Enhance JohnT: add test for the rest of the interface.
 		--------------------------------------------------------------------------------------*/
@@ -929,6 +982,227 @@ namespace TestViews
 			m_qacth.Clear();
 		}
 	};
+
+	// Remembers the last change it was notified of, and how many there were.
+	class RecordingNotifyChange : public IVwNotifyChange
+	{
+	public:
+		HVO m_hvo;
+		PropTag m_tag;
+		int m_ivMin;
+		int m_cvIns;
+		int m_cvDel;
+		int m_cpc;
+		ulong m_cref;
+
+		RecordingNotifyChange()
+		{
+			m_cref = 1;
+			m_cpc = 0;
+		}
+
+		STDMETHOD(QueryInterface)(REFIID iid, void ** ppv)
+		{
+			*ppv = NULL;
+			if (iid == IID_IUnknown)
+				*ppv = static_cast<IUnknown *>(this);
+			else if (iid == IID_IVwNotifyChange)
+				*ppv = static_cast<IVwNotifyChange *>(this);
+			else
+				return E_NOINTERFACE;
+			AddRef();
+			return S_OK;
+		}
+		STDMETHOD_(UCOMINT32, AddRef)(void)
+		{
+			return ++m_cref;
+		}
+		STDMETHOD_(UCOMINT32, Release)(void)
+		{
+			if (--m_cref > 0)
+				return m_cref;
+			m_cref = 1;
+			delete this;
+			return 0;
+		}
+
+		STDMETHOD(PropChanged)(HVO hvo, PropTag tag, int ivMin, int cvIns, int cvDel)
+		{
+			m_hvo = hvo;
+			m_tag = tag;
+			m_ivMin = ivMin;
+			m_cvIns = cvIns;
+			m_cvDel = cvDel;
+			m_cpc++;
+			return S_OK;
+		}
+	};
+	DEFINE_COM_PTR(RecordingNotifyChange);
+
+	static const HVO khvoUndoPara = 1001;
+
+	// Tests for VwUndoSetStringAction: the changes VwUndoDa records for SetString are stored
+	// as deltas, and consecutive typing is merged into one action.
+	class TestVwUndoSetString : public unitpp::suite
+	{
+		DummyActionHandlerPtr m_qacth;
+		VwUndoDaPtr m_quda;
+		RecordingNotifyChangePtr m_qrnc;
+		ITsStrFactoryPtr m_qtsf;
+
+		void MakeString(const wchar_t * pszText, ITsString ** pptss)
+		{
+			StrUni stu(pszText);
+			CheckHr(m_qtsf->MakeString(stu.Bstr(), g_wsEng, pptss));
+		}
+
+		// Change the paragraph's contents to pszText, through the undo-recording SetString.
+		void SetContents(const wchar_t * pszText)
+		{
+			ITsStringPtr qtss;
+			MakeString(pszText, &qtss);
+			CheckHr(m_quda->SetString(khvoUndoPara, kflidStTxtPara_Contents, qtss));
+		}
+
+		void VerifyContents(const char * pszMsg, const wchar_t * pszExpected)
+		{
+			ITsStringPtr qtss;
+			CheckHr(m_quda->get_StringProp(khvoUndoPara, kflidStTxtPara_Contents, &qtss));
+			SmartBstr sbstr;
+			CheckHr(qtss->get_Text(&sbstr));
+			unitpp::assert_true(pszMsg, StrUni(sbstr.Chars()) == pszExpected);
+		}
+
+		void VerifyPropChanged(const char * pszMsg, int ivMin, int cvIns, int cvDel)
+		{
+			unitpp::assert_eq(pszMsg, khvoUndoPara, m_qrnc->m_hvo);
+			unitpp::assert_eq(pszMsg, (int)kflidStTxtPara_Contents, m_qrnc->m_tag);
+			unitpp::assert_eq(pszMsg, ivMin, m_qrnc->m_ivMin);
+			unitpp::assert_eq(pszMsg, cvIns, m_qrnc->m_cvIns);
+			unitpp::assert_eq(pszMsg, cvDel, m_qrnc->m_cvDel);
+		}
+
+		// The last action recorded on the stack, which these tests know is a string action.
+		VwUndoSetStringAction * LastAction()
+		{
+			return dynamic_cast<VwUndoSetStringAction *>(m_qacth->LastAction());
+		}
+
+		/*--------------------------------------------------------------------------------------
+			Undoing and redoing a change stored as a delta restores each value in turn, and
+			tells notifiers only about the range that changed.
+		--------------------------------------------------------------------------------------*/
+		void testDeltaRoundTrip()
+		{
+			CheckHr(m_qacth->BeginUndoTask(NULL, NULL));
+			SetContents(L"The quick brown fox");
+			CheckHr(m_qacth->EndUndoTask());
+			VwUndoSetStringAction * puact = LastAction();
+			unitpp::assert_true("String action recorded", puact != NULL);
+
+			ComBool fSuccess;
+			CheckHr(puact->Undo(false, &fSuccess));
+			unitpp::assert_true("Undo succeeded", fSuccess);
+			VerifyContents("Undo restores the old value", L"The quick fox");
+			VerifyPropChanged("Undo reports the deleted word", 10, 0, 6);
+
+			CheckHr(puact->Redo(false, &fSuccess));
+			unitpp::assert_true("Redo succeeded", fSuccess);
+			VerifyContents("Redo restores the new value", L"The quick brown fox");
+			VerifyPropChanged("Redo reports the inserted word", 10, 6, 0);
+
+			CheckHr(puact->Undo(false, &fSuccess));
+			VerifyContents("Second undo", L"The quick fox");
+
+			int cpc = m_qrnc->m_cpc;
+			CheckHr(puact->Redo(true, &fSuccess));
+			VerifyContents("Redo with a refresh pending", L"The quick brown fox");
+			unitpp::assert_eq("No notification when a refresh is pending", cpc, m_qrnc->m_cpc);
+		}
+
+		/*--------------------------------------------------------------------------------------
+			Typing continued in the same task is merged into one action, which undoes the
+			whole burst; typing somewhere else is recorded separately.
+		--------------------------------------------------------------------------------------*/
+		void testTypingMerges()
+		{
+			CheckHr(m_qacth->BeginUndoTask(NULL, NULL));
+			SetContents(L"The quick fox j");
+			CheckHr(m_qacth->EndUndoTask());
+			CheckHr(m_qacth->ContinueUndoTask());
+			SetContents(L"The quick fox ju");
+			CheckHr(m_qacth->EndUndoTask());
+			CheckHr(m_qacth->ContinueUndoTask());
+			SetContents(L"The quick fox jum");
+			CheckHr(m_qacth->EndUndoTask());
+			int cact;
+			CheckHr(m_qacth->get_UndoableActionCount(&cact));
+			unitpp::assert_eq("Consecutive typing is one action", 1, cact);
+			VwUndoSetStringAction * puactTyping = LastAction();
+
+			CheckHr(m_qacth->ContinueUndoTask());
+			SetContents(L"A quick fox jum");
+			CheckHr(m_qacth->EndUndoTask());
+			CheckHr(m_qacth->get_UndoableActionCount(&cact));
+			unitpp::assert_eq("Typing elsewhere is another action", 2, cact);
+
+			ComBool fSuccess;
+			CheckHr(LastAction()->Undo(false, &fSuccess));
+			VerifyContents("Undo the separate change", L"The quick fox jum");
+			VerifyPropChanged("Separate change replaced the first word", 0, 3, 1);
+			CheckHr(puactTyping->Undo(false, &fSuccess));
+			unitpp::assert_true("Undo of merged typing succeeded", fSuccess);
+			VerifyContents("Merged typing undone at once", L"The quick fox");
+			VerifyPropChanged("Merged typing reported as one deletion", 13, 0, 4);
+		}
+
+		/*--------------------------------------------------------------------------------------
+			An action whose text has been changed behind its back refuses to undo, even if the
+			string is still long enough for the change.
+		--------------------------------------------------------------------------------------*/
+		void testUndoChecksReplacedText()
+		{
+			CheckHr(m_qacth->BeginUndoTask(NULL, NULL));
+			SetContents(L"The quick red fox");
+			CheckHr(m_qacth->EndUndoTask());
+			VwUndoSetStringAction * puact = LastAction();
+
+			// Same length, different text where the action made its change.
+			ITsStringPtr qtss;
+			MakeString(L"The quick big fox", &qtss);
+			CheckHr(m_quda->CacheStringProp(khvoUndoPara, kflidStTxtPara_Contents, qtss));
+
+			int cpc = m_qrnc->m_cpc;
+			ComBool fSuccess;
+			CheckHr(puact->Undo(false, &fSuccess));
+			unitpp::assert_true("Undo refused", !fSuccess);
+			VerifyContents("Changed text left alone", L"The quick big fox");
+			unitpp::assert_eq("No notification for a refused undo", cpc, m_qrnc->m_cpc);
+		}
+
+	public:
+		TestVwUndoSetString();
+		virtual void Setup()
+		{
+			m_qtsf.CreateInstance(CLSID_TsStrFactory);
+			m_qacth.Attach(NewObj DummyActionHandler());
+			m_quda.Attach(NewObj VwUndoDa());
+			CheckHr(m_quda->SetActionHandler(m_qacth));
+			ITsStringPtr qtss;
+			MakeString(L"The quick fox", &qtss);
+			CheckHr(m_quda->CacheStringProp(khvoUndoPara, kflidStTxtPara_Contents, qtss));
+			m_qrnc.Attach(NewObj RecordingNotifyChange());
+			CheckHr(m_quda->AddNotification(m_qrnc));
+		}
+		virtual void Teardown()
+		{
+			CheckHr(m_quda->RemoveNotification(m_qrnc));
+			m_qrnc.Clear();
+			m_quda.Clear();
+			m_qacth.Clear();
+			m_qtsf.Clear();
+		}
+	};
 }
 
 #endif /*TESTUNDOSTACK_H_INCLUDED*/
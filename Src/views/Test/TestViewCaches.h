@@ -218,6 +218,204 @@ namespace TestViews
 	public:
 		TestShapeRunCache();
 	};
+
+	// What SnapshotReaderThread reads, and how many times it found the wrong value.
+	struct SnapshotReader
+	{
+		VwCacheSnapshot * m_pcsnap; // The thread releases it when done.
+		HVO m_hvo;
+		PropTag m_tagInt;
+		PropTag m_tagSeq;
+		int m_cBad;
+	};
+
+	// Read a snapshot over and over, as background work would, while the cache changes on the
+	// test's thread, then release the snapshot on this thread.
+#if defined(_WIN32) || defined(_M_X64)
+	static DWORD WINAPI SnapshotReaderThread(void * pv)
+#else
+	static void * SnapshotReaderThread(void * pv)
+#endif
+	{
+		SnapshotReader * psr = reinterpret_cast<SnapshotReader *>(pv);
+		HvoVec vhvo;
+		for (int i = 0; i < 1000; i++)
+		{
+			if (psr->m_pcsnap->IntProp(psr->m_hvo, psr->m_tagInt) != 7)
+				psr->m_cBad++;
+			psr->m_pcsnap->VecProp(psr->m_hvo, psr->m_tagSeq, vhvo);
+			if (vhvo.Size() != 3 || vhvo[0] != 2001)
+				psr->m_cBad++;
+		}
+		psr->m_pcsnap->Release();
+		psr->m_pcsnap = NULL;
+		return 0;
+	}
+
+	class TestVwCacheSnapshot : public unitpp::suite
+	{
+		VwCacheDaPtr m_qcda;
+		ITsStrFactoryPtr m_qtsf;
+
+		void MakeString(const wchar_t * pszText, ITsString ** pptss)
+		{
+			StrUni stu(pszText);
+			CheckHr(m_qtsf->MakeString(stu.Bstr(), g_wsEng, pptss));
+		}
+
+		/*--------------------------------------------------------------------------------------
+			A snapshot goes on answering with the values it was taken with, whatever the cache
+			does afterwards, while the cache itself sees the changes.
+		--------------------------------------------------------------------------------------*/
+		void testSnapshotKeepsOldValues()
+		{
+			const HVO hvo = 1000;
+			const PropTag tagStr = 5001;
+			const PropTag tagSeq = 5002;
+			const PropTag tagInt = 5003;
+			const PropTag tagNew = 5004;
+			ITsStringPtr qtssOld;
+			MakeString(L"old", &qtssOld);
+			CheckHr(m_qcda->CacheStringProp(hvo, tagStr, qtssOld));
+			HVO rghvo[] = {2001, 2002, 2003};
+			CheckHr(m_qcda->CacheVecProp(hvo, tagSeq, rghvo, 3));
+			CheckHr(m_qcda->CacheIntProp(hvo, tagInt, 7));
+
+			VwCacheSnapshotPtr qcsnap;
+			m_qcda->TakeSnapshot(&qcsnap);
+
+			ITsStringPtr qtssNew;
+			MakeString(L"new", &qtssNew);
+			CheckHr(m_qcda->SetString(hvo, tagStr, qtssNew));
+			HVO hvoIns = 2004;
+			CheckHr(m_qcda->Replace(hvo, tagSeq, 0, 1, &hvoIns, 1));
+			CheckHr(m_qcda->SetInt(hvo, tagInt, 8));
+			CheckHr(m_qcda->CacheIntProp(hvo, tagNew, 9));
+
+			ITsStringPtr qtss;
+			qcsnap->StringProp(hvo, tagStr, &qtss);
+			unitpp::assert_true("Snapshot keeps the old string", qtss.Ptr() == qtssOld.Ptr());
+			HvoVec vhvo;
+			qcsnap->VecProp(hvo, tagSeq, vhvo);
+			unitpp::assert_eq("Snapshot keeps the old sequence", 3, vhvo.Size());
+			unitpp::assert_eq("Snapshot keeps the old first item", 2001, vhvo[0]);
+			unitpp::assert_eq("Snapshot keeps the old integer", 7, qcsnap->IntProp(hvo, tagInt));
+			unitpp::assert_eq("Properties cached later are not in the snapshot", 0,
+				qcsnap->IntProp(hvo, tagNew));
+
+			qtss.Clear();
+			CheckHr(m_qcda->get_StringProp(hvo, tagStr, &qtss));
+			unitpp::assert_true("Cache has the new string", qtss.Ptr() == qtssNew.Ptr());
+			HVO hvoFirst;
+			CheckHr(m_qcda->get_VecItem(hvo, tagSeq, 0, &hvoFirst));
+			unitpp::assert_eq("Cache has the new sequence", 2004, hvoFirst);
+
+			// A second snapshot sees the data as it is now, and clearing the cache leaves
+			// both intact.
+			VwCacheSnapshotPtr qcsnap2;
+			m_qcda->TakeSnapshot(&qcsnap2);
+			CheckHr(m_qcda->ClearAllData());
+			unitpp::assert_eq("First snapshot survives ClearAllData", 7,
+				qcsnap->IntProp(hvo, tagInt));
+			unitpp::assert_eq("Second snapshot survives ClearAllData", 8,
+				qcsnap2->IntProp(hvo, tagInt));
+			qcsnap2->VecProp(hvo, tagSeq, vhvo);
+			unitpp::assert_eq("Second snapshot has the new sequence", 3, vhvo.Size());
+			unitpp::assert_eq("Second snapshot has the new first item", 2004, vhvo[0]);
+			int chvo;
+			CheckHr(m_qcda->get_VecSize(hvo, tagSeq, &chvo));
+			unitpp::assert_eq("Cache itself was cleared", 0, chvo);
+		}
+
+		/*--------------------------------------------------------------------------------------
+			A snapshot read and released on another thread keeps its values while the cache
+			changes, and once it is gone the cache no longer saves values for it.
+		--------------------------------------------------------------------------------------*/
+		void testSnapshotOnAnotherThread()
+		{
+			const HVO hvo = 1000;
+			const PropTag tagSeq = 5002;
+			const PropTag tagInt = 5003;
+			HVO rghvo[] = {2001, 2002, 2003};
+			CheckHr(m_qcda->CacheVecProp(hvo, tagSeq, rghvo, 3));
+			CheckHr(m_qcda->CacheIntProp(hvo, tagInt, 7));
+
+			SnapshotReader sr;
+			sr.m_pcsnap = NULL;
+			m_qcda->TakeSnapshot(&sr.m_pcsnap);
+			sr.m_hvo = hvo;
+			sr.m_tagInt = tagInt;
+			sr.m_tagSeq = tagSeq;
+			sr.m_cBad = 0;
+#if defined(_WIN32) || defined(_M_X64)
+			HANDLE hthread = ::CreateThread(NULL, 0, SnapshotReaderThread, &sr, 0, NULL);
+			unitpp::assert_true("Reader thread started", hthread != NULL);
+#else
+			pthread_t tid;
+			unitpp::assert_eq("Reader thread started", 0,
+				pthread_create(&tid, NULL, SnapshotReaderThread, &sr));
+#endif
+			for (int i = 0; i < 1000; i++)
+			{
+				CheckHr(m_qcda->SetInt(hvo, tagInt, 8 + i));
+				HVO hvoIns = 3000 + i;
+				CheckHr(m_qcda->Replace(hvo, tagSeq, 0, 1, &hvoIns, 1));
+			}
+#if defined(_WIN32) || defined(_M_X64)
+			::WaitForSingleObject(hthread, INFINITE);
+			::CloseHandle(hthread);
+#else
+			pthread_join(tid, NULL);
+#endif
+			unitpp::assert_eq("Snapshot kept its values while the cache changed", 0, sr.m_cBad);
+			unitpp::assert_true("Reader thread released the snapshot", sr.m_pcsnap == NULL);
+
+			// The cache must have forgotten the released snapshot, and still be usable here.
+			CheckHr(m_qcda->SetInt(hvo, tagInt, 5));
+			int n;
+			CheckHr(m_qcda->get_IntProp(hvo, tagInt, &n));
+			unitpp::assert_eq("Cache still works after the snapshot is released", 5, n);
+		}
+
+		/*--------------------------------------------------------------------------------------
+			A snapshot doesn't keep its cache alive, and goes on answering after the cache is
+			destroyed, including for properties the cache never changed.
+		--------------------------------------------------------------------------------------*/
+		void testSnapshotOutlivesCache()
+		{
+			const HVO hvo = 1000;
+			const PropTag tagStr = 5001;
+			const PropTag tagInt = 5003;
+			ITsStringPtr qtss;
+			MakeString(L"unchanged", &qtss);
+			CheckHr(m_qcda->CacheStringProp(hvo, tagStr, qtss));
+			CheckHr(m_qcda->CacheIntProp(hvo, tagInt, 7));
+
+			VwCacheSnapshotPtr qcsnap;
+			m_qcda->TakeSnapshot(&qcsnap);
+			CheckHr(m_qcda->SetInt(hvo, tagInt, 8));
+			m_qcda.Clear(); // The only reference; the snapshot must not hold another.
+
+			unitpp::assert_eq("Changed value survives the cache", 7, qcsnap->IntProp(hvo, tagInt));
+			ITsStringPtr qtssSnap;
+			qcsnap->StringProp(hvo, tagStr, &qtssSnap);
+			unitpp::assert_true("Unchanged value survives the cache", qtssSnap.Ptr() == qtss.Ptr());
+			unitpp::assert_eq("Uncached value is still zero", 0, qcsnap->IntProp(hvo, 5004));
+		}
+
+	public:
+		TestVwCacheSnapshot();
+		virtual void Setup()
+		{
+			m_qcda.Attach(NewObj VwCacheDa());
+			m_qtsf.CreateInstance(CLSID_TsStrFactory);
+		}
+		virtual void Teardown()
+		{
+			m_qcda.Clear();
+			m_qtsf.Clear();
+		}
+	};
 }
 
 #endif // TESTVIEWCACHES_H_INCLUDED
@@ -18,6 +18,52 @@ Last reviewed:
 
 namespace TestViews
 {
+	// Displays an StText as a div of bold paragraphs, either through individual IVwEnv calls
+	// or through equivalent AddInstructions buffers.
+	class InstructionVc : public DummyBaseVc
+	{
+	public:
+		InstructionVc(bool fUseInstructions)
+		{
+			m_fUseInstructions = fUseInstructions;
+		}
+		STDMETHOD(Display)(IVwEnv* pvwenv, HVO hvo, int frag)
+		{
+			switch(frag)
+			{
+			case kfragStText:
+				if (m_fUseInstructions)
+				{
+					int rgn[] = { kveopOpenDiv,
+						kveopObjVecItems, kflidStText_Paragraphs, kfragStTxtPara,
+						kveopCloseDiv };
+					return pvwenv->AddInstructions(rgn, isizeof(rgn) / isizeof(int), this);
+				}
+				pvwenv->OpenDiv();
+				pvwenv->AddObjVecItems(kflidStText_Paragraphs, this, kfragStTxtPara);
+				pvwenv->CloseDiv();
+				break;
+			case kfragStTxtPara:
+				if (m_fUseInstructions)
+				{
+					int rgn[] = { kveopIntProperty, ktptBold, ktpvEnum, kttvForceOn,
+						kveopOpenParagraph,
+						kveopStringProp, kflidStTxtPara_Contents,
+						kveopCloseParagraph };
+					return pvwenv->AddInstructions(rgn, isizeof(rgn) / isizeof(int), this);
+				}
+				pvwenv->put_IntProperty(ktptBold, ktpvEnum, kttvForceOn);
+				pvwenv->OpenParagraph();
+				pvwenv->AddStringProp(kflidStTxtPara_Contents, this);
+				pvwenv->CloseParagraph();
+				break;
+			}
+			return S_OK;
+		}
+	protected:
+		bool m_fUseInstructions;
+	};
+
 	class TestVwEnv : public unitpp::suite
 	{
 		VwEnvPtr m_qvwenv;
@@ -121,6 +167,41 @@ namespace TestViews
 			catch(Throwable& thr){
 				unitpp::assert_eq("AddString(NULL) HRESULT", E_POINTER, thr.Result());
 			}
+			try{
+				CheckHr(hr = m_qvwenv->AddInstructions(NULL, 1, NULL));
+				unitpp::assert_eq("AddInstructions(NULL, 1, NULL) HRESULT", E_POINTER, hr);
+			}
+			catch(Throwable& thr){
+				unitpp::assert_eq("AddInstructions(NULL, 1, NULL) HRESULT", E_POINTER, thr.Result());
+			}
+			// An unknown opcode is rejected before anything is done with it.
+			int rgnBad[] = { kveopLim };
+			try{
+				CheckHr(hr = m_qvwenv->AddInstructions(rgnBad, 1, NULL));
+				unitpp::assert_eq("AddInstructions(kveopLim) HRESULT", E_INVALIDARG, hr);
+			}
+			catch(Throwable& thr){
+				unitpp::assert_eq("AddInstructions(kveopLim) HRESULT", E_INVALIDARG, thr.Result());
+			}
+			// So is an instruction that is missing operands.
+			int rgnShort[] = { kveopObjProp, 0 };
+			try{
+				CheckHr(hr = m_qvwenv->AddInstructions(rgnShort, 2, NULL));
+				unitpp::assert_eq("AddInstructions(truncated) HRESULT", E_INVALIDARG, hr);
+			}
+			catch(Throwable& thr){
+				unitpp::assert_eq("AddInstructions(truncated) HRESULT", E_INVALIDARG, thr.Result());
+			}
+			// And an opcode number whose operand count does not match its opcode.
+			int rgnMismatch[] = { kveopStringProp & kveopNumberMask };
+			try{
+				CheckHr(hr = m_qvwenv->AddInstructions(rgnMismatch, 1, NULL));
+				unitpp::assert_eq("AddInstructions(mismatched count) HRESULT", E_INVALIDARG, hr);
+			}
+			catch(Throwable& thr){
+				unitpp::assert_eq("AddInstructions(mismatched count) HRESULT", E_INVALIDARG,
+					thr.Result());
+			}
 			// This causes a memory leak if executed, since the VwEnv is not initialized.
 			//hr = m_qvwenv->AddPicture(NULL);
 			//unitpp::assert_eq("AddPicture(NULL) HRESULT", E_UNEXPECTED, hr);
@@ -158,16 +239,135 @@ namespace TestViews
 	//		hr = m_qvwenv->put_Props(NULL);						// requires valid m_qzvps
 	//		unitpp::assert_eq("put_Props(NULL) HRESULT", E_POINTER, hr);
 		}
+
+		// Build the same view through AddInstructions and through individual calls, and check
+		// that each gives the same boxes and that they are kept up to date by PropChanged.
+		void testAddInstructions_Replay()
+		{
+			VerifyInstructionView(true);
+			VerifyInstructionView(false);
+		}
+
+		void VerifyInstructionView(bool fUseInstructions)
+		{
+			const char * pszMode = fUseInstructions ? "instructions" : "calls";
+			ITsStrFactoryPtr qtsf;
+			qtsf.CreateInstance(CLSID_TsStrFactory);
+			IVwCacheDaPtr qcda;
+			qcda.CreateInstance(CLSID_VwCacheDa);
+			qcda->putref_TsStrFactory(qtsf);
+			ISilDataAccessPtr qsda;
+			CheckHr(qcda->QueryInterface(IID_ISilDataAccess, (void **)&qsda));
+			CheckHr(qsda->putref_WritingSystemFactory(g_qwsf));
+
+			const HVO hvoText = 100;
+			HVO rghvo[] = {1, 2};
+			ITsStringPtr qtss;
+			for (int ihvo = 0; ihvo < 2; ihvo++)
+			{
+				StrUni stu;
+				stu.Format(L"Paragraph %d", rghvo[ihvo]);
+				CheckHr(qtsf->MakeString(stu.Bstr(), g_wsEng, &qtss));
+				CheckHr(qcda->CacheStringProp(rghvo[ihvo], kflidStTxtPara_Contents, qtss));
+			}
+			CheckHr(qcda->CacheVecProp(hvoText, kflidStText_Paragraphs, rghvo, 2));
+
+			IVwRootBoxPtr qrootb;
+			VwRootBox::CreateCom(NULL, IID_IVwRootBox, (void **)&qrootb);
+			VwRootBox * prootb = dynamic_cast<VwRootBox *>(qrootb.Ptr());
+			IRenderEngineFactoryPtr qref;
+			qref.Attach(NewObj MockRenderEngineFactory);
+			IVwGraphicsWin32Ptr qvg32;
+			HDC hdc = 0;
+			try
+			{
+				qvg32.CreateInstance(CLSID_VwGraphicsWin32);
+				hdc = GetTestDC();
+				CheckHr(qvg32->Initialize(hdc));
+
+				IVwViewConstructorPtr qvc;
+				qvc.Attach(NewObj InstructionVc(fUseInstructions));
+				CheckHr(qrootb->putref_DataAccess(qsda));
+				CheckHr(qrootb->putref_RenderEngineFactory(qref));
+				CheckHr(qrootb->putref_TsStrFactory(qtsf));
+				CheckHr(qrootb->SetRootObject(hvoText, qvc, kfragStText, NULL));
+				DummyRootSitePtr qdrs;
+				qdrs.Attach(NewObj DummyRootSite());
+				Rect rcSrc(0, 0, 96, 96);
+				qdrs->SetRects(rcSrc, rcSrc);
+				qdrs->SetGraphics(qvg32);
+				CheckHr(qrootb->SetSite(qdrs));
+				CheckHr(qrootb->Layout(qvg32, 300));
+
+				StrAnsi staMsg;
+				VwDivBox * pdbox = dynamic_cast<VwDivBox *>(prootb->FirstBox());
+				staMsg.Format("%s: the root holds the div", pszMode);
+				unitpp::assert_true(staMsg.Chars(), pdbox && !pdbox->Next());
+				int cpara = 0;
+				for (VwBox * pbox = pdbox->FirstBox(); pbox; pbox = pbox->Next())
+				{
+					VwParagraphBox * pvpbox = dynamic_cast<VwParagraphBox *>(pbox);
+					staMsg.Format("%s: the div holds paragraphs", pszMode);
+					unitpp::assert_true(staMsg.Chars(), pvpbox);
+					LgCharRenderProps chrp;
+					int ichMin, ichLim;
+					CheckHr(pvpbox->Source()->GetCharProps(0, &chrp, &ichMin, &ichLim));
+					staMsg.Format("%s: put_IntProperty applied to paragraph %d", pszMode, cpara);
+					unitpp::assert_eq(staMsg.Chars(), (int)kttvForceOn, (int)chrp.ttvBold);
+					cpara++;
+				}
+				staMsg.Format("%s: one paragraph per item", pszMode);
+				unitpp::assert_eq(staMsg.Chars(), 2, cpara);
+
+				// The string property must be noted, so changing it updates the display.
+				StrUni stuNew(L"Second paragraph, changed");
+				CheckHr(qtsf->MakeString(stuNew.Bstr(), g_wsEng, &qtss));
+				CheckHr(qcda->CacheStringProp(2, kflidStTxtPara_Contents, qtss));
+				CheckHr(qrootb->PropChanged(2, kflidStTxtPara_Contents, 0, stuNew.Length(), 11));
+
+				IVwSelectionPtr qsel;
+				ITsStringPtr qtssShown;
+				int ich, ws;
+				ComBool fAssocPrev;
+				HVO hvo;
+				PropTag tag;
+				CheckHr(qrootb->MakeSimpleSel(false, true, false, true, &qsel));
+				CheckHr(qsel->TextSelInfo(false, &qtssShown, &ich, &fAssocPrev, &hvo, &tag, &ws));
+				staMsg.Format("%s: selection in the last paragraph", pszMode);
+				unitpp::assert_eq(staMsg.Chars(), 2, hvo);
+				staMsg.Format("%s: selection in its contents", pszMode);
+				unitpp::assert_eq(staMsg.Chars(), kflidStTxtPara_Contents, tag);
+				SmartBstr sbstr;
+				CheckHr(qtssShown->get_Text(&sbstr));
+				staMsg.Format("%s: last paragraph shows its new contents", pszMode);
+				unitpp::assert_true(staMsg.Chars(), wcscmp(sbstr.Chars(), stuNew.Chars()) == 0);
+			}
+			catch(...)
+			{
+				if (qvg32)
+					qvg32->ReleaseDC();
+				if (hdc != 0)
+					ReleaseTestDC(hdc);
+				qrootb->Close();
+				throw;
+			}
+
+			qvg32->ReleaseDC();
+			ReleaseTestDC(hdc);
+			qrootb->Close();
+		}
 	public:
 		TestVwEnv();
 
 		virtual void Setup()
 		{
 			m_qvwenv.Attach(NewObj VwEnv);
+			CreateTestWritingSystemFactory();
 		}
 		virtual void Teardown()
 		{
 			m_qvwenv.Clear();
+			CloseTestWritingSystemFactory();
 		}
 	};
 }
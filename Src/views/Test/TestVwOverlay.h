@@ -178,6 +178,42 @@ namespace TestViews
 			}
 
 		}
+
+		// Anything that may change how a tag is displayed gives the overlay a new version, and
+		// no two overlays share one.
+		void testVersion()
+		{
+			VwOverlay * pzvo = dynamic_cast<VwOverlay *>(m_qvo.Ptr());
+			unitpp::assert_true("VwOverlay", pzvo != NULL);
+			int nVersion = pzvo->Version();
+			unitpp::assert_true("new overlay has a version", nVersion != 0);
+			IVwOverlayPtr qvo2;
+			VwOverlay::CreateCom(NULL, IID_IVwOverlay, (void **)&qvo2);
+			unitpp::assert_true("versions are unique",
+				dynamic_cast<VwOverlay *>(qvo2.Ptr())->Version() != nVersion);
+
+			OLECHAR rgchGuid[kcchGuidRepLength];
+			for (int ich = 0; ich < kcchGuidRepLength; ich++)
+				rgchGuid[ich] = (OLECHAR)(0x100 + ich);
+			CheckHr(m_qvo->SetTagInfo(rgchGuid, 1, 0, NULL, NULL, kclrRed, kclrWhite, kclrRed,
+				kuntSingle, false));
+			unitpp::assert_eq("no change, same version", nVersion, pzvo->Version());
+			CheckHr(m_qvo->SetTagInfo(rgchGuid, 1, kosmAll, NULL, NULL, kclrRed, kclrWhite,
+				kclrRed, kuntSingle, false));
+			unitpp::assert_true("SetTagInfo changes version", pzvo->Version() != nVersion);
+
+			nVersion = pzvo->Version();
+			ComBool fHidden;
+			COLORREF clrFore, clrBack, clrUnder;
+			int unt, cchAbbr, cchName;
+			CheckHr(m_qvo->GetDispTagInfo(rgchGuid, &fHidden, &clrFore, &clrBack, &clrUnder, &unt,
+				NULL, 0, &cchAbbr, NULL, 0, &cchName));
+			unitpp::assert_eq("lookup does not change version", nVersion, pzvo->Version());
+			unitpp::assert_eq("tag foreground", (COLORREF)kclrRed, clrFore);
+
+			CheckHr(m_qvo->RemoveTag(rgchGuid));
+			unitpp::assert_true("RemoveTag changes version", pzvo->Version() != nVersion);
+		}
 	public:
 		TestVwOverlay();
 
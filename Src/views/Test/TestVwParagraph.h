@@ -843,6 +843,159 @@ namespace TestViews
 			qrootb->Close();
 		}
 
+		// Spell checking should not check paragraphs again until they or the dictionaries change.
+		void testSpellCheckSkipsUnchangedParagraphs()
+		{
+			ITsStrFactoryPtr qtsf;
+			qtsf.CreateInstance(CLSID_TsStrFactory);
+			IVwCacheDaPtr qcda;
+			qcda.CreateInstance(CLSID_VwCacheDa);
+			qcda->putref_TsStrFactory(qtsf);
+			ISilDataAccessPtr qsda;
+			qcda->QueryInterface(IID_ISilDataAccess, (void **)&qsda);
+			qsda->putref_WritingSystemFactory(g_qwsf);
+
+			IRenderEngineFactoryPtr qref;
+			qref.Attach(NewObj MockRenderEngineFactory);
+
+			VwRootBoxPtr qrootb;
+			qrootb.Attach(NewObj MockDictRootBox());
+			IVwGraphicsWin32Ptr qvg32;
+			HDC hdc = 0;
+			StrUni testData(L"The xzklymgz string");
+			ITsStringPtr qtss;
+			qtsf->MakeString(testData.Bstr(), g_wsEng, &qtss);
+			qcda->CacheStringProp(hvoRoot, kflidStTxtPara_Contents, qtss);
+
+			try
+			{
+				qvg32.CreateInstance(CLSID_VwGraphicsWin32);
+				hdc = GetTestDC();
+				qvg32->Initialize(hdc);
+
+				IVwViewConstructorPtr qvc;
+				qvc.Attach(NewObj NestedStringDummyVc());
+				qrootb->putref_DataAccess(qsda);
+				qrootb->putref_RenderEngineFactory(qref);
+				qrootb->putref_TsStrFactory(qtsf);
+				qrootb->SetRootObject(hvoRoot, qvc, kfragBase, NULL);
+				DummyRootSitePtr qdrs;
+				qdrs.Attach(NewObj DummyRootSite());
+				Rect rcSrc(0, 0, 96, 96);
+				qdrs->SetRects(rcSrc, rcSrc);
+				qdrs->SetGraphics(qvg32);
+				qrootb->SetSite(qdrs);
+				qrootb->Layout(qvg32, 3000);
+				ComBool fDone = false;
+				while (!fDone)
+					qrootb->DoSpellCheckStep(&fDone);
+				VwDivBox * pdbInner = dynamic_cast<VwDivBox *>(qrootb->FirstBox());
+				VwParagraphBox * pvpbox = dynamic_cast<VwParagraphBox *>(pdbInner->FirstBox());
+				unitpp::assert_true("checked paragraph should not need checking",
+					!pvpbox->NeedsSpellCheck());
+				unitpp::assert_true("unchanged paragraph should not be checked again",
+					!pvpbox->SpellCheck());
+				unitpp::assert_true("squiggle override should still be in place",
+					dynamic_cast<VwSpellingOverrideTxtSrc *>(pvpbox->Source()) != NULL);
+
+				// A new dictionary may have different words, so everything must be checked again.
+				qrootb->RestartSpellChecking();
+				unitpp::assert_true("restart should force checking", pvpbox->NeedsSpellCheck());
+				fDone = false;
+				while (!fDone)
+					qrootb->DoSpellCheckStep(&fDone);
+				unitpp::assert_true("checked again after restart", !pvpbox->NeedsSpellCheck());
+
+				// A word's status changed through another root box sharing the spelling cache.
+				VwSpellingCachePtr qspc;
+				VwSpellingCache::GetSharedCache(&qspc);
+				qspc->ClearResults();
+				unitpp::assert_true("shared status change should force checking",
+					pvpbox->NeedsSpellCheck());
+				qrootb->IsSpellCheckComplete(&fDone);
+				unitpp::assert_true("view should no longer be completely checked", !fDone);
+				while (!fDone)
+					qrootb->DoSpellCheckStep(&fDone);
+				unitpp::assert_true("checked again after shared change", !pvpbox->NeedsSpellCheck());
+
+				// Changing the string means the paragraph must be checked again.
+				StrUni stuGood(L"The good string");
+				UpdateString(stuGood.Bstr(), g_wsEng, qtsf, qcda, qsda);
+				pdbInner = dynamic_cast<VwDivBox *>(qrootb->FirstBox());
+				pvpbox = dynamic_cast<VwParagraphBox *>(pdbInner->FirstBox());
+				unitpp::assert_true("changed paragraph should need checking",
+					pvpbox->NeedsSpellCheck());
+				fDone = false;
+				while (!fDone)
+					qrootb->DoSpellCheckStep(&fDone);
+				unitpp::assert_true("should remove spelling override",
+					dynamic_cast<VwSpellingOverrideTxtSrc *>(pvpbox->Source()) == NULL);
+				unitpp::assert_true("changed paragraph has been checked", !pvpbox->NeedsSpellCheck());
+			}
+			catch(...)
+			{
+				if (qvg32)
+					qvg32->ReleaseDC();
+				if (hdc != 0)
+					ReleaseTestDC(hdc);
+				qrootb->Close();
+				throw;
+			}
+
+			// Cleanup
+			qvg32->ReleaseDC();
+			ReleaseTestDC(hdc);
+			qrootb->Close();
+		}
+
+		// The spelling cache should answer repeated words without asking the dictionary.
+		void testSpellingCache()
+		{
+			VwSpellingCachePtr qspc;
+			VwSpellingCache::GetSharedCache(&qspc);
+			ICheckWordPtr qcwReal;
+			qcwReal.Attach(new MockDict(8));
+			ICheckWordPtr qcw;
+			qspc->GetChecker(OleStringLiteral(L"en"), qcwReal, &qcw);
+			int cHit, cMiss, cEvict;
+			qspc->GetStatistics(&cHit, &cMiss, &cEvict);
+			unitpp::assert_eq("new dictionary has no hits", 0, cHit);
+
+			StrUni stuBad(L"xzklymgz");
+			StrUni stuGood(L"good");
+			ComBool fOk;
+			qcw->Check(stuBad.Chars(), &fOk);
+			unitpp::assert_true("bad word is rejected", !fOk);
+			qcw->Check(stuGood.Chars(), &fOk);
+			unitpp::assert_true("good word is accepted", (bool)fOk);
+			qcw->Check(stuBad.Chars(), &fOk);
+			unitpp::assert_true("cached bad word is still rejected", !fOk);
+			qspc->GetStatistics(&cHit, &cMiss, &cEvict);
+			unitpp::assert_eq("one word answered from the cache", 1, cHit);
+			unitpp::assert_eq("two words asked of the dictionary", 2, cMiss);
+
+			// Another root asking for the same dictionary shares the results.
+			VwSpellingCachePtr qspc2;
+			VwSpellingCache::GetSharedCache(&qspc2);
+			unitpp::assert_true("cache is shared", qspc.Ptr() == qspc2.Ptr());
+			ICheckWordPtr qcw2;
+			qspc2->GetChecker(OleStringLiteral(L"en"), qcwReal, &qcw2);
+			unitpp::assert_true("same wrapper for same dictionary", qcw.Ptr() == qcw2.Ptr());
+
+			// After words are added or removed, the dictionary must be asked again.
+			qspc->ClearResults();
+			qcw->Check(stuGood.Chars(), &fOk);
+			qspc->GetStatistics(&cHit, &cMiss, &cEvict);
+			unitpp::assert_eq("cleared word asked of the dictionary again", 3, cMiss);
+
+			// A different dictionary for the same id does not use the old results.
+			ICheckWordPtr qcwOther;
+			qcwOther.Attach(new MockDict(4));
+			qspc->GetChecker(OleStringLiteral(L"en"), qcwOther, &qcw2);
+			qcw2->Check(stuGood.Chars(), &fOk);
+			unitpp::assert_true("new dictionary rejects 4-letter word", !fOk);
+		}
+
 		void UpdateString(BSTR pchTxt, int ws, ITsStrFactory * ptsf, IVwCacheDa * pcda, ISilDataAccess * psda)
 		{
 			ITsStringPtr qtss;
@@ -1441,6 +1441,408 @@ namespace TestViews
 			qrootb->Close();
 		}
 
+		void testPropChangedBatch()
+		{
+			class SimpleParagraphVc : public DummyBaseVc
+			{
+			public:
+				STDMETHOD(Display)(IVwEnv * pvwenv, HVO hvo, int frag)
+				{
+					pvwenv->OpenDiv();
+					pvwenv->OpenParagraph();
+					pvwenv->AddStringProp(kflidStTxtPara_Contents, NULL);
+					pvwenv->CloseParagraph();
+					pvwenv->CloseDiv();
+					return S_OK;
+				}
+			};
+
+			ITsStrFactoryPtr qtsf;
+			qtsf.CreateInstance(CLSID_TsStrFactory);
+			IVwCacheDaPtr qcda;
+			qcda.CreateInstance(CLSID_VwCacheDa);
+			qcda->putref_TsStrFactory(qtsf);
+			ISilDataAccessPtr qsda;
+			CheckHr(qcda->QueryInterface(IID_ISilDataAccess, (void **)&qsda));
+			CheckHr(qsda->putref_WritingSystemFactory(g_qwsf));
+
+			ITsStringPtr qtss;
+			StrUni stuPara(L"Original");
+			CheckHr(qtsf->MakeString(stuPara.Bstr(), g_wsEng, &qtss));
+			HVO hvoPara = 1;
+			CheckHr(qcda->CacheStringProp(hvoPara, kflidStTxtPara_Contents, qtss));
+
+			IRenderEngineFactoryPtr qref;
+			qref.Attach(NewObj MockRenderEngineFactory);
+
+			IVwRootBoxPtr qrootb;
+			VwRootBox::CreateCom(NULL, IID_IVwRootBox, (void **)&qrootb);
+			IVwGraphicsWin32Ptr qvg32;
+			HDC hdc = 0;
+			try
+			{
+				qvg32.CreateInstance(CLSID_VwGraphicsWin32);
+				hdc = GetTestDC();
+				CheckHr(qvg32->Initialize(hdc));
+
+				IVwViewConstructorPtr qvc;
+				qvc.Attach(NewObj SimpleParagraphVc());
+				CheckHr(qrootb->putref_DataAccess(qsda));
+				CheckHr(qrootb->putref_RenderEngineFactory(qref));
+				CheckHr(qrootb->putref_TsStrFactory(qtsf));
+				CheckHr(qrootb->SetRootObject(hvoPara, qvc, 1, NULL));
+
+				DummyRootSitePtr qdrs;
+				qdrs.Attach(NewObj DummyRootSite());
+				Rect rcSrc(0, 0, 96, 96);
+				qdrs->SetRects(rcSrc, rcSrc);
+				qdrs->SetGraphics(qvg32);
+				CheckHr(qrootb->SetSite(qdrs));
+				CheckHr(qrootb->Layout(qvg32, 300));
+
+				HRESULT hr = S_OK;
+				try
+				{
+					CheckHr(hr = qrootb->EndPropChangedBatch());
+				}
+				catch(Throwable& thr)
+				{
+					hr = thr.Result();
+				}
+				unitpp::assert_eq("EndPropChangedBatch without Begin", E_UNEXPECTED, hr);
+
+				CheckHr(qrootb->BeginPropChangedBatch());
+				CheckHr(qrootb->BeginPropChangedBatch());
+				StrUni stuFirst(L"First change");
+				CheckHr(qtsf->MakeString(stuFirst.Bstr(), g_wsEng, &qtss));
+				CheckHr(qcda->CacheStringProp(hvoPara, kflidStTxtPara_Contents, qtss));
+				CheckHr(qrootb->PropChanged(hvoPara, kflidStTxtPara_Contents, 0,
+					stuFirst.Length(), stuPara.Length()));
+				StrUni stuSecond(L"Second");
+				CheckHr(qtsf->MakeString(stuSecond.Bstr(), g_wsEng, &qtss));
+				CheckHr(qcda->CacheStringProp(hvoPara, kflidStTxtPara_Contents, qtss));
+				CheckHr(qrootb->PropChanged(hvoPara, kflidStTxtPara_Contents, 0,
+					stuSecond.Length(), stuFirst.Length()));
+				CheckHr(qrootb->EndPropChangedBatch());
+
+				IVwSelectionPtr qsel;
+				ITsStringPtr qtssShown;
+				int ich, ws;
+				ComBool fAssocPrev;
+				HVO hvo;
+				PropTag tag;
+				const OLECHAR * pwrgch;
+				int cch;
+				CheckHr(qrootb->MakeSimpleSel(true, true, false, true, &qsel));
+				CheckHr(qsel->TextSelInfo(false, &qtssShown, &ich, &fAssocPrev, &hvo, &tag, &ws));
+				CheckHr(qtssShown->LockText(&pwrgch, &cch));
+				bool fOriginal = wcscmp(pwrgch, stuPara.Chars()) == 0;
+				CheckHr(qtssShown->UnlockText(pwrgch));
+				unitpp::assert_true("Changes should wait for the outermost batch to end", fOriginal);
+
+				CheckHr(qrootb->EndPropChangedBatch());
+				CheckHr(qrootb->MakeSimpleSel(true, true, false, true, &qsel));
+				CheckHr(qsel->TextSelInfo(false, &qtssShown, &ich, &fAssocPrev, &hvo, &tag, &ws));
+				CheckHr(qtssShown->LockText(&pwrgch, &cch));
+				bool fUpdated = wcscmp(pwrgch, stuSecond.Chars()) == 0;
+				CheckHr(qtssShown->UnlockText(pwrgch));
+				unitpp::assert_true("Ending the batch should show the final contents", fUpdated);
+			}
+			catch(...)
+			{
+				if (qvg32)
+					qvg32->ReleaseDC();
+				if (hdc != 0)
+					ReleaseTestDC(hdc);
+				qrootb->Close();
+				throw;
+			}
+
+			qvg32->ReleaseDC();
+			ReleaseTestDC(hdc);
+			qrootb->Close();
+		}
+
+		/*--------------------------------------------------------------------------------------
+			A change in a batch may regenerate boxes made by an earlier change in the same
+			batch, before they have been laid out; the layout at the end of the batch must
+			still lay them all out.
+		--------------------------------------------------------------------------------------*/
+		void testPropChangedBatch_RegeneratedBoxes()
+		{
+			ITsStrFactoryPtr qtsf;
+			qtsf.CreateInstance(CLSID_TsStrFactory);
+			IVwCacheDaPtr qcda;
+			qcda.CreateInstance(CLSID_VwCacheDa);
+			qcda->putref_TsStrFactory(qtsf);
+			ISilDataAccessPtr qsda;
+			CheckHr(qcda->QueryInterface(IID_ISilDataAccess, (void **)&qsda));
+			CheckHr(qsda->putref_WritingSystemFactory(g_qwsf));
+
+			const HVO hvoText = 100;
+			HVO rghvoOld[] = {1, 2};
+			HVO rghvoNew[] = {3, 4};
+			ITsStringPtr qtss;
+			for (HVO hvoPara = 1; hvoPara <= 4; hvoPara++)
+			{
+				StrUni stu;
+				stu.Format(L"Paragraph %d", hvoPara);
+				CheckHr(qtsf->MakeString(stu.Bstr(), g_wsEng, &qtss));
+				CheckHr(qcda->CacheStringProp(hvoPara, kflidStTxtPara_Contents, qtss));
+			}
+			CheckHr(qcda->CacheVecProp(hvoText, kflidStText_Paragraphs, rghvoOld, 2));
+
+			IRenderEngineFactoryPtr qref;
+			qref.Attach(NewObj MockRenderEngineFactory);
+			VwRootBox * prootb = dynamic_cast<VwRootBox *>(m_qrootb.Ptr());
+			IVwGraphicsWin32Ptr qvg32;
+			HDC hdc = 0;
+			try
+			{
+				qvg32.CreateInstance(CLSID_VwGraphicsWin32);
+				hdc = GetTestDC();
+				CheckHr(qvg32->Initialize(hdc));
+
+				DummyParaVc * pdpvc = NewObj DummyParaVc();
+				pdpvc->m_nInitialParas = 0;
+				IVwViewConstructorPtr qvc;
+				qvc.Attach(pdpvc);
+				CheckHr(m_qrootb->putref_DataAccess(qsda));
+				CheckHr(m_qrootb->putref_RenderEngineFactory(qref));
+				CheckHr(m_qrootb->putref_TsStrFactory(qtsf));
+				CheckHr(m_qrootb->SetRootObject(hvoText, qvc, kfragStText, NULL));
+				DummyRootSitePtr qdrs;
+				qdrs.Attach(NewObj DummyRootSite());
+				Rect rcSrc(0, 0, 96, 96);
+				qdrs->SetRects(rcSrc, rcSrc);
+				qdrs->SetGraphics(qvg32);
+				CheckHr(m_qrootb->SetSite(qdrs));
+				CheckHr(m_qrootb->Layout(qvg32, 300));
+
+				// Replace the paragraphs, then change one of the new ones, in one batch.
+				CheckHr(m_qrootb->BeginPropChangedBatch());
+				CheckHr(qcda->CacheVecProp(hvoText, kflidStText_Paragraphs, rghvoNew, 2));
+				CheckHr(m_qrootb->PropChanged(hvoText, kflidStText_Paragraphs, 0, 2, 2));
+				StrUni stuLast(L"Last paragraph, changed");
+				CheckHr(qtsf->MakeString(stuLast.Bstr(), g_wsEng, &qtss));
+				CheckHr(qcda->CacheStringProp(4, kflidStTxtPara_Contents, qtss));
+				CheckHr(m_qrootb->PropChanged(4, kflidStTxtPara_Contents, 0, stuLast.Length(),
+					11));
+				CheckHr(m_qrootb->EndPropChangedBatch());
+
+				int cbox = 0;
+				for (VwBox * pbox = prootb->FirstBox(); pbox; pbox = pbox->Next())
+				{
+					unitpp::assert_true("Every regenerated paragraph is laid out",
+						pbox->Height() > 0);
+					cbox++;
+				}
+				unitpp::assert_eq("Two paragraphs", 2, cbox);
+
+				IVwSelectionPtr qsel;
+				ITsStringPtr qtssShown;
+				int ich, ws;
+				ComBool fAssocPrev;
+				HVO hvo;
+				PropTag tag;
+				CheckHr(m_qrootb->MakeSimpleSel(false, true, false, true, &qsel));
+				CheckHr(qsel->TextSelInfo(false, &qtssShown, &ich, &fAssocPrev, &hvo, &tag, &ws));
+				unitpp::assert_eq("Selection in the last new paragraph", 4, hvo);
+				SmartBstr sbstr;
+				CheckHr(qtssShown->get_Text(&sbstr));
+				unitpp::assert_true("Last paragraph shows its new contents",
+					wcscmp(sbstr.Chars(), stuLast.Chars()) == 0);
+			}
+			catch(...)
+			{
+				if (qvg32)
+					qvg32->ReleaseDC();
+				if (hdc != 0)
+					ReleaseTestDC(hdc);
+				throw;
+			}
+
+			qvg32->ReleaseDC();
+			ReleaseTestDC(hdc);
+		}
+
+		void testCollectDamage()
+		{
+			IVwRootBoxPtr qrootb;
+			VwRootBox::CreateCom(NULL, IID_IVwRootBox, (void **)&qrootb);
+			VwRootBox * prootb = dynamic_cast<VwRootBox *>(qrootb.Ptr());
+			DummyRootSitePtr qdrs;
+			qdrs.Attach(NewObj DummyRootSite());
+			CheckHr(qrootb->SetSite(qdrs));
+
+			prootb->BeginCollectingDamage();
+			prootb->BeginCollectingDamage();
+			Rect rcLine(0, 0, 100, 20);
+			prootb->InvalidateRect(&rcLine);
+			Rect rcInside(10, 5, 50, 15);
+			prootb->InvalidateRect(&rcInside);
+			Rect rcBelow(0, 20, 100, 40);
+			prootb->InvalidateRect(&rcBelow);
+			prootb->EndCollectingDamage();
+			unitpp::assert_eq("Nothing is reported until the outermost collection ends",
+				0, prootb->LastDamageArea());
+			Rect rcApart(0, 200, 10, 210);
+			prootb->InvalidateRect(&rcApart);
+			prootb->InvalidateRect(&rcLine);
+			prootb->EndCollectingDamage();
+			// The inside and repeated rectangles add nothing, the adjacent ones are merged, and
+			// the distant one is kept separately.
+			unitpp::assert_eq("Minimal damage area", 100 * 40 + 10 * 10,
+				prootb->LastDamageArea());
+
+			qrootb->Close();
+		}
+
+		void testFragmentHeightMemo()
+		{
+			IVwRootBoxPtr qrootb;
+			VwRootBox::CreateCom(NULL, IID_IVwRootBox, (void **)&qrootb);
+			VwRootBox * prootb = dynamic_cast<VwRootBox *>(qrootb.Ptr());
+			IVwViewConstructorPtr qvc;
+			qvc.Attach(NewObj DummyBaseVc());
+			const HVO khvo1 = 1001;
+			const HVO khvo2 = 1002;
+			int dysHeight;
+
+			// Nothing is remembered unless the client asks for it.
+			ComBool fRemember;
+			CheckHr(qrootb->get_RememberFragmentHeights(&fRemember));
+			unitpp::assert_true("Off by default", !fRemember);
+			prootb->NoteFragmentHeight(qvc, 1, khvo1, 300, 25);
+			unitpp::assert_true("Not remembered by default",
+				!prootb->RetrieveFragmentHeight(qvc, 1, khvo1, 300, &dysHeight));
+
+			CheckHr(qrootb->put_RememberFragmentHeights(true));
+			int crefBefore = qvc->AddRef() - 1;
+			qvc->Release();
+			prootb->NoteFragmentHeight(qvc, 1, khvo1, 300, 25);
+			prootb->NoteFragmentHeight(qvc, 2, khvo1, 300, 40);
+			prootb->NoteFragmentHeight(qvc, 1, khvo2, 300, 30);
+			int crefAfter = qvc->AddRef() - 1;
+			qvc->Release();
+			unitpp::assert_eq("Memo holds the view constructor", crefBefore + 1, crefAfter);
+			unitpp::assert_true("Height remembered",
+				prootb->RetrieveFragmentHeight(qvc, 2, khvo1, 300, &dysHeight));
+			unitpp::assert_eq("Height for the right fragment", 40, dysHeight);
+			unitpp::assert_true("Other width not remembered",
+				!prootb->RetrieveFragmentHeight(qvc, 1, khvo1, 200, &dysHeight));
+			prootb->NoteFragmentHeight(qvc, 1, khvo1, 300, 27);
+			prootb->RetrieveFragmentHeight(qvc, 1, khvo1, 300, &dysHeight);
+			unitpp::assert_eq("Height replaced", 27, dysHeight);
+
+			// A change to one object forgets only its displays.
+			prootb->ForgetFragmentHeights(khvo1);
+			unitpp::assert_true("Changed object forgotten",
+				!prootb->RetrieveFragmentHeight(qvc, 1, khvo1, 300, &dysHeight) &&
+				!prootb->RetrieveFragmentHeight(qvc, 2, khvo1, 300, &dysHeight));
+			unitpp::assert_true("Other object kept",
+				prootb->RetrieveFragmentHeight(qvc, 1, khvo2, 300, &dysHeight));
+
+			// Turning it off forgets everything and lets go of the view constructor.
+			CheckHr(qrootb->put_RememberFragmentHeights(false));
+			unitpp::assert_true("All forgotten",
+				!prootb->RetrieveFragmentHeight(qvc, 1, khvo2, 300, &dysHeight));
+			crefAfter = qvc->AddRef() - 1;
+			qvc->Release();
+			unitpp::assert_eq("View constructor released", crefBefore, crefAfter);
+
+			qrootb->Close();
+		}
+
+		void testReconstructKeepingLayout()
+		{
+			ITsStrFactoryPtr qtsf;
+			qtsf.CreateInstance(CLSID_TsStrFactory);
+			IVwCacheDaPtr qcda;
+			qcda.CreateInstance(CLSID_VwCacheDa);
+			qcda->putref_TsStrFactory(qtsf);
+			ISilDataAccessPtr qsda;
+			CheckHr(qcda->QueryInterface(IID_ISilDataAccess, (void **)&qsda));
+			CheckHr(qsda->putref_WritingSystemFactory(g_qwsf));
+
+			ITsStringPtr qtss;
+			StrUni stuPara1(L"This paragraph does not change");
+			CheckHr(qtsf->MakeString(stuPara1.Bstr(), g_wsEng, &qtss));
+			CheckHr(qcda->CacheStringProp(khvoOrigPara1, kflidStTxtPara_Contents, qtss));
+			StrUni stuPara2(L"This one does");
+			CheckHr(qtsf->MakeString(stuPara2.Bstr(), g_wsEng, &qtss));
+			CheckHr(qcda->CacheStringProp(khvoOrigPara2, kflidStTxtPara_Contents, qtss));
+			HVO rghvo[2] = {khvoOrigPara1, khvoOrigPara2};
+			HVO hvoRootBox = 101;
+			CheckHr(qcda->CacheVecProp(hvoRootBox, kflidStText_Paragraphs, rghvo, 2));
+
+			IRenderEngineFactoryPtr qref;
+			qref.Attach(NewObj MockRenderEngineFactory);
+
+			IVwRootBoxPtr qrootb;
+			VwRootBox::CreateCom(NULL, IID_IVwRootBox, (void **)&qrootb);
+			IVwGraphicsWin32Ptr qvg32;
+			HDC hdc = 0;
+			try
+			{
+				qvg32.CreateInstance(CLSID_VwGraphicsWin32);
+				hdc = GetTestDC();
+				CheckHr(qvg32->Initialize(hdc));
+
+				IVwViewConstructorPtr qvc;
+				qvc.Attach(NewObj DummyParaVc());
+				CheckHr(qrootb->putref_DataAccess(qsda));
+				CheckHr(qrootb->putref_RenderEngineFactory(qref));
+				CheckHr(qrootb->putref_TsStrFactory(qtsf));
+				CheckHr(qrootb->SetRootObject(hvoRootBox, qvc, kfragStText, NULL));
+
+				DummyRootSitePtr qdrs;
+				qdrs.Attach(NewObj DummyRootSite());
+				Rect rcSrc(0, 0, 96, 96);
+				qdrs->SetRects(rcSrc, rcSrc);
+				qdrs->SetGraphics(qvg32);
+				CheckHr(qrootb->SetSite(qdrs));
+				CheckHr(qrootb->Layout(qvg32, 300));
+
+				VwRootBox * prootb = dynamic_cast<VwRootBox *>(qrootb.Ptr());
+				VwParagraphBox * pvpbox1 = dynamic_cast<VwParagraphBox *>(prootb->FirstBox());
+				unitpp::assert_true("First paragraph", pvpbox1 != NULL);
+				VwBox * pboxLine1 = pvpbox1->FirstBox();
+				unitpp::assert_true("First paragraph has been laid out", pboxLine1 != NULL);
+
+				StrUni stuPara2New(L"This one has changed");
+				CheckHr(qtsf->MakeString(stuPara2New.Bstr(), g_wsEng, &qtss));
+				CheckHr(qcda->CacheStringProp(khvoOrigPara2, kflidStTxtPara_Contents, qtss));
+				prootb->Reconstruct(true, true);
+
+				VwParagraphBox * pvpbox1New = dynamic_cast<VwParagraphBox *>(prootb->FirstBox());
+				unitpp::assert_true("First paragraph rebuilt", pvpbox1New != NULL);
+				unitpp::assert_true("Unchanged paragraph keeps its lines",
+					pvpbox1New->FirstBox() == pboxLine1);
+				unitpp::assert_true("Lines belong to the new paragraph",
+					pboxLine1->Container() == pvpbox1New);
+				VwParagraphBox * pvpbox2New = dynamic_cast<VwParagraphBox *>(pvpbox1New->Next());
+				unitpp::assert_true("Second paragraph rebuilt", pvpbox2New != NULL);
+				unitpp::assert_eq("Changed paragraph shows the new contents",
+					stuPara2New.Length(), pvpbox2New->Source()->Cch());
+				unitpp::assert_true("Changed paragraph has been laid out",
+					pvpbox2New->FirstBox() != NULL && pvpbox2New->Height() > 0);
+			}
+			catch(...)
+			{
+				if (qvg32)
+					qvg32->ReleaseDC();
+				if (hdc != 0)
+					ReleaseTestDC(hdc);
+				qrootb->Close();
+				throw;
+			}
+
+			qvg32->ReleaseDC();
+			ReleaseTestDC(hdc);
+			qrootb->Close();
+		}
+
 		void testPutrefOverlayRelayoutsWithoutDirtyingConstructedView()
 		{
 			class TaggedParagraphVc : public DummyBaseVc
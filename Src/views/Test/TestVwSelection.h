@@ -370,6 +370,24 @@ namespace TestViews
 		ITsStringPtr m_qtssLit;
 	};
 
+	// Display prop1 and prop2 each in a paragraph of its own, letting the env make the
+	// paragraphs (as a browse cell does).
+	class StringPropParasVc : public DummyBaseVc
+	{
+	public:
+		STDMETHOD(Display)(IVwEnv* pvwenv, HVO hvo, int frag)
+		{
+			switch(frag)
+			{
+			case 1: // the root; no paragraph open, so each property gets one made for it.
+				pvwenv->AddStringProp(kflidProp1, NULL);
+				pvwenv->AddStringProp(kflidProp2, NULL);
+				break;
+			}
+			return S_OK;
+		}
+	};
+
 	// Display a single paragraph made up of multiple strings.
 	class ComplexParaVc : public DummyBaseVc
 	{
@@ -3182,6 +3200,169 @@ namespace TestViews
 			VerifyParaContents(0, OleStringLiteral(L"String 1litString 2c"));
 		}
 
+		// A string property displayed with no paragraph open gets a paragraph made for it by
+		// VwEnv. A single-run string gets the single-run text source; editing it into several
+		// runs must fall back to the ordinary behavior.
+		void testSingleRunParagraphs()
+		{
+			ITsStringPtr qtss1;
+			StrUni stuProp1(L"String 1");
+			m_qtsf->MakeString(stuProp1.Bstr(), g_wsEng, &qtss1);
+			m_qcda->CacheStringProp(khvoBook, kflidProp1, qtss1);
+			// Prop2 has two runs: "String 2" followed by " deux" in French.
+			ITsStringPtr qtss2;
+			StrUni stuProp2(L"String 2");
+			m_qtsf->MakeString(stuProp2.Bstr(), g_wsEng, &qtss2);
+			ITsStrBldrPtr qtsb;
+			qtss2->GetBldr(&qtsb);
+			ITsPropsBldrPtr qtpb;
+			qtpb.CreateInstance(CLSID_TsPropsBldr);
+			qtpb->SetIntPropValues(ktptWs, ktpvDefault, g_wsFrn);
+			ITsTextPropsPtr qttpFrn;
+			qtpb->GetTextProps(&qttpFrn);
+			qtsb->ReplaceRgch(stuProp2.Length(), stuProp2.Length(), OleStringLiteral(L" deux"), 5,
+				qttpFrn);
+			qtsb->GetString(&qtss2);
+			m_qcda->CacheStringProp(khvoBook, kflidProp2, qtss2);
+
+			m_qvc.Attach(NewObj StringPropParasVc());
+			m_qrootb->SetRootObject(khvoBook, m_qvc, 1, NULL);
+			HRESULT hr = m_qrootb->Layout(m_qvg32, 300);
+			unitpp::assert_eq("testSingleRunParagraphs Layout succeeded", S_OK, hr);
+
+			VwParagraphBox * pvpbox1 = dynamic_cast<VwParagraphBox *>(m_qrootb->FirstRealBox());
+			unitpp::assert_true("first paragraph made", pvpbox1);
+			VwParagraphBox * pvpbox2 = dynamic_cast<VwParagraphBox *>(pvpbox1->NextRealBox());
+			unitpp::assert_true("second paragraph made", pvpbox2);
+			unitpp::assert_eq("single-run string gets the single-run source",
+				kvstSingleRun, pvpbox1->Source()->SourceType());
+			unitpp::assert_eq("two-run string gets an ordinary source",
+				kvstNormal, pvpbox2->Source()->SourceType());
+			VerifyParaContents(0, stuProp1.Chars());
+			VerifyParaContents(1, OleStringLiteral(L"String 2 deux"));
+
+			// Insert some French after "String", which splits prop1 into three runs.
+			StrUni stuIns(L" un");
+			ITsStringPtr qtssIns;
+			m_qtsf->MakeString(stuIns.Bstr(), g_wsFrn, &qtssIns);
+			int ichIns = 6;
+			VwTextSelectionPtr qsel;
+			qsel.Attach(NewObj VwTextSelection(pvpbox1, ichIns, ichIns, false, NULL));
+			m_qrootb->SetSelection(qsel, false);
+			m_qdrs->SimulateBeginUnitOfWork();
+			qsel->ReplaceWithTsString(qtssIns);
+			m_qdrs->SimulateEndUnitOfWork();
+
+			VerifyPropContents(kflidProp1, OleStringLiteral(L"String un 1"));
+			VerifyParaContents(0, OleStringLiteral(L"String un 1"));
+			pvpbox1 = dynamic_cast<VwParagraphBox *>(m_qrootb->FirstRealBox());
+			VwSingleRunTxtSrc * pts = dynamic_cast<VwSingleRunTxtSrc *>(pvpbox1->Source());
+			unitpp::assert_true("edited paragraph still has a single-run source", pts);
+			unitpp::assert_true("edited paragraph no longer a single run", !pts->IsSingleRun());
+			LgCharRenderProps chrp;
+			int ichMin, ichLim;
+			hr = pts->GetCharProps(0, &chrp, &ichMin, &ichLim);
+			unitpp::assert_eq("GetCharProps at start succeeded", S_OK, hr);
+			unitpp::assert_eq("first run is English", g_wsEng, chrp.ws);
+			unitpp::assert_eq("first run starts the paragraph", 0, ichMin);
+			unitpp::assert_eq("first run ends at the insertion", ichIns, ichLim);
+			hr = pts->GetCharProps(ichIns, &chrp, &ichMin, &ichLim);
+			unitpp::assert_eq("GetCharProps in insertion succeeded", S_OK, hr);
+			unitpp::assert_eq("inserted run is French", g_wsFrn, chrp.ws);
+			unitpp::assert_eq("inserted run starts at the insertion", ichIns, ichMin);
+			unitpp::assert_eq("inserted run ends after the insertion", ichIns + stuIns.Length(),
+				ichLim);
+			hr = pts->GetCharProps(ichLim, &chrp, &ichMin, &ichLim);
+			unitpp::assert_eq("GetCharProps after insertion succeeded", S_OK, hr);
+			unitpp::assert_eq("last run is English", g_wsEng, chrp.ws);
+			unitpp::assert_eq("last run ends the paragraph", pts->Cch(), ichLim);
+		}
+
+		// Check which runs GetSelectionProps reports as bold for the selection.
+		void VerifySelectionBold(IVwSelection * psel, int cttpExpected, const bool * prgfBold,
+			const char * pszWhat)
+		{
+			StrAnsi staMsg;
+			int cttp;
+			CheckHr(psel->GetSelectionProps(0, NULL, NULL, &cttp));
+			staMsg.Format("%s: run count", pszWhat);
+			unitpp::assert_eq(staMsg.Chars(), cttpExpected, cttp);
+			Vector<ITsTextProps *> vpttp;
+			Vector<IVwPropertyStore *> vpvps;
+			vpttp.Resize(cttp);
+			vpvps.Resize(cttp);
+			CheckHr(psel->GetSelectionProps(cttp, vpttp.Begin(), vpvps.Begin(), &cttp));
+			staMsg.Format("%s: run count when getting props", pszWhat);
+			unitpp::assert_eq(staMsg.Chars(), cttpExpected, cttp);
+			for (int ittp = 0; ittp < cttp; ittp++)
+			{
+				int nWeight; // what a property store answers for ktptBold
+				CheckHr(vpvps[ittp]->get_IntProperty(ktptBold, &nWeight));
+				staMsg.Format("%s: bold of run %d", pszWhat, ittp);
+				unitpp::assert_eq(staMsg.Chars(), prgfBold[ittp], nWeight > 550);
+				ReleaseObj(vpttp[ittp]);
+				ReleaseObj(vpvps[ittp]);
+			}
+		}
+
+		// GetSelectionProps takes whole paragraphs from the text source's run props summary
+		// and walks the runs of partial ones; either way each run gets an entry.
+		void testGetSelectionProps_Range()
+		{
+			HVO rghvoPara[3] = {khvoOrigPara1, khvoOrigPara2, khvoOrigPara3};
+			ITsStringPtr qtss;
+			StrUni stuPara1(L"First paragraph");
+			m_qtsf->MakeString(stuPara1.Bstr(), g_wsEng, &qtss);
+			m_qcda->CacheStringProp(khvoOrigPara1, kflidStTxtPara_Contents, qtss);
+			StrUni stuPara2(L"Bold and plain");
+			m_qtsf->MakeString(stuPara2.Bstr(), g_wsEng, &qtss);
+			ITsStrBldrPtr qtsb;
+			qtss->GetBldr(&qtsb);
+			qtsb->SetIntPropValues(0, 4, ktptBold, ktpvEnum, kttvForceOn);
+			qtsb->GetString(&qtss);
+			m_qcda->CacheStringProp(khvoOrigPara2, kflidStTxtPara_Contents, qtss);
+			StrUni stuPara3(L"Third paragraph");
+			m_qtsf->MakeString(stuPara3.Bstr(), g_wsEng, &qtss);
+			m_qcda->CacheStringProp(khvoOrigPara3, kflidStTxtPara_Contents, qtss);
+			m_qcda->CacheVecProp(khvoBook, kflidStText_Paragraphs, rghvoPara, 3);
+
+			m_qvc.Attach(NewObj SimpleStTextVc());
+			m_qrootb->SetRootObject(khvoBook, m_qvc, 1, NULL);
+			HRESULT hr = m_qrootb->Layout(m_qvg32, 300);
+			unitpp::assert_eq("testGetSelectionProps_Range Layout succeeded", S_OK, hr);
+			VwParagraphBox * pvpbox1 = dynamic_cast<VwParagraphBox *>(m_qrootb->FirstRealBox());
+			VwParagraphBox * pvpbox2 = dynamic_cast<VwParagraphBox *>(pvpbox1->NextRealBox());
+			VwParagraphBox * pvpbox3 = dynamic_cast<VwParagraphBox *>(pvpbox2->NextRealBox());
+
+			// From the middle of the first paragraph to the middle of the third: one run at
+			// each end, and both runs of the whole paragraph in between.
+			bool rgfAcross[] = {false, true, false, false};
+			VwTextSelectionPtr qsel;
+			qsel.Attach(NewObj VwTextSelection(pvpbox1, 6, 5, false, pvpbox3));
+			VerifySelectionBold(qsel, 4, rgfAcross, "across three paragraphs");
+			// Asking again answers the same from the kept summary.
+			VerifySelectionBold(qsel, 4, rgfAcross, "across three paragraphs again");
+			// Made backwards, the selection covers the same runs.
+			qsel.Attach(NewObj VwTextSelection(pvpbox3, 5, 6, false, pvpbox1));
+			VerifySelectionBold(qsel, 4, rgfAcross, "across three paragraphs backwards");
+
+			// Part of the middle paragraph gets only the runs it overlaps.
+			bool rgfPartial[] = {true};
+			qsel.Attach(NewObj VwTextSelection(pvpbox2, 1, 3, false, NULL));
+			VerifySelectionBold(qsel, 1, rgfPartial, "within the bold run");
+
+			// Making the middle paragraph a single plain run gets it a new summary.
+			m_qtsf->MakeString(stuPara2.Bstr(), g_wsEng, &qtss);
+			m_qcda->CacheStringProp(khvoOrigPara2, kflidStTxtPara_Contents, qtss);
+			m_qrootb->PropChanged(khvoOrigPara2, kflidStTxtPara_Contents, 0, stuPara2.Length(),
+				stuPara2.Length());
+			pvpbox1 = dynamic_cast<VwParagraphBox *>(m_qrootb->FirstRealBox());
+			pvpbox3 = dynamic_cast<VwParagraphBox *>(pvpbox1->NextRealBox()->NextRealBox());
+			bool rgfPlain[] = {false, false, false};
+			qsel.Attach(NewObj VwTextSelection(pvpbox1, 6, 5, false, pvpbox3));
+			VerifySelectionBold(qsel, 3, rgfPlain, "after the middle paragraph changed");
+		}
+
 		void testDropCapsPosition_TimesNewRoman()
 		{
 			// Set up a simple stylesheet
@@ -3650,6 +3831,133 @@ namespace TestViews
 			unitpp::assert_true("Line broke at the non-breaking space.", ich > 5);
 		}
 
+		// Vertical navigation uses an index of where the lines are (see
+		// VwRootBox::NextLineBaseline). It must be kept up to date when an edit relays out a
+		// paragraph, moving the lines below it.
+		void testDownArrowAfterParagraphGrows()
+		{
+			ITsStringPtr qtss;
+			StrUni stuPara1(L"abc");
+			m_qtsf->MakeString(stuPara1.Bstr(), g_wsEng, &qtss);
+			m_qcda->CacheStringProp(khvoOrigPara1, kflidStTxtPara_Contents, qtss);
+			StrUni stuPara2(L"def");
+			m_qtsf->MakeString(stuPara2.Bstr(), g_wsEng, &qtss);
+			m_qcda->CacheStringProp(khvoOrigPara2, kflidStTxtPara_Contents, qtss);
+			HVO rghvo[2] = { khvoOrigPara1, khvoOrigPara2 };
+			HVO hvoRootBox = 101;
+			m_qcda->CacheVecProp(hvoRootBox, kflidStText_Paragraphs, rghvo, 2);
+			m_qvc.Attach(NewObj DummyParaVc());
+			m_qrootb->SetRootObject(hvoRootBox, m_qvc, kfragStText, NULL);
+			CheckHr(m_qrootb->Layout(m_qvg32, 100));
+			CheckHr(m_qrootb->Activate(vssEnabled));
+
+			// Moving down from the first paragraph builds the index.
+			Rect rc = Rect(0, 0, 96, 96);
+			int xdPos = -1;
+			IVwSelectionPtr qsel;
+			CheckHr(m_qrootb->MakeSimpleSel(true, true, false, true, &qsel));
+			unitpp::assert_true("Down arrow from first paragraph",
+				dynamic_cast<VwTextSelection *>(qsel.Ptr())->DownArrow(m_qvg32, rc, rc, &xdPos));
+			int ich;
+			ComBool fAssocPrev;
+			HVO hvoPara;
+			PropTag tag;
+			int ws;
+			CheckHr(qsel->TextSelInfo(false, &qtss, &ich, &fAssocPrev, &hvoPara, &tag, &ws));
+			unitpp::assert_eq("Moved into the second paragraph", khvoOrigPara2, hvoPara);
+
+			// The first paragraph grows to several lines, pushing the second one down below
+			// where any line used to be.
+			StrUni stuLong(L"abcd efgh ijkl mnop qrst uvwx yzab cdef ghij klmn opqr stuv wxyz");
+			m_qtsf->MakeString(stuLong.Bstr(), g_wsEng, &qtss);
+			m_qcda->CacheStringProp(khvoOrigPara1, kflidStTxtPara_Contents, qtss);
+			m_qsda->PropChanged(NULL, kpctNotifyAll, khvoOrigPara1, kflidStTxtPara_Contents, 0,
+				stuLong.Length(), stuPara1.Length());
+			VwParagraphBox * pvpbox1 = dynamic_cast<VwParagraphBox *>(m_qrootb->FirstBox());
+			unitpp::assert_true("First paragraph now has several lines",
+				pvpbox1->FirstBox() != pvpbox1->LastBox());
+			VwParagraphBox * pvpbox2 = dynamic_cast<VwParagraphBox *>(pvpbox1->Next());
+			int ysPara2 = pvpbox2->FirstBox()->TopToTopOfDocument() +
+				pvpbox2->FirstBox()->Ascent();
+			int ysLastLine1 = pvpbox1->LastBox()->TopToTopOfDocument() +
+				pvpbox1->LastBox()->Ascent();
+			unitpp::assert_eq("Index knows where the second paragraph moved to", ysPara2,
+				m_qrootb->NextLineBaseline(ysLastLine1));
+			unitpp::assert_eq("Index knows where the last line of the first paragraph is",
+				ysLastLine1, m_qrootb->PrevLineBaseline(ysPara2));
+
+			// Down from the start of the first paragraph now stops at its second line.
+			xdPos = -1;
+			CheckHr(m_qrootb->MakeSimpleSel(true, true, false, true, &qsel));
+			unitpp::assert_true("Down arrow within first paragraph",
+				dynamic_cast<VwTextSelection *>(qsel.Ptr())->DownArrow(m_qvg32, rc, rc, &xdPos));
+			CheckHr(qsel->TextSelInfo(false, &qtss, &ich, &fAssocPrev, &hvoPara, &tag, &ws));
+			unitpp::assert_eq("Still in the first paragraph", khvoOrigPara1, hvoPara);
+			unitpp::assert_true("On a later line", ich > 0);
+		}
+
+		// Down arrow goes one line at a time through a paragraph of several lines, by way of
+		// the line band for each line (not one band for the whole paragraph).
+		void testDownArrowThroughParagraphLines()
+		{
+			ITsStringPtr qtss;
+			StrUni stuPara(L"abcd efgh ijkl mnop qrst uvwx yzab cdef ghij klmn opqr stuv wxyz");
+			m_qtsf->MakeString(stuPara.Bstr(), g_wsEng, &qtss);
+			m_qcda->CacheStringProp(khvoOrigPara1, kflidStTxtPara_Contents, qtss);
+			HVO rghvo[1] = { khvoOrigPara1 };
+			HVO hvoRootBox = 101;
+			m_qcda->CacheVecProp(hvoRootBox, kflidStText_Paragraphs, rghvo, 1);
+			m_qvc.Attach(NewObj DummyParaVc());
+			m_qrootb->SetRootObject(hvoRootBox, m_qvc, kfragStText, NULL);
+			CheckHr(m_qrootb->Layout(m_qvg32, 100));
+			CheckHr(m_qrootb->Activate(vssEnabled));
+
+			// Where each line starts, in characters and in layout coordinates.
+			VwParagraphBox * pvpbox = dynamic_cast<VwParagraphBox *>(m_qrootb->FirstBox());
+			Vector<int> vichLine;
+			Vector<int> vysBaseline;
+			for (VwBox * pbox = pvpbox->FirstBox(); pbox; pbox = pbox->Next())
+			{
+				int ysBaseline = pbox->TopToTopOfDocument() + pbox->Ascent();
+				VwStringBox * psbox = dynamic_cast<VwStringBox *>(pbox);
+				if (psbox && (!vysBaseline.Size() || *vysBaseline.Top() != ysBaseline))
+				{
+					vichLine.Push(psbox->IchMin());
+					vysBaseline.Push(ysBaseline);
+				}
+			}
+			int cline = vysBaseline.Size();
+			unitpp::assert_true("Paragraph has several lines", cline >= 3);
+			for (int iline = 0; iline < cline - 1; iline++)
+			{
+				unitpp::assert_eq("Next line band is the next line", vysBaseline[iline + 1],
+					m_qrootb->NextLineBaseline(vysBaseline[iline]));
+			}
+			unitpp::assert_eq("No line band below the last line", -1,
+				m_qrootb->NextLineBaseline(vysBaseline[cline - 1]));
+
+			Rect rc = Rect(0, 0, 96, 96);
+			int xdPos = -1;
+			IVwSelectionPtr qsel;
+			CheckHr(m_qrootb->MakeSimpleSel(true, true, false, true, &qsel));
+			int ich;
+			ComBool fAssocPrev;
+			HVO hvoPara;
+			PropTag tag;
+			int ws;
+			for (int iline = 1; iline < cline; iline++)
+			{
+				unitpp::assert_true("Down arrow within the paragraph",
+					dynamic_cast<VwTextSelection *>(qsel.Ptr())->DownArrow(m_qvg32, rc, rc,
+						&xdPos));
+				CheckHr(qsel->TextSelInfo(false, &qtss, &ich, &fAssocPrev, &hvoPara, &tag,
+					&ws));
+				unitpp::assert_true("Reached the start of the next line",
+					ich >= vichLine[iline] &&
+					(iline == cline - 1 || ich < vichLine[iline + 1]));
+			}
+		}
+
 		void testExpandToWord()
 		{
 			ITsStringPtr qtss;
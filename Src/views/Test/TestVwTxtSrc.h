@@ -142,6 +142,87 @@ namespace TestViews
 			unitpp::assert_eq("range at cch1+15 is expected color", (COLORREF)54321, chrp.clrFore);
 		}
 
+		// A long paragraph with a squiggle on every word. Every character finds its override,
+		// (on every pass, so answers do not change once cached), and correcting one word
+		// replaces only its override.
+		void testOverride_ManyOverrides()
+		{
+			const int cword = 1000;
+			const int cchWord = 5; // "word "
+			StrUni stuPara;
+			for (int iword = 0; iword < cword; iword++)
+				stuPara.Append(L"word ");
+			ITsStringPtr qtss;
+			CheckHr(m_qtsf->MakeString(stuPara.Bstr(), g_wsEng, &qtss));
+			VwSimpleTxtSrcPtr qsts;
+			qsts.Attach(NewObj VwSimpleTxtSrc);
+			qsts->SetWritingSystemFactory(g_qwsf);
+			VwPropertyStorePtr qzvps;
+			qzvps.Attach(NewObj VwPropertyStore);
+			qsts->AddString(qtss, qzvps, NULL);
+			VwSpellingOverrideTxtSrcPtr qsots;
+			qsots.Attach(NewObj VwSpellingOverrideTxtSrc(qsts));
+
+			PropOverrideVec vdpOverrides;
+			DispPropOverride dpo;
+			::memset(&dpo.chrp, 0, sizeof(dpo.chrp));
+			dpo.chrp.clrUnder = kclrRed;
+			dpo.chrp.unt = kuntSquiggle;
+			for (int iword = 0; iword < cword; iword++)
+			{
+				dpo.ichMin = iword * cchWord;
+				dpo.ichLim = dpo.ichMin + cchWord - 1;
+				vdpOverrides.Push(dpo);
+			}
+			unitpp::assert_true("overrides added", qsots->UpdateOverrides(vdpOverrides));
+
+			const int cpass = 2;
+			for (int ipass = 0; ipass < cpass; ipass++)
+			{
+				for (int ich = 0; ich < stuPara.Length(); ich++)
+				{
+					LgCharRenderProps chrp;
+					int ichMin, ichLim;
+					CheckHr(qsots->GetCharProps(ich, &chrp, &ichMin, &ichLim));
+					int ichWord = ich - ich % cchWord;
+					if (ich % cchWord == cchWord - 1)
+					{
+						unitpp::assert_eq("space ichMin", ich, ichMin);
+						unitpp::assert_eq("space ichLim", ich + 1, ichLim);
+					}
+					else
+					{
+						unitpp::assert_eq("word ichMin", ichWord, ichMin);
+						unitpp::assert_eq("word ichLim", ichWord + cchWord - 1, ichLim);
+					}
+				}
+			}
+
+			// Correct the misspelling of word 500.
+			const int iwordFixed = 500;
+			vdpOverrides.Delete(iwordFixed);
+			int ichMinChanged, ichLimChanged;
+			unitpp::assert_true("overrides changed",
+				qsots->UpdateOverrides(vdpOverrides, &ichMinChanged, &ichLimChanged));
+			unitpp::assert_eq("changed range starts at the word", iwordFixed * cchWord,
+				ichMinChanged);
+			unitpp::assert_eq("changed range ends at the word",
+				iwordFixed * cchWord + cchWord - 1, ichLimChanged);
+			unitpp::assert_true("no further change", !qsots->UpdateOverrides(vdpOverrides));
+
+			int unt, ichLim;
+			COLORREF clrUnder;
+			qsots->GetUnderlineInfo(iwordFixed * cchWord, &unt, &clrUnder, &ichLim);
+			unitpp::assert_true("corrected word not squiggled", unt != kuntSquiggle);
+			unitpp::assert_eq("plain text runs up to the next word", (iwordFixed + 1) * cchWord,
+				ichLim);
+			qsots->GetUnderlineInfo((iwordFixed + 1) * cchWord, &unt, &clrUnder, &ichLim);
+			unitpp::assert_eq("next word still squiggled", (int)kuntSquiggle, unt);
+			unitpp::assert_eq("next word still red", (COLORREF)kclrRed, clrUnder);
+			qsots->GetUnderlineInfo((iwordFixed - 1) * cchWord, &unt, &clrUnder, &ichLim);
+			unitpp::assert_eq("previous word still squiggled", (int)kuntSquiggle, unt);
+		}
+
 		void testStringFromIch_MiddleOfString()
 		{
 			VwSimpleTxtSrcPtr qsts;
@@ -254,6 +335,280 @@ namespace TestViews
 			unitpp::assert_eq("ichLim should be the last character in the data source", cchT, ichLim);
 		}
 
+		// A paragraph with thousands of strings (e.g., an interlinear or concordance-like
+		// display with one string per word) used to walk all the earlier strings on every
+		// lookup. Check that the offset index answers the same as a linear walk would, and
+		// that it is rebuilt when the strings change.
+		void testStringOffsets_ManyStrings()
+		{
+			const int cstr = 5000;
+			VwSimpleTxtSrcPtr qsts;
+			qsts.Attach(NewObj VwSimpleTxtSrc);
+			qsts->SetWritingSystemFactory(g_qwsf);
+			VwPropertyStorePtr qzvps;
+			qzvps.Attach(NewObj VwPropertyStore);
+			Vector<int> vichMin;
+			int cchTotal = 0;
+			for (int istr = 0; istr < cstr; istr++)
+			{
+				// Vary the lengths, including some empty strings.
+				StrUni stu(L"word word word", istr % 7 * 2);
+				ITsStringPtr qtss;
+				CheckHr(m_qtsf->MakeString(stu.Bstr(), g_wsEng, &qtss));
+				qsts->AddString(qtss, qzvps, NULL);
+				vichMin.Push(cchTotal);
+				cchTotal += stu.Length();
+			}
+			unitpp::assert_eq("Cch should be the total length", cchTotal, qsts->Cch());
+
+			for (int istr = 0; istr < cstr; istr++)
+			{
+				unitpp::assert_eq("IchStartString", vichMin[istr], qsts->IchStartString(istr));
+				int cchThis = (istr < cstr - 1 ? vichMin[istr + 1] : cchTotal) - vichMin[istr];
+				if (cchThis == 0)
+					continue;
+				int ichMin, ichLim, itss;
+				ITsStringPtr qtssOut;
+				VwPropertyStorePtr qvps;
+				qsts->StringFromIch(vichMin[istr], false, &qtssOut, &ichMin, &ichLim, &qvps, &itss);
+				unitpp::assert_eq("StringFromIch found the right string", istr, itss);
+				unitpp::assert_eq("StringFromIch ichMin", vichMin[istr], ichMin);
+				unitpp::assert_eq("StringFromIch ichLim", vichMin[istr] + cchThis, ichLim);
+
+				LgCharRenderProps chrp;
+				CheckHr(qsts->GetCharProps(vichMin[istr] + cchThis - 1, &chrp, &ichMin, &ichLim));
+				unitpp::assert_eq("GetCharProps ichMin", vichMin[istr], ichMin);
+				unitpp::assert_eq("GetCharProps ichLim", vichMin[istr] + cchThis, ichLim);
+			}
+
+			// At the very end we get the last string.
+			int ichMin, ichLim, itss;
+			ITsStringPtr qtssOut;
+			VwPropertyStorePtr qvps;
+			qsts->StringFromIch(cchTotal, false, &qtssOut, &ichMin, &ichLim, &qvps, &itss);
+			unitpp::assert_eq("End of paragraph gives the last string", cstr - 1, itss);
+
+			// Replacing a string with a longer one must move all the later offsets.
+			VwSimpleTxtSrcPtr qstsRep;
+			qstsRep.Attach(NewObj VwSimpleTxtSrc);
+			StrUni stuRep(L"replacement");
+			ITsStringPtr qtssRep;
+			CheckHr(m_qtsf->MakeString(stuRep.Bstr(), g_wsEng, &qtssRep));
+			qstsRep->AddString(qtssRep, qzvps, NULL);
+			int cchOld = vichMin[2] - vichMin[1];
+			qsts->ReplaceContents(1, 2, qstsRep);
+			int dcch = stuRep.Length() - cchOld;
+			unitpp::assert_eq("Cch after replace", cchTotal + dcch, qsts->Cch());
+			unitpp::assert_eq("Later string moved", vichMin[cstr - 1] + dcch,
+				qsts->IchStartString(cstr - 1));
+
+			// So must adding an embedded box through EditVpst().
+			qsts->EditVpst().Push(VpsTssRec(qzvps, NULL));
+			unitpp::assert_eq("Cch after adding a box", cchTotal + dcch + 1, qsts->Cch());
+		}
+
+		// GetCharProps answers the largest range with the same properties, across runs and
+		// strings, except that an embedded box is always a range by itself.
+		void testGetCharProps_MergesEqualRuns()
+		{
+			VwSimpleTxtSrcPtr qsts;
+			qsts.Attach(NewObj VwSimpleTxtSrc);
+			qsts->SetWritingSystemFactory(g_qwsf);
+			VwPropertyStorePtr qzvps;
+			qzvps.Attach(NewObj VwPropertyStore);
+
+			StrUni stuTest1(L"abc");
+			StrUni stuTest2(L"def");
+			StrUni stuTest3(L"ghi");
+			ITsStringPtr qtss1;
+			CheckHr(m_qtsf->MakeString(stuTest1.Bstr(), g_wsEng, &qtss1));
+			ITsStringPtr qtss2;
+			CheckHr(m_qtsf->MakeString(stuTest2.Bstr(), g_wsEng, &qtss2));
+			ITsStringPtr qtss3;
+			CheckHr(m_qtsf->MakeString(stuTest3.Bstr(), g_wsEng, &qtss3));
+			// Make the 'h' bold.
+			ITsStrBldrPtr qtsb;
+			CheckHr(qtss3->GetBldr(&qtsb));
+			CheckHr(qtsb->SetIntPropValues(1, 2, ktptBold, ktpvEnum, kttvForceOn));
+			CheckHr(qtsb->GetString(&qtss3));
+			qsts->AddString(qtss1, qzvps, NULL);
+			qsts->AddString(qtss2, qzvps, NULL);
+			qsts->AddString(qtss3, qzvps, NULL);
+
+			int ichMin, ichLim;
+			LgCharRenderProps chrp;
+			CheckHr(qsts->GetCharProps(4, &chrp, &ichMin, &ichLim));
+			unitpp::assert_eq("plain range starts at 0", 0, ichMin);
+			unitpp::assert_eq("plain range runs into the third string", 7, ichLim);
+			unitpp::assert_eq("plain range is not bold", kttvOff, chrp.ttvBold);
+			CheckHr(qsts->GetCharProps(7, &chrp, &ichMin, &ichLim));
+			unitpp::assert_eq("bold range starts at 7", 7, ichMin);
+			unitpp::assert_eq("bold range ends at 8", 8, ichLim);
+			unitpp::assert_eq("bold range is bold", kttvForceOn, chrp.ttvBold);
+			CheckHr(qsts->GetCharProps(8, &chrp, &ichMin, &ichLim));
+			unitpp::assert_eq("last range starts at 8", 8, ichMin);
+			unitpp::assert_eq("last range ends at 9", 9, ichLim);
+
+			// An embedded box with the same properties is not merged with the text, and
+			// adding it is noticed.
+			qsts->EditVpst().Push(VpsTssRec(qzvps, NULL));
+			CheckHr(qsts->GetCharProps(8, &chrp, &ichMin, &ichLim));
+			unitpp::assert_eq("text before box ends at 9", 9, ichLim);
+			CheckHr(qsts->GetCharProps(9, &chrp, &ichMin, &ichLim));
+			unitpp::assert_eq("box range starts at 9", 9, ichMin);
+			unitpp::assert_eq("box range ends at 10", 10, ichLim);
+
+			// Runs that render the same but differ in named style (which has no effect
+			// without a stylesheet) are not merged, since VwPattern treats a range as a run.
+			VwSimpleTxtSrcPtr qsts2;
+			qsts2.Attach(NewObj VwSimpleTxtSrc);
+			qsts2->SetWritingSystemFactory(g_qwsf);
+			StrUni stuStyle(L"Emphasis");
+			CheckHr(qtss2->GetBldr(&qtsb));
+			CheckHr(qtsb->SetStrPropValue(0, 3, ktptNamedStyle, stuStyle.Bstr()));
+			CheckHr(qtsb->GetString(&qtss2));
+			qsts2->AddString(qtss1, qzvps, NULL);
+			qsts2->AddString(qtss2, qzvps, NULL);
+			LgCharRenderProps chrpStyled;
+			CheckHr(qsts2->GetCharProps(1, &chrp, &ichMin, &ichLim));
+			unitpp::assert_eq("unstyled range ends at 3", 3, ichLim);
+			CheckHr(qsts2->GetCharProps(4, &chrpStyled, &ichMin, &ichLim));
+			unitpp::assert_eq("styled range starts at 3", 3, ichMin);
+			unitpp::assert_true("styled range renders the same",
+				!memcmp(&chrp, &chrpStyled, isizeof(LgCharRenderProps)));
+		}
+
+		// A single-run text source answers from what it cached just as a simple one would,
+		// and goes on working when it gets more than one run.
+		void testSingleRun()
+		{
+			VwSingleRunTxtSrcPtr qsrts;
+			qsrts.Attach(NewObj VwSingleRunTxtSrc);
+			qsrts->SetWritingSystemFactory(g_qwsf);
+			VwPropertyStorePtr qzvps;
+			qzvps.Attach(NewObj VwPropertyStore);
+			StrUni stuTest1(L"abcdef");
+			ITsStringPtr qtss1;
+			CheckHr(m_qtsf->MakeString(stuTest1.Bstr(), g_wsEng, &qtss1));
+			qsrts->AddString(qtss1, qzvps, NULL);
+
+			unitpp::assert_true("one run", qsrts->IsSingleRun());
+			unitpp::assert_eq("SourceType", kvstSingleRun, qsrts->SourceType());
+			int cch;
+			CheckHr(qsrts->get_Length(&cch));
+			unitpp::assert_eq("get_Length", 6, cch);
+			unitpp::assert_eq("IchStartString(1)", 6, qsrts->IchStartString(1));
+			OLECHAR rgch[10];
+			CheckHr(qsrts->Fetch(1, 4, rgch));
+			unitpp::assert_true("Fetch", wcsncmp(rgch, OleStringLiteral(L"bcd"), 3) == 0);
+			CheckHr(qsrts->Fetch(5, 8, rgch));
+			unitpp::assert_eq("Fetch stops at the end", (OLECHAR)'f', rgch[0]);
+			unitpp::assert_eq("past the end is left alone", (OLECHAR)'c', rgch[1]);
+
+			int ichMin, ichLim;
+			LgCharRenderProps chrp;
+			CheckHr(qsrts->GetCharProps(2, &chrp, &ichMin, &ichLim));
+			unitpp::assert_eq("run starts at 0", 0, ichMin);
+			unitpp::assert_eq("run ends at 6", 6, ichLim);
+			unitpp::assert_eq("run is in the string's ws", g_wsEng, chrp.ws);
+			CheckHr(qsrts->GetCharProps(6, &chrp, &ichMin, &ichLim));
+			unitpp::assert_eq("end of para is in the run", 6, ichLim);
+
+			// Another string (with a different run) makes it an ordinary simple source.
+			StrUni stuTest2(L"gh");
+			ITsStringPtr qtss2;
+			CheckHr(m_qtsf->MakeString(stuTest2.Bstr(), g_wsEng, &qtss2));
+			ITsStrBldrPtr qtsb;
+			CheckHr(qtss2->GetBldr(&qtsb));
+			CheckHr(qtsb->SetIntPropValues(0, 2, ktptBold, ktpvEnum, kttvForceOn));
+			CheckHr(qtsb->GetString(&qtss2));
+			qsrts->AddString(qtss2, qzvps, NULL);
+			unitpp::assert_true("two strings", !qsrts->IsSingleRun());
+			CheckHr(qsrts->get_Length(&cch));
+			unitpp::assert_eq("get_Length of both", 8, cch);
+			CheckHr(qsrts->Fetch(5, 8, rgch));
+			unitpp::assert_true("Fetch across strings",
+				wcsncmp(rgch, OleStringLiteral(L"fgh"), 3) == 0);
+			CheckHr(qsrts->GetCharProps(2, &chrp, &ichMin, &ichLim));
+			unitpp::assert_eq("plain run ends at 6", 6, ichLim);
+			unitpp::assert_eq("plain run not bold", kttvOff, chrp.ttvBold);
+			CheckHr(qsrts->GetCharProps(7, &chrp, &ichMin, &ichLim));
+			unitpp::assert_eq("bold run starts at 6", 6, ichMin);
+			unitpp::assert_eq("bold run is bold", kttvForceOn, chrp.ttvBold);
+
+			// Back to one string with one run.
+			qsrts->EditVpst().Delete(1);
+			unitpp::assert_true("one run again", qsrts->IsSingleRun());
+			unitpp::assert_eq("Cch", 6, qsrts->Cch());
+		}
+
+		// RunProps summarizes each run of the paragraph with the style of its own string, and
+		// keeps the summary until the strings change.
+		void testRunProps()
+		{
+			VwSimpleTxtSrcPtr qsts;
+			qsts.Attach(NewObj VwSimpleTxtSrc);
+			qsts->SetWritingSystemFactory(g_qwsf);
+			VwPropertyStorePtr qzvps;
+			qzvps.Attach(NewObj VwPropertyStore);
+			VwPropertyStorePtr qzvpsItalic;
+			CheckHr(qzvps->ComputedPropertiesForInt(ktptItalic, ktpvEnum, kttvForceOn,
+				&qzvpsItalic));
+
+			// The first string has a bold run and a plain one; the second a single run.
+			StrUni stuTest1(L"This is a string");
+			ITsStringPtr qtss1;
+			CheckHr(m_qtsf->MakeString(stuTest1.Bstr(), g_wsEng, &qtss1));
+			ITsStrBldrPtr qtsb;
+			CheckHr(qtss1->GetBldr(&qtsb));
+			CheckHr(qtsb->SetIntPropValues(0, 4, ktptBold, ktpvEnum, kttvForceOn));
+			CheckHr(qtsb->GetString(&qtss1));
+			StrUni stuTest2(L"in italics");
+			ITsStringPtr qtss2;
+			CheckHr(m_qtsf->MakeString(stuTest2.Bstr(), g_wsEng, &qtss2));
+			qsts->AddString(qtss1, qzvps, NULL);
+			qsts->AddString(qtss2, qzvpsItalic, NULL);
+
+			RunPropsVec & vrpr = qsts->RunProps();
+			unitpp::assert_eq("one entry per run", 3, vrpr.Size());
+			unitpp::assert_eq("first run is bold", kttvForceOn, vrpr[0].qzvps->Chrp()->ttvBold);
+			unitpp::assert_eq("second run is plain", kttvOff, vrpr[1].qzvps->Chrp()->ttvBold);
+			unitpp::assert_eq("second run uses its string's style", kttvOff,
+				vrpr[1].qzvps->Chrp()->ttvItalic);
+			unitpp::assert_eq("third run uses its string's style", kttvForceOn,
+				vrpr[2].qzvps->Chrp()->ttvItalic);
+
+			RunPropsVec vrprAll;
+			qsts->CollectRunProps(0, qsts->Cch(), vrprAll);
+			unitpp::assert_eq("same runs as collecting the whole paragraph", vrprAll.Size(),
+				vrpr.Size());
+			for (int irpr = 0; irpr < vrpr.Size(); irpr++)
+			{
+				unitpp::assert_true("same text props as collecting the whole paragraph",
+					vrprAll[irpr].qttp.Ptr() == vrpr[irpr].qttp.Ptr());
+			}
+			RunPropsVec vrprPartial;
+			qsts->CollectRunProps(2, stuTest1.Length() + 2, vrprPartial);
+			unitpp::assert_eq("a partial range gets only the runs it overlaps", 3,
+				vrprPartial.Size());
+			vrprPartial.Clear();
+			qsts->CollectRunProps(5, 7, vrprPartial);
+			unitpp::assert_eq("a range within one run gets that run", 1, vrprPartial.Size());
+
+			// Asking again reuses the summary.
+			VwPropertyStore * pzvpsFirst = vrpr[0].qzvps;
+			unitpp::assert_true("summary kept", &qsts->RunProps() == &vrpr &&
+				qsts->RunProps()[0].qzvps.Ptr() == pzvpsFirst);
+
+			// Changing the strings rebuilds it.
+			qsts->EditVpst()[1].qzvps = qzvps;
+			unitpp::assert_eq("restyled string still one run", 3, qsts->RunProps().Size());
+			unitpp::assert_eq("restyled string no longer italic", kttvOff,
+				qsts->RunProps()[2].qzvps->Chrp()->ttvItalic);
+			qsts->EditVpst().Delete(1);
+			unitpp::assert_eq("removed string's run gone", 2, qsts->RunProps().Size());
+		}
+
 		virtual void Setup()
 		{
 			CreateTestWritingSystemFactory();
@@ -442,6 +797,75 @@ namespace TestViews
 			unitpp::assert_eq("SearchToLog returned wrong value", 4, cch);
 		}
 
+		// Fetch and FetchSearch answer from text saved by the first call, until the contents
+		// change.
+		void testFetch_Cached()
+		{
+			// Make a string with a footnote ORC in the middle.
+			ITsStrBldrPtr qtsb;
+			qtsb.CreateInstance(CLSID_TsStrBldr);
+			ITsPropsBldrPtr qtpb;
+			qtpb.CreateInstance(CLSID_TsPropsBldr);
+			CheckHr(qtpb->SetIntPropValues(ktptWs, ktpvDefault, g_wsEng));
+			ITsTextPropsPtr qttp;
+			CheckHr(qtpb->GetTextProps(&qttp));
+			StrUni stuText(L"abcdef");
+			CheckHr(qtsb->Replace(0, 0, stuText.Bstr(), qttp));
+			StrUni stuData;
+			OLECHAR * prgchData;
+			GUID uidFootnote;
+			CheckHr(CoCreateGuid(&uidFootnote));
+			stuData.SetSize(isizeof(GUID) / isizeof(OLECHAR) + 1, &prgchData);
+			*prgchData = kodtOwnNameGuidHot;
+			memmove(prgchData + 1, &uidFootnote, isizeof(uidFootnote));
+			CheckHr(qtpb->SetStrPropValue(ktptObjData, stuData.Bstr()));
+			CheckHr(qtpb->GetTextProps(&qttp));
+			OLECHAR chObj = kchObject;
+			CheckHr(qtsb->ReplaceRgch(3, 3, &chObj, 1, qttp));
+			ITsStringPtr qtss;
+			CheckHr(qtsb->GetString(&qtss));
+			m_qts->AddString(qtss, m_qzvps, m_qvc);
+
+			OLECHAR rgch[20];
+			CheckHr(m_qts->Fetch(0, 11, rgch));
+			unitpp::assert_true("Fetch made the substitution",
+				wcsncmp(rgch, OleStringLiteral(L"abc<obj>def"), 11) == 0);
+			unitpp::assert_eq("first Fetch builds the text", 1, m_qts->FetchMisses());
+			CheckHr(m_qts->Fetch(2, 5, rgch));
+			unitpp::assert_true("Fetch of part",
+				wcsncmp(rgch, OleStringLiteral(L"c<o"), 3) == 0);
+			unitpp::assert_eq("second Fetch is a hit", 1, m_qts->FetchHits());
+			// Just reading the strings keeps the cached text.
+			unitpp::assert_eq("one string", 1, m_qts->Vpst().Size());
+			CheckHr(m_qts->Fetch(0, 1, rgch));
+			unitpp::assert_eq("Fetch after reading Vpst is a hit", 2, m_qts->FetchHits());
+
+			// The footnote is left out of the search text, which is cached separately.
+			CheckHr(m_qts->FetchSearch(0, 6, rgch));
+			unitpp::assert_true("FetchSearch left out the footnote",
+				wcsncmp(rgch, OleStringLiteral(L"abcdef"), 6) == 0);
+			CheckHr(m_qts->FetchSearch(3, 5, rgch));
+			unitpp::assert_true("FetchSearch of part",
+				wcsncmp(rgch, OleStringLiteral(L"de"), 2) == 0);
+			unitpp::assert_eq("FetchSearch misses once", 2, m_qts->FetchMisses());
+			unitpp::assert_eq("FetchSearch then hits", 3, m_qts->FetchHits());
+
+			// Characters past the end are left alone.
+			rgch[1] = 'Z';
+			CheckHr(m_qts->Fetch(10, 12, rgch));
+			unitpp::assert_eq("last char", (OLECHAR)'f', rgch[0]);
+			unitpp::assert_eq("past the end", (OLECHAR)'Z', rgch[1]);
+
+			// Adding a string changes the text.
+			StrUni stuMore(L"xyz");
+			CheckHr(m_qtsf->MakeString(stuMore.Bstr(), g_wsEng, &qtss));
+			m_qts->AddString(qtss, m_qzvps, m_qvc);
+			CheckHr(m_qts->Fetch(9, 14, rgch));
+			unitpp::assert_true("Fetch sees the new string",
+				wcsncmp(rgch, OleStringLiteral(L"efxyz"), 5) == 0);
+			unitpp::assert_eq("changed contents are fetched again", 3, m_qts->FetchMisses());
+		}
+
 		// Test basics of ConcTxtSrc offset conversion.
 		void testConcTxtSrc()
 		{
@@ -509,6 +933,66 @@ namespace TestViews
 			unitpp::assert_eq("wrong min range from GetCharProps", 155, ichMin);
 			unitpp::assert_eq("wrong lim range from GetCharProps", 160, ichLim);
 			unitpp::assert_eq("GetCharProps not bold", kttvForceOn, chrp.ttvBold);
+
+			// Search positions are shifted by the search characters discarded at the start
+			// (one omitted orc fewer than logical ones).
+			int ichSearchX;
+			CheckHr(qcts->LogToSearch(150, &ichSearchX));
+			unitpp::assert_eq("LogToSearch", 149, ichSearchX);
+			CheckHr(qcts->FetchSearch(ichSearchX, ichSearchX + 2, buf));
+			unitpp::assert_true("FetchSearch got wrong data",
+				wcsncmp(buf, OleStringLiteral(L"Xe"), 2) == 0);
+			int ichLogX;
+			CheckHr(qcts->SearchToLog(ichSearchX, false, &ichLogX));
+			unitpp::assert_eq("SearchToLog", 150, ichLogX);
+		}
+
+		// Asks many concordance lines for everything layout and drawing ask for, and checks
+		// that each answers consistently for its trimmed text.
+		void testConcTxtSrc_ManyLines()
+		{
+			const int cline = 100;
+			const int cchLine = 700;
+			const int ichMinItem = 400;
+			const int ichLimItem = 405;
+			StrUni stuLine;
+			for (int ich = 0; ich < cchLine; ich++)
+				stuLine.Append(ich % 6 == 5 ? L" " : L"e");
+			ITsStringPtr qtss;
+			CheckHr(m_qtsf->MakeString(stuLine.Bstr(), g_wsEng, &qtss));
+			Vector<OLECHAR> vch;
+			vch.Resize(cchLine);
+
+			for (int iline = 0; iline < cline; iline++)
+			{
+				VwConcTxtSrcPtr qcts;
+				qcts.Attach(NewObj VwConcTxtSrc());
+				qcts->SetWritingSystemFactory(g_qwsf);
+				qcts->Init(ichMinItem, ichLimItem, true);
+				qcts->AddString(qtss, m_qzvps, m_qvc);
+
+				int cch = qcts->CchRen();
+				// 150 base characters are kept before the item, and 201 after it.
+				unitpp::assert_eq("trimmed length", 150 + 5 + 201, cch);
+				unitpp::assert_eq("Cch", cch, qcts->Cch());
+				unitpp::assert_eq("IchStartString(1)", cch, qcts->IchStartString(1));
+				CheckHr(qcts->Fetch(0, cch, vch.Begin()));
+				for (int ich = 0; ich < cch; )
+				{
+					LgCharRenderProps chrp;
+					int ichMin, ichLim;
+					CheckHr(qcts->GetCharProps(ich, &chrp, &ichMin, &ichLim));
+					unitpp::assert_true("run moves on", ichLim > ich);
+					ich = ichLim;
+				}
+				int cchSearch;
+				CheckHr(qcts->get_LengthSearch(&cchSearch));
+				unitpp::assert_eq("search length", cch, cchSearch);
+				CheckHr(qcts->FetchSearch(0, cchSearch, vch.Begin()));
+				int ichSearch;
+				CheckHr(qcts->LogToSearch(cch / 2, &ichSearch));
+				unitpp::assert_eq("LogToSearch", cch / 2, ichSearch);
+			}
 		}
 
 		void testFontVariations_OverlongEntryWithoutCommaClearsRenderBuffer()
@@ -561,6 +1045,203 @@ namespace TestViews
 				wcscmp(pchrp->szFontVar, sbstrBoundary.Chars()) == 0);
 		}
 
+		// Append the ws-dependent settings for one writing system to a kspWsStyle string.
+		void AppendWsStyle(StrUni & stu, int ws, const wchar_t * pszFont, int mpSize)
+		{
+			StrUni stuFont(pszFont);
+			OLECHAR rgch[4];
+			rgch[0] = (OLECHAR)(ws & 0xffff);
+			rgch[1] = (OLECHAR)((unsigned int)ws >> 16);
+			rgch[2] = (OLECHAR)stuFont.Length();
+			stu.Append(rgch, 3);
+			stu.Append(stuFont);
+			rgch[0] = 1; // one integer property
+			rgch[1] = ktptFontSize;
+			rgch[2] = ktpvMilliPoint;
+			stu.Append(rgch, 3);
+			rgch[0] = (OLECHAR)(mpSize & 0xffff);
+			rgch[1] = (OLECHAR)((unsigned int)mpSize >> 16);
+			stu.Append(rgch, 2);
+		}
+
+		// The stores for runs get the ws-dependent properties for their own writing system
+		// from the (shared, parsed) kspWsStyle of their parent.
+		void testPropertiesForTtp_WsStyles()
+		{
+			int wsFirst = (unsigned int)g_wsEng < (unsigned int)g_wsFrn ? g_wsEng : g_wsFrn;
+			int wsSecond = wsFirst == g_wsEng ? g_wsFrn : g_wsEng;
+			StrUni stuWsStyle;
+			AppendWsStyle(stuWsStyle, wsFirst, L"FirstFont", 11000);
+			AppendWsStyle(stuWsStyle, wsSecond, L"SecondFont", 22000);
+			VwPropertyStorePtr qzvps;
+			qzvps.Attach(NewObj VwPropertyStore());
+			CheckHr(qzvps->put_IntProperty(ktptFontSize, ktpvMilliPoint, 9000));
+			CheckHr(qzvps->put_StringProperty(ktptWsStyle, stuWsStyle.Bstr()));
+
+			ITsPropsBldrPtr qtpb;
+			qtpb.CreateInstance(CLSID_TsPropsBldr);
+			int rgws[3] = { wsSecond, wsFirst, g_wsGer };
+			int rgmp[3] = { 22000, 11000, 9000 };
+			const wchar_t * rgpszFont[3] = { L"SecondFont", L"FirstFont", NULL };
+			for (int i = 0; i < 2; i++)
+			{
+				// Once for a plain run, and again for a bold one, which makes new stores
+				// from the same parent.
+				if (i == 1)
+					CheckHr(qtpb->SetIntPropValues(ktptBold, ktpvEnum, kttvForceOn));
+				for (int iws = 0; iws < 3; iws++)
+				{
+					CheckHr(qtpb->SetIntPropValues(ktptWs, ktpvDefault, rgws[iws]));
+					ITsTextPropsPtr qttp;
+					CheckHr(qtpb->GetTextProps(&qttp));
+					VwPropertyStore * pzvpsRun = qzvps->PropertiesForTtp(qttp);
+					int mp;
+					CheckHr(pzvpsRun->get_FontSize(&mp));
+					unitpp::assert_eq("font size for ws", rgmp[iws], mp);
+					if (rgpszFont[iws])
+					{
+						SmartBstr sbstrFont;
+						CheckHr(pzvpsRun->get_StringProperty(ktptFontFamily, &sbstrFont));
+						StrUni stuFont(sbstrFont.Chars());
+						unitpp::assert_true("font family for ws", stuFont == StrUni(rgpszFont[iws]));
+					}
+				}
+			}
+		}
+
+		// A ttp invoking a named style gets the style's props; changing the style is seen by
+		// stores derived afterwards.
+		void testPropertiesForTtp_NamedStyle()
+		{
+			VwStylesheet * pzss = NewObj VwStylesheet();
+			IVwStylesheetPtr qss;
+			qss.Attach(pzss);
+			StrUni stuName(L"Emphasis");
+			ITsPropsBldrPtr qtpb;
+			qtpb.CreateInstance(CLSID_TsPropsBldr);
+			CheckHr(qtpb->SetIntPropValues(ktptBold, ktpvEnum, kttvForceOn));
+			ITsTextPropsPtr qttpStyle;
+			CheckHr(qtpb->GetTextProps(&qttpStyle));
+			int nGeneration = pzss->Generation();
+			CheckHr(qss->PutStyle(stuName.Bstr(), NULL, 0, 0, 0, 0, false, false,
+				qttpStyle));
+			unitpp::assert_true("PutStyle changes generation", pzss->Generation() != nGeneration);
+			int istyle = pzss->StyleId(stuName.Bstr(), stuName.Length());
+			unitpp::assert_true("style has an id", istyle >= 0);
+			unitpp::assert_true("id gives the props", pzss->StyleProps(istyle) == qttpStyle.Ptr());
+			StrUni stuOther(L"Other");
+			unitpp::assert_eq("unknown style has no id", -1,
+				pzss->StyleId(stuOther.Bstr(), stuOther.Length()));
+
+			ITsPropsBldrPtr qtpbRun;
+			qtpbRun.CreateInstance(CLSID_TsPropsBldr);
+			CheckHr(qtpbRun->SetIntPropValues(ktptWs, ktpvDefault, g_wsEng));
+			CheckHr(qtpbRun->SetStrPropValue(ktptNamedStyle, stuName.Bstr()));
+			ITsTextPropsPtr qttpRun;
+			CheckHr(qtpbRun->GetTextProps(&qttpRun));
+
+			VwPropertyStorePtr qzvps1;
+			qzvps1.Attach(NewObj VwPropertyStore());
+			CheckHr(qzvps1->putref_Stylesheet(qss));
+			unitpp::assert_eq("named style applied", kttvForceOn,
+				qzvps1->PropertiesForTtp(qttpRun)->Chrp()->ttvBold);
+
+			// Redefine the style; it now makes text italic instead.
+			CheckHr(qtpb->SetIntPropValues(ktptBold, -1, -1));
+			CheckHr(qtpb->SetIntPropValues(ktptItalic, ktpvEnum, kttvForceOn));
+			CheckHr(qtpb->GetTextProps(&qttpStyle));
+			CheckHr(qss->PutStyle(stuName.Bstr(), NULL, 0, 0, 0, 0, false, false,
+				qttpStyle));
+			unitpp::assert_eq("same id after replacing", istyle,
+				pzss->StyleId(stuName.Bstr(), stuName.Length()));
+			// A run the store has not seen before must not get the old definition.
+			CheckHr(qtpbRun->SetIntPropValues(ktptWs, ktpvDefault, g_wsFrn));
+			CheckHr(qtpbRun->GetTextProps(&qttpRun));
+			VwPropertyStore * pzvpsRun = qzvps1->PropertiesForTtp(qttpRun);
+			unitpp::assert_eq("new style is italic", kttvForceOn, pzvpsRun->Chrp()->ttvItalic);
+			unitpp::assert_eq("new style is not bold", kttvOff, pzvpsRun->Chrp()->ttvBold);
+		}
+
+		// Run stores with the same character properties answer the same Chrp(), even when
+		// they were derived from different parents.
+		void testChrp_SharedAcrossParents()
+		{
+			VwPropertyStorePtr qzvps1;
+			qzvps1.Attach(NewObj VwPropertyStore());
+			VwPropertyStorePtr qzvps2;
+			qzvps2.Attach(NewObj VwPropertyStore());
+			int cStores, cSharedChrpBefore, cRefsBefore;
+			VwPropertyStore::GetStoreStatistics(&cStores, &cSharedChrpBefore, &cRefsBefore);
+
+			ITsPropsBldrPtr qtpb;
+			qtpb.CreateInstance(CLSID_TsPropsBldr);
+			CheckHr(qtpb->SetIntPropValues(ktptWs, ktpvDefault, g_wsEng));
+			ITsTextPropsPtr qttpPlain;
+			CheckHr(qtpb->GetTextProps(&qttpPlain));
+			CheckHr(qtpb->SetIntPropValues(ktptBold, ktpvEnum, kttvForceOn));
+			ITsTextPropsPtr qttpBold;
+			CheckHr(qtpb->GetTextProps(&qttpBold));
+
+			CachedProps * pchrp1 = qzvps1->PropertiesForTtp(qttpPlain)->Chrp();
+			CachedProps * pchrp2 = qzvps2->PropertiesForTtp(qttpPlain)->Chrp();
+			unitpp::assert_true("different stores share equal props", pchrp1 == pchrp2);
+			CachedProps * pchrpBold = qzvps2->PropertiesForTtp(qttpBold)->Chrp();
+			unitpp::assert_true("different props are not shared", pchrp1 != pchrpBold);
+			unitpp::assert_eq("bold props are bold", kttvForceOn, pchrpBold->ttvBold);
+
+			int cSharedChrp, cRefs;
+			VwPropertyStore::GetStoreStatistics(&cStores, &cSharedChrp, &cRefs);
+			unitpp::assert_eq("two shared sets of props", cSharedChrpBefore + 2, cSharedChrp);
+			unitpp::assert_eq("used by three stores", cRefsBefore + 3, cRefs);
+
+			// When the stores go away, so do the shared props.
+			qzvps1.Clear();
+			qzvps2.Clear();
+			VwPropertyStore::GetStoreStatistics(&cStores, &cSharedChrp, &cRefs);
+			unitpp::assert_eq("shared props released", cSharedChrpBefore, cSharedChrp);
+			unitpp::assert_eq("no more references", cRefsBefore, cRefs);
+		}
+
+		// Unlocking a store frees its shared props if no other store uses them; the
+		// generation tells anything still holding the pointer to get it again.
+		void testChrpGeneration_SharedPropsFreed()
+		{
+			VwPropertyStorePtr qzvps1;
+			qzvps1.Attach(NewObj VwPropertyStore());
+			VwPropertyStorePtr qzvps2;
+			qzvps2.Attach(NewObj VwPropertyStore());
+
+			ITsPropsBldrPtr qtpb;
+			qtpb.CreateInstance(CLSID_TsPropsBldr);
+			CheckHr(qtpb->SetIntPropValues(ktptWs, ktpvDefault, g_wsEng));
+			ITsTextPropsPtr qttpPlain;
+			CheckHr(qtpb->GetTextProps(&qttpPlain));
+			CheckHr(qtpb->SetIntPropValues(ktptItalic, ktpvEnum, kttvForceOn));
+			ITsTextPropsPtr qttpItalic;
+			CheckHr(qtpb->GetTextProps(&qttpItalic));
+
+			// Props another store still uses survive, so the generation doesn't change.
+			VwPropertyStore * pzvpsPlain1 = qzvps1->PropertiesForTtp(qttpPlain);
+			CachedProps * pchrpPlain = pzvpsPlain1->Chrp();
+			unitpp::assert_true("plain props shared",
+				qzvps2->PropertiesForTtp(qttpPlain)->Chrp() == pchrpPlain);
+			int nGen = VwPropertyStore::ChrpGeneration();
+			pzvpsPlain1->Unlock();
+			unitpp::assert_eq("shared props still in use", nGen, VwPropertyStore::ChrpGeneration());
+			pzvpsPlain1->Lock();
+			unitpp::assert_true("same props again", pzvpsPlain1->Chrp() == pchrpPlain);
+
+			// Props only one store uses are freed, and the generation says so.
+			VwPropertyStore * pzvpsItalic = qzvps1->PropertiesForTtp(qttpItalic);
+			unitpp::assert_eq("italic props", kttvForceOn, pzvpsItalic->Chrp()->ttvItalic);
+			nGen = VwPropertyStore::ChrpGeneration();
+			pzvpsItalic->Unlock();
+			unitpp::assert_true("freeing props changes the generation",
+				nGen != VwPropertyStore::ChrpGeneration());
+			pzvpsItalic->Lock();
+			unitpp::assert_eq("props got again", kttvForceOn, pzvpsItalic->Chrp()->ttvItalic);
+		}
+
 		void testComputedPropertiesForString_OverlongInheritedFontVariationsWithoutCommaClearsRenderBuffer()
 		{
 			SmartBstr sbstrOverlong = MakeOverlongFontVariationBstr();
@@ -71,17 +71,28 @@ VwPropertyStore * VwEnv::MakePropertyStore()
 	Initialize a VwEnv for creating a new view.
 	Arguments:
 		pvg - gives initial clip rect
+		fKeepStyles - true to build on the root's existing property store (and hence share
+			derived property stores with the boxes being replaced), because only data has
+			changed since it was made.
 ----------------------------------------------------------------------------------------------*/
-void VwEnv::Initialize(IVwGraphics * pvg, VwRootBox * pzrootb, IVwViewConstructor * pvc)
+void VwEnv::Initialize(IVwGraphics * pvg, VwRootBox * pzrootb, IVwViewConstructor * pvc,
+	bool fKeepStyles)
 {
-	m_qzvps.Attach(MakePropertyStore()); // constructor does default state
-	IVwStylesheetPtr qss;
-	qss = pzrootb->Stylesheet();
-	m_qzvps->SetStyleSheet(qss);
-	// set the initial root text props
-	m_qzvps->InitRootTextProps(pvc);
-
-	pzrootb->_SetPropStore(m_qzvps);
+	if (fKeepStyles && pzrootb->Style())
+	{
+		m_qzvps = pzrootb->Style();
+	}
+	else
+	{
+		m_qzvps.Attach(MakePropertyStore()); // constructor does default state
+		IVwStylesheetPtr qss;
+		qss = pzrootb->Stylesheet();
+		m_qzvps->SetStyleSheet(qss);
+		// set the initial root text props
+		m_qzvps->InitRootTextProps(pvc);
+
+		pzrootb->_SetPropStore(m_qzvps);
+	}
 	m_qrootbox = pzrootb;
 	m_qsda = pzrootb->GetDataAccess();
 	// Set the writing system factory for the property store if we can.
@@ -706,11 +717,11 @@ STDMETHODIMP VwEnv::AddStringProp(PropTag tag, IVwViewConstructor * pvwvc)
 	ChkComArgPtrN(pvwvc);
 
 	ITsStringPtr qtss;
+	CheckHr(m_qsda->get_StringProp(m_hvoCurr, tag, &qtss));
 	VwParagraphBox * pvpbox = dynamic_cast<VwParagraphBox *>(m_pgboxCurr);
 	if (!pvpbox)
-		OpenParagraph();
+		OpenParagraphForString(qtss);
 	OpenProp(tag, pvwvc, 0, kvnpStringProp);
-	CheckHr(m_qsda->get_StringProp(m_hvoCurr, tag, &qtss));
 	CheckHr(AddString(qtss));
 	CloseProp();
 	if (!pvpbox)
@@ -725,16 +736,16 @@ STDMETHODIMP VwEnv::AddUnicodeProp(int tag, int ws, IVwViewConstructor * pvwvc)
 	ChkComArgPtrN(pvwvc);
 
 	ITsStringPtr qtss;
-	VwParagraphBox * pvpbox = dynamic_cast<VwParagraphBox *>(m_pgboxCurr);
-	if (!pvpbox)
-		OpenParagraph();
-	OpenProp(tag, pvwvc, ws, kvnpUnicodeProp);
 	SmartBstr sbstr;
 	CheckHr(m_qsda->get_UnicodeProp(m_hvoCurr, tag, &sbstr));
 	if (!m_qtsf)
 		CheckHr(m_qrootbox->get_TsStrFactory(&m_qtsf));
 	AssertPtr(m_qtsf);
 	CheckHr(m_qtsf->MakeStringRgch(sbstr.Chars(), sbstr.Length(), ws, &qtss));
+	VwParagraphBox * pvpbox = dynamic_cast<VwParagraphBox *>(m_pgboxCurr);
+	if (!pvpbox)
+		OpenParagraphForString(qtss);
+	OpenProp(tag, pvwvc, ws, kvnpUnicodeProp);
 	AddString(qtss);
 	CloseProp();
 	if (!pvpbox)
@@ -752,15 +763,15 @@ STDMETHODIMP VwEnv::AddIntProp(int tag)
 
 	int nVal;
 	ITsStringPtr qtss;
-	VwParagraphBox * pvpbox = dynamic_cast<VwParagraphBox *>(m_pgboxCurr);
-	if (!pvpbox)
-		OpenParagraph();
-	OpenProp(tag, NULL, 0, kvnpIntProp);
 	CheckHr(m_qsda->get_IntProp(m_hvoCurr, tag, &nVal));
 	if (!m_qtsf)
 		CheckHr(m_qrootbox->get_TsStrFactory(&m_qtsf));
 	AssertPtr(m_qtsf);
 	IntToTsString(nVal, m_qtsf, m_qsda, &qtss);
+	VwParagraphBox * pvpbox = dynamic_cast<VwParagraphBox *>(m_pgboxCurr);
+	if (!pvpbox)
+		OpenParagraphForString(qtss);
+	OpenProp(tag, NULL, 0, kvnpIntProp);
 	AddString(qtss);
 	CloseProp();
 	if (!pvpbox)
@@ -803,11 +814,11 @@ STDMETHODIMP VwEnv::AddStringAltMember(int tag, int ws, IVwViewConstructor * pvw
 	ChkComArgPtrN(pvwvc);
 
 	ITsStringPtr qtss;
+	CheckHr(m_qsda->get_MultiStringAlt(m_hvoCurr, tag,ws, &qtss));
 	VwParagraphBox * pvpbox = dynamic_cast<VwParagraphBox *>(m_pgboxCurr);
 	if (!pvpbox)
-		OpenParagraph();
+		OpenParagraphForString(qtss);
 	OpenProp(tag, pvwvc, ws, kvnpStringAltMember);
-	CheckHr(m_qsda->get_MultiStringAlt(m_hvoCurr, tag,ws, &qtss));
 	AddString(qtss);
 	CloseProp();
 	if (!pvpbox)
@@ -924,7 +935,7 @@ STDMETHODIMP VwEnv::AddString(ITsString * ptss)
 	bool fHadPara = pvpbox != NULL;
 	if (!pvpbox)
 	{
-		OpenParagraph();
+		OpenParagraphForString(ptss);
 		pvpbox = dynamic_cast<VwParagraphBox *>(m_pgboxCurr);
 	}
 	// Do this before adding the string to the text source: the number of things in the
@@ -1381,6 +1392,26 @@ VwParagraphBox * VwEnv::MakeParagraphBox(VwSourceType vst)
 	return NewObj VwParagraphBox(m_qzvps, vst);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Open a paragraph made just to hold ptss. Such a paragraph (as in a browse view cell) rarely
+	gets anything else, so if the string is a single run, give it the text source optimized
+	for that.
+----------------------------------------------------------------------------------------------*/
+void VwEnv::OpenParagraphForString(ITsString * ptss)
+{
+	int crun = 0;
+	if (ptss)
+		CheckHr(ptss->get_RunCount(&crun));
+	if (crun != 1)
+	{
+		CheckHr(OpenParagraph());
+		return;
+	}
+	// Paragraphs can only go inside some kind of pile
+	Assert(dynamic_cast<VwPileBox *>(m_pgboxCurr));
+	OpenFlowObject(MakeParagraphBox(kvstSingleRun));
+}
+
 /*----------------------------------------------------------------------------------------------
 	Delimit a paragraph
 ----------------------------------------------------------------------------------------------*/
@@ -1615,6 +1646,88 @@ STDMETHODIMP VwEnv::IsParagraphOpen(ComBool * pfRet)
 	END_COM_METHOD(dfactEnv, IID_IVwEnv);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Replay a buffer of VwEnvOp instructions, each followed by its operands. This is just a
+	loop over the individual methods, but it lets a managed view constructor build a large
+	part of a display in one interop call rather than one call per property or flow object.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwEnv::AddInstructions(int * prgn, int cn, IVwViewConstructor * pvwvc)
+{
+	BEGIN_COM_METHOD;
+	ChkComArrayArg(prgn, cn);
+	ChkComArgPtrN(pvwvc);
+
+	int iin = 0;
+	while (iin < cn)
+	{
+		int veop = prgn[iin++];
+		// The opcode carries its own operand count (see VwEnvOp).
+		int copnd = (uint)veop >> kveopOperandShift;
+		if ((veop & kveopNumberMask) >= kveopLim)
+			ThrowInternalError(E_INVALIDARG, "Unknown VwEnvOp");
+		if (copnd > cn - iin)
+			ThrowInternalError(E_INVALIDARG, "Instruction buffer ends inside an instruction");
+		int * prgopnd = prgn + iin;
+		iin += copnd;
+		switch (veop)
+		{
+		case kveopOpenParagraph:
+			CheckHr(OpenParagraph());
+			break;
+		case kveopCloseParagraph:
+			CheckHr(CloseParagraph());
+			break;
+		case kveopOpenDiv:
+			CheckHr(OpenDiv());
+			break;
+		case kveopCloseDiv:
+			CheckHr(CloseDiv());
+			break;
+		case kveopOpenInnerPile:
+			CheckHr(OpenInnerPile());
+			break;
+		case kveopCloseInnerPile:
+			CheckHr(CloseInnerPile());
+			break;
+		case kveopOpenSpan:
+			CheckHr(OpenSpan());
+			break;
+		case kveopCloseSpan:
+			CheckHr(CloseSpan());
+			break;
+		case kveopIntProperty:
+			CheckHr(put_IntProperty(prgopnd[0], prgopnd[1], prgopnd[2]));
+			break;
+		case kveopStringProp:
+			CheckHr(AddStringProp(prgopnd[0], pvwvc));
+			break;
+		case kveopUnicodeProp:
+			CheckHr(AddUnicodeProp(prgopnd[0], prgopnd[1], pvwvc));
+			break;
+		case kveopStringAltMember:
+			CheckHr(AddStringAltMember(prgopnd[0], prgopnd[1], pvwvc));
+			break;
+		case kveopIntProp:
+			CheckHr(AddIntProp(prgopnd[0]));
+			break;
+		case kveopObjProp:
+			CheckHr(AddObjProp(prgopnd[0], pvwvc, prgopnd[1]));
+			break;
+		case kveopObjVecItems:
+			CheckHr(AddObjVecItems(prgopnd[0], pvwvc, prgopnd[1]));
+			break;
+		case kveopObj:
+			CheckHr(AddObj(prgopnd[0], pvwvc, prgopnd[1]));
+			break;
+		default:
+			// A known opcode number with the wrong operand count.
+			ThrowInternalError(E_INVALIDARG, "Unknown VwEnvOp");
+		}
+	}
+
+	END_COM_METHOD(dfactEnv, IID_IVwEnv);
+}
+
 /*----------------------------------------------------------------------------------------------
 
 ----------------------------------------------------------------------------------------------*/
@@ -1968,7 +2081,7 @@ STDMETHODIMP VwEnv::get_StringWidth(ITsString * ptss, ITsTextProps * pttp, int *
 		qrootb->putref_TsStrFactory(qtsf);
 		pvpboxCont->Container(qrootb);
 
-		pvpbox->Source()->Vpst().Push(VpsTssRec(qzvps, ptss));
+		pvpbox->Source()->EditVpst().Push(VpsTssRec(qzvps, ptss));
 		pvpbox->DoLayout(m_qvg, INT_MAX);
 		int dxInch, dyInch;
 		CheckHr(m_qvg->get_XUnitsPerInch(&dxInch));
@@ -139,7 +139,9 @@ class VwEnv : public IVwEnv
 
 	STDMETHOD(EmptyParagraphBehavior)(int behavior);
 	STDMETHOD(IsParagraphOpen)(ComBool * pfRet);
-	void Initialize(IVwGraphics * pvg, VwRootBox * pzrootb, IVwViewConstructor * pvc);
+	STDMETHOD(AddInstructions)(int * prgn, int cn, IVwViewConstructor * pvwvc);
+	void Initialize(IVwGraphics * pvg, VwRootBox * pzrootb, IVwViewConstructor * pvc,
+		bool fKeepStyles = false);
 	void InitEmbedded(IVwGraphics * pvg, VwMoveablePileBox * pmpbox);
 	void InitRegenerate(IVwGraphics * pvg, VwRootBox * pzrootb,
 		VwGroupBox * pgboxContainer, VwPropertyStore * pzvps, HVO hvo,
@@ -341,6 +343,7 @@ class VwEnv : public IVwEnv
 
 	// Other protected methods
 	virtual VwParagraphBox * MakeParagraphBox(VwSourceType vst = kvstNormal);
+	void OpenParagraphForString(ITsString * ptss);
 	virtual VwDivBox * MakeDivBox();
 	virtual VwPropertyStore * MakePropertyStore();
 
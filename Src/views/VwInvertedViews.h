@@ -108,6 +108,11 @@ class VwInvertedParaBox : public VwParagraphBox
 	virtual void RunParaBuilder(IVwGraphics * pvg, int dxAvailWidth, int cch);
 	virtual void RunParaReBuilder(IVwGraphics * pvg, int dxAvailWidth, VwRootBox * prootb,
 		FixupMap * pfixmap, int cch);
+	// Lines are laid out from the bottom up, so a partial layout may move any of them.
+	virtual Rect GetInvalidateRectFrom(int dysTop)
+	{
+		return GetInvalidateRect();
+	}
 
 	// True if ys2 is further than or the same as ys1 in the direction the boxes are arranged.
 	virtual bool IsVerticallySameOrAfter(int ys1, int ys2)
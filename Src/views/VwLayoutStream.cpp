@@ -30,12 +30,14 @@ VwLayoutStream::VwLayoutStream(VwPropertyStore * pzvps)
 	: VwRootBox(pzvps)
 {
 	m_dxsLayoutWidth = -1;
+	m_pboxResume = NULL;
 }
 
 // Protected default constructor used for CreateCom
 VwLayoutStream::VwLayoutStream() : VwRootBox()
 {
 	m_dxsLayoutWidth = -1;
+	m_pboxResume = NULL;
 }
 
 
@@ -91,6 +93,129 @@ VwPage * VwLayoutStream::CreatePage(int hPage)
 	return qpage;
 }
 
+/*----------------------------------------------------------------------------------------------
+	Report that the page is broken and forget it. Its last layout is remembered in
+	m_hmhpagePrevLayout so that when the manager lays it out again we can tell whether the
+	page boundary has returned to where it was.
+----------------------------------------------------------------------------------------------*/
+void VwLayoutStream::BreakPage(int hPage)
+{
+	VwPagePtr qpage;
+	if (m_hmhpagePages.Retrieve(hPage, qpage))
+		m_hmhpagePrevLayout.Insert(hPage, qpage, true);
+	NoteChangedPage(hPage);
+	CheckHr(m_qlm->PageBroken(this, hPage));
+	m_hmhpagePages.Delete(hPage);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Add the page to the list that GetChangedPages will report, if it is not there already.
+----------------------------------------------------------------------------------------------*/
+void VwLayoutStream::NoteChangedPage(int hPage)
+{
+	for (int i = 0; i < m_vhPageChanged.Size(); i++)
+	{
+		if (m_vhPageChanged[i] == hPage)
+			return;
+	}
+	m_vhPageChanged.Push(hPage);
+}
+
+/*----------------------------------------------------------------------------------------------
+	The page has just been laid out by LayoutPage. Work out where it ends within its last box,
+	and compare its boundaries with those of the layout it replaces (either the current layout
+	of the same page, or the one remembered when it was broken). If the end is in the same box,
+	at the same offset, and the next page starts at the same character, the pages that follow
+	are unaffected and the manager can stop repaginating.
+----------------------------------------------------------------------------------------------*/
+void VwLayoutStream::NotePageLaidOut(VwPage * ppage)
+{
+	int dysEndInEndBox = ppage->m_dysEnd + ppage->m_pboxStart->TopToTopOfDocument()
+		- ppage->m_pboxEnd->TopToTopOfDocument();
+	ppage->m_dysEndInEndBox = dysEndInEndBox;
+	ppage->m_ichNextPage = -1;
+	VwParagraphBox * pvpbox = dynamic_cast<VwParagraphBox *>(ppage->m_pboxEnd);
+	if (pvpbox)
+	{
+		for (VwBox * pbox = pvpbox->FirstBox(); pbox; pbox = pbox->NextOrLazy())
+		{
+			VwStringBox * psbox = dynamic_cast<VwStringBox *>(pbox);
+			if (psbox && psbox->Top() >= dysEndInEndBox)
+			{
+				ppage->m_ichNextPage = psbox->IchMin();
+				break;
+			}
+		}
+	}
+
+	VwPagePtr qpageOld;
+	if (!m_hmhpagePages.Retrieve(ppage->m_hPage, qpageOld))
+		m_hmhpagePrevLayout.Retrieve(ppage->m_hPage, qpageOld);
+	m_hmhpagePrevLayout.Delete(ppage->m_hPage);
+
+	ppage->m_fEndUnchanged = qpageOld && qpageOld->m_pboxEnd &&
+		qpageOld->m_pboxEnd == ppage->m_pboxEnd &&
+		qpageOld->m_dysEndInEndBox == dysEndInEndBox &&
+		qpageOld->m_ichNextPage == ppage->m_ichNextPage;
+	if (!ppage->m_fEndUnchanged || qpageOld->m_pboxStart != ppage->m_pboxStart ||
+		qpageOld->m_dysStart != ppage->m_dysStart)
+	{
+		NoteChangedPage(ppage->m_hPage);
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Remember that the page just laid out ended in pbox, and the next page starts at
+	ysNextPage (zero if there is no next page).
+----------------------------------------------------------------------------------------------*/
+void VwLayoutStream::NoteResumePoint(VwBox * pbox, int ysNextPage)
+{
+	if (!pbox || !ysNextPage)
+	{
+		ForgetResumePoint();
+		return;
+	}
+	m_pboxResume = pbox;
+	m_ysResume = ysNextPage;
+	m_ysResumeBoxTop = pbox->TopToTopOfDocument();
+}
+
+/*----------------------------------------------------------------------------------------------
+	If a page starting at ysPosition follows on from the page most recently laid out, and
+	nothing has moved since, answer the box that page ended in. The first line of the new page
+	is in that box or follows it, so the search can start there. Otherwise answer null.
+----------------------------------------------------------------------------------------------*/
+VwBox * VwLayoutStream::ResumeBoxAt(int ysPosition)
+{
+	if (!m_pboxResume || ysPosition != m_ysResume)
+		return NULL;
+	if (m_pboxResume->TopToTopOfDocument() != m_ysResumeBoxTop)
+	{
+		ForgetResumePoint();
+		return NULL;
+	}
+	return m_pboxResume;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Called as any box of this stream is deleted, by whatever route (relayout, lazy expansion,
+	ReplaceStrings, which does not always supply a set of deleted boxes, etc.). Make sure we
+	keep no pointer to it that might later be followed, or matched by a new box at the same
+	address.
+----------------------------------------------------------------------------------------------*/
+void VwLayoutStream::BoxDeleted(VwBox * pbox)
+{
+	if (pbox == m_pboxResume)
+		ForgetResumePoint();
+	GpHashMap<int, VwPage>::iterator itLim = m_hmhpagePrevLayout.End();
+	for (GpHashMap<int, VwPage>::iterator it = m_hmhpagePrevLayout.Begin(); it != itLim; ++it)
+	{
+		VwPage * ppage = it.GetValue();
+		if (ppage->m_pboxStart == pbox || ppage->m_pboxEnd == pbox)
+			ppage->m_pboxStart = ppage->m_pboxEnd = NULL;
+	}
+}
+
 //:>********************************************************************************************
 //:>	IUnknown Methods
 //:>********************************************************************************************
@@ -282,6 +407,7 @@ STDMETHODIMP VwLayoutStream::DiscardPage(int hPage)
 {
 	BEGIN_COM_METHOD;
 	m_hmhpagePages.Delete(hPage);
+	m_hmhpagePrevLayout.Delete(hPage);
 	END_COM_METHOD(g_fact, IID_IVwRootBox);
 }
 
@@ -455,6 +581,45 @@ STDMETHODIMP VwLayoutStream::IsInPageAbove(int xs, int ys, int ysBottomOfPage,
 	END_COM_METHOD(g_fact, IID_IVwRootBox);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Answer true if the most recent LayoutPage for the specified page ended in the same box,
+	at the same offset and before the same character, as the layout it replaced (whether the
+	page had been broken or was simply laid out again). The manager can stop repaginating
+	after such a page, as long as the following pages have not themselves been broken.
+	Answers false for a page that has not been laid out before, or is not currently laid out.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwLayoutStream::PageEndUnchanged(int hPage, ComBool * pfUnchanged)
+{
+	BEGIN_COM_METHOD;
+	ChkComOutPtr(pfUnchanged);
+	VwPage * ppage = FindPage(hPage);
+	if (ppage)
+		*pfUnchanged = ppage->m_fEndUnchanged;
+	END_COM_METHOD(g_fact, IID_IVwRootBox);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get the handles of the pages whose content or boundaries have changed since this was last
+	called: pages that have been broken, and pages that LayoutPage laid out differently from
+	before. If chPageMax is zero, just answer the number of such pages; otherwise copy them to
+	prghPage and start a new list.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwLayoutStream::GetChangedPages(int chPageMax, int * prghPage, int * pchPage)
+{
+	BEGIN_COM_METHOD;
+	ChkComArrayArg(prghPage, chPageMax);
+	ChkComOutPtr(pchPage);
+	*pchPage = m_vhPageChanged.Size();
+	if (!chPageMax)
+		return S_OK;
+	if (chPageMax < m_vhPageChanged.Size())
+		ThrowHr(WarnHr(E_INVALIDARG));
+	if (m_vhPageChanged.Size())
+		CopyItems(m_vhPageChanged.Begin(), prghPage, m_vhPageChanged.Size());
+	m_vhPageChanged.Clear();
+	END_COM_METHOD(g_fact, IID_IVwRootBox);
+}
+
 
 /*----------------------------------------------------------------------------------------------
 	Revert the collections of objects on the given page to its previously-committed state.
@@ -498,6 +663,7 @@ STDMETHODIMP VwLayoutStream::CommitLayoutObjects(int hPage)
 ----------------------------------------------------------------------------------------------*/
 STDMETHODIMP VwLayoutStream::Layout(IVwGraphics * pvg, int dxAvailWidth)
 {
+	ForgetResumePoint();
 	m_dxsLayoutWidth = dxAvailWidth;
 	return SuperClass::Layout(pvg, dxAvailWidth);
 }
@@ -527,10 +693,12 @@ void InsertBoxAndContainers(BoxIntMultiMap * pmmbi, VwBox * pbox, int hPage, VwR
 
 	@param fCheckForSync True to do synchronization if it is needed; false to force the
 						reconstruct only on this one VwRootBox.
+	@param fKeepLayout See VwRootBox::Reconstruct.
 ----------------------------------------------------------------------------------------------*/
-void VwLayoutStream::Reconstruct(bool fCheckForSync)
+void VwLayoutStream::Reconstruct(bool fCheckForSync, bool fKeepLayout)
 {
-	SuperClass::Reconstruct(fCheckForSync);
+	ForgetResumePoint();
+	SuperClass::Reconstruct(fCheckForSync, fKeepLayout);
 
 	// Send PageBroken notifications for all our pages, and delete them.
 	// We build the vector so that all the old pages are actually gone before we start
@@ -539,13 +707,18 @@ void VwLayoutStream::Reconstruct(bool fCheckForSync)
 	// contain dangerous dangling pointers to boxes that the superclass Reconstruct()
 	// has destroyed. It also ensures that the Clear() does not destroy any new pages
 	// that might get created as a result of whatever PageBroken does.
+	// The boxes any previous layouts refer to are gone too, so nothing can be compared with them.
 	Vector<int> vpage;
 	GpHashMap<int, VwPage>::iterator itLim = m_hmhpagePages.End();
 	for (GpHashMap<int, VwPage>::iterator it = m_hmhpagePages.Begin(); it != itLim; ++it)
 		vpage.Push(it.GetKey());
 	m_hmhpagePages.Clear();
+	m_hmhpagePrevLayout.Clear();
 	for (int i = 0; i < vpage.Size(); i++)
+	{
+		NoteChangedPage(vpage[i]);
 		CheckHr(m_qlm->PageBroken(this,  vpage[i]));
+	}
 }
 
 /*----------------------------------------------------------------------------------------------
@@ -560,6 +733,7 @@ bool VwLayoutStream::RelayoutCore(IVwGraphics * pvg, int dxpAvailWidth, VwRootBo
 {
 	Assert(pmmbi == NULL); // We should not be called by anything that supplies an mmbi.
 	BoxIntMultiMap mmbi;
+	ForgetResumePoint(); // The box may be deleted or moved.
 
 	// Create a list of all of the last boxes in the rootbox so we can see if they changed later
 	Vector<VwBox *> vlastBoxes;
@@ -588,6 +762,20 @@ bool VwLayoutStream::RelayoutCore(IVwGraphics * pvg, int dxpAvailWidth, VwRootBo
 		InsertBoxAndContainers(&mmbi, ppage->m_pboxStart, ppage->m_hPage, prootb);
 		InsertBoxAndContainers(&mmbi, ppage->m_pboxEnd, ppage->m_hPage, prootb);
 	}
+	// Previous layouts of broken pages must not keep pointers that a new box might reuse.
+	if (pboxsetDeleted)
+	{
+		itLim = m_hmhpagePrevLayout.End();
+		for (GpHashMap<int, VwPage>::iterator it = m_hmhpagePrevLayout.Begin(); it != itLim; ++it)
+		{
+			VwPage * ppage = it.GetValue();
+			if (pboxsetDeleted->IsMember(ppage->m_pboxStart) ||
+				pboxsetDeleted->IsMember(ppage->m_pboxEnd))
+			{
+				ppage->m_pboxStart = ppage->m_pboxEnd = NULL;
+			}
+		}
+	}
 
 	bool fResult = SuperClass::Relayout(pvg, dxpAvailWidth, prootb, pfixmap, dxpAvailOnLine, &mmbi);
 
@@ -634,10 +822,7 @@ bool VwLayoutStream::RelayoutCore(IVwGraphics * pvg, int dxpAvailWidth, VwRootBo
 	{
 		int hPage = vpage[i];
 		if (FindPage(hPage))
-		{
-			CheckHr(m_qlm->PageBroken(this, hPage));
-			CheckHr(DiscardPage(hPage));
-		}
+			BreakPage(hPage);
 		// Otherwise it was in the list twice or more, and has already been done.
 	}
 	return fResult;
@@ -658,10 +843,7 @@ void VwLayoutStream::SendPageNotifications(VwBox * pbox)
 	{
 		VwPage * ppage = it.GetValue();
 		if (ppage->m_pboxStart == pbox || ppage->m_pboxEnd == pbox)
-		{
-			CheckHr(m_qlm->PageBroken(this, ppage->m_hPage));
-			CheckHr(DiscardPage(ppage->m_hPage));
-		}
+			BreakPage(ppage->m_hPage);
 	}
 }
 
@@ -679,6 +861,9 @@ VwPage::VwPage(int hPage)
 	m_fPageBroken = false;
 	m_pboxStart = m_pboxEnd = NULL;
 	m_dysStart = m_dysEnd = -1;
+	m_dysEndInEndBox = -1;
+	m_ichNextPage = -1;
+	m_fEndUnchanged = false;
 }
 
 
@@ -729,7 +914,11 @@ LayoutPageMethod::LayoutPageMethod(VwLayoutStream * play, IVwGraphics * pvg,
 void LayoutPageMethod::FindFirstLineOnPage(int ysPosition)
 {
 	int dysOffsetIntoBox;
-	m_pboxBeingAdded = m_play->FindNonPileChildAtOffset(ysPosition, m_dpiY, &dysOffsetIntoBox);
+	// When pages are laid out in sequence, each one starts where the previous one ended,
+	// so there is no need to search from the top of the stream for every page.
+	m_pboxBeingAdded = m_play->ResumeBoxAt(ysPosition);
+	if (!m_pboxBeingAdded)
+		m_pboxBeingAdded = m_play->FindNonPileChildAtOffset(ysPosition, m_dpiY, &dysOffsetIntoBox);
 	m_vlnLinesOfBoxBeingAdded.Clear();
 	m_ilnBeingConsideredMin = m_ilnBeingConsideredLim = 0;
 	if (m_pboxBeingAdded != NULL)
@@ -948,7 +1137,9 @@ void LayoutPageMethod::Run()
 	qpage->m_dysEnd = ysBottomOfLastLineThatFit - qpage->m_pboxStart->TopToTopOfDocument();
 	Assert(!qpage->m_pboxStart->IsStringBox());
 	Assert(!qpage->m_pboxEnd->IsStringBox());
+	m_play->NotePageLaidOut(qpage);
 	m_play->AddPage(qpage);
+	m_play->NoteResumePoint(pboxLast, *m_pysStartNextPageBoundary);
 }
 
 // Answer true if there is more material available to add to this page. That is, we got a box
@@ -56,6 +56,16 @@ class VwPage : public GenRefObj
 	// This flag is set during Relayout() operations, so at the end of the Relayout()
 	// we can determine which pages are broken and report them.
 	bool m_fPageBroken;
+	// The offset from the top of m_pboxEnd to the bottom of the last thing on the page.
+	// Unlike m_dysEnd this does not change when material between the start and end boxes
+	// changes height, so it identifies the page boundary when comparing layouts.
+	int m_dysEndInEndBox;
+	// If m_pboxEnd is a paragraph that continues on the next page, the character offset at
+	// which the next page starts; otherwise -1.
+	int m_ichNextPage;
+	// True if the most recent layout of this page ended at exactly the same place as the
+	// layout it replaced, so following pages need not be repaginated.
+	bool m_fEndUnchanged;
 };
 typedef GenSmartPtr<VwPage> VwPagePtr;
 
@@ -111,6 +121,8 @@ class VwLayoutStream : public IVwLayoutStream, public VwRootBox
 	STDMETHOD(ColumnOverlapWithPrevious)(int iColumn, int * pdysHeight);
 	STDMETHOD(IsInPageAbove)(int dxs, int dys, int ysBottomOfPage, IVwGraphics * pvg,
 		int * pxsLeft, int * pxsRight, ComBool * pfInLineAbove);
+	STDMETHOD(PageEndUnchanged)(int hPage, ComBool * pfUnchanged);
+	STDMETHOD(GetChangedPages)(int chPageMax, int * prghPage, int * pchPage);
 	void ConstructAndLayout(IVwGraphics* pvg, int dxsAvailWidth);
 
 protected:
@@ -125,6 +137,31 @@ class VwLayoutStream : public IVwLayoutStream, public VwRootBox
 	VwPage m_pageRollBack; // Copy of state of page we can roll back.
 	Vector<int> m_vColumnHeights; // Heights of individual columns
 	Vector<int> m_vColumnOverlaps; // Overlaps of individual columns
+	// Pages that were broken and have not yet been laid out again. They are kept so that the
+	// new layout can be compared with the old one; their box pointers are only compared, never
+	// followed, and are cleared if the boxes are deleted (see BoxDeleted).
+	GpHashMap<int, VwPage> m_hmhpagePrevLayout;
+	Vector<int> m_vhPageChanged; // Pages broken or moved since GetChangedPages was last called.
+
+	void BreakPage(int hPage);
+	void NoteChangedPage(int hPage);
+	void NotePageLaidOut(VwPage * ppage);
+
+	// Where the most recent LayoutPage ended, so that laying out the following page can
+	// start from there instead of searching the whole stream from the top. m_pboxResume is
+	// the last box on that page, valid only while it is still m_ysResumeBoxTop from the top
+	// of the document; any relayout or reconstruct forgets it, and so does deleting the box
+	// by any other route (e.g. expanding a lazy box, or ReplaceStrings), see BoxDeleted.
+	VwBox * m_pboxResume;
+	int m_ysResume;
+	int m_ysResumeBoxTop;
+
+	void NoteResumePoint(VwBox * pbox, int ysNextPage);
+	void ForgetResumePoint()
+	{
+		m_pboxResume = NULL;
+	}
+	VwBox * ResumeBoxAt(int ysPosition);
 
 public:
 	IVwLayoutManager * Manager() { return m_qlm; }
@@ -133,7 +170,11 @@ class VwLayoutStream : public IVwLayoutStream, public VwRootBox
 			FixupMap * pfixmap, int dxpAvailOnLine, BoxIntMultiMap * pmmbi,
 			BoxSet * pboxsetDeleted);
 	virtual void SendPageNotifications(VwBox * pbox);
-	virtual void Reconstruct(bool fCheckForSync);
+	virtual void BoxDeleted(VwBox * pbox);
+	virtual void Reconstruct(bool fCheckForSync, bool fKeepLayout = false);
+	// Page fixups need the set of boxes each regeneration deleted, which cannot be carried
+	// across a batch, so each change in a PropChanged batch is laid out as it is handled.
+	virtual bool CanDeferRelayout() { return false; }
 };
 DEFINE_COM_PTR(VwLayoutStream);
 
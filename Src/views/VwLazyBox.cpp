@@ -777,17 +777,9 @@ void VwLazyBox::LayoutExpandedItems(VwBox * pboxFirstLayout, VwBox * pboxLimLayo
 	AssertPtr(pdboxContainer);
 
 	VwRootBox * prootb = pdboxContainer->Root();
-	int dxsAvailWidth;
-	IVwRootSitePtr qvrs;
-	CheckHr(prootb->get_Site(&qvrs));
-	CheckHr(qvrs->GetAvailWidth(prootb, &dxsAvailWidth));
+	int dxsAvailWidth = ItemAvailWidth(pdboxContainer);
 
 	HoldLayoutGraphics hg(prootb);
-	int dxsSrcWidth = prootb->DpiSrc().y;
-	// The available width for boxes embedded in a div is the original width available to
-	// the container minus the margins etc. of all the containing divs, including the root.
-	for (VwGroupBox * pgbox = pdboxContainer; pgbox; pgbox = pgbox->Container())
-		dxsAvailWidth -= pgbox->SurroundWidth(dxsSrcWidth);
 
 	// This fails in the case that pboxLimLayout is a lazy box, and in the course of
 	// laying out the last real box in the sequence, we expand it. NextOrLazy then
@@ -815,8 +807,29 @@ void VwLazyBox::LayoutExpandedItems(VwBox * pboxFirstLayout, VwBox * pboxLimLayo
 		vpboxes[ibox]->DoLayout(hg.m_qvg, dxsAvailWidth, -1, fSyncTops);
 }
 
+/*----------------------------------------------------------------------------------------------
+	The available width for boxes embedded in a div is the original width available to
+	the container minus the margins etc. of all the containing divs, including the root.
+----------------------------------------------------------------------------------------------*/
+int VwLazyBox::ItemAvailWidth(VwDivBox * pdboxContainer)
+{
+	VwRootBox * prootb = pdboxContainer->Root();
+	int dxsAvailWidth;
+	IVwRootSitePtr qvrs;
+	CheckHr(prootb->get_Site(&qvrs));
+	CheckHr(qvrs->GetAvailWidth(prootb, &dxsAvailWidth));
+
+	int dxsSrcWidth = prootb->DpiSrc().y;
+	for (VwGroupBox * pgbox = pdboxContainer; pgbox; pgbox = pgbox->Container())
+		dxsAvailWidth -= pgbox->SurroundWidth(dxsSrcWidth);
+	return dxsAvailWidth;
+}
+
 /*----------------------------------------------------------------------------------------------
 	Compute a box size based on an estimate of the size of an item.
+	If the root box remembers the real height of an item's display at this width (because it
+	was expanded and later made lazy again), that is used instead of asking the view
+	constructor for an estimate.
 
 	(Note: it would be interesting to see if the program's behavior is noticeably improved
 	by averaging the estimates for several items.)
@@ -834,13 +847,19 @@ void VwLazyBox::DoLayout(IVwGraphics* pvg, int dxsAvailWidth, int dxpAvailOnLine
 		{
 			int dypInch;
 			pvg->get_YUnitsPerInch(&dypInch);
+			VwRootBox * prootb = Root();
 			int itemHeight = 0;
 			m_dysHeight = 0;
 			m_dysUniformHeightEstimate = 0; // set on first iteration, cleared again if not uniform
 			for (int i = 0; i < m_vwlziItems.Size(); i++)
 			{
-				CheckHr(m_qvc->EstimateHeight(m_vwlziItems.GetHvo(i), m_frag, dxsAvailWidth, &itemHeight));
-				itemHeight = MulDiv((itemHeight > 0 ? itemHeight : 1), dypInch, 72); // points to pixels.
+				HVO hvoItem = m_vwlziItems.GetHvo(i);
+				if (!prootb || !prootb->RetrieveFragmentHeight(m_qvc, m_frag, hvoItem,
+					dxsAvailWidth, &itemHeight))
+				{
+					CheckHr(m_qvc->EstimateHeight(hvoItem, m_frag, dxsAvailWidth, &itemHeight));
+					itemHeight = MulDiv((itemHeight > 0 ? itemHeight : 1), dypInch, 72); // points to pixels.
+				}
 				m_vwlziItems.SetEstimatedHeight(i, itemHeight);
 				m_dysHeight += itemHeight;
 				if (this == Container()->LastBox())
@@ -1389,6 +1408,10 @@ void LazinessIncreaser::ConvertIt(bool fSynchronizing)
 	VwDivBox * pdboxContainer = dynamic_cast<VwDivBox *>(m_pboxFirst->Container());
 	CheckHr(pdboxContainer->Style()->ComputedPropertiesForEmbedding(&qzvps));
 
+	// Before the real boxes go away, remember how tall each item's display actually was, so
+	// the lazy box can use that rather than an estimate if it is laid out at the same width.
+	RememberItemHeights(pdboxContainer);
+
 	// Now we have enough information to actually make the lazy box.
 	VwLazyBox * plzbox = NewObj VwLazyBox(qzvps, vhvoItems.Begin(), vhvoItems.Size(),
 		m_ihvoMin, m_qnote->Constructors()[m_iprop], m_qnote->Fragments()[m_iprop],
@@ -1432,6 +1455,40 @@ void LazinessIncreaser::ConvertIt(bool fSynchronizing)
 	Assert(!fForcedScroll);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Record in the root box the laid-out height of each item displayed by the boxes from
+	m_pboxFirst to m_pboxLast, which we are about to convert into a lazy box. The height of an
+	item runs from the top of its first box to the top of whatever follows its last one, so
+	the heights of adjacent items add up to the space they occupy in the container.
+	Items already in lazy boxes are skipped. Nothing is done unless the root box has been asked
+	to remember them (see VwRootBox::put_RememberFragmentHeights).
+----------------------------------------------------------------------------------------------*/
+void LazinessIncreaser::RememberItemHeights(VwDivBox * pdboxContainer)
+{
+	if (!m_prootb->RemembersFragmentHeights())
+		return;
+	IVwViewConstructor * pvc = m_qnote->Constructors()[m_iprop];
+	int frag = m_qnote->Fragments()[m_iprop];
+	int dxsAvailWidth = VwLazyBox::ItemAvailWidth(pdboxContainer);
+	VwBox * pboxLim = m_pboxLast->NextOrLazy();
+	for (VwBox * pbox = m_pboxFirst; pbox && pbox != pboxLim; )
+	{
+		VwNotifier * pnoteChild = dynamic_cast<VwLazyBox *>(pbox) ? NULL :
+			m_prootb->NotifierWithKeyAndParent(pbox, m_qnote);
+		if (!pnoteChild)
+		{
+			pbox = pbox->NextOrLazy();
+			continue;
+		}
+		VwBox * pboxLastItem = pnoteChild->LastCoveringBox();
+		VwBox * pboxNext = pboxLastItem->NextOrLazy();
+		int dysBottom = pboxNext ? pboxNext->Top() : pboxLastItem->Bottom();
+		m_prootb->NoteFragmentHeight(pvc, frag, pnoteChild->Object(), dxsAvailWidth,
+			max(dysBottom - pbox->Top(), 1));
+		pbox = pboxNext;
+	}
+}
+
 /*----------------------------------------------------------------------------------------------
 	Convert the specified part of the specified property to a lazy box.
 ----------------------------------------------------------------------------------------------*/
@@ -100,6 +100,7 @@ class VwLazyBox : public VwBox
 		int ipropBest, int tag, VwBox ** ppboxFirstLayout, VwBox ** ppboxLimLayout);
 	static void LayoutExpandedItems(VwBox * pboxFirstLayout, VwBox * pboxLimLayout,
 		VwDivBox * pdboxContainer, bool fSyncTops = false);
+	static int ItemAvailWidth(VwDivBox * pdboxContainer);
 
 	virtual OLECHAR * Name()
 	{
@@ -194,6 +195,7 @@ class LazinessIncreaser
 	bool OkToConvertObject(VwBox * pbox, VwNotifier * pnote, int iprop,
 		VwBox ** ppboxNext);
 	void ConvertIt(bool fSynchronizing = true);
+	void RememberItemHeights(VwDivBox * pdboxContainer);
 };
 
 #endif  //VWLAZYBOX_INCLUDED
@@ -30,6 +30,8 @@ DEFINE_THIS_FILE
 //:>	Local Constants and static variables
 //:>********************************************************************************************
 
+int VwOverlay::s_nLastVersion = 0;
+
 //:>********************************************************************************************
 //:>	Methods
 //:>********************************************************************************************
@@ -39,6 +41,7 @@ VwOverlay::VwOverlay()
 {
 	m_cref = 1;
 	m_psslId = (HVO)-1;
+	Changed();
 	ModuleEntry::ModuleAddRef();
 }
 
@@ -413,6 +416,7 @@ STDMETHODIMP VwOverlay::SetTagInfo(OLECHAR * prgchGuid, HVO hvo, int osm, BSTR b
 		tds.m_stuAbbr.Assign(bstrAbbr, BstrLen(bstrAbbr));
 	if (osm & kosmName)
 		tds.m_stuName.Assign(bstrName, BstrLen(bstrName));
+	Changed();
 	return S_OK;
 
 	END_COM_METHOD(g_fact, IID_IVwOverlay);
@@ -591,6 +595,7 @@ STDMETHODIMP VwOverlay::RemoveTag(OLECHAR * prgchGuid)
 	{
 		m_vtds.Delete(itds);
 		m_hmgi.Delete(tdk);
+		Changed();
 	}
 	return S_OK;
 
@@ -633,6 +638,7 @@ STDMETHODIMP VwOverlay::Sort(ComBool fByAbbr)
 	SortIndirect(m_vtds.Begin(), m_vitdsOrder.Size(),
 		m_vitdsOrder.Begin());
 	ViewsGlobals::s_qcoleng.Clear();
+	Changed();
 
 	return S_OK;
 
@@ -805,5 +811,5 @@ STDMETHODIMP VwOverlay::Merge(IVwOverlay * pvo, IVwOverlay ** ppvoMerged)
 
 template class Vector<TagDispSpec>; // VecTagDispSpec; // vtds
 
-// Map from a 26-char representation of a Guid to an index.
+// Map from the binary form of a Guid to an index.
 template class HashMap<TagSpecKey, int>; // MapGuidInt; // hmgi
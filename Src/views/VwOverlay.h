@@ -46,7 +46,7 @@ struct TagDispSpec
 
 typedef Vector<TagDispSpec> VecTagDispSpec; // vtds
 
-// Map from a 26-char representation of a Guid to an index.
+// Map from the binary form of a Guid (kcchGuidRepLength OLECHARs) to an index.
 typedef HashMap<TagSpecKey, int> MapGuidInt; // hmgi
 
 /*----------------------------------------------------------------------------------------------
@@ -119,9 +119,19 @@ class VwOverlay : public IVwOverlay
 	static void MergeOverlayProps2(COLORREF * pclrUnder, COLORREF clrUnder,
 		int * punt, int unt);
 
+	// Changes whenever the display of some tag may have changed. No two overlays ever have
+	// the same version, so clients may cache what they learn from GetDispTagInfo as long as
+	// this (alone) stays the same.
+	int Version()
+	{
+		return m_nVersion;
+	}
+
 protected:
 	// Member variables
 	long m_cref;
+	int m_nVersion;
+	static int s_nLastVersion; // the most recent version given to any overlay.
 	StrUni m_stuName;
 	OLECHAR m_rgchGuid[kcchGuidRepLength];
 	VwOverlayFlags m_vof;
@@ -138,6 +148,11 @@ class VwOverlay : public IVwOverlay
 	int m_citdsUsed;
 	IntVec m_vitdsOrder;
 	HVO m_psslId;
+
+	void Changed()
+	{
+		m_nVersion = ++s_nLastVersion;
+	}
 };
 DEFINE_COM_PTR(VwOverlay);
 #endif  //VwOverlay_INCLUDED
@@ -22,6 +22,10 @@ Last reviewed: Not yet.
 DEFINE_THIS_FILE
 
 int VwPropertyStore::totalrefs = 0;
+VwPropertyStore::SharedChrpMap VwPropertyStore::s_hmchrpschr;
+int VwPropertyStore::s_cStores = 0;
+int VwPropertyStore::s_cRecompute = 0;
+int VwPropertyStore::s_cSharedChrpFreed = 0;
 
 //:>********************************************************************************************
 //:>	Forward declarations
@@ -204,11 +208,14 @@ VwPropertyStore::VwPropertyStore()
 	Assert(m_nMaxLines == 0); // interpreted as unlimited
 	Assert(m_pzvpsParent == 0);
 	CommonInit();
+	s_cStores++;
 }
 
 VwPropertyStore::~VwPropertyStore()
 {
 	ModuleEntry::ModuleRelease();
+	ReleaseSharedChrp();
+	s_cStores--;
 	// Call DisconnectParent on all children: forces them to get rid of their
 	// (uncounted) pointer to this.
 
@@ -320,7 +327,65 @@ CachedProps * VwPropertyStore::Chrp()
 	{
 		InitChrp();
 	}
-	return &m_chrp;
+	if (!m_fLocked)
+		return &m_chrp; // may still change
+	// Answer the copy shared by all locked stores with the same character properties, so
+	// that callers comparing the pointers (e.g., VwParagraphBox::CompareSourceStrings) see
+	// that runs of different paragraphs have the same properties.
+	if (!m_pschr)
+	{
+		CachedProps chrpKey;
+		CopyBytes(&m_chrp, &chrpKey, isizeof(CachedProps));
+		// Make sure anything left after the end of the names does not make a difference.
+		int cch = u_strlen(reinterpret_cast<const UChar *>(chrpKey.szFaceName));
+		memset(chrpKey.szFaceName + cch, 0, isizeof(chrpKey.szFaceName) - cch * isizeof(OLECHAR));
+		cch = u_strlen(reinterpret_cast<const UChar *>(chrpKey.szFontVar));
+		memset(chrpKey.szFontVar + cch, 0, isizeof(chrpKey.szFontVar) - cch * isizeof(OLECHAR));
+		if (!s_hmchrpschr.Retrieve(chrpKey, &m_pschr))
+		{
+			m_pschr = NewObj SharedChrpRec;
+			m_pschr->m_chrp = chrpKey;
+			s_hmchrpschr.Insert(chrpKey, m_pschr);
+		}
+		m_pschr->m_cref++;
+	}
+	return &m_pschr->m_chrp;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Stop using the shared copy of m_chrp, because we are changing or going away. Delete it if
+	no other store uses it; callers that kept a pointer to it find out from ChrpGeneration().
+----------------------------------------------------------------------------------------------*/
+void VwPropertyStore::ReleaseSharedChrp()
+{
+	if (!m_pschr)
+		return;
+	if (--m_pschr->m_cref == 0)
+	{
+		s_hmchrpschr.Delete(m_pschr->m_chrp);
+		delete m_pschr;
+		s_cSharedChrpFreed++;
+	}
+	m_pschr = NULL;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Answer the number of property stores that exist, the number of different sets of character
+	properties they have shared, and how many stores share them. (Tracing these is a quick way
+	to see how much sharing a view achieves.)
+----------------------------------------------------------------------------------------------*/
+void VwPropertyStore::GetStoreStatistics(int * pcStores, int * pcSharedChrp,
+	int * pcSharedChrpRefs)
+{
+	AssertPtr(pcStores);
+	AssertPtr(pcSharedChrp);
+	AssertPtr(pcSharedChrpRefs);
+	*pcStores = s_cStores;
+	*pcSharedChrp = s_hmchrpschr.Size();
+	*pcSharedChrpRefs = 0;
+	SharedChrpMap::iterator it;
+	for (it = s_hmchrpschr.Begin(); it != s_hmchrpschr.End(); ++it)
+		*pcSharedChrpRefs += it.GetValue()->m_cref;
 }
 
 CachedProps * VwPropertyStore::ChrpFor(ITsTextProps * pttp)
@@ -1614,7 +1679,7 @@ STDMETHODIMP VwPropertyStore::put_StringProperty(int sp, BSTR bstrValue)
 			m_fDropCaps = u_strcmp(reinterpret_cast<const UChar *>(chapterNumber.Chars()), reinterpret_cast<const UChar *>(bstrValue)) == 0;
 			// Ttp invokes a named style. Apply it.
 			ITsTextPropsPtr qttpNamed;
-			CheckHr(m_qss->GetStyleRgch(BstrLen(bstrValue), bstrValue, &qttpNamed));
+			NamedStyleCache()->GetStyle(bstrValue, BstrLen(bstrValue), &qttpNamed);
 			if (qttpNamed)
 			{
 				SmartBstr sbstr;
@@ -1849,6 +1914,9 @@ void VwPropertyStore::CopyInheritedFrom(VwPropertyStore* pzvpsParent)
 {
 	m_stuFontFamily = pzvpsParent->m_stuFontFamily;
 	m_stuWsStyle = pzvpsParent->m_stuWsStyle;
+	// Share the parsed form, so the stores for the runs of a paragraph don't each parse it.
+	if (m_stuWsStyle.Length())
+		m_qwst = pzvpsParent->WsStyleTable();
 	m_chrp.ttvItalic = pzvpsParent->m_chrp.ttvItalic;
 	m_ta = pzvpsParent->m_ta;
 	m_smSpellMode = pzvpsParent->m_smSpellMode;
@@ -1871,6 +1939,8 @@ void VwPropertyStore::CopyInheritedFrom(VwPropertyStore* pzvpsParent)
 	m_nRelLineHeight = pzvpsParent->m_nRelLineHeight;
 	// Copy the map of old writing system overrides; not any of the other maps.
 	m_qss = pzvpsParent->m_qss;
+	if (m_qss)
+		m_qnsc = pzvpsParent->NamedStyleCache();
 	m_qwsf = pzvpsParent->m_qwsf;
 
 	m_fEditable = pzvpsParent->m_fEditable;
@@ -2002,87 +2072,57 @@ void VwPropertyStore::DoWsDefaultFontVar(int ws)
 /*----------------------------------------------------------------------------------------------
 	Set up the properties associated with the given writing system/old writing system in the
 	wsStyle string.
-	NOTE: This method must be kept in sync with the FwStyledText functions.
 ----------------------------------------------------------------------------------------------*/
 void VwPropertyStore::DoWsStyles(int ws)
 {
 	if (!m_stuWsStyle.Length())
 		return;
 
-	// Copy m_stuWsStyle to a temporary variable, so that put_IntProperty doesn't try
+	// Hold on to the table, and clear m_stuWsStyle, so that put_IntProperty doesn't try
 	// to change it out from underneath of us.
-	StrUni stuWsStyle = m_stuWsStyle;
+	VwWsStyleTablePtr qwst = WsStyleTable();
 	m_stuWsStyle.Clear();
+	m_qwst.Clear();
 
-	const OLECHAR * pch = stuWsStyle.Chars();
-	const OLECHAR * pchLim = pch + stuWsStyle.Length();
-	while (pch < pchLim)
+	VwWsStyleTable::WsRec * pwsr = qwst->Find(ws);
+	if (!pwsr)
+		return;
+	if (pwsr->cchFont)
+		m_stuFontFamily.Assign(qwst->Chars(pwsr->ichMinFont), pwsr->cchFont);
+	for (int ispr = pwsr->isprMin; ispr < pwsr->isprLim; ispr++)
 	{
-		int wsCur;
-		// The minimum size of a valid field is 4 chars: 2 for ws,
-		// a length for the font name, if any; and a number of properties.
-		if (pchLim - pch < 4)
-			ThrowHr(WarnHr(E_UNEXPECTED));
-		wsCur = *pch | (*(pch + 1)) << 16;
-		pch += 2;
-		const OLECHAR * pchFont = pch + 1;
-		int cchFont = *pch;
-		pch = pchFont + cchFont;
-		if (pch >= pchLim)
-			ThrowHr(WarnHr(E_UNEXPECTED));
-		int cprop = SignedInt(*pch++);
-		if (ws != wsCur)
-		{
-			// Not the entry we want--move on--unless we are past the one we want, then stop.
-			// (Encs are stored in a numerical order that reflects their alphabetical order,
-			// hence the unsigned int.)
-			if ((unsigned int)ws < (unsigned int)wsCur)
-				break;
-			// Else skip this writing system.
-			int cchStrProps = 0;
-			if (cprop < 0)
-			{
-				// Additional string properties.
-				cchStrProps = 1; // counter
-				OLECHAR * pchTmp = const_cast<OLECHAR *>(pchFont) + cchFont + 1;
-				for (; cprop < 0; cprop++)
-				{
-					int cch = *(pchTmp + 1);
-					cchStrProps += cch + 2;
-					pchTmp += cch + 2;
-				}
-				cprop = *pchTmp;
-			}
-			pch += cchStrProps + (cprop * 4);
-			continue;
-		}
-		// Got the one we want!
-		if (cchFont)
-			m_stuFontFamily.Assign(pchFont, cchFont);
-		if (cprop < 0)
-		{
-			// String properties.
-			for (; cprop < 0; cprop++)
-			{
-				int tpt = *pch++;
-				int cch = *pch++;
-				StrUni stu(pch, cch);
-				CheckHr(put_StringProperty(tpt, stu.Bstr()));
-				pch += cch;
-			}
-			cprop = *pch++;
-		}
-		// Integer properties.
-		for (; --cprop >= 0; )
-		{
-			int tpt = *pch++;
-			int ttv = *pch++;
-			int nVal = *pch | (*(pch + 1)) << 16;
-			pch += 2;
-			CheckHr(put_IntProperty(tpt, ttv, nVal));
-		}
-		break; // No point in searching further.
+		VwWsStyleTable::StrPropRec & spr = qwst->StrProp(ispr);
+		StrUni stu(qwst->Chars(spr.ichMin), spr.cch);
+		CheckHr(put_StringProperty(spr.tpt, stu.Bstr()));
 	}
+	for (int iipr = pwsr->iiprMin; iipr < pwsr->iiprLim; iipr++)
+	{
+		VwWsStyleTable::IntPropRec & ipr = qwst->IntProp(iipr);
+		CheckHr(put_IntProperty(ipr.tpt, ipr.ttv, ipr.nVal));
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Answer the parsed form of m_stuWsStyle, making it if the one we have is for some other
+	string.
+----------------------------------------------------------------------------------------------*/
+VwWsStyleTable * VwPropertyStore::WsStyleTable()
+{
+	if (!m_qwst || !m_qwst->IsFor(m_stuWsStyle))
+		m_qwst.Attach(NewObj VwWsStyleTable(m_stuWsStyle));
+	return m_qwst;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Answer the cache of the named styles of m_qss (which must not be null), making it if the
+	one we have is for some other stylesheet.
+----------------------------------------------------------------------------------------------*/
+VwNamedStyleCache * VwPropertyStore::NamedStyleCache()
+{
+	AssertPtr(m_qss);
+	if (!m_qnsc || !m_qnsc->IsFor(m_qss))
+		m_qnsc.Attach(NewObj VwNamedStyleCache(m_qss));
+	return m_qnsc;
 }
 
 /*----------------------------------------------------------------------------------------------
@@ -2270,6 +2310,8 @@ void VwPropertyStore::RecomputeEffects()
 	// Set m_fInitChrp to false to recompute the actual character properties, m_chrp, when next
 	// needed.
 	m_fInitChrp = false;
+	ReleaseSharedChrp();
+	s_cRecompute++;
 
 	// Fix the property store obtained when uninheritable properties are reset.
 	if (m_qzvpsReset)
@@ -2463,6 +2505,7 @@ void VwStylesheet::CreateCom(IUnknown *punkCtl, REFIID riid, void ** ppv)
 VwStylesheet::VwStylesheet()
 {
 	m_cref = 1;
+	m_nGeneration = 1;
 	ModuleEntry::ModuleAddRef();
 }
 
@@ -2550,7 +2593,18 @@ STDMETHODIMP VwStylesheet::PutStyle(BSTR bstrName, BSTR bstrUsage, HVO hvoStyle,
 	ChkComArgPtr(pttp);
 
 	StrUni suKey(bstrName);
-	m_hmsuttp.Insert(suKey, pttp, true); // allow replacements
+	int istyle;
+	if (m_hmsuistyle.Retrieve(suKey, &istyle))
+	{
+		m_vqttp[istyle] = pttp; // allow replacements
+	}
+	else
+	{
+		istyle = m_vqttp.Size();
+		m_vqttp.Push(pttp);
+		m_hmsuistyle.Insert(suKey, istyle);
+	}
+	m_nGeneration++;
 
 	END_COM_METHOD(g_fact, IID_IVwStylesheet);
 }
@@ -2564,14 +2618,27 @@ STDMETHODIMP VwStylesheet::GetStyleRgch(int cch, OLECHAR * prgchName, ITsTextPro
 	ChkComArrayArg(prgchName, cch);
 	ChkComOutPtr(ppttp);
 
-	ITsTextPropsPtr qttp;
-	StrUni suKey(prgchName, cch);
-	m_hmsuttp.Retrieve(suKey, qttp);
-	*ppttp = qttp.Detach();
+	int istyle = StyleId(prgchName, cch);
+	if (istyle >= 0)
+	{
+		*ppttp = m_vqttp[istyle];
+		AddRefObj(*ppttp);
+	}
 
 	END_COM_METHOD(g_fact, IID_IVwStylesheet);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Answer the id PutStyle gave the style called prgchName, or -1 if there is none.
+----------------------------------------------------------------------------------------------*/
+int VwStylesheet::StyleId(OLECHAR * prgchName, int cch)
+{
+	int istyle;
+	if (!m_hmsuistyle.Retrieve(prgchName, cch, &istyle))
+		return -1;
+	return istyle;
+}
+
 /*----------------------------------------------------------------------------------------------
 	Get the next style that will be used if the user types a CR at the end of this paragraph.
 ----------------------------------------------------------------------------------------------*/
@@ -2809,5 +2876,164 @@ int VwPropertyStore::FontSizeForWs(int ws)
 	return nRet;
 }
 
+//:>********************************************************************************************
+//:>	VwWsStyleTable methods.
+//:>********************************************************************************************
+
+/*----------------------------------------------------------------------------------------------
+	Parse the kspWsStyle string. Each writing system has two chars of ws, a font family
+	preceded by its length, then optionally a negative count of string properties (each a tpt,
+	a length and the value) and a count of integer properties (each a tpt, a variation and
+	two chars of value).
+	NOTE: This method must be kept in sync with the FwStyledText functions.
+----------------------------------------------------------------------------------------------*/
+VwWsStyleTable::VwWsStyleTable(StrUni & stuWsStyle)
+{
+	m_stuWsStyle = stuWsStyle; // shares the buffer, which IsFor relies on.
+	const OLECHAR * pchMin = m_stuWsStyle.Chars();
+	const OLECHAR * pch = pchMin;
+	const OLECHAR * pchLim = pch + m_stuWsStyle.Length();
+	while (pch < pchLim)
+	{
+		// The minimum size of a valid field is 4 chars: 2 for ws,
+		// a length for the font name, if any; and a number of properties.
+		if (pchLim - pch < 4)
+		{
+			m_fBadTail = true;
+			break;
+		}
+		int wsCur = *pch | (*(pch + 1)) << 16;
+		pch += 2;
+		WsRec wsr;
+		wsr.cchFont = *pch;
+		wsr.ichMinFont = (int)(pch + 1 - pchMin);
+		pch += 1 + wsr.cchFont;
+		if (pch >= pchLim)
+		{
+			m_fBadTail = true;
+			break;
+		}
+		int cprop = SignedInt(*pch++);
+		wsr.isprMin = m_vspr.Size();
+		if (cprop < 0)
+		{
+			// String properties.
+			for (; cprop < 0 && pchLim - pch >= 2; cprop++)
+			{
+				StrPropRec spr;
+				spr.tpt = *pch++;
+				spr.cch = *pch++;
+				spr.ichMin = (int)(pch - pchMin);
+				pch += spr.cch;
+				m_vspr.Push(spr);
+			}
+			if (cprop < 0 || pch >= pchLim)
+			{
+				m_fBadTail = true;
+				break;
+			}
+			cprop = *pch++;
+		}
+		wsr.isprLim = m_vspr.Size();
+		// Integer properties.
+		if (pchLim - pch < cprop * 4)
+		{
+			m_fBadTail = true;
+			break;
+		}
+		wsr.iiprMin = m_vipr.Size();
+		for (; --cprop >= 0; )
+		{
+			IntPropRec ipr;
+			ipr.tpt = *pch++;
+			ipr.ttv = *pch++;
+			ipr.nVal = *pch | (*(pch + 1)) << 16;
+			pch += 2;
+			m_vipr.Push(ipr);
+		}
+		wsr.iiprLim = m_vipr.Size();
+
+		int iwsr;
+		if (!m_hmwsiwsr.Retrieve(wsCur, &iwsr))
+		{
+			m_hmwsiwsr.Insert(wsCur, m_vwsr.Size());
+			m_vwsr.Push(wsr);
+			if ((unsigned int)wsCur > m_uwsMax)
+				m_uwsMax = (unsigned int)wsCur;
+		}
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Answer the settings for ws, or NULL if it has none.
+----------------------------------------------------------------------------------------------*/
+VwWsStyleTable::WsRec * VwWsStyleTable::Find(int ws)
+{
+	int iwsr;
+	if (m_hmwsiwsr.Retrieve(ws, &iwsr))
+		return &m_vwsr[iwsr];
+	// Searching the string for a ws that sorts after all the good entries would have run
+	// into the bad part.
+	if (m_fBadTail && (!m_vwsr.Size() || (unsigned int)ws > m_uwsMax))
+		ThrowHr(WarnHr(E_UNEXPECTED));
+	return NULL;
+}
+
+//:>********************************************************************************************
+//:>	VwNamedStyleCache methods
+//:>********************************************************************************************
+
+VwNamedStyleCache::VwNamedStyleCache(IVwStylesheet * pss)
+{
+	AssertPtr(pss);
+	m_qss = pss;
+	m_pzss = dynamic_cast<VwStylesheet *>(pss);
+	m_nGeneration = CurrentGeneration();
+}
+
+int VwNamedStyleCache::CurrentGeneration()
+{
+	return m_pzss ? m_pzss->Generation() : VwPropertyStore::RecomputeCount();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get the text props of the style called prgchName, or null if the stylesheet has none.
+----------------------------------------------------------------------------------------------*/
+void VwNamedStyleCache::GetStyle(OLECHAR * prgchName, int cch, ITsTextProps ** ppttp)
+{
+	AssertArray(prgchName, cch);
+	AssertPtr(ppttp);
+	Assert(!*ppttp);
+
+	int nGeneration = CurrentGeneration();
+	if (nGeneration != m_nGeneration)
+	{
+		m_hmsuistyle.Clear();
+		m_vqttp.Clear();
+		m_nGeneration = nGeneration;
+	}
+	int istyle;
+	if (!m_hmsuistyle.Retrieve(prgchName, cch, &istyle))
+	{
+		ITsTextPropsPtr qttp;
+		if (m_pzss)
+		{
+			int istyleSheet = m_pzss->StyleId(prgchName, cch);
+			if (istyleSheet >= 0)
+				qttp = m_pzss->StyleProps(istyleSheet);
+		}
+		else
+		{
+			CheckHr(m_qss->GetStyleRgch(cch, prgchName, &qttp));
+		}
+		istyle = m_vqttp.Size();
+		m_vqttp.Push(qttp);
+		StrUni stuName(prgchName, cch);
+		m_hmsuistyle.Insert(stuName, istyle);
+	}
+	*ppttp = m_vqttp[istyle];
+	AddRefObj(*ppttp);
+}
+
 #include "HashMap_i.cpp"
 template class HashMap<OLECHAR, OLECHAR>;
@@ -44,6 +44,109 @@ class CachedProps : public LgCharRenderProps
 	CachedProps();
 };
 
+/*----------------------------------------------------------------------------------------------
+Class: VwWsStyleTable
+Description: A kspWsStyle string (see FwStyledText), parsed once into the font family and the
+property settings for each writing system, so that resolving a run's properties is a hash
+lookup rather than a search of the packed string. It keeps (and so pins) the string it was
+made from; a property store uses it only while its own string still shares that buffer, and
+passes it on to the stores that inherit the string.
+Hungarian: wst
+----------------------------------------------------------------------------------------------*/
+class VwWsStyleTable : public GenRefObj
+{
+public:
+	// A string property to set for a writing system; the value is part of m_stuWsStyle.
+	struct StrPropRec
+	{
+		int tpt;
+		int ichMin;
+		int cch;
+	};
+	// An integer property to set for a writing system.
+	struct IntPropRec
+	{
+		int tpt;
+		int ttv;
+		int nVal;
+	};
+	// Everything set for one writing system: ranges in m_vspr and m_vipr.
+	struct WsRec
+	{
+		int ichMinFont;
+		int cchFont;
+		int isprMin;
+		int isprLim;
+		int iiprMin;
+		int iiprLim;
+	};
+
+	VwWsStyleTable(StrUni & stuWsStyle);
+
+	bool IsFor(StrUni & stuWsStyle)
+	{
+		return stuWsStyle.Chars() == m_stuWsStyle.Chars();
+	}
+	WsRec * Find(int ws);
+	const OLECHAR * Chars(int ich)
+	{
+		return m_stuWsStyle.Chars() + ich;
+	}
+	StrPropRec & StrProp(int ispr)
+	{
+		return m_vspr[ispr];
+	}
+	IntPropRec & IntProp(int iipr)
+	{
+		return m_vipr[iipr];
+	}
+
+protected:
+	StrUni m_stuWsStyle;
+	Vector<WsRec> m_vwsr;
+	HashMap<int, int> m_hmwsiwsr; // ws to index in m_vwsr
+	Vector<StrPropRec> m_vspr;
+	Vector<IntPropRec> m_vipr;
+	// Set if the string is badly formed after the last entry in m_vwsr.
+	bool m_fBadTail;
+	unsigned int m_uwsMax; // largest ws in m_vwsr, compared as FwStyledText sorts them
+};
+typedef GenSmartPtr<VwWsStyleTable> VwWsStyleTablePtr;
+
+class VwStylesheet;
+
+/*----------------------------------------------------------------------------------------------
+Class: VwNamedStyleCache
+Description: The text props of the named styles of one stylesheet, found by name without
+making a key string or asking the stylesheet each time a ttp invokes a style. Each name is
+given an id the first time it is seen. It is shared by the property stores that use the
+stylesheet. What it knows is thrown away when the stylesheet's generation changes; for a
+stylesheet that is not a VwStylesheet, that is whenever VwPropertyStore::RecomputeCount()
+does, as it does when a root box is told the styles changed (OnStylesheetChange).
+Hungarian: nsc
+----------------------------------------------------------------------------------------------*/
+class VwNamedStyleCache : public GenRefObj
+{
+public:
+	VwNamedStyleCache(IVwStylesheet * pss);
+
+	bool IsFor(IVwStylesheet * pss)
+	{
+		return m_qss.Ptr() == pss;
+	}
+	void GetStyle(OLECHAR * prgchName, int cch, ITsTextProps ** ppttp);
+
+protected:
+	IVwStylesheetPtr m_qss;
+	VwStylesheet * m_pzss; // m_qss, if it is one of ours.
+	HashMapStrUni<int> m_hmsuistyle; // style name to id (index into m_vqttp)
+	ComVector<ITsTextProps> m_vqttp; // null for names the stylesheet does not know
+	int m_nGeneration; // of the stylesheet when the entries were made
+
+	int CurrentGeneration();
+};
+typedef GenSmartPtr<VwNamedStyleCache> VwNamedStyleCachePtr;
+
 /*----------------------------------------------------------------------------------------------
 Class: VwPropertyStore
 Description:
@@ -307,6 +410,7 @@ class VwPropertyStore : public IVwPropertyStore
 	void Unlock()
 	{
 		m_fLocked = false;
+		ReleaseSharedChrp();
 	}
 
 	void DisconnectParent();
@@ -315,6 +419,19 @@ class VwPropertyStore : public IVwPropertyStore
 
 	// Recompute the effects of this property store, and recursively fix its children.
 	void RecomputeEffects();
+	// Incremented whenever RecomputeEffects may have changed what Chrp() answers.
+	static int RecomputeCount()
+	{
+		return s_cRecompute;
+	}
+	// Changes whenever a pointer answered by Chrp() or ChrpFor() may no longer be valid:
+	// when RecomputeEffects runs, or when the shared record it points to is freed because no
+	// store uses it any more (see ReleaseSharedChrp).
+	static int ChrpGeneration()
+	{
+		return s_cRecompute + s_cSharedChrpFreed;
+	}
+	static void GetStoreStatistics(int * pcStores, int * pcSharedChrp, int * pcSharedChrpRefs);
 	void SetStyleSheet(IVwStylesheet * pss)
 	{
 		m_qss = pss;
@@ -337,6 +454,19 @@ class VwPropertyStore : public IVwPropertyStore
 	long m_cref;
 
 	CachedProps m_chrp; // The actual character properties to render text for this vps.
+	// Once locked, the copy of m_chrp shared with other stores with the same character
+	// properties, which is what Chrp() answers.
+	struct SharedChrpRec
+	{
+		CachedProps m_chrp;
+		int m_cref;
+	};
+	typedef HashMap<CachedProps, SharedChrpRec *> SharedChrpMap; // Hungarian hmchrpschr
+	SharedChrpRec * m_pschr;
+	static SharedChrpMap s_hmchrpschr;
+	static int s_cStores; // number of live property stores
+	static int s_cRecompute;
+	static int s_cSharedChrpFreed;
 
 	bool m_fInitChrp; // Have we figured out our chrp?
 
@@ -346,6 +476,8 @@ class VwPropertyStore : public IVwPropertyStore
 	// This variable stores the string kept at kspWsStyle,
 	// a string that encapsulates properties defined on a per-writing-system basis.
 	StrUni m_stuWsStyle;
+	// m_stuWsStyle parsed; may be stale, or made for the parent's copy of the string.
+	VwWsStyleTablePtr m_qwst;
 	int m_nWeight;   // degree of boldness, scale 0-1000
 	int m_cactBolder; // number of requests for bolder since last absolute
 						// -ve for lighter requests
@@ -515,6 +647,8 @@ class VwPropertyStore : public IVwPropertyStore
 	VecStrProps m_vstrprrec;
 
 	IVwStylesheetPtr m_qss;
+	// The named styles of m_qss; may be stale, or made for some other stylesheet.
+	VwNamedStyleCachePtr m_qnsc;
 	ILgWritingSystemFactoryPtr m_qwsf;
 
 	// Static methods
@@ -529,11 +663,13 @@ class VwPropertyStore : public IVwPropertyStore
 	void GetUnderlineInfo(int * punt, COLORREF * pclr);
 	void DoWsDefaultFontVar(int ws);
 	void DoWsStyles(int ws);
+	VwWsStyleTable * WsStyleTable();
+	VwNamedStyleCache * NamedStyleCache();
+	void ReleaseSharedChrp();
 	int FontSizeForWs(int ws);
 	void EnsureWritingSystemFactory();
 };
 
-typedef ComHashMapStrUni<ITsTextProps> MapStrTtp; // Hungarian hmsuttp
 /*----------------------------------------------------------------------------------------------
 Class: VwStylesheet
 Description: Provides a place to store a collection of styles and pass them as one argument
@@ -590,10 +726,26 @@ class VwStylesheet : public IVwStylesheet
 	STDMETHOD(get_NormalFontStyle)(ITsTextProps ** ppttp);
 	STDMETHOD(get_IsStyleProtected)(BSTR bstrName, ComBool * pfProtected);
 	STDMETHOD(CacheProps)(int cch, OLECHAR * prgchName, HVO hvoStyle, ITsTextProps * pttp);
+
+	// Each style is given an id when PutStyle first sees its name. Answer -1 if there is no
+	// style called prgchName.
+	int StyleId(OLECHAR * prgchName, int cch);
+	ITsTextProps * StyleProps(int istyle)
+	{
+		return m_vqttp[istyle];
+	}
+	// Changes whenever a style does, so cached resolutions of names can be checked.
+	int Generation()
+	{
+		return m_nGeneration;
+	}
+
 protected:
 	// member variables
 	long m_cref;
-	MapStrTtp m_hmsuttp;
+	HashMapStrUni<int> m_hmsuistyle; // style name to id
+	ComVector<ITsTextProps> m_vqttp; // the props of each style, by id
+	int m_nGeneration;
 };
 
 
@@ -17,6 +17,7 @@ Last reviewed: Not yet.
 #include "Main.h"
 #pragma hdrstop
 // any other headers (not precompiled)
+#include "VwRenderTrace.h"
 
 #undef THIS_FILE
 DEFINE_THIS_FILE
@@ -80,6 +81,11 @@ void VwRootBox::Init()
 	m_fNeedsLayout = true;
 	m_dxLastLayoutWidth = -1;
 	m_fNeedsReconstruct = true;
+	m_fLineBandsValid = false;
+	m_pgboxLineBandsChanging = NULL;
+	m_cPropChangedBatch = 0;
+	m_fRememberFragmentHeights = false;
+	m_fDeferRelayout = false;
 	// Usually set in Layout method, but some tests don't do this...
 	// play safe also for any code called before Layout.
 	m_ptDpiSrc.x = 96;
@@ -205,7 +211,25 @@ STDMETHODIMP VwRootBox::PropChanged(HVO hvo, PropTag tag, int ivMin, int cvIns,
 
 	// Any data change makes a subsequent Reconstruct() valid work.
 	m_fNeedsReconstruct = true;
+	ForgetFragmentHeights(hvo);
 
+	if (m_cPropChangedBatch)
+		QueuePropChanged(hvo, tag, ivMin, cvIns, cvDel);
+	else
+	{
+		CollectDamage cd(this);
+		DoPropChanged(hvo, tag, ivMin, cvIns, cvDel);
+	}
+
+	END_COM_METHOD(g_fact, IID_IVwNotifyChange);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Regenerate whatever displays the specified property, and lay out the result (unless
+	m_fDeferRelayout is set, in which case the layout is left for FlushPropChangedBatch).
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::DoPropChanged(HVO hvo, PropTag tag, int ivMin, int cvIns, int cvDel)
+{
 	int ivMinDisp;
 	if (m_qsda)
 	{
@@ -216,8 +240,8 @@ STDMETHODIMP VwRootBox::PropChanged(HVO hvo, PropTag tag, int ivMin, int cvIns,
 		{
 			// Don't force a reconstruct on insert - new item just won't be displayed
 			if (cvIns == 0)
-				Reconstruct(true);
-			return S_OK;
+				Reconstruct(true, true);
+			return;
 		}
 	}
 	else
@@ -259,8 +283,126 @@ STDMETHODIMP VwRootBox::PropChanged(HVO hvo, PropTag tag, int ivMin, int cvIns,
 		throw;
 	}
 	m_fIsPropChangedInProgress = false;
+}
 
-	END_COM_METHOD(g_fact, IID_IVwNotifyChange);
+/*----------------------------------------------------------------------------------------------
+	Start a batch of PropChanged notifications. See IVwRootBox::BeginPropChangedBatch.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwRootBox::BeginPropChangedBatch()
+{
+	BEGIN_COM_METHOD;
+	m_cPropChangedBatch++;
+	END_COM_METHOD(g_fact, IID_IVwRootBox);
+}
+
+/*----------------------------------------------------------------------------------------------
+	End a batch of PropChanged notifications; if it is the outermost one, handle everything
+	that was queued.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwRootBox::EndPropChangedBatch()
+{
+	BEGIN_COM_METHOD;
+	if (m_cPropChangedBatch <= 0)
+		ThrowInternalError(E_UNEXPECTED, "EndPropChangedBatch without BeginPropChangedBatch");
+	if (--m_cPropChangedBatch == 0)
+	{
+		CollectDamage cd(this);
+		FlushPropChangedBatch();
+	}
+	END_COM_METHOD(g_fact, IID_IVwRootBox);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Queue a PropChanged received during a batch. A change to a property that already has a
+	queued change is merged with it into a single replacement covering both: if the first
+	replaced cvDel1 items at ivMin1 with cvIns1, and the second then replaced cvDel2 at ivMin2
+	with cvIns2, the region affected (in terms of the intermediate state) runs from the
+	smaller ivMin to ivLim = max(ivMin1 + cvIns1, ivMin2 + cvDel2); mapping its end back
+	through each change gives the combined counts.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::QueuePropChanged(HVO hvo, PropTag tag, int ivMin, int cvIns, int cvDel)
+{
+	HvoTagRec htr(hvo, tag);
+	int ippc;
+	if (m_hmhtippc.Retrieve(htr, &ippc))
+	{
+		PendingPropChange & ppc = m_vppc[ippc];
+		int ivMinNew = min(ppc.m_ivMin, ivMin);
+		int ivLim = max(ppc.m_ivMin + ppc.m_cvIns, ivMin + cvDel);
+		int cvDelNew = ivLim - ppc.m_cvIns + ppc.m_cvDel - ivMinNew;
+		int cvInsNew = ivLim - cvDel + cvIns - ivMinNew;
+		ppc.m_ivMin = ivMinNew;
+		ppc.m_cvIns = cvInsNew;
+		ppc.m_cvDel = cvDelNew;
+		return;
+	}
+	PendingPropChange ppc;
+	ppc.m_hvo = hvo;
+	ppc.m_tag = tag;
+	ppc.m_ivMin = ivMin;
+	ppc.m_cvIns = cvIns;
+	ppc.m_cvDel = cvDel;
+	m_hmhtippc.Insert(htr, m_vppc.Size());
+	m_vppc.Push(ppc);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Handle the changes queued during a batch. Each one is regenerated as usual, but the
+	layout that would normally follow each regeneration is deferred: the fix maps are merged,
+	and a single RelayoutRoot at the end lays out everything affected. If the view has never
+	been laid out, that is left to the Layout still to come. The selection is kept hidden and
+	inactive meanwhile, since the boxes it refers to may not be laid out.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::FlushPropChangedBatch()
+{
+	PendingPropChangeVec vppc;
+	vppc = m_vppc;
+	m_vppc.Clear();
+	m_hmhtippc.Clear();
+	if (!vppc.Size() || !m_fConstructed || !m_qvrs)
+		return;
+
+	VwSelectionState vss = SelectionState();
+	bool fSelShowing = m_qvwsel && m_qvwsel->Showing();
+	if (fSelShowing)
+		m_qvwsel->Hide();
+	if (vss == vssEnabled)
+		HandleActivate(vssDisabled);
+
+	m_fDeferRelayout = CanDeferRelayout();
+	try
+	{
+		for (int ippc = 0; ippc < vppc.Size(); ippc++)
+		{
+			PendingPropChange & ppc = vppc[ippc];
+			DoPropChanged(ppc.m_hvo, ppc.m_tag, ppc.m_ivMin, ppc.m_cvIns, ppc.m_cvDel);
+		}
+	}
+	catch(...)
+	{
+		m_fDeferRelayout = false;
+		m_fixmapDeferred.Clear();
+		HandleActivate(vss);
+		if (fSelShowing && m_qvwsel)
+			m_qvwsel->Show();
+		throw;
+	}
+	m_fDeferRelayout = false;
+
+	if (m_dxLastLayoutWidth < 0)
+		m_fixmapDeferred.Clear(); // Never laid out; Layout will do the lot.
+	if (m_fixmapDeferred.Size())
+	{
+		FixupMap fixmap;
+		m_fixmapDeferred.CopyTo(fixmap);
+		m_fixmapDeferred.Clear();
+		HoldLayoutGraphics hg(this);
+		RelayoutRoot(hg.m_qvg, &fixmap);
+	}
+
+	HandleActivate(vss);
+	if (fSelShowing && m_qvwsel)
+		m_qvwsel->Show();
 }
 
 /***********************************************************************************************
@@ -293,6 +435,7 @@ STDMETHODIMP VwRootBox::SetSpellingRepository(IGetSpellChecker * pgsp)
 	BEGIN_COM_METHOD;
 	ChkComArgPtr(pgsp);
 	m_qgspCheckerRepository = pgsp;
+	m_nSpellCheckGen++; // Paragraphs checked with the old repository must be checked again.
 	END_COM_METHOD(g_fact, IID_IVwRootBox);
 }
 
@@ -415,6 +558,7 @@ STDMETHODIMP VwRootBox::putref_Overlay(IVwOverlay * pvo)
 	if (m_fConstructed)
 	{
 		m_fNeedsLayout = true; // overlay changes may affect layout
+		ForgetFragmentHeights();
 		LayoutFull();
 	}
 	END_COM_METHOD(g_fact, IID_IVwRootBox);
@@ -2547,18 +2691,119 @@ void VwRootBox::ClearNotifiers()
 	m_mmboxqnote.Clear();
 }
 
+/*----------------------------------------------------------------------------------------------
+	Record the paragraphs of the box chain starting at pboxFirst (which Reconstruct has detached
+	from the root) that could give their lines to identical paragraphs of the new box tree.
+	Lazy boxes have no paragraphs, so lazy regions of the new tree stay lazy and cost nothing.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::CollectLayoutDonors(VwBox * pboxFirst)
+{
+	for (VwBox * pbox = pboxFirst; pbox; pbox = pbox->NextOrLazy())
+	{
+		VwParagraphBox * pvpbox = dynamic_cast<VwParagraphBox *>(pbox);
+		if (pvpbox)
+		{
+			if (pvpbox->CanShareLayout())
+			{
+				int nKey = pvpbox->LayoutShareKey();
+				m_mmnpboxDonor.Insert(nKey, pvpbox);
+			}
+			continue;
+		}
+		VwGroupBox * pgbox = dynamic_cast<VwGroupBox *>(pbox);
+		if (pgbox)
+			CollectLayoutDonors(pgbox->FirstBox());
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Called by a paragraph of the new box tree as it is about to be laid out during Reconstruct.
+	If an old paragraph would be laid out exactly the same way, remove it from the candidates
+	and return it, so the new one can take over its lines; otherwise return NULL.
+----------------------------------------------------------------------------------------------*/
+VwParagraphBox * VwRootBox::TakeLayoutDonor(VwParagraphBox * pvpbox, int dxAvailWidth)
+{
+	AssertPtr(pvpbox);
+	if (pvpbox->FirstBox() || !pvpbox->CanShareLayout())
+		return NULL;
+	int nKey = pvpbox->LayoutShareKey();
+	LayoutDonorMap::iterator itMin, itLim;
+	if (!m_mmnpboxDonor.Retrieve(nKey, &itMin, &itLim))
+		return NULL;
+	for (LayoutDonorMap::iterator it = itMin; it != itLim; ++it)
+	{
+		VwParagraphBox * pvpboxDonor = it.GetValue();
+		if (pvpbox->HasSameLayoutInputs(pvpboxDonor, dxAvailWidth))
+		{
+			m_mmnpboxDonor.Delete(nKey, pvpboxDonor);
+			return pvpboxDonor;
+		}
+	}
+	return NULL;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get rid of the selection, notifiers and boxes, as the first step of Reconstruct. If
+	fKeepLayout is true, the boxes are detached rather than deleted, so that paragraphs of the
+	new box tree whose contents did not change can take over the old lines instead of being
+	broken into lines all over again; the detached chain is returned, and must be passed to
+	DeleteOldBoxes once the new boxes have been laid out. Otherwise the boxes are deleted at
+	once (so that only one box tree exists at a time) and NULL is returned.
+----------------------------------------------------------------------------------------------*/
+VwBox * VwRootBox::DetachOldBoxes(bool fKeepLayout)
+{
+	CheckHr(DestroySelection());
+
+	ClearNotifiers();
+
+	if (!fKeepLayout)
+	{
+		NotifierVec vpanoteDelDummy; // required argument, but all gone already.
+		DeleteContents(this, vpanoteDelDummy);
+		return NULL;
+	}
+	VwBox * pboxOldFirst = m_pboxFirst;
+	m_pboxFirst = m_pboxLast = NULL;
+	CollectLayoutDonors(pboxOldFirst);
+	return pboxOldFirst;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Delete the box chain that Reconstruct detached from the root, now that the new box tree has
+	taken what it could from it. This is what VwGroupBox::DeleteContents would have done with it.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::DeleteOldBoxes(VwBox * pboxFirst)
+{
+	m_mmnpboxDonor.Clear();
+	NotifierVec vpanoteDelDummy; // required argument, but all gone already.
+	VwBox * pboxNext;
+	for (VwBox * pbox = pboxFirst; pbox; pbox = pboxNext)
+	{
+		pbox->DeleteContents(this, vpanoteDelDummy);
+		DeleteNotifiersFor(pbox, -1, vpanoteDelDummy);
+		FixSelections(pbox);
+		pboxNext = pbox->NextOrLazy(); // save before deleting!
+		delete pbox;
+	}
+}
+
 /*----------------------------------------------------------------------------------------------
 	Clean out everything and rebuild the view from scratch. Selections are lost. This is a last
 	resort if some property changed and we are not sure what the consequences should be.
 
 	@param fCheckForSync True to do synchronization if it is needed; false to force the
 						reconstruct only on this one VwRootBox.
+	@param fKeepLayout True if only data has changed (not styles or writing systems), as when
+						a PropChanged can't be handled any other way. The property stores are
+						then kept, and new paragraphs identical to old ones take over their
+						lines rather than being laid out again, so the cost of the layout
+						depends mainly on how much changed.
 ----------------------------------------------------------------------------------------------*/
-void VwRootBox::Reconstruct(bool fCheckForSync)
+void VwRootBox::Reconstruct(bool fCheckForSync, bool fKeepLayout)
 {
 	if (m_qsync && fCheckForSync)
 	{
-		m_qsync->Reconstruct();
+		m_qsync->Reconstruct(fKeepLayout);
 		return;
 	}
 
@@ -2571,12 +2816,7 @@ void VwRootBox::Reconstruct(bool fCheckForSync)
 	// m_vfrag.Clear();
 	// m_qsda.Clear();
 
-	CheckHr(DestroySelection());
-
-	ClearNotifiers();
-	NotifierVec vpanoteDelDummy; // required argument, but all gone already.
-
-	DeleteContents(this, vpanoteDelDummy);
+	VwBox * pboxOldFirst = DetachOldBoxes(fKeepLayout);
 
 	CheckHr(m_qvrs->GetAvailWidth(this, &dxAvailWidth));
 	HoldLayoutGraphics hg(this);
@@ -2604,9 +2844,18 @@ void VwRootBox::Reconstruct(bool fCheckForSync)
 			m_vhvo[i] = 0; // treat as null object, hope view constructor copes!
 		}
 	}
-	Construct(hg.m_qvg, dxAvailWidth);
+	try
+	{
+		Construct(hg.m_qvg, dxAvailWidth, fKeepLayout);
 
-	Layout(hg.m_qvg, dxAvailWidth);
+		Layout(hg.m_qvg, dxAvailWidth);
+	}
+	catch (...)
+	{
+		DeleteOldBoxes(pboxOldFirst);
+		throw;
+	}
+	DeleteOldBoxes(pboxOldFirst);
 	if (dyOld != FieldHeight() || dxOld != Width() || dyOld2 != Height())
 		CheckHr(m_qvrs->RootBoxSizeChanged(this));
 
@@ -2643,6 +2892,7 @@ STDMETHODIMP VwRootBox::OnStylesheetChange()
 	// notifier/property-store assumptions. Leave m_fNeedsReconstruct set so later callers
 	// like SimpleRootSite.RefreshDisplay() can still observe that a full rebuild may be needed.
 	m_fNeedsReconstruct = true; // style changes warrant reconstruction
+	ForgetFragmentHeights();
 
 	Style()->InitRootTextProps(m_vqvwvc.Size() == 0 ? NULL : m_vqvwvc[0]);
 	Style()->RecomputeEffects();
@@ -2895,10 +3145,17 @@ STDMETHODIMP VwRootBox::Layout(IVwGraphics * pvg, int dxAvailWidth)
 	if (!m_fConstructed)
 		Construct(pvg, dxAvailWidth);
 	VwDivBox::DoLayout(pvg, dxAvailWidth, -1, true);
+	InvalidateLineBands();
 
 	// Layout succeeded — cache the width and clear the dirty flag.
 	m_fNeedsLayout = false;
 	m_dxLastLayoutWidth = dxAvailWidth;
+#ifdef TRACING_RENDER
+	int cStores, cSharedChrp, cSharedChrpRefs;
+	VwPropertyStore::GetStoreStatistics(&cStores, &cSharedChrp, &cSharedChrpRefs);
+	RENDER_TRACE_MSG("[RENDER] Stage=PropStores Stores=%d StoreBytes=%d SharedChrp=%d SharedChrpRefs=%d\r\n",
+		cStores, cStores * isizeof(VwPropertyStore), cSharedChrp, cSharedChrpRefs);
+#endif
 #ifdef ENABLE_TSF
 	if (m_qvim)
 		CheckHr(m_qvim->OnLayoutChange());
@@ -3577,6 +3834,8 @@ STDMETHODIMP VwRootBox::Close()
 	}
 	m_qsync.Clear();
 	m_qref.Clear();
+	m_qspc.Clear();
+	ForgetFragmentHeights(); // releases the view constructors it holds
 
 #ifdef ENABLE_TSF
 	// m_qvim gets created in the c'tor, so one could think of destroying it in the
@@ -3666,6 +3925,7 @@ STDMETHODIMP VwRootBox::IsSpellCheckComplete(ComBool * pfComplete)
 {
 	BEGIN_COM_METHOD;
 	ChkComOutPtr(pfComplete);
+	CheckSpellCheckCurrent();
 	*pfComplete = m_fCompletedSpellCheck;
 	END_COM_METHOD(g_fact, IID_IVwRootBox);
 }
@@ -3673,12 +3933,14 @@ STDMETHODIMP VwRootBox::IsSpellCheckComplete(ComBool * pfComplete)
 /*----------------------------------------------------------------------------------------------
 	Do a step of spell-checking the view. Return true if everything (except contents
 	of lazy boxes that have not been expanded) has been checked. One call should be short
-	enough to be performed during idle time without significant impact.
+	enough to be performed during idle time without significant impact. Each step checks one
+	paragraph that has changed since it was last checked.
 ----------------------------------------------------------------------------------------------*/
 STDMETHODIMP VwRootBox::DoSpellCheckStep(ComBool * pfComplete)
 {
 	BEGIN_COM_METHOD;
 	ChkComOutPtr(pfComplete);
+	CheckSpellCheckCurrent();
 	if (m_fCompletedSpellCheck)
 	{
 		*pfComplete = true;
@@ -3698,11 +3960,22 @@ STDMETHODIMP VwRootBox::DoSpellCheckStep(ComBool * pfComplete)
 		m_pvpboxNextSpellCheck->SpellCheck();
 		pboxTarget = m_pvpboxNextSpellCheck->NextInRootSeq(false, NULL, true);
 	}
-	while (pboxTarget != NULL && dynamic_cast<VwParagraphBox *>(pboxTarget) == NULL)
+	// Skip over paragraphs that have not changed since they were checked. This is cheap, and
+	// without it, after an edit, it would take one step per paragraph in the view to get back
+	// to the ones that actually need checking.
+	while (pboxTarget != NULL)
+	{
+		VwParagraphBox * pvpbox = dynamic_cast<VwParagraphBox *>(pboxTarget);
+		if (pvpbox && pvpbox->NeedsSpellCheck())
+			break;
 		pboxTarget = pboxTarget->NextInRootSeq(false, NULL, true);
+	}
 	m_pvpboxNextSpellCheck = dynamic_cast<VwParagraphBox *>(pboxTarget);
 	if (m_pvpboxNextSpellCheck == NULL)
+	{
 		m_fCompletedSpellCheck = true;
+		m_nSpellCheckGenCompleted = SpellCheckGeneration();
+	}
 	else
 		m_pvpboxNextSpellCheck->AssertValid();
 	*pfComplete = m_fCompletedSpellCheck;
@@ -3968,11 +4241,72 @@ void VwRootBox::InvalidateRect (Rect * pvwrect)
 		ThrowHr(E_UNEXPECTED);
 	}
 	Assert(m_qvrs.Ptr());
+	if (m_cDamageCollect)
+	{
+		AddDamage(*pvwrect);
+		return;
+	}
 	// if an error occurs while doing this ignore it.
 	m_qvrs->InvalidateRect(this, pvwrect->left, pvwrect->top,
 		pvwrect->Width(), pvwrect->Height());
 }
 
+/*----------------------------------------------------------------------------------------------
+	Add a rectangle to the damage being collected (see CollectDamage). Rectangles inside ones
+	we already have are dropped, and overlapping or adjacent ones are merged, as long as
+	painting the merged rectangle does not cover more pixels than painting both separately.
+	Changing one line typically invalidates the line, the paragraph, and perhaps some
+	containers, several of them more than once, so this usually leaves a single rectangle.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::AddDamage(Rect rc)
+{
+	if (rc.IsEmpty())
+		return;
+	for (int irc = 0; irc < m_vrectDamage.Size(); )
+	{
+		Rect & rcOld = m_vrectDamage[irc];
+		if (rc.Inside(rcOld))
+			return;
+		Rect rcUnion(rcOld);
+		rcUnion.Union(rc);
+		if (rcOld.Inside(rc) || rcUnion.Width() * rcUnion.Height() <=
+			rcOld.Width() * rcOld.Height() + rc.Width() * rc.Height())
+		{
+			// Replace both with the union, which may now absorb earlier ones.
+			rc = rcUnion;
+			m_vrectDamage.Delete(irc);
+			irc = 0;
+			continue;
+		}
+		irc++;
+	}
+	m_vrectDamage.Push(rc);
+}
+
+/*----------------------------------------------------------------------------------------------
+	End collecting damage; if this is the outermost collection, pass what was collected to
+	the root site, and note the total area for LastDamageArea().
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::EndCollectingDamage()
+{
+	Assert(m_cDamageCollect > 0);
+	if (--m_cDamageCollect > 0)
+		return;
+	Vector<Rect> vrect;
+	vrect = m_vrectDamage;
+	m_vrectDamage.Clear();
+	m_nLastDamageArea = 0;
+	for (int irc = 0; irc < vrect.Size(); irc++)
+	{
+		Rect & rc = vrect[irc];
+		m_nLastDamageArea += rc.Width() * rc.Height();
+		if (m_qvrs)
+			m_qvrs->InvalidateRect(this, rc.left, rc.top, rc.Width(), rc.Height());
+	}
+	RENDER_TRACE_MSG("[RENDER] Stage=Damage Rects=%d Area=%d\r\n", vrect.Size(),
+		m_nLastDamageArea);
+}
+
 /*----------------------------------------------------------------------------------------------
 	Box is about to be deleted; if this affects your selection destroy the selection
 	or repair it, if a replacement is known. Also clean up any other active selections.
@@ -4029,12 +4363,27 @@ void VwRootBox::ResetSpellCheck()
 	m_pvpboxNextSpellCheck = NULL;
 	m_fCompletedSpellCheck = false;
 }
+
+/*----------------------------------------------------------------------------------------------
+	If the view was completely checked, but since then the status of some word has changed
+	(possibly through another root box sharing the spelling cache, e.g. Add to Dictionary in
+	another window), start checking again. Paragraphs checked since the change are skipped.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::CheckSpellCheckCurrent()
+{
+	if (m_fCompletedSpellCheck && m_nSpellCheckGenCompleted != SpellCheckGeneration())
+		ResetSpellCheck();
+}
 /*----------------------------------------------------------------------------------------------
 	Spell checking needs to start over (possibly dictionaries have been changed)
 ----------------------------------------------------------------------------------------------*/
 STDMETHODIMP VwRootBox::RestartSpellChecking()
 {
 	BEGIN_COM_METHOD;
+	m_nSpellCheckGen++;
+	// Typically words have just been added to or removed from a dictionary.
+	if (m_qspc)
+		m_qspc->ClearResults();
 	ResetSpellCheck();
 	END_COM_METHOD(g_fact, IID_IVwRootBox);
 }
@@ -4057,7 +4406,193 @@ void VwRootBox::GetDictionary(const OLECHAR * pszId, ICheckWord ** ppcw)
 	static const OleStringLiteral literalNone = L"<None>";
 	if (wcscmp(pszId, literalNone) == 0)
 		return;
-	CheckHr(m_qgspCheckerRepository->GetChecker(const_cast<OLECHAR *>(pszId), ppcw));
+	ICheckWordPtr qcw;
+	CheckHr(m_qgspCheckerRepository->GetChecker(const_cast<OLECHAR *>(pszId), &qcw));
+	if (!qcw)
+		return;
+	// Answer a wrapper that remembers what the dictionary says about each word, shared with
+	// all other root boxes.
+	if (!m_qspc)
+		VwSpellingCache::GetSharedCache(&m_qspc);
+	m_qspc->GetChecker(pszId, qcw, ppcw);
+}
+
+//:>********************************************************************************************
+//:>	VwCachedCheckWord methods.
+//:>********************************************************************************************
+
+VwCachedCheckWord::VwCachedCheckWord(ICheckWord * pcw)
+{
+	AssertPtr(pcw);
+	m_cref = 1;
+	m_qcw = pcw;
+	m_cHit = m_cMiss = m_cEvict = 0;
+}
+
+VwCachedCheckWord::~VwCachedCheckWord()
+{
+}
+
+STDMETHODIMP VwCachedCheckWord::QueryInterface(REFIID riid, void ** ppv)
+{
+	AssertPtr(ppv);
+	if (!ppv)
+		return WarnHr(E_POINTER);
+	*ppv = NULL;
+
+	if (riid == IID_IUnknown)
+		*ppv = static_cast<IUnknown *>(this);
+	else if (riid == IID_ICheckWord)
+		*ppv = static_cast<ICheckWord *>(this);
+	else
+		return E_NOINTERFACE;
+
+	AddRef();
+	return NOERROR;
+}
+
+STDMETHODIMP_(UCOMINT32) VwCachedCheckWord::AddRef(void)
+{
+	return InterlockedIncrement(&m_cref);
+}
+
+STDMETHODIMP_(UCOMINT32) VwCachedCheckWord::Release(void)
+{
+	long cref = InterlockedDecrement(&m_cref);
+	if (cref == 0)
+	{
+		m_cref = 1;
+		delete this;
+	}
+	return cref;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Answer whether the word is spelled correctly, asking the real dictionary only the first
+	time a word form is seen (since the results were last cleared).
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwCachedCheckWord::Check(LPCOLESTR pszWord, ComBool * pfGood)
+{
+	BEGIN_COM_METHOD;
+	ChkComArgPtr(pszWord);
+	ChkComOutPtr(pfGood);
+
+	StrUni stuWord(pszWord);
+	bool fGood;
+	if (m_hmsufGood.Retrieve(stuWord, &fGood))
+	{
+		m_cHit++;
+		*pfGood = fGood;
+		return S_OK;
+	}
+	m_cMiss++;
+	CheckHr(m_qcw->Check(pszWord, pfGood));
+	// Keep the table from growing without limit; starting again just means asking the
+	// dictionary again about the words that are still being checked.
+	if (m_hmsufGood.Size() >= kcwMax)
+	{
+		m_cEvict += m_hmsufGood.Size();
+		m_hmsufGood.Clear();
+	}
+	fGood = *pfGood;
+	m_hmsufGood.Insert(stuWord, fGood);
+
+	END_COM_METHOD(g_fact, IID_ICheckWord);
+}
+
+//:>********************************************************************************************
+//:>	VwSpellingCache methods.
+//:>********************************************************************************************
+
+VwSpellingCache * VwSpellingCache::s_pspc = NULL;
+int VwSpellingCache::s_nGeneration = 0;
+
+VwSpellingCache::VwSpellingCache()
+{
+	Assert(!s_pspc);
+	s_pspc = this;
+}
+
+VwSpellingCache::~VwSpellingCache()
+{
+	Assert(s_pspc == this);
+	ClearResults(); // reports the statistics
+	s_pspc = NULL;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get the cache shared by all root boxes, creating it if no root box currently has it.
+----------------------------------------------------------------------------------------------*/
+void VwSpellingCache::GetSharedCache(VwSpellingCache ** ppspc)
+{
+	AssertPtr(ppspc);
+	if (s_pspc)
+	{
+		*ppspc = s_pspc;
+		s_pspc->AddRef();
+	}
+	else
+	{
+		*ppspc = NewObj VwSpellingCache();
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get (with a reference count) the caching wrapper for the dictionary pcw, which the spelling
+	repository answered for pszId. If the repository now answers a different dictionary for
+	that id, the results remembered from the old one are discarded.
+----------------------------------------------------------------------------------------------*/
+void VwSpellingCache::GetChecker(const OLECHAR * pszId, ICheckWord * pcw, ICheckWord ** ppcw)
+{
+	AssertPtr(pcw);
+	AssertPtr(ppcw);
+	StrUni stuId(pszId);
+	VwCachedCheckWordPtr qccw;
+	if (!m_hmsuqccw.Retrieve(stuId, qccw) || qccw->Checker() != pcw)
+	{
+		if (qccw)
+			s_nGeneration++; // words checked with the old dictionary may now be different.
+		qccw.Attach(NewObj VwCachedCheckWord(pcw));
+		m_hmsuqccw.Insert(stuId, qccw, true);
+	}
+	*ppcw = qccw.Detach();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Forget all remembered results, because words have been added to or removed from some
+	dictionary (see VwRootBox::RestartSpellChecking).
+----------------------------------------------------------------------------------------------*/
+void VwSpellingCache::ClearResults()
+{
+	int cHit, cMiss, cEvict;
+	GetStatistics(&cHit, &cMiss, &cEvict);
+	RENDER_TRACE_MSG("[RENDER] Stage=SpellingCache Req=%d Hit=%d Miss=%d Evict=%d Dicts=%d\r\n",
+		cHit + cMiss, cHit, cMiss, cEvict, m_hmsuqccw.Size());
+	CachedCheckWordMap::iterator itLim = m_hmsuqccw.End();
+	for (CachedCheckWordMap::iterator it = m_hmsuqccw.Begin(); it != itLim; ++it)
+		it.GetValue()->ClearResults();
+	// Every root box sharing the cache must check its paragraphs again.
+	s_nGeneration++;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get the number of words answered from the cache and from the dictionaries themselves, and
+	the number forgotten to keep the cache within bounds, over all dictionaries. The ratio of
+	hits to requests shows whether VwCachedCheckWord::kcwMax is big enough.
+----------------------------------------------------------------------------------------------*/
+void VwSpellingCache::GetStatistics(int * pcHit, int * pcMiss, int * pcEvict)
+{
+	AssertPtr(pcHit);
+	AssertPtr(pcMiss);
+	AssertPtr(pcEvict);
+	*pcHit = *pcMiss = *pcEvict = 0;
+	CachedCheckWordMap::iterator itLim = m_hmsuqccw.End();
+	for (CachedCheckWordMap::iterator it = m_hmsuqccw.Begin(); it != itLim; ++it)
+	{
+		*pcHit += it.GetValue()->HitCount();
+		*pcMiss += it.GetValue()->MissCount();
+		*pcEvict += it.GetValue()->EvictionCount();
+	}
 }
 
 
@@ -4186,6 +4721,38 @@ void VwRootBox::RelayoutRoot(IVwGraphics * pvg, FixupMap * pfixmap, int dxpAvail
 		Assert (false);
 		ThrowHr(WarnHr(E_UNEXPECTED));
 	}
+	if (m_fDeferRelayout)
+	{
+		InvalidateLineBands();
+		// Regenerating a batch of changes (see FlushPropChangedBatch): just remember what
+		// needs laying out. Keys are only ever looked up, so boxes deleted later in the batch
+		// do no harm. An all-zero rectangle means "don't relayout"; any real one wins.
+		// A box that isn't laid out yet (one made by an earlier change in the batch) is left
+		// out: it has no old position worth invalidating, and Relayout lays out any box whose
+		// height is still zero when its container is relaid out.
+		FixupMap::iterator itLim = pfixmap->End();
+		for (FixupMap::iterator it = pfixmap->Begin(); it != itLim; ++it)
+		{
+			VwBox * pbox = it.GetKey();
+			if (!pbox->Height())
+				continue;
+			Rect rcNew = it.GetValue();
+			Rect rcOld;
+			if (!m_fixmapDeferred.Retrieve(pbox, &rcOld))
+			{
+				m_fixmapDeferred.Insert(pbox, rcNew);
+				continue;
+			}
+			if (rcOld.left == rcOld.right && rcOld.top == rcOld.bottom && rcOld.top == 0)
+				m_fixmapDeferred.Insert(pbox, rcNew, true);
+			else if (!rcOld.IsEmpty() && !rcNew.IsEmpty())
+			{
+				rcOld.Union(rcNew);
+				m_fixmapDeferred.Insert(pbox, rcOld, true);
+			}
+		}
+		return;
+	}
 	int dxAvailWidth;
 	CheckHr(m_qvrs->GetAvailWidth(this, &dxAvailWidth));
 	// It is safest to check both Height() and FieldHeight(). Occasionally FieldHeight
@@ -4194,7 +4761,30 @@ void VwRootBox::RelayoutRoot(IVwGraphics * pvg, FixupMap * pfixmap, int dxpAvail
 	int dyOld2 = Height();
 	int dyOld = FieldHeight();
 	int dxOld = Width();
+	// Usually the fixmap holds just the box that changed and its containers; then only the
+	// line bands over that box need redoing. ReplaceStrings looks after them itself when it
+	// calls this for a paragraph it has already laid out.
+	VwBox * pboxChanged = ChangedBox(pfixmap);
+	VwGroupBox * pgboxChanged = NULL;
+	if (!LineBandsChanging(pboxChanged))
+	{
+		Rect rc;
+		pgboxChanged = dynamic_cast<VwGroupBox *>(pboxChanged);
+		// An all-zero rectangle means the box is already laid out, so its old height is lost.
+		if (pgboxChanged && pfixmap->Retrieve(pgboxChanged, &rc) &&
+			!(rc.left == rc.right && rc.top == rc.bottom && rc.top == 0))
+		{
+			BeginLineBandsChange(pgboxChanged, 0, pgboxChanged->Height());
+		}
+		else
+		{
+			pgboxChanged = NULL;
+			InvalidateLineBands();
+		}
+	}
 	RelayoutCore(pvg, dxAvailWidth, this, pfixmap, -1, NULL, pboxsetDeleted);
+	if (pgboxChanged)
+		EndLineBandsChange(pgboxChanged);
 
 	// Incremental relayout succeeded — update layout guard state.
 	int dpiX, dpiY;
@@ -4209,6 +4799,33 @@ void VwRootBox::RelayoutRoot(IVwGraphics * pvg, FixupMap * pfixmap, int dxpAvail
 		CheckHr(m_qvrs->RootBoxSizeChanged(this));
 }
 
+/*----------------------------------------------------------------------------------------------
+	If all the boxes in pfixmap are one box and (some of) its containers, return that box;
+	otherwise return NULL.
+----------------------------------------------------------------------------------------------*/
+VwBox * VwRootBox::ChangedBox(FixupMap * pfixmap)
+{
+	VwBox * pboxChanged = NULL;
+	FixupMap::iterator itLim = pfixmap->End();
+	for (FixupMap::iterator it = pfixmap->Begin(); it != itLim; ++it)
+	{
+		VwBox * pbox = it.GetKey();
+		VwBox * pboxT;
+		// Ignore containers of the box found so far.
+		for (pboxT = pboxChanged; pboxT && pboxT != pbox; pboxT = pboxT->Container())
+			;
+		if (pboxT)
+			continue;
+		// Replace the box found so far by one inside it; anything else is a second change.
+		for (pboxT = pbox; pboxT && pboxT != pboxChanged; pboxT = pboxT->Container())
+			;
+		if (pboxChanged && !pboxT)
+			return NULL;
+		pboxChanged = pbox;
+	}
+	return pboxChanged;
+}
+
 int VwRootBox::AvailWidthForChild(int dpiX, VwBox * pboxChild)
 {
 	int dxAvailWidth;
@@ -4238,12 +4855,12 @@ VwEnv * VwRootBox::MakeEnv()
 	Construct your embedded boxes, assuming Init and one of the SetRoot methods has been called.
 	ENHANCE: JohnT: figure what it should do for SetRootVariant.
 ----------------------------------------------------------------------------------------------*/
-void VwRootBox::Construct(IVwGraphics * pvg, int dxAvailWidth)
+void VwRootBox::Construct(IVwGraphics * pvg, int dxAvailWidth, bool fKeepStyles)
 {
 	AssertPtr(pvg);
 	VwEnvPtr qvwenv;
 	qvwenv.Attach(MakeEnv());
-	qvwenv->Initialize(pvg, this, m_vqvwvc.Size() == 0 ? NULL : m_vqvwvc[0]);
+	qvwenv->Initialize(pvg, this, m_vqvwvc.Size() == 0 ? NULL : m_vqvwvc[0], fKeepStyles);
 	for (int i = 0; i < m_chvoRoot; i++)
 	{
 		qvwenv->OpenObject(m_vhvo[i]);
@@ -4254,6 +4871,8 @@ void VwRootBox::Construct(IVwGraphics * pvg, int dxAvailWidth)
 	// about everything being closed, etc...
 	qvwenv->Cleanup();
 	m_fConstructed = true;
+	ForgetFragmentHeights(); // view constructors may display things differently now.
+	InvalidateLineBands();
 	m_fNeedsLayout = true; // newly-constructed boxes require layout
 	m_fNeedsReconstruct = false; // construction complete — no need to reconstruct
 	// until PropChanged, OnStylesheetChange, or another mutation sets the flag.
@@ -4262,6 +4881,336 @@ void VwRootBox::Construct(IVwGraphics * pvg, int dxAvailWidth)
 	ResetSpellCheck(); // in case it somehow got called while we had no contents.
 }
 
+/*----------------------------------------------------------------------------------------------
+	The fragment height memo remembers how tall the real display of an object turned out to be
+	when it is converted back into part of a lazy box, so that if the same object is later
+	shown lazily by the same fragment of the same view constructor at the same width, its
+	height is known exactly instead of being estimated (and the view constructor does not
+	have to be asked for an estimate). It is only kept if the client asks for it (see
+	put_RememberFragmentHeights).
+
+	The heights are only ever used as estimates for lazy boxes, which are corrected when the
+	items are expanded, so it is acceptable that a change to some object other than the one
+	displayed (e.g., one of its owned objects) does not invalidate the entry.
+----------------------------------------------------------------------------------------------*/
+bool VwRootBox::RetrieveFragmentHeight(IVwViewConstructor * pvc, int frag, HVO hvo,
+	int dxsAvailWidth, int * pdysHeight)
+{
+	AssertPtr(pdysHeight);
+	if (!m_mmhvofhr.Size())
+		return false;
+	FragHeightMap::iterator itMin, itLim;
+	if (!m_mmhvofhr.Retrieve(hvo, &itMin, &itLim))
+		return false;
+	for (FragHeightMap::iterator it = itMin; it != itLim; ++it)
+	{
+		FragHeightRec & fhr = it.GetValue();
+		if (fhr.m_qvc.Ptr() == pvc && fhr.m_frag == frag && fhr.m_dxsAvailWidth == dxsAvailWidth)
+		{
+			*pdysHeight = fhr.m_dysHeight;
+			return true;
+		}
+	}
+	return false;
+}
+
+void VwRootBox::NoteFragmentHeight(IVwViewConstructor * pvc, int frag, HVO hvo,
+	int dxsAvailWidth, int dysHeight)
+{
+	if (!m_fRememberFragmentHeights)
+		return;
+	FragHeightMap::iterator itMin, itLim;
+	if (m_mmhvofhr.Retrieve(hvo, &itMin, &itLim))
+	{
+		for (FragHeightMap::iterator it = itMin; it != itLim; ++it)
+		{
+			FragHeightRec & fhr = it.GetValue();
+			if (fhr.m_qvc.Ptr() == pvc && fhr.m_frag == frag &&
+				fhr.m_dxsAvailWidth == dxsAvailWidth)
+			{
+				fhr.m_dysHeight = dysHeight;
+				return;
+			}
+		}
+	}
+	// Keep the memo from growing without limit in a very long view; starting again just
+	// means some heights get estimated again.
+	const int kcfhrMax = 10000;
+	if (m_mmhvofhr.Size() >= kcfhrMax)
+		m_mmhvofhr.Clear();
+	FragHeightRec fhr;
+	fhr.m_qvc = pvc;
+	fhr.m_frag = frag;
+	fhr.m_dxsAvailWidth = dxsAvailWidth;
+	fhr.m_dysHeight = dysHeight;
+	m_mmhvofhr.Insert(hvo, fhr);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Answer whether the fragment height memo is kept.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwRootBox::get_RememberFragmentHeights(ComBool * pfRemember)
+{
+	BEGIN_COM_METHOD;
+	ChkComOutPtr(pfRemember);
+
+	*pfRemember = m_fRememberFragmentHeights;
+
+	END_COM_METHOD(g_fact, IID_IVwRootBox);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Set whether the fragment height memo is kept. It costs memory and a little time whenever
+	items are made lazy again, which only pays off in views where the user scrolls back over
+	material already seen.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwRootBox::put_RememberFragmentHeights(ComBool fRemember)
+{
+	BEGIN_COM_METHOD;
+
+	m_fRememberFragmentHeights = (bool)fRemember;
+	if (!m_fRememberFragmentHeights)
+		ForgetFragmentHeights();
+
+	END_COM_METHOD(g_fact, IID_IVwRootBox);
+}
+
+/*----------------------------------------------------------------------------------------------
+	The line band index has one band for each laid-out line of each paragraph in the root
+	(including paragraphs inside tables and interlinear piles), giving the vertical range it
+	occupies, its baseline, and which paragraph and line it is, plus one for each lazy box,
+	which may expand into lines. Bands are sorted by baseline, so vertical navigation (UpArrow,
+	DownArrow, PageUp, PageDown) can find the next or previous line, or the line at a given
+	position, by binary search, instead of probing with FindBoxClicked a few pixels at a time.
+
+	The whole index is built on demand by a single pass over the boxes, and discarded by Layout,
+	Construct, and any change it cannot follow. It is kept up to date as paragraphs are relaid
+	out (by ReplaceStrings or RelayoutRoot) and lazy boxes expanded or contracted (by
+	AdjustBoxPositions): BeginLineBandsChange notes the part of the root that is about to
+	change, and EndLineBandsChange replaces the bands in it with those of the new layout and
+	moves the ones below by the change in height. That is only done when the box that changes
+	lies in a plain stack of divisions, so that nothing beside it moves and everything below it
+	moves by the same amount; otherwise the index is discarded.
+----------------------------------------------------------------------------------------------*/
+int VwRootBox::CompareLineBands(const void * pv1, const void * pv2)
+{
+	int ysBaseline1 = ((LineBand *)pv1)->m_ysBaseline;
+	int ysBaseline2 = ((LineBand *)pv2)->m_ysBaseline;
+	return ysBaseline1 < ysBaseline2 ? -1 : (ysBaseline1 > ysBaseline2 ? 1 : 0);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Add to vlbnd (unsorted) the bands of pbox, whose top is at ysTop relative to the root, and
+	of the boxes in it, that have baselines from ysMin to (not including) ysLim. Boxes entirely
+	outside that range are not looked into.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::AddLineBands(VwBox * pbox, int ysTop, int ysMin, int ysLim,
+	LineBandVec & vlbnd)
+{
+	if (pbox->Height() <= 0 || ysTop + pbox->Height() <= ysMin || ysTop >= ysLim)
+		return;
+	if (pbox->IsLazyBox())
+	{
+		if (ysTop >= ysMin)
+		{
+			LineBand lbnd;
+			lbnd.m_ysTop = ysTop;
+			lbnd.m_ysBottom = ysTop + pbox->Height();
+			lbnd.m_ysBaseline = ysTop;
+			lbnd.m_pvpbox = NULL;
+			lbnd.m_iline = 0;
+			vlbnd.Push(lbnd);
+		}
+		return;
+	}
+	VwGroupBox * pgbox = dynamic_cast<VwGroupBox *>(pbox);
+	if (!pgbox)
+		return;
+	if (!pgbox->IsParagraphBox())
+	{
+		for (VwBox * pboxChild = pgbox->FirstBox(); pboxChild; pboxChild = pboxChild->NextOrLazy())
+			AddLineBands(pboxChild, ysTop + pboxChild->Top(), ysMin, ysLim, vlbnd);
+		return;
+	}
+	// A line is a run of boxes with the same baseline (compare VwParagraphBox::CLines). Only
+	// lines with some text get a band, but boxes such as inner piles in any line may have
+	// lines of their own.
+	LineBand lbnd;
+	lbnd.m_pvpbox = dynamic_cast<VwParagraphBox *>(pgbox);
+	lbnd.m_iline = -1;
+	bool fText = false;
+	for (VwBox * pboxChild = pgbox->FirstBox(); ; pboxChild = pboxChild->Next())
+	{
+		int ysBaselineThis = pboxChild ? pboxChild->Top() + pboxChild->Ascent() : -1;
+		if (!pboxChild || ysBaselineThis < 0 || lbnd.m_iline < 0 ||
+			ysTop + ysBaselineThis != lbnd.m_ysBaseline)
+		{
+			// End of the previous line, if any.
+			if (fText && lbnd.m_ysBaseline >= ysMin && lbnd.m_ysBaseline < ysLim)
+				vlbnd.Push(lbnd);
+			// An extra box not to be drawn (from a truncated paragraph) ends the last line.
+			if (!pboxChild || ysBaselineThis < 0)
+				break;
+			lbnd.m_iline++;
+			lbnd.m_ysBaseline = ysTop + ysBaselineThis;
+			lbnd.m_ysTop = ysTop + pboxChild->Top();
+			lbnd.m_ysBottom = lbnd.m_ysTop;
+			fText = false;
+		}
+		lbnd.m_ysTop = min(lbnd.m_ysTop, ysTop + pboxChild->Top());
+		lbnd.m_ysBottom = max(lbnd.m_ysBottom, ysTop + pboxChild->Bottom());
+		if (pboxChild->IsStringBox())
+			fText = true;
+		else
+			AddLineBands(pboxChild, ysTop + pboxChild->Top(), ysMin, ysLim, vlbnd);
+	}
+}
+
+void VwRootBox::BuildLineBands()
+{
+	m_vlbnd.Clear();
+	AddLineBands(this, Top(), INT_MIN, INT_MAX, m_vlbnd);
+	// Boxes come in document order, which is mostly but not always (e.g., table columns)
+	// top to bottom.
+	qsort((void *)m_vlbnd.Begin(), (size_t)m_vlbnd.Size(), sizeof(LineBand), CompareLineBands);
+	m_fLineBandsValid = true;
+	m_pgboxLineBandsChanging = NULL;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Note that the part of pgbox from dysMin to dysLim (relative to its top) is about to be laid
+	out again, and that pgbox, its containers, and the root may change height accordingly, but
+	nothing else will change. Call EndLineBandsChange with the same box when it is done. If the
+	index cannot follow such a change to this box, it is simply discarded.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::BeginLineBandsChange(VwGroupBox * pgbox, int dysMin, int dysLim)
+{
+	if (!m_fLineBandsValid)
+		return; // Nothing to keep up to date; it will be built when next needed.
+	// Changes inside one another, layout that is put off, and synchronized heights are all
+	// too hard to follow.
+	if (m_pgboxLineBandsChanging || m_fDeferRelayout || m_qsync || !pgbox->Height())
+	{
+		InvalidateLineBands();
+		return;
+	}
+	for (VwBox * pbox = pgbox; pbox; pbox = pbox->Container())
+	{
+		// In anything but a division (e.g., a table cell, or a pile in a paragraph), a change
+		// of height can move boxes beside this one; in an inverted one it moves those above.
+		if ((pbox != pgbox && !dynamic_cast<VwDivBox *>(pbox)) ||
+			pbox->ChooseSecondIfInverted(false, true))
+		{
+			InvalidateLineBands();
+			return;
+		}
+	}
+	m_pgboxLineBandsChanging = pgbox;
+	m_ysLineBandsTop = pgbox->TopToTopOfDocument();
+	m_ysLineBandsMin = m_ysLineBandsTop + dysMin;
+	m_ysLineBandsLim = m_ysLineBandsTop + dysLim;
+	m_dysLineBandsBox = pgbox->Height();
+	m_dysLineBandsRoot = Height();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Finish a change begun by BeginLineBandsChange: replace the bands in the part of pgbox that
+	was laid out again by its new ones, and move the bands below it by the change in the root's
+	height. This costs a search of the boxes in that part, and of the bands; the rest of the
+	root is not looked at.
+----------------------------------------------------------------------------------------------*/
+void VwRootBox::EndLineBandsChange(VwGroupBox * pgbox)
+{
+	if (!m_fLineBandsValid || !LineBandsChanging(pgbox))
+	{
+		InvalidateLineBands();
+		return;
+	}
+	m_pgboxLineBandsChanging = NULL;
+	int dys = Height() - m_dysLineBandsRoot;
+	int ysLimNew = m_ysLineBandsLim + dys;
+	// Anything but the box itself changing height (or moving) would move other lines.
+	if (pgbox->TopToTopOfDocument() != m_ysLineBandsTop ||
+		pgbox->Height() - m_dysLineBandsBox != dys || ysLimNew < m_ysLineBandsMin)
+	{
+		InvalidateLineBands();
+		return;
+	}
+	int ilbndMin = FindLineBand(m_ysLineBandsMin);
+	int ilbndLim = FindLineBand(m_ysLineBandsLim);
+	for (int ilbnd = ilbndLim; ilbnd < m_vlbnd.Size(); ilbnd++)
+	{
+		LineBand & lbnd = m_vlbnd[ilbnd];
+		lbnd.m_ysTop += dys;
+		lbnd.m_ysBottom += dys;
+		lbnd.m_ysBaseline += dys;
+	}
+	LineBandVec vlbnd;
+	AddLineBands(pgbox, m_ysLineBandsTop, m_ysLineBandsMin, ysLimNew, vlbnd);
+	qsort((void *)vlbnd.Begin(), (size_t)vlbnd.Size(), sizeof(LineBand), CompareLineBands);
+	m_vlbnd.Replace(ilbndMin, ilbndLim, vlbnd.Begin(), vlbnd.Size());
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the index of the first line band whose baseline is at or below ys, or
+	m_vlbnd.Size() if there is none.
+----------------------------------------------------------------------------------------------*/
+int VwRootBox::FindLineBand(int ys)
+{
+	// A change that never finished (because of an exception) leaves the index unreliable.
+	if (!m_fLineBandsValid || m_pgboxLineBandsChanging)
+		BuildLineBands();
+	int ilbndMin = 0;
+	int ilbndLim = m_vlbnd.Size();
+	while (ilbndMin < ilbndLim)
+	{
+		int ilbndMid = (ilbndMin + ilbndLim) / 2;
+		if (m_vlbnd[ilbndMid].m_ysBaseline < ys)
+			ilbndMin = ilbndMid + 1;
+		else
+			ilbndLim = ilbndMid;
+	}
+	return ilbndMin;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the baseline of the first line (or the top of the first lazy box) below ys, or -1
+	if there is none.
+----------------------------------------------------------------------------------------------*/
+int VwRootBox::NextLineBaseline(int ys)
+{
+	int ilbnd = FindLineBand(ys + 1);
+	if (ilbnd >= m_vlbnd.Size())
+		return -1;
+	return m_vlbnd[ilbnd].m_ysBaseline;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the baseline of the last line (or the top of the last lazy box) above ys, or -1
+	if there is none.
+----------------------------------------------------------------------------------------------*/
+int VwRootBox::PrevLineBaseline(int ys)
+{
+	int ilbnd = FindLineBand(ys);
+	if (ilbnd == 0)
+		return -1;
+	return m_vlbnd[ilbnd - 1].m_ysBaseline;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the baseline of a line (or the top of a lazy box) that occupies ys, preferring the
+	one whose baseline is nearest below it, or -1 if ys is not in any line.
+----------------------------------------------------------------------------------------------*/
+int VwRootBox::LineBaselineAt(int ys)
+{
+	int ilbnd = FindLineBand(ys);
+	if (ilbnd < m_vlbnd.Size() && m_vlbnd[ilbnd].m_ysTop <= ys)
+		return m_vlbnd[ilbnd].m_ysBaseline;
+	if (ilbnd > 0 && m_vlbnd[ilbnd - 1].m_ysBottom > ys)
+		return m_vlbnd[ilbnd - 1].m_ysBaseline;
+	return -1;
+}
+
 /*----------------------------------------------------------------------------------------------
 	Set your selection. Will remove the old one, but will not show the new one; call
 	ShowSelection if appropriate. Does nothing if the argument is already the selection.
@@ -4519,7 +5468,10 @@ void VwRootBox::AdjustBoxPositions(Rect rcRootOld, VwBox * pboxFirstLayout, VwBo
 {
 	Assert(pdboxContainer || (!pboxFirstLayout && !pboxLimLayout));
 	if (!pdboxContainer)
+	{
+		InvalidateLineBands();
 		return;
+	}
 
 	// This method is used for layout operations during expanding lazy boxes. Operations like paint and PropChanged
 	// are dangerous during it, just like PropChanged calls.
@@ -4542,6 +5494,17 @@ void VwRootBox::AdjustBoxPositions(Rect rcRootOld, VwBox * pboxFirstLayout, VwBo
 		IVwRootSitePtr qvrs;
 		CheckHr(get_Site(&qvrs));
 		CheckHr(qvrs->GetAvailWidth(this, &dxsAvailWidth));
+		// Only the boxes from pboxFirstLayout up to pboxLimLayout are new; the line bands
+		// below them just move. Nothing in the container has moved yet.
+		VwBox * pboxBefore = NULL;
+		if (pboxFirstLayout && pboxFirstLayout->Container() == pdboxContainer)
+			pboxBefore = pdboxContainer->BoxBefore(pboxFirstLayout);
+		int dysLimChange = pdboxContainer->Height();
+		if (pboxLimLayout && pboxLimLayout->Container() == pdboxContainer)
+			dysLimChange = pboxLimLayout->Top();
+		BeginLineBandsChange(pdboxContainer, pboxBefore ? pboxBefore->Bottom() : 0,
+			dysLimChange);
+
 		int dysSrcHeight; // the height of the Src rectangle in our coord transformation.
 		int dxsSrcWidth;
 		{	// BLOCK, to control scope of HoldLayoutGraphics. Note that we only use its width,
@@ -4640,6 +5603,7 @@ void VwRootBox::AdjustBoxPositions(Rect rcRootOld, VwBox * pboxFirstLayout, VwBo
 				break;
 			pboxBeforeLayout = pdboxOuter->BoxBefore(pboxCurr);
 		}
+		EndLineBandsChange(pdboxContainer);
 
 		{ // BLOCK for HoldGraphics
 			HoldGraphics hg(this);
@@ -4666,6 +5630,10 @@ void VwRootBox::AdjustBoxPositions(Rect rcRootOld, VwBox * pboxFirstLayout, VwBo
 			}
 		}
 	}
+	else
+	{
+		InvalidateLineBands();
+	}
 	m_fIsPropChangedInProgress = fWasPropChangeInProgress;
 }
 /*----------------------------------------------------------------------------------------------
@@ -4749,6 +5717,10 @@ VwNotifier * VwRootBox::NotifierWithKeyAndParent(VwBox * pbox, VwNotifier * pnot
 void VwRootBox::Unlock()
 {
 	m_fLocked = false;
+	if (!m_vrectSkippedPaints.Size())
+		return;
+	// Paints skipped while locked often cover the same area repeatedly.
+	CollectDamage cd(this);
 	Rect invalid;
 	while (m_vrectSkippedPaints.Pop(&invalid))
 		InvalidateRect(&invalid);
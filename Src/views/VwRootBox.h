@@ -46,6 +46,82 @@ typedef enum
 
 typedef Vector<VwSelection *> SelVec; // Hungarian vsel
 
+/*----------------------------------------------------------------------------------------------
+Class: VwCachedCheckWord
+Description: Wraps a spelling dictionary, remembering the answer it gave for each word form, so
+spell checking does not ask it again about words that occur in many paragraphs, or each time a
+paragraph is re-checked. Words are expected to be normalized (NFC) already, as SpellCheckMethod
+does. Instances are shared by all root boxes through VwSpellingCache.
+Hungarian: ccw
+----------------------------------------------------------------------------------------------*/
+class VwCachedCheckWord : public ICheckWord
+{
+public:
+	VwCachedCheckWord(ICheckWord * pcw);
+	virtual ~VwCachedCheckWord();
+
+	STDMETHOD(QueryInterface)(REFIID riid, void ** ppv);
+	STDMETHOD_(UCOMINT32, AddRef)(void);
+	STDMETHOD_(UCOMINT32, Release)(void);
+
+	STDMETHOD(Check)(LPCOLESTR pszWord, ComBool * pfGood);
+
+	ICheckWord * Checker()
+	{
+		return m_qcw;
+	}
+	void ClearResults()
+	{
+		m_hmsufGood.Clear();
+	}
+
+	int HitCount() const { return m_cHit; }
+	int MissCount() const { return m_cMiss; }
+	int EvictionCount() const { return m_cEvict; }
+
+	// Most words remembered for one dictionary; more than enough for a typical text.
+	static const int kcwMax = 20000;
+
+protected:
+	long m_cref;
+	ICheckWordPtr m_qcw; // the real dictionary.
+	HashMapStrUni<bool> m_hmsufGood; // word form -> answer from m_qcw.
+	int m_cHit;
+	int m_cMiss;
+	int m_cEvict;
+};
+DEFINE_COM_PTR(VwCachedCheckWord);
+
+typedef ComHashMapStrUni<VwCachedCheckWord> CachedCheckWordMap; // Hungarian hmsuqccw
+
+/*----------------------------------------------------------------------------------------------
+Class: VwSpellingCache
+Description: The spelling results shared by all root boxes that do spell checking, one
+VwCachedCheckWord for each dictionary id (that is, for each SpellCheckingId of a writing
+system). It lives as long as some root box has a spelling repository.
+Hungarian: spc
+----------------------------------------------------------------------------------------------*/
+class VwSpellingCache : public GenRefObj
+{
+public:
+	static void GetSharedCache(VwSpellingCache ** ppspc);
+
+	void GetChecker(const OLECHAR * pszId, ICheckWord * pcw, ICheckWord ** ppcw);
+	void ClearResults();
+	void GetStatistics(int * pcHit, int * pcMiss, int * pcEvict);
+	// Incremented whenever any remembered spelling status may have changed.
+	static int Generation() { return s_nGeneration; }
+
+protected:
+	VwSpellingCache();
+	virtual ~VwSpellingCache();
+
+	CachedCheckWordMap m_hmsuqccw;
+	static VwSpellingCache * s_pspc; // the one shared instance, if any.
+	static int s_nGeneration;
+};
+typedef GenSmartPtr<VwSpellingCache> VwSpellingCachePtr;
+
 class LayoutPageMethod;
 /*----------------------------------------------------------------------------------------------
 Class: VwRootBox
@@ -199,6 +275,10 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 	STDMETHOD(SetSpellingRepository)(IGetSpellChecker * pgsp);
 
 	STDMETHOD(get_NeedsReconstruct)(ComBool * pfNeeds);
+	STDMETHOD(BeginPropChangedBatch)();
+	STDMETHOD(EndPropChangedBatch)();
+	STDMETHOD(get_RememberFragmentHeights)(ComBool * pfRemember);
+	STDMETHOD(put_RememberFragmentHeights)(ComBool fRemember);
 
 	// IServiceProvider methods
 	STDMETHOD(QueryService)(REFGUID guidService, REFIID riid, void ** ppv);
@@ -218,13 +298,23 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 	void AdjustBoxPositions(Rect rcRootOld, VwBox * pboxFirstLayout, VwBox * pboxLimLayout,
 		Rect rcThisOld, VwDivBox * pdboxContainer, bool * pfForcedScroll, VwSynchronizer * psync,
 		bool fDoLayoutForExpandedItems);
-	virtual void Reconstruct(bool fCheckForSync);
+	virtual void Reconstruct(bool fCheckForSync, bool fKeepLayout = false);
 #ifdef DEBUG
 	void AssertNotifiersValid();
 #endif
 	// Other public methods
 	void SetDirty(bool fDirty);
 	void InvalidateRect (Rect * vwrect);
+	// Damage collection (see VwRootBox.cpp).
+	void BeginCollectingDamage()
+	{
+		m_cDamageCollect++;
+	}
+	void EndCollectingDamage();
+	int LastDamageArea()
+	{
+		return m_nLastDamageArea;
+	}
 	virtual VwRootBox * Root()
 	{
 		return this;
@@ -454,6 +544,13 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 	// Note that this is accessed by VwLazyBox.ExpandItems to make sure it is set during expansion.
 	bool m_fIsPropChangedInProgress;
 
+	// Number of calls to BeginPropChangedBatch without matching EndPropChangedBatch.
+	int m_cPropChangedBatch;
+	// True while the changes queued during a batch are being regenerated; RelayoutRoot then
+	// just accumulates its fix map in m_fixmapDeferred.
+	bool m_fDeferRelayout;
+	FixupMap m_fixmapDeferred;
+
 	// The root box is locked when it is in a state where certain operations
 	// (notably spell check steps and painting) cannot safely take place, such as
 	// during a PropChanged which inserts a temporary box in place of a real one
@@ -462,13 +559,19 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 	// While the view is locked, if we get paint messages, we must save the
 	// invalid areas, and invalidate them when no longer locked.
 	Vector<Rect> m_vrectSkippedPaints;
+	// While m_cDamageCollect is non-zero, invalidated rectangles are merged into
+	// m_vrectDamage rather than being passed on to the site (see EndCollectingDamage).
+	int m_cDamageCollect;
+	Vector<Rect> m_vrectDamage;
+	int m_nLastDamageArea; // area invalidated by the last collection, in layout pixels.
+	void AddDamage(Rect rc);
 
 	// Static methods
 
 	// Constructors/destructors/etc.
 
 	// Other protected methods
-	void Construct(IVwGraphics * pvg, int dxAvailWidth);
+	void Construct(IVwGraphics * pvg, int dxAvailWidth, bool fKeepStyles = false);
 
 	// Protected default constructor does nothing.
 	// After creating with CreateCom, must set everything up from Init
@@ -495,9 +598,15 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 	// next paragraph box to spell-check.
 	VwParagraphBox * m_pvpboxNextSpellCheck;
 	bool m_fCompletedSpellCheck; // true when we reach the end.
+	// Incremented whenever the dictionaries may have changed, so every paragraph is checked again.
+	int m_nSpellCheckGen;
+	// SpellCheckGeneration() when m_fCompletedSpellCheck was last set.
+	int m_nSpellCheckGenCompleted;
+	void CheckSpellCheckCurrent();
 	void FindBreak(VwPrintInfo * pvpi, Rect rcSrc, Rect rcDst, int ysStart, int * pysEnd);
 	bool OnMouseEvent(int xd, int yd, RECT rcSrc, RECT rcDst, VwMouseEvent me);
 	IGetSpellCheckerPtr m_qgspCheckerRepository;
+	VwSpellingCachePtr m_qspc; // results from the dictionaries obtained from the repository.
 	// The string in the paragraph box can fall out of sync with selection indices while a normalize commit is in progress.
 	bool m_fNormalizationCommitInProgress;
 	HVO m_hvoNormalizationCommitInProgress;
@@ -511,8 +620,134 @@ class VwRootBox : public IVwRootBox, public IServiceProvider, public VwDivBox
 		int iprop, int ihvoMin, int ihvoLim);
 	Point DpiSrc() { return m_ptDpiSrc; }
 	virtual void SendPageNotifications(VwBox * pbox) {}; // See VwLayoutStream override.
+	virtual void BoxDeleted(VwBox * pbox) {} // Called by ~VwBox; see VwLayoutStream override.
+	virtual bool CanDeferRelayout() { return true; } // See VwLayoutStream override.
 	void ResetSpellCheck();
+	// Both parts only ever increase, so the sum changes whenever either does.
+	int SpellCheckGeneration() { return m_nSpellCheckGen + VwSpellingCache::Generation(); }
 	virtual void GetDictionary(const OLECHAR * pszId, ICheckWord ** ppcw);
+
+	// Fragment height memo (see VwRootBox.cpp).
+	bool RemembersFragmentHeights() { return m_fRememberFragmentHeights; }
+	bool RetrieveFragmentHeight(IVwViewConstructor * pvc, int frag, HVO hvo,
+		int dxsAvailWidth, int * pdysHeight);
+	void NoteFragmentHeight(IVwViewConstructor * pvc, int frag, HVO hvo, int dxsAvailWidth,
+		int dysHeight);
+	void ForgetFragmentHeights(HVO hvo)
+	{
+		if (m_mmhvofhr.Size())
+			m_mmhvofhr.Delete(hvo);
+	}
+	void ForgetFragmentHeights()
+	{
+		m_mmhvofhr.Clear();
+	}
+
+	// Line band index for vertical navigation (see VwRootBox.cpp).
+	int NextLineBaseline(int ys);
+	int PrevLineBaseline(int ys);
+	int LineBaselineAt(int ys);
+	void BeginLineBandsChange(VwGroupBox * pgbox, int dysMin, int dysLim);
+	void EndLineBandsChange(VwGroupBox * pgbox);
+	bool LineBandsChanging(VwBox * pbox)
+	{
+		return pbox && pbox == m_pgboxLineBandsChanging;
+	}
+	void InvalidateLineBands()
+	{
+		m_vlbnd.Clear();
+		m_fLineBandsValid = false;
+		m_pgboxLineBandsChanging = NULL;
+	}
+
+	// Reuse of paragraph layout across Reconstruct (see VwRootBox.cpp).
+	bool HasLayoutDonors()
+	{
+		return m_mmnpboxDonor.Size() != 0;
+	}
+	VwParagraphBox * TakeLayoutDonor(VwParagraphBox * pvpbox, int dxAvailWidth);
+
+protected:
+	/*------------------------------------------------------------------------------------------
+		The remembered laid-out height of the display of one object by one fragment of one
+		view constructor at one available width. The view constructor is held so that it
+		cannot be freed and another one made at the same address while it is remembered.
+		Hungarian: fhr
+	------------------------------------------------------------------------------------------*/
+	struct FragHeightRec
+	{
+		IVwViewConstructorPtr m_qvc;
+		int m_frag;
+		int m_dxsAvailWidth;
+		int m_dysHeight;
+	};
+	// Keyed by object, so that a PropChanged can forget the heights of displays of the
+	// object that changed without looking at the others.
+	typedef MultiMap<HVO, FragHeightRec> FragHeightMap; // Hungarian mmhvofhr
+	FragHeightMap m_mmhvofhr;
+	bool m_fRememberFragmentHeights; // see get_RememberFragmentHeights.
+
+	/*------------------------------------------------------------------------------------------
+		One laid-out line of a paragraph (or one lazy box, which may expand into some), in
+		layout coordinates relative to the whole root. The paragraph pointer is only ever
+		compared, never followed; it is null for a lazy box.
+		Hungarian: lbnd
+	------------------------------------------------------------------------------------------*/
+	struct LineBand
+	{
+		int m_ysTop;
+		int m_ysBottom; // exclusive
+		int m_ysBaseline; // the top, for a lazy box
+		VwParagraphBox * m_pvpbox;
+		int m_iline;
+	};
+	typedef Vector<LineBand> LineBandVec; // Hungarian vlbnd
+	// One band per line of the whole root, sorted by baseline; valid only if m_fLineBandsValid.
+	LineBandVec m_vlbnd;
+	bool m_fLineBandsValid;
+	// The box between BeginLineBandsChange and EndLineBandsChange, if any, with the part of
+	// the root it occupied (m_ysLineBandsMin to m_ysLineBandsLim), and its own top and height
+	// and the root's height before the change.
+	VwGroupBox * m_pgboxLineBandsChanging;
+	int m_ysLineBandsMin;
+	int m_ysLineBandsLim;
+	int m_ysLineBandsTop;
+	int m_dysLineBandsBox;
+	int m_dysLineBandsRoot;
+	void BuildLineBands();
+	static void AddLineBands(VwBox * pbox, int ysTop, int ysMin, int ysLim,
+		LineBandVec & vlbnd);
+	int FindLineBand(int ys);
+	static VwBox * ChangedBox(FixupMap * pfixmap);
+	static int CompareLineBands(const void * pv1, const void * pv2);
+
+	/*------------------------------------------------------------------------------------------
+		A PropChanged notification queued during a batch (see BeginPropChangedBatch).
+		Hungarian: ppc
+	------------------------------------------------------------------------------------------*/
+	struct PendingPropChange
+	{
+		HVO m_hvo;
+		PropTag m_tag;
+		int m_ivMin;
+		int m_cvIns;
+		int m_cvDel;
+	};
+	typedef Vector<PendingPropChange> PendingPropChangeVec; // Hungarian vppc
+	PendingPropChangeVec m_vppc;
+	// Index in m_vppc of the queued change, if any, for each property.
+	HashMap<HvoTagRec, int> m_hmhtippc;
+	void QueuePropChanged(HVO hvo, PropTag tag, int ivMin, int cvIns, int cvDel);
+	void FlushPropChangedBatch();
+	void DoPropChanged(HVO hvo, PropTag tag, int ivMin, int cvIns, int cvDel);
+
+	// Paragraphs of the box tree being replaced by Reconstruct, keyed by
+	// VwParagraphBox::LayoutShareKey, whose lines may be taken over by identical new ones.
+	typedef MultiMap<int, VwParagraphBox *> LayoutDonorMap; // Hungarian mmnpbox
+	LayoutDonorMap m_mmnpboxDonor;
+	void CollectLayoutDonors(VwBox * pboxFirst);
+	VwBox * DetachOldBoxes(bool fKeepLayout);
+	void DeleteOldBoxes(VwBox * pboxFirst);
 };
 DEFINE_COM_PTR(VwRootBox);
 
@@ -604,6 +839,30 @@ class HoldGraphicsAtSrc
 protected:
 	VwRootBox * m_prootb;
 };
+/*----------------------------------------------------------------------------------------------
+This class collects the rectangles invalidated in the root box while it is in scope, and
+passes a minimal set of them to the root site when it goes out of scope. Use it around an
+operation (such as handling a PropChanged) which may invalidate the same or overlapping areas
+several times as boxes are replaced and laid out again.
+@h3{Hungarian: cd}
+----------------------------------------------------------------------------------------------*/
+class CollectDamage
+{
+public:
+	CollectDamage(VwRootBox * prootb)
+	{
+		m_prootb = prootb;
+		m_prootb->BeginCollectingDamage();
+	}
+	~CollectDamage()
+	{
+		m_prootb->EndCollectingDamage();
+	}
+
+protected:
+	VwRootBox * m_prootb;
+};
+
 /*----------------------------------------------------------------------------------------------
 This class is useful when you need to get a layout resolution VwGraphics from
 the root box GetLayoutGraphics method. It guarantees to call the necessary ReleaseGraphics when
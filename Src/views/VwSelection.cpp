@@ -568,6 +568,12 @@ void VwSelection::MoveIpVerticalByAmount(IVwGraphics * pvg, int lYAdjustment, bo
 
 	CheckHr(pRootBox->PrepareToDraw(pvg, rcSrc, rcDest, &pdr));
 
+	// Click on the baseline of the line we land in, rather than wherever in it (or in the
+	// space beside it) the page height happens to reach.
+	int ysBaseline = pRootBox->LineBaselineAt(rcDest.MapYTo(newPos.y, rcSrc));
+	if (ysBaseline >= 0)
+		newPos.y = rcSrc.MapYTo(ysBaseline, rcDest);
+
 	if(fIsExtendedSelection)
 		CheckHr(pRootBox->MouseDownExtended(newPos.x, newPos.y, rcSrc, rcDest));
 	else
@@ -1596,62 +1602,28 @@ STDMETHODIMP VwTextSelection::GetSelectionProps(int cttpMax, ITsTextProps ** prg
 				cttp++;
 			}
 
-			for (int ich = ichStart; ich < ichEnd;)
+			// Paragraphs entirely covered by the selection use the summary kept by the text
+			// source; only the partial paragraphs at each end need their runs walked.
+			RunPropsVec vrprPartial;
+			RunPropsVec * pvrpr = &vrprPartial;
+			if (ichStart == 0 && ichEnd == pts->Cch())
+				pvrpr = &pts->RunProps();
+			else
+				pts->CollectRunProps(ichStart, ichEnd, vrprPartial);
+			if (cttpMax)
 			{
-				// ich is relative to the paragraph, as is ichMinTss
-				int ichNew;
-				if (qtss)
-				{
-					ITsTextPropsPtr qttp;
-					TsRunInfo tri;
-					CheckHr(qtss->FetchRunInfoAt(ich - ichMinTss, &tri, &qttp));
-					if (cttpMax)
-					{
-						if (cttp < cttpMax)
-						{
-							VwPropertyStorePtr qzvpsA;
-							CheckHr(qzvps->ComputedPropertiesForTtp(qttp, &qzvpsA));
-							prgpvps[cttp] = qzvpsA.Detach();
-							prgpttp[cttp] = qttp.Detach();
-						}
-						else
-						{
-							return E_FAIL;
-						}
-					}
-					cttp++;
-					ichNew = ichMinTss + tri.ichLim;
-				}
-				else
-				{
-					// Otherwise, there aren't any ttps associated with this char position,
-					// ignore it.  Just advance by the one character which is associated with
-					// a non-tss.
-					ichNew = ichMinTss + 1;
-				}
-				if (ichNew >= ichLimTss && ichEnd > ichLimTss)
-				{
-					Assert(pts->CStrings() > (itss+1));
-					// We need the next string
-					Assert(ichNew == ichLimTss);  // we should have used this string up
-					pts->StringAtIndex(++itss, &qtss);
-					ichMinTss = ichLimTss;
-					int cch;
-					if (qtss)
-						CheckHr(qtss->get_Length(&cch));
-					else
-						cch = 1;
-					ichLimTss += cch;
-				}
-				else
+				if (cttp + pvrpr->Size() > cttpMax)
+					return E_FAIL;
+				for (int irpr = 0; irpr < pvrpr->Size(); irpr++)
 				{
-					// Only if we didn't move to the next string: there might be some
-					// empty strings in there...but processing a run should have
-					// caused us to make some progress, otherwise.
-					Assert(ichNew > ich);
+					RunPropsRec & rpr = (*pvrpr)[irpr];
+					prgpttp[cttp + irpr] = rpr.qttp;
+					AddRefObj(prgpttp[cttp + irpr]);
+					prgpvps[cttp + irpr] = rpr.qzvps;
+					AddRefObj(prgpvps[cttp + irpr]);
 				}
-				ich = ichNew;
 			}
+			cttp += pvrpr->Size();
 		}
 		// More boxes?
 		if (pboxNew == pvpboxLast)
@@ -6132,9 +6104,6 @@ VwParagraphBox * VwTextSelection::MakeDummyPara(ITsString * ptss, VwPropertyStor
 	This implements the guts of GetSelectionString and GetFirstParaString. If fWholeSelection
 	is true, we always process the whole selection and return true; otherwise, we process just
 	the first paragraph, and return true if we truncated.
-
-	Note that the logic here is very similar to VwStringBox::GetDependentObjects.
-	We were not able to figure a clean way to factor it out, however.
 ----------------------------------------------------------------------------------------------*/
 class GetSelectionStringMethod
 {
@@ -10993,7 +10962,13 @@ int VwTextSelection::DownOneLine(int ichLogIP, VwParagraphBox * pvpboxIP, bool f
 	int yBaselineNew = yBaselineOrig;		// Definitely not > yBaselineOrig.
 	do
 	{
-		yd += 3;
+		// Go straight to the baseline of the next line (or lazy box) below the one we are on
+		// or last looked at.
+		int ysNext = prootb->NextLineBaseline(max(rcDstRoot.MapYTo(yd, rcSrcRoot),
+			yBaselineOrig));
+		if (ysNext < 0)
+			break;
+		yd = max(yd + 1, rcSrcRoot.MapYTo(ysNext, rcDstRoot));
 		if (yd > twHeight)
 			break;
 		pbox = prootb->FindBoxClicked(qvg, m_xdIP, yd, rcSrcRoot, rcDstRoot, &rcSrc, &rcDst);
@@ -11770,7 +11745,16 @@ int VwTextSelection::UpOneLine(int ichLogIP, VwParagraphBox * pvpboxIP, bool fAs
 	int yBaselineNew = yBaselineOrig;		// Definitely not < yBaselineOrig.
 	do
 	{
-		yd -= 3;
+		// Go straight to the baseline of the previous line (or the top of the lazy box) above
+		// the one we are on or last looked at.
+		int ysPrev = prootb->PrevLineBaseline(min(rcDstRoot.MapYTo(yd, rcSrcRoot),
+			yBaselineOrig));
+		if (ysPrev < 0)
+		{
+			pbox = NULL;
+			break;
+		}
+		yd = min(yd - 1, rcSrcRoot.MapYTo(ysPrev, rcDstRoot));
 		if (yd < rcDst.top)
 		{
 			pbox = NULL;
@@ -12290,7 +12274,7 @@ VwStringBox * VwTextSelection::GetStringBox(int ichLogIP, VwParagraphBox * pvpbo
 	Return true if the selection was modified.
 ----------------------------------------------------------------------------------------------*/
 bool VwTextSelection::AdjustForRep(int & ichLog, VwParagraphBox * pvpbox, int itssMin,
-	int itssLim, VpsTssVec & vpst)
+	int itssLim, const VpsTssVec & vpst)
 {
 	int ichMin = pvpbox->Source()->IchStartString(itssMin);
 	if (ichLog <= ichMin)
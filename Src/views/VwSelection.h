@@ -746,7 +746,7 @@ class VwTextSelection : public VwSelection
 	void UnprotectedCommit(bool * pfOk);
 	VwStringBox * GetStringBox(int ichLogIP, VwParagraphBox * pvpboxIP, bool fAssocPrev);
 	bool AdjustForRep(int & ichLog, VwParagraphBox * pvpbox, int itssMin, int itssLim,
-		VpsTssVec & vpst);
+		const VpsTssVec & vpst);
 
 	// Test whether the given location is at the beginning (or end) of a line on the display.
 	bool IsBeginningOfLine(int ichLogIP, VwParagraphBox * pvpboxIP, IVwGraphics * pvg)
@@ -60,6 +60,7 @@ VwBox::~VwBox()
 		NotifierVec vpanoteDel;
 		prootb->DeleteNotifiersFor(this, -1, vpanoteDel);
 		Assert(vpanoteDel.Size() == 0);
+		prootb->BoxDeleted(this);
 	}
 }
 
@@ -580,8 +580,11 @@ bool VwSynchronizer::AnotherRootHasSelection(VwRootBox * prootbSrc)
 /*----------------------------------------------------------------------------------------------
 	Reconstruct every root box in the set, but in a way that preserves the sync. This means
 	that we must do the Construct() phase for everyone before the Layout() phase for everyone.
+
+	@param fKeepLayout See VwRootBox::Reconstruct. The old boxes of every root are then kept
+						until all the roots have been laid out.
 ----------------------------------------------------------------------------------------------*/
-void VwSynchronizer::Reconstruct()
+void VwSynchronizer::Reconstruct(bool fKeepLayout)
 {
 	// Save the information we need to determine which views changed size.
 	IntVec vHeight;
@@ -613,33 +616,52 @@ void VwSynchronizer::Reconstruct()
 		prootb->InvalidateRect(&vwrect); //old
 	}
 
-	// Now we reconstruct everything. No layout until all are back in default state,
-	// with nothing lazy expanded.
-	for (int irootb = 0; irootb < m_vrootb.Size(); irootb++)
+	// The old boxes of each root, if they are kept (see VwRootBox::DetachOldBoxes).
+	BoxVec vboxOld;
+	vboxOld.Resize(m_vrootb.Size(), NULL);
+	try
 	{
-		VwRootBox * prootb = dynamic_cast<VwRootBox *>(m_vrootb[irootb].Ptr());
-		if (prootb->Site() == NULL)
-			continue;
-		CheckHr(prootb->DestroySelection());
-		prootb->ClearNotifiers();
-		NotifierVec vpanoteDelDummy; // required argument, but all gone already.
-		prootb->DeleteContents(prootb, vpanoteDelDummy);
-		int dxAvailWidth;
-		CheckHr(prootb->Site()->GetAvailWidth(prootb, &dxAvailWidth));
-		HoldLayoutGraphics hg(prootb);
-		prootb->Construct(hg.m_qvg, dxAvailWidth);
-	}
+		// Now we reconstruct everything. No layout until all are back in default state,
+		// with nothing lazy expanded.
+		for (int irootb = 0; irootb < m_vrootb.Size(); irootb++)
+		{
+			VwRootBox * prootb = dynamic_cast<VwRootBox *>(m_vrootb[irootb].Ptr());
+			if (prootb->Site() == NULL)
+				continue;
+			vboxOld[irootb] = prootb->DetachOldBoxes(fKeepLayout);
+			int dxAvailWidth;
+			CheckHr(prootb->Site()->GetAvailWidth(prootb, &dxAvailWidth));
+			HoldLayoutGraphics hg(prootb);
+			prootb->Construct(hg.m_qvg, dxAvailWidth, fKeepLayout);
+		}
 
-	// Now we lay them ALL out...
+		// Now we lay them ALL out...
+		for (int irootb = 0; irootb < m_vrootb.Size(); irootb++)
+		{
+			VwRootBox * prootb = dynamic_cast<VwRootBox *>(m_vrootb[irootb].Ptr());
+			if (prootb->Site() == NULL)
+				continue;
+			int dxAvailWidth;
+			CheckHr(prootb->Site()->GetAvailWidth(prootb, &dxAvailWidth));
+			HoldLayoutGraphics hg(prootb);
+			prootb->Layout(hg.m_qvg, dxAvailWidth);
+		}
+	}
+	catch (...)
+	{
+		for (int irootb = 0; irootb < m_vrootb.Size(); irootb++)
+		{
+			VwRootBox * prootb = dynamic_cast<VwRootBox *>(m_vrootb[irootb].Ptr());
+			if (vboxOld[irootb])
+				prootb->DeleteOldBoxes(vboxOld[irootb]);
+		}
+		throw;
+	}
 	for (int irootb = 0; irootb < m_vrootb.Size(); irootb++)
 	{
 		VwRootBox * prootb = dynamic_cast<VwRootBox *>(m_vrootb[irootb].Ptr());
-		if (prootb->Site() == NULL)
-			continue;
-		int dxAvailWidth;
-		CheckHr(prootb->Site()->GetAvailWidth(prootb, &dxAvailWidth));
-		HoldLayoutGraphics hg(prootb);
-		prootb->Layout(hg.m_qvg, dxAvailWidth);
+		if (vboxOld[irootb])
+			prootb->DeleteOldBoxes(vboxOld[irootb]);
 	}
 
 	// And then, when they've all had a chance to affect each other, we figure size
@@ -92,7 +92,7 @@ class VwSynchronizer : public IVwSynchronizer
 	void ContractLazyItems(VwRootBox * prootbSrc, HVO hvoContext, int tag,
 		int iprop, int ihvoMin, int ihvoLim);
 	bool AnotherRootHasSelection(VwRootBox * prootbSrc);
-	void Reconstruct();
+	void Reconstruct(bool fKeepLayout = false);
 	bool VerifyCorrespondence(VwRootBox * prootbSrc, HVO hvoObj,
 		VwBox * pboxSrc);
 	bool OkToNotifyOfSizeChange();
@@ -503,30 +503,21 @@ void VwTableBox::DoLayout(IVwGraphics* pvg, int dxAvailWidth, int dxpAvailOnLine
 	VwTableRowBox* ptabrow;
 	VwBox* pboxCell; //before cast
 	VwTableCellBox* ptabcell;
-	int icolm;
-	int ccolmSpan;
 
 	// Figure cell border status BEFORE laying them out.
 	ComputeCellBorders();
 
-	// Lay out each individual cell; this determines their natural height
+	// Lay out each individual cell; this determines their natural height.
+	// Once the column widths are fixed the cells are independent of each other. Every child
+	// of a table is a row and every child of a row is a cell (ComputeColumnIndexes and
+	// ComputeRowAndCellSizes rely on this too), so plain casts are enough here.
 	for (pboxRow = FirstBox(); pboxRow; pboxRow = pboxRow->Next())
 	{
-		ptabrow = dynamic_cast<VwTableRowBox *>(pboxRow);
+		ptabrow = static_cast<VwTableRowBox *>(pboxRow);
 		for (pboxCell = ptabrow->FirstBox(); pboxCell; pboxCell = pboxCell->Next())
 		{
-			ptabcell = dynamic_cast<VwTableCellBox *>(pboxCell);
-			icolm = ptabcell->ColPosition();
-			ccolmSpan = ptabcell->ColSpan();
-			// The available width for laying out the cell is the sum of
-			// the widths of its columns. (Space between columns is part
-			// of the cell's own margin/border/padding.)
-			int twAvail = 0;
-			for (int i = 0; i < ccolmSpan; i++, icolm++)
-			{
-				twAvail += m_vcolspec[icolm].Width();
-			}
-			ptabcell->DoLayout(pvg, twAvail, -1, fSyncTops);
+			ptabcell = static_cast<VwTableCellBox *>(pboxCell);
+			ptabcell->DoLayout(pvg, CellAvailWidth(ptabcell), -1, fSyncTops);
 		}
 	}
 
@@ -650,6 +641,21 @@ void VwTableBox::ComputeColumnWidths(IVwGraphics * pvg, int dxAvailWidth)
 	}
 }
 
+/*----------------------------------------------------------------------------------------------
+	The available width for laying out a cell is the sum of the widths of the columns it spans.
+	(Space between columns is part of the cell's own margin/border/padding.) Since
+	ComputeColumnWidths sets each column's left to the running total of the widths before it,
+	this is just the distance from the left of the first column to the right of the last one.
+----------------------------------------------------------------------------------------------*/
+int VwTableBox::CellAvailWidth(VwTableCellBox * ptabcell)
+{
+	int icolm = ptabcell->ColPosition();
+	int icolmLast = icolm + ptabcell->ColSpan() - 1;
+	Assert(icolmLast < m_ccolm);
+	return m_vcolspec[icolmLast].Left() + m_vcolspec[icolmLast].Width() -
+		m_vcolspec[icolm].Left();
+}
+
 /*----------------------------------------------------------------------------------------------
 	Table relayout. See  VwBox::Relayout for description of purpose and arguments.
 ----------------------------------------------------------------------------------------------*/
@@ -683,8 +689,6 @@ bool VwTableBox::Relayout(IVwGraphics * pvg, int dxAvailWidth,
 	VwTableRowBox * ptabrow;
 	VwBox * pboxCell; //before cast
 	VwTableCellBox * ptabcell;
-	int icolm;
-	int ccolmSpan;
 
 	Vector<int> vtwRowHeights;
 
@@ -701,7 +705,7 @@ bool VwTableBox::Relayout(IVwGraphics * pvg, int dxAvailWidth,
 	//in the process note current row heights.
 	for (pboxRow = FirstBox(); pboxRow; pboxRow = pboxRow->Next())
 	{
-		ptabrow = dynamic_cast<VwTableRowBox*>(pboxRow);
+		ptabrow = static_cast<VwTableRowBox*>(pboxRow);
 		VwBox * pboxTempRow = ptabrow; // Retrieve non-const param
 		if (pfixmap->Retrieve(pboxTempRow, &vrect))
 		{
@@ -719,14 +723,8 @@ bool VwTableBox::Relayout(IVwGraphics * pvg, int dxAvailWidth,
 		vtwRowHeights.Push(ptabrow->Height());
 		for (pboxCell = ptabrow->FirstBox(); pboxCell; pboxCell = pboxCell->Next())
 		{
-			ptabcell = dynamic_cast<VwTableCellBox*>(pboxCell);
-			icolm = ptabcell->ColPosition();
-			ccolmSpan = ptabcell->ColSpan();
-			int dxAvail = 0;
-			for (int i=0; i < ccolmSpan; i++, icolm++)
-			{
-				dxAvail += m_vcolspec[icolm].Width();
-			}
+			ptabcell = static_cast<VwTableCellBox*>(pboxCell);
+			int dxAvail = CellAvailWidth(ptabcell);
 			//if the cell spans more than the number of rows we are
 			//currently planning to recompute, and if it is a modified box,
 			//increase ctabrowAffected.
@@ -264,6 +264,7 @@ class VwTableBox : public VwPileBox
 	void ComputeCellBorders();
 	void ComputeRowAndCellSizes();
 	void ComputeColumnWidths(IVwGraphics * pvg, int dxsAvailWidth);
+	int CellAvailWidth(VwTableCellBox * ptabcell);
 };
 
 class VwTableRowBox : public VwGroupBox
@@ -235,8 +235,8 @@ void VwStringBox::DeleteAndCleanup(NotifierVec &vpanoteDel)
 }
 
 // Check for links to dependent objects. For each such object, add it's GUID to the vector.
-// Note that the logic here is very similar to VwTextSelection::GetSelectionString1.
-// We were not able to figure a clean way to factor it out, however.
+// The paragraph's text source keeps an index of them, so this does not need to look at the
+// runs of the strings.
 void VwStringBox::GetDependentObjects(Vector<GUID> & vguid)
 {
 	VwTxtSrc * pts = dynamic_cast<VwParagraphBox *>(Container())->Source();
@@ -245,71 +245,7 @@ void VwStringBox::GetDependentObjects(Vector<GUID> & vguid)
 	CheckHr(m_qlseg->get_Lim(IchMin(), &dichLim));
 	// end of string box in logical chars relative to para;
 	int ichLim = pts->RenToLog(IchMin() + dichLim);
-	ITsStringPtr qtss;
-	int ichMinTss; // Start of current TsString in paragraph (logical)
-	int ichLimTss; // End of current TsString in paragraph (logical)
-	int itss; // indexes strings in paragraph.
-	VwPropertyStorePtr qzvps;
-	pts->StringFromIch(ichMin, false, &qtss, &ichMinTss, &ichLimTss, &qzvps, &itss);
-	int ichNew;
-
-	// Loop over the runs of the string(s).
-	for (int ich = ichMin; ich < ichLim; ich = ichNew)
-	{
-		// ich is logical chars, relative to the paragraph, as are ichMinTss and ichLim
-		if (qtss) // otherwise embedded picture, or similar.
-		{
-			ITsTextPropsPtr qttp;
-			TsRunInfo tri;
-			CheckHr(qtss->FetchRunInfoAt(ich - ichMinTss, &tri, &qttp));
-			if (tri.ichLim - tri.ichMin == 1)
-			{
-				// Run of length 1: it might be an ORC. Get it and see.
-				OLECHAR ch;
-				qtss->FetchChars(ich - ichMinTss, ich - ichMinTss + 1, &ch);
-				if (ch == L'\xfffc')
-				{
-					// it's an ORC! See if it has objData.
-					SmartBstr sbstrObjData;
-					CheckHr(qttp->GetStrPropValue(ktptObjData, &sbstrObjData));
-					if (sbstrObjData.Length() == 9 && (sbstrObjData.Chars()[0] == kodtOwnNameGuidHot
-						|| sbstrObjData.Chars()[0] == kodtNameGuidHot))
-					{
-						// It's one of the guids we care about.
-						GUID guid;
-						memcpy(&guid, sbstrObjData.Chars() + 1, 16);
-						vguid.Push(guid);
-					}
-				}
-			}
-			ichNew = ichMinTss + tri.ichLim;
-		}
-		else // no qtss here; advance past the missing string's character position.
-		{
-			ichNew = ichLimTss;
-		}
-		// See if we need the next Tss.
-		if (ichNew >= ichLimTss && ichLim > ichLimTss)
-		{
-			// We need the next string
-			Assert(ichNew == ichLimTss);  // we should have used this string up
-			pts->StringAtIndex(++itss, &qtss);
-			ichMinTss = ichLimTss; // This string begins where the old one ended.
-			int cch; // Length of new current string.
-			if (qtss)
-				CheckHr(qtss->get_Length(&cch));
-			else
-				cch = 1; // embedded non-string boxes always occupy one char position.
-			ichLimTss += cch;
-		}
-		else
-		{
-			// If we didn't move to the next string, we should have advanced the
-			// character position. (If we did move to the next string, we might
-			// NOT advance the character position, because the string might be empty.)
-			Assert(ichNew > ich);
-		}
-	}
+	pts->GetDependentObjects(ichMin, ichLim, vguid);
 }
 
 
@@ -406,6 +342,20 @@ Rect VwParagraphBox::GetInvalidateRect()
 	return rcRet;
 }
 
+/*----------------------------------------------------------------------------------------------
+	Answer the part of GetInvalidateRect() that starts dysTop below the top of the paragraph,
+	that is, what needs repainting when the lines from there on are laid out again.
+----------------------------------------------------------------------------------------------*/
+Rect VwParagraphBox::GetInvalidateRectFrom(int dysTop)
+{
+	Rect rcRet = GetInvalidateRect();
+	// GetInvalidateRect allows a margin above the paragraph; keep the same margin above the
+	// first line that changed.
+	if (dysTop > 0)
+		rcRet.top = std::min(rcRet.top + dysTop, rcRet.bottom);
+	return rcRet;
+}
+
 /*----------------------------------------------------------------------------------------------
 	This defaults to the same as GetBoundsRect() unless the paragraph is enclosed by a
 	VwTableCellBox, in which case we call GetBoundsRect() on the enclosing VwTableCellBox.
@@ -4051,6 +4001,9 @@ VwParagraphBox::VwParagraphBox(VwPropertyStore * pzvps, VwSourceType vst)
 	case kvstNormal:
 		m_qts.Attach(NewObj VwSimpleTxtSrc);
 		break;
+	case kvstSingleRun:
+		m_qts.Attach(NewObj VwSingleRunTxtSrc);
+		break;
 	case kvstTagged:
 		m_qts.Attach(NewObj VwOverlayTxtSrc);
 		break;
@@ -4079,6 +4032,7 @@ VwParagraphBox::VwParagraphBox(VwPropertyStore * pzvps, VwSourceType vst)
 		break;
 	}
 	m_dympExactAscent = -1;
+	m_dxLayoutAvailWidth = -1;
 }
 
 VwParagraphBox::~VwParagraphBox()
@@ -4958,9 +4912,11 @@ void VwParagraphBox::ReplaceStrings(IVwGraphics * pvg, int itssMin, int itssLim,
 
 		// Force layout to recompute size of this box; also replaces all VwStringBoxes, so we
 		// don't have to worry about having messed up their offsets etc.
-		m_dysHeight = 0;
 		VwRootBox * prootb = Root();
-		prootb->RelayoutRoot(pvg, &fixmap);
+		prootb->BeginLineBandsChange(this, 0, m_dysHeight);
+		m_dysHeight = 0;
+		prootb->RelayoutRoot(pvg, &fixmap, -1, pboxsetDeleted);
+		prootb->EndLineBandsChange(this);
 
 #ifdef ENABLE_TSF
 		if (pvim)
@@ -4973,17 +4929,20 @@ void VwParagraphBox::ReplaceStrings(IVwGraphics * pvg, int itssMin, int itssLim,
 	else
 	{
 		VwRootBox * prootb = Root();
-		Rect vwrectOrig = GetInvalidateRect();
+		// The lines before dyStartReplace are kept as they are, so only the part of the
+		// paragraph from there down needs repainting.
+		Rect vwrectOrig = GetInvalidateRectFrom(dyStartReplace);
 		// This might look as if it is duplicated down below, but we need both because the
 		// rectangles may be different sizes as a result of the layout, and either might be
-		// larger. If we really want to do only one invalidate we should compute the union of
-		// the before and after rectangles.
+		// larger. The root box merges them when it is collecting damage (see CollectDamage).
 		prootb->InvalidateRect(&vwrectOrig);
 		int dysHeight = m_dysHeight;
 		int dxsWidth = m_dxsWidth;
 
 		Source()->ReplaceContents(itssMin, itssLim, pvpboxRep->Source());
 
+		// The lines before dyStartReplace keep their line bands too.
+		prootb->BeginLineBandsChange(this, dyStartReplace, dysHeight);
 		DoPartialLayout(pvg, pboxStartReplace, cLinesToSave, dyStartReplace, dyPrevDescent,
 			ichMinDiff, ichLimDiff, cchLenDiff);
 
@@ -4991,10 +4950,11 @@ void VwParagraphBox::ReplaceStrings(IVwGraphics * pvg, int itssMin, int itssLim,
 		// there is no need to recompute containers.
 		if (NoSignificantSizeChange(dysHeight, dxsWidth) && cchLenDiff >= 0)
 		{
+			prootb->EndLineBandsChange(this);
 			if (dxsWidth < m_dxsWidth)
 			{
 				// But if the width increased, need to invalidate the new rectangle.
-				Rect vwrectNew = GetInvalidateRect();
+				Rect vwrectNew = GetInvalidateRectFrom(dyStartReplace);
 				prootb->InvalidateRect(&vwrectNew);
 			}
 #ifdef ENABLE_TSF
@@ -5018,12 +4978,13 @@ void VwParagraphBox::ReplaceStrings(IVwGraphics * pvg, int itssMin, int itssLim,
 		fixmap.Insert(pboxKey, rectEmpty);
 
 		prootb->RelayoutRoot(pvg, &fixmap);
+		prootb->EndLineBandsChange(this);
 
 		// If you get a crash here verify that you don't have a recursive call to the layout
 		// code (e.g. set a breakpoint in SimpleRootSite.SizeChanged). The call to RelayoutRoot
 		// should not destroy any paragraph boxes - if it does it is very likely that something
 		// else is going wrong (c.f. TE-4889).
-		Rect vwrectNew = GetInvalidateRect();
+		Rect vwrectNew = GetInvalidateRectFrom(dyStartReplace);
 		Root()->InvalidateRect(&vwrectNew);
 
 #ifdef ENABLE_TSF
@@ -5624,11 +5585,151 @@ void VwParagraphBox::DoLayout(IVwGraphics * pvg, int dxAvailWidth, int dxpAvailO
 	// better recalculate the width of our boundary mark - things like font size might have
 	// changed.
 	m_dxdBoundaryMark = 0;
+
+	// While the root is being reconstructed, an identical paragraph from the old box tree may
+	// already have worked out the line breaks.
+	VwRootBox * prootb = Root();
+	if (prootb && prootb->HasLayoutDonors())
+	{
+		VwParagraphBox * pvpboxDonor = prootb->TakeLayoutDonor(this, dxAvailWidth);
+		if (pvpboxDonor)
+		{
+			AdoptLayout(pvpboxDonor);
+			return;
+		}
+	}
 	int cch;
 	CheckHr(m_qts->get_Length(&cch));
 	RunParaBuilder(pvg, dxAvailWidth, cch);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Answer true if the result of laying out this paragraph depends only on its strings, their
+	styles, the paragraph style and the available width, so that it may take over the lines
+	of an identical paragraph (see VwRootBox::TakeLayoutDonor). Paragraphs nested in other
+	paragraphs (e.g., in inner piles) have their lines adjusted to align baselines with their
+	neighbors; numbered paragraphs depend on the ones before; concordance paragraphs are
+	aligned specially; and embedded boxes have notifiers of their own.
+----------------------------------------------------------------------------------------------*/
+bool VwParagraphBox::CanShareLayout()
+{
+	if (m_qts->SourceType() == kvstConc || dynamic_cast<VwConcParaBox *>(this))
+		return false;
+	if (m_qzvps->BulNumScheme() != kvbnNone)
+		return false;
+	for (VwGroupBox * pgbox = Container(); pgbox; pgbox = pgbox->Container())
+	{
+		if (pgbox->IsParagraphBox())
+			return false;
+	}
+	int cstr = m_qts->CStrings();
+	if (!cstr)
+		return false;
+	const VpsTssVec & vpst = m_qts->Vpst();
+	for (int itss = 0; itss < cstr; itss++)
+	{
+		if (!vpst[itss].qtms)
+			return false; // embedded box
+	}
+	return true;
+}
+
+/*----------------------------------------------------------------------------------------------
+	A hash of the text of the paragraph, used to find paragraphs that may have the same
+	layout. HasSameLayoutInputs makes the real comparison.
+----------------------------------------------------------------------------------------------*/
+int VwParagraphBox::LayoutShareKey()
+{
+	const VpsTssVec & vpst = m_qts->Vpst();
+	int nKey = vpst.Size();
+	HashObj hasho;
+	for (int itss = 0; itss < vpst.Size(); itss++)
+	{
+		// Hash the string's own buffer; this is done for every paragraph, so don't copy it.
+		const OLECHAR * prgch;
+		int cch;
+		CheckHr(vpst[itss].qtms->LockText(&prgch, &cch));
+		nKey = nKey * 31 + hasho((void *)prgch, cch * isizeof(OLECHAR));
+		CheckHr(vpst[itss].qtms->UnlockText(prgch));
+	}
+	return nKey;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Answer true if pvpboxOther, a paragraph that has been laid out, would be laid out exactly
+	the same way as this one at the given available width. Both must satisfy CanShareLayout.
+----------------------------------------------------------------------------------------------*/
+bool VwParagraphBox::HasSameLayoutInputs(VwParagraphBox * pvpboxOther, int dxAvailWidth)
+{
+	AssertPtr(pvpboxOther);
+	if (pvpboxOther->m_dxLayoutAvailWidth != dxAvailWidth)
+		return false;
+	if (pvpboxOther->m_qzvps != m_qzvps)
+		return false;
+	if ((dynamic_cast<VwInvertedParaBox *>(this) == NULL) !=
+		(dynamic_cast<VwInvertedParaBox *>(pvpboxOther) == NULL))
+	{
+		return false;
+	}
+	VwTxtSrc * pts = pvpboxOther->Source();
+	if (pts->SourceType() != m_qts->SourceType() || pts->Overlay() != m_qts->Overlay())
+		return false;
+	const VpsTssVec & vpst = m_qts->Vpst();
+	const VpsTssVec & vpstOther = pts->Vpst();
+	if (vpst.Size() != vpstOther.Size())
+		return false;
+	for (int itss = 0; itss < vpst.Size(); itss++)
+	{
+		if (vpst[itss].qzvps != vpstOther[itss].qzvps)
+			return false;
+		ComBool fEqual;
+		CheckHr(vpst[itss].qtms->Equals(vpstOther[itss].qtms, &fEqual));
+		if (!fEqual)
+			return false;
+	}
+	// The lines can only be moved if they are all plain string boxes.
+	for (VwBox * pbox = pvpboxOther->FirstBox(); pbox; pbox = pbox->NextOrLazy())
+	{
+		if (!dynamic_cast<VwStringBox *>(pbox))
+			return false;
+	}
+	return true;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Take over the lines of pvpboxDonor, a paragraph of the box tree that the root is replacing,
+	instead of laying this one out. The donor's text source goes with them, since the segments
+	refer to it; the donor gets ours in exchange (they have the same contents), and is about to
+	be deleted anyway.
+----------------------------------------------------------------------------------------------*/
+void VwParagraphBox::AdoptLayout(VwParagraphBox * pvpboxDonor)
+{
+	AssertPtr(pvpboxDonor);
+	Assert(!m_pboxFirst);
+
+	VwTxtSrcPtr qts = m_qts;
+	m_qts = pvpboxDonor->m_qts;
+	pvpboxDonor->m_qts = qts;
+
+	m_pboxFirst = pvpboxDonor->m_pboxFirst;
+	m_pboxLast = pvpboxDonor->m_pboxLast;
+	pvpboxDonor->m_pboxFirst = pvpboxDonor->m_pboxLast = NULL;
+	for (VwBox * pbox = m_pboxFirst; pbox; pbox = pbox->NextOrLazy())
+		pbox->Container(this);
+
+	m_dxsWidth = pvpboxDonor->m_dxsWidth;
+	m_dysHeight = pvpboxDonor->m_dysHeight;
+	m_fParaRtl = pvpboxDonor->m_fParaRtl;
+	m_dxsRightEdge = pvpboxDonor->m_dxsRightEdge;
+	m_dympExactAscent = pvpboxDonor->m_dympExactAscent;
+	m_fSemiTagging = pvpboxDonor->m_fSemiTagging;
+	m_dxLayoutAvailWidth = pvpboxDonor->m_dxLayoutAvailWidth;
+#ifdef ENABLE_TSF
+	if (Root()->InputManager())
+		CheckHr(Root()->InputManager()->OnLayoutChange());
+#endif /*ENABLE_TSF*/
+}
+
 /*----------------------------------------------------------------------------------------------
 	This method gives a box an opportunity to stretch its own width to match the final
 	determined width of a containing box. This is initiated by inner piles to allow
@@ -5798,6 +5899,7 @@ void VwParagraphBox::DoLayoutAux(IVwGraphics * pvg, void * pv)
 	// run the main loop assigning boxes to lines and breaking strings.
 	pzpb->MainLoop();
 
+	m_dxLayoutAvailWidth = pzpb->m_dxAvailWidth;
 	m_pboxFirst = pzpb->m_pboxFirst;
 	if (m_pboxFirst) // May be empty (e.g., because 0 lines allowed)
 		m_pboxLast = m_pboxFirst->EndOfChain();
@@ -8696,18 +8798,20 @@ class SpellCheckMethod
 		return vepv == kvepvEditable;
 	}
 
-	// Core wrapper for whole algorithm
-	void Run()
+	// Core wrapper for whole algorithm. Answer false if the paragraph was not checked at all.
+	bool Run()
 	{
 		// If source is an override but NOT a spelling one, skip.
 		// Typically this would mean we're in a TE diff view or an active IME paragraph.
 		if (dynamic_cast<VwOverrideTxtSrc *>(m_psrc))
-			return;
+			return false;
 		OLECHAR * pch;
 		m_text.SetSize(m_cch, &pch);
 		CheckHr(m_psrc->Fetch(0, m_cch, pch));
 		CheckRun();
 		bool fChanged = false;
+		int ichMinChanged = 0;
+		int ichLimChanged = m_cch;
 		if (!m_qsotsOverride && m_vdp.Size() > 0)
 		{
 			m_qsotsOverride.Attach(NewObj VwSpellingOverrideTxtSrc(m_psrc));
@@ -8716,42 +8820,89 @@ class SpellCheckMethod
 		else if (m_qsotsOverride && m_vdp.Size() == 0)
 		{
 			m_pvpbox->SetSource(m_qsotsOverride->EmbeddedSrc());
-			fChanged = true;
+			// Only the words that were squiggled need redrawing.
+			fChanged = m_qsotsOverride->UpdateOverrides(m_vdp, &ichMinChanged, &ichLimChanged);
 		}
 		if (m_vdp.Size() > 0)
-			fChanged = m_qsotsOverride->UpdateOverrides(m_vdp);
+			fChanged = m_qsotsOverride->UpdateOverrides(m_vdp, &ichMinChanged, &ichLimChanged);
 		if (fChanged)
-			UpdateDisplay();
+			UpdateDisplay(ichMinChanged, ichLimChanged);
+		return true;
 	}
 
-	void UpdateDisplay()
+	// Redraw the lines that show the characters from ichMin to ichLim (rendered offsets),
+	// which are the only ones whose squiggles changed. Typing in a long paragraph changes at
+	// most the word being typed, so there is no need to repaint the whole paragraph.
+	void UpdateDisplay(int ichMin, int ichLim)
 	{
 		// JohnT: underline doesn't affect the layout at all, so should just be able to redraw.
-		m_pvpbox->Invalidate();
-		// Enhance JohnT: this could be optimized; typically the size of the paragraph
-		// does not change.
-		//VwRootBox * prootb = m_pvpbox->Root();
-		//HoldLayoutGraphics hg(prootb);
-		//FixupMap fixmap;
-		//VwBox * pboxContainer;
-		//for (pboxContainer = m_pvpbox; pboxContainer; pboxContainer = pboxContainer->Container())
-		//{
-		//	Rect vwrect = pboxContainer->GetInvalidateRect();
-		//	fixmap.Insert(pboxContainer, vwrect);
-		//}
-		//m_pvpbox->_Height(0); // forces it to be fully laid out.
-		//prootb->RelayoutRoot(hg.m_qvg, &fixmap);
+		// The string boxes are in logical order; each shows the characters up to the next one.
+		VwStringBox * psboxPrev = NULL;
+		for (VwBox * pbox = m_pvpbox->FirstBox(); pbox; pbox = pbox->NextOrLazy())
+		{
+			VwStringBox * psbox = dynamic_cast<VwStringBox *>(pbox);
+			if (!psbox)
+				continue;
+			if (psboxPrev && psboxPrev->IchMin() < ichLim && psbox->IchMin() > ichMin)
+				psboxPrev->Invalidate();
+			psboxPrev = psbox;
+		}
+		if (!psboxPrev)
+			m_pvpbox->Invalidate();
+		else if (psboxPrev->IchMin() < ichLim)
+			psboxPrev->Invalidate();
 	}
 };
 
+/*----------------------------------------------------------------------------------------------
+	Answer true if the paragraph needs to be spell-checked, that is, it has not been checked
+	since its strings or styles last changed, or since the dictionaries were changed (see
+	VwRootBox::RestartSpellChecking). Strings are immutable, so as in VwTxtSrc::RunProps()
+	comparing pointers is enough. We also compare the source itself, since the override that
+	holds the squiggles may have been removed (e.g., by ReplaceStrings, or while an IME is
+	active) without the strings changing.
+----------------------------------------------------------------------------------------------*/
+bool VwParagraphBox::NeedsSpellCheck()
+{
+	if (m_qtsSpellChecked.Ptr() != m_qts.Ptr() ||
+		m_nSpellCheckGen != Root()->SpellCheckGeneration())
+	{
+		return true;
+	}
+	const VpsTssVec & vpst = m_qts->Vpst();
+	if (m_vpstSpellChecked.Size() != vpst.Size())
+		return true;
+	for (int itss = 0; itss < vpst.Size(); itss++)
+	{
+		if (m_vpstSpellChecked[itss].qtms.Ptr() != vpst[itss].qtms.Ptr() ||
+			m_vpstSpellChecked[itss].qzvps.Ptr() != vpst[itss].qzvps.Ptr())
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 /*----------------------------------------------------------------------------------------------
 	Main driver routine for spell checking. Scan your text for mis-spelled words, and if any
-	are found, insert an overlay text source to squiggle them.
+	are found, insert an overlay text source to squiggle them. Nothing is done if the paragraph
+	has not changed since it was last checked. Answer true if it was actually checked.
 ----------------------------------------------------------------------------------------------*/
-void VwParagraphBox::SpellCheck()
+bool VwParagraphBox::SpellCheck()
 {
+	if (!NeedsSpellCheck())
+		return false;
 	SpellCheckMethod method(this);
-	method.Run();
+	if (!method.Run())
+	{
+		m_qtsSpellChecked.Clear();
+		m_vpstSpellChecked.Clear();
+		return false;
+	}
+	m_qtsSpellChecked = m_qts;
+	m_vpstSpellChecked = m_qts->Vpst();
+	m_nSpellCheckGen = Root()->SpellCheckGeneration();
+	return true;
 }
 
 
@@ -9387,7 +9538,7 @@ void VwParagraphBox::Add(VwBox * pbox)
 {
 	VwGroupBox::Add(pbox);
 	// Put a dummy record to stand for it in the text source.
-	m_qts->Vpst().Push(VpsTssRec(pbox->Style(), NULL));
+	m_qts->EditVpst().Push(VpsTssRec(pbox->Style(), NULL));
 }
 
 /*----------------------------------------------------------------------------------------------
@@ -9483,7 +9634,7 @@ void VwParagraphBox::MakeSourceNfd()
 	qsort(vpint.Begin(), vpint.Size(), isizeof(int *), compareIntPtrs);
 
 	// This is the vector of objects that have the strings we need to normalize.
-	VpsTssVec & vpst = Source()->Vpst();
+	VpsTssVec & vpst = Source()->EditVpst();
 	int ichMinOld = 0; // min offset covered by current string before normalization.
 	int ichMinNew = 0; // min offset covered by current string after normalization.
 	int ipiMinOffsetToFix = 0; // index into vpint of first item to fix, in this string.
@@ -267,6 +267,7 @@ class VwParagraphBox : public VwGroupBox
 		:VwGroupBox()
 	{
 		m_dympExactAscent = -1;
+		m_dxLayoutAvailWidth = -1;
 	}
 
 	void GetWritingSystemFactory(ILgWritingSystemFactory ** ppwsf);
@@ -279,6 +280,12 @@ class VwParagraphBox : public VwGroupBox
 	bool m_fSemiTagging;
 	VwBoundaryMark m_BoundaryMark; // enumeration used to represent the paragraph or section mark
 	int m_dxdBoundaryMark; // the width of the boundary mark character
+	int m_dxLayoutAvailWidth; // available width of the most recent layout; -1 if none yet.
+	// The source and strings the paragraph had when it was last spell-checked, and the
+	// VwRootBox::SpellCheckGeneration() at the time (see NeedsSpellCheck).
+	VwTxtSrcPtr m_qtsSpellChecked;
+	VpsTssVec m_vpstSpellChecked;
+	int m_nSpellCheckGen;
 
 	// A little struct used to pass info between DrawForeground and its overlay
 	// sub-methods.
@@ -382,6 +389,11 @@ class VwParagraphBox : public VwGroupBox
 		m_fSemiTagging = f;
 	}
 
+	bool CanShareLayout();
+	int LayoutShareKey();
+	bool HasSameLayoutInputs(VwParagraphBox * pvpboxOther, int dxAvailWidth);
+	void AdoptLayout(VwParagraphBox * pvpboxDonor);
+
 	virtual int PadLeading();
 	virtual int BorderTop();
 	virtual int BorderBottom();
@@ -425,6 +437,7 @@ class VwParagraphBox : public VwGroupBox
 	bool IsSelectionTruncated(int ich);
 	// overridden to also invalidate possible overhang
 	virtual Rect GetInvalidateRect();
+	virtual Rect GetInvalidateRectFrom(int dysTop);
 	StrUni GetBulNumString(IVwGraphics * pvg, COLORREF * pclrUnder, int * punt);
 
 	virtual void Search(VwPattern * ppat, IVwSearchKiller * pxserkl = NULL);
@@ -586,7 +599,8 @@ class VwParagraphBox : public VwGroupBox
 public:
 	bool AssertValid(void);
 	Rect GetOuterBoundsRect(IVwGraphics * pvg, Rect rcSrcRoot, Rect rcDstRoot);
-	void SpellCheck();
+	bool NeedsSpellCheck();
+	bool SpellCheck();
 	virtual void CountColumnsAndLines(int * pcCol, int * pcLines);
 };
 
@@ -90,6 +90,167 @@ STDMETHODIMP VwTxtSrc::QueryInterface(REFIID riid, void **ppv)
 	return NOERROR;
 }
 
+//:>********************************************************************************************
+//:>	Other public methods
+//:>********************************************************************************************
+/*----------------------------------------------------------------------------------------------
+	Append to vrpr the text props of each run from ichStart to ichEnd (logical), and the
+	property store used to display it. Runs are counted the way SetSelectionProps expects
+	them: an entry for each run of each string that overlaps the range, none for embedded
+	boxes.
+----------------------------------------------------------------------------------------------*/
+void VwTxtSrc::CollectRunProps(int ichStart, int ichEnd, RunPropsVec & vrpr)
+{
+	ITsStringPtr qtss;
+	int ichMinTss;
+	int ichLimTss;
+	VwPropertyStorePtr qzvps;
+	int itss;
+	StringFromIch(ichStart, false, &qtss, &ichMinTss, &ichLimTss, &qzvps, &itss);
+	for (int ich = ichStart; ich < ichEnd;)
+	{
+		// ich is relative to the paragraph, as is ichMinTss
+		int ichNew;
+		if (qtss)
+		{
+			RunPropsRec rpr;
+			TsRunInfo tri;
+			CheckHr(qtss->FetchRunInfoAt(ich - ichMinTss, &tri, &rpr.qttp));
+			CheckHr(qzvps->ComputedPropertiesForTtp(rpr.qttp, &rpr.qzvps));
+			vrpr.Push(rpr);
+			ichNew = ichMinTss + tri.ichLim;
+		}
+		else
+		{
+			// Otherwise, there aren't any ttps associated with this char position,
+			// ignore it.  Just advance by the one character which is associated with
+			// a non-tss.
+			ichNew = ichMinTss + 1;
+		}
+		if (ichNew >= ichLimTss && ichEnd > ichLimTss)
+		{
+			Assert(CStrings() > (itss+1));
+			// We need the next string
+			Assert(ichNew == ichLimTss);  // we should have used this string up
+			StringAtIndex(++itss, &qtss);
+			StyleAtIndex(itss, &qzvps);
+			ichMinTss = ichLimTss;
+			int cch;
+			if (qtss)
+				CheckHr(qtss->get_Length(&cch));
+			else
+				cch = 1;
+			ichLimTss += cch;
+		}
+		else
+		{
+			// Only if we didn't move to the next string: there might be some
+			// empty strings in there...but processing a run should have
+			// caused us to make some progress, otherwise.
+			Assert(ichNew > ich);
+		}
+		ich = ichNew;
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Answer the run props of the whole paragraph, as CollectRunProps(0, Cch()) would.
+	The result is kept until the strings or styles of the paragraph change, so a selection
+	covering many whole paragraphs does not have to walk their runs every time its properties
+	are asked for. Strings are immutable and the summary holds references to the ones it was
+	built from, so comparing pointers is enough to tell whether it is still valid.
+----------------------------------------------------------------------------------------------*/
+RunPropsVec & VwTxtSrc::RunProps()
+{
+	const VpsTssVec & vpst = Vpst();
+	bool fValid = m_vpstRunProps.Size() == vpst.Size();
+	for (int itss = 0; fValid && itss < vpst.Size(); itss++)
+	{
+		fValid = m_vpstRunProps[itss].qtms.Ptr() == vpst[itss].qtms.Ptr() &&
+			m_vpstRunProps[itss].qzvps.Ptr() == vpst[itss].qzvps.Ptr();
+	}
+	if (!fValid)
+	{
+		m_vrpr.Clear();
+		m_vpstRunProps = vpst;
+		CollectRunProps(0, Cch(), m_vrpr);
+	}
+	return m_vrpr;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Answer the index of ORCs in the paragraph that link to dependent objects (owned or
+	referenced 'hot' GUIDs, such as footnotes), sorted by position. Like RunProps() it is
+	kept until the strings change, so page layout, which asks about every line, walks the
+	runs of each paragraph only once.
+----------------------------------------------------------------------------------------------*/
+DepObjVec & VwTxtSrc::DependentObjects()
+{
+	const VpsTssVec & vpst = Vpst();
+	bool fValid = m_vpstDepObjs.Size() == vpst.Size();
+	for (int itss = 0; fValid && itss < vpst.Size(); itss++)
+		fValid = m_vpstDepObjs[itss].qtms.Ptr() == vpst[itss].qtms.Ptr();
+	if (fValid)
+		return m_vdor;
+
+	m_vdor.Clear();
+	m_vpstDepObjs = vpst;
+	for (int itss = 0; itss < vpst.Size(); itss++)
+	{
+		ITsString * ptss = vpst[itss].qtms;
+		if (!ptss)
+			continue; // embedded box
+		int ichMinTss = IchStartString(itss);
+		int crun;
+		CheckHr(ptss->get_RunCount(&crun));
+		for (int irun = 0; irun < crun; irun++)
+		{
+			TsRunInfo tri;
+			ITsTextPropsPtr qttp;
+			CheckHr(ptss->FetchRunInfo(irun, &tri, &qttp));
+			if (tri.ichLim - tri.ichMin != 1)
+				continue; // an ORC is always a run by itself.
+			OLECHAR ch;
+			CheckHr(ptss->FetchChars(tri.ichMin, tri.ichLim, &ch));
+			if (ch != L'\xfffc')
+				continue;
+			SmartBstr sbstrObjData;
+			CheckHr(qttp->GetStrPropValue(ktptObjData, &sbstrObjData));
+			if (sbstrObjData.Length() == 9 && (sbstrObjData.Chars()[0] == kodtOwnNameGuidHot
+				|| sbstrObjData.Chars()[0] == kodtNameGuidHot))
+			{
+				DepObjRec dor;
+				dor.ich = ichMinTss + tri.ichMin;
+				memcpy(&dor.guid, sbstrObjData.Chars() + 1, 16);
+				m_vdor.Push(dor);
+			}
+		}
+	}
+	return m_vdor;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Append to vguid the GUIDs of the dependent objects linked from ORCs between ichMin and
+	ichLim (logical).
+----------------------------------------------------------------------------------------------*/
+void VwTxtSrc::GetDependentObjects(int ichMin, int ichLim, Vector<GUID> & vguid)
+{
+	DepObjVec & vdor = DependentObjects();
+	// Binary search for the first entry at or after ichMin.
+	int idorMin = 0;
+	int idorLim = vdor.Size();
+	while (idorMin < idorLim)
+	{
+		int idorMid = (idorMin + idorLim) / 2;
+		if (vdor[idorMid].ich < ichMin)
+			idorMin = idorMid + 1;
+		else
+			idorLim = idorMid;
+	}
+	for (int idor = idorMin; idor < vdor.Size() && vdor[idor].ich < ichLim; idor++)
+		vguid.Push(vdor[idor].guid);
+}
+
 //:>********************************************************************************************
 //:>	IVwTextSource Methods
 //:>********************************************************************************************
@@ -130,7 +291,13 @@ void VwSimpleTxtSrc::FetchLog(int ichMin, int ichLim, OLECHAR * prgchBuf)
 	// Note that we adjust ichMin and ichLim as we go so they are relative to the curr str
 	OLECHAR * pch = prgchBuf;
 	int csbt = m_vpst.Size();
-	for (int isbt = 0; isbt < csbt && ichLim > 0; ++isbt)
+	// Skip straight to the string containing ichMin.
+	int isbtFirst = StringIndexFromIch(ichMin, false);
+	if (isbtFirst >= csbt)
+		return;
+	ichMin -= m_vichStart[isbtFirst];
+	ichLim -= m_vichStart[isbtFirst];
+	for (int isbt = isbtFirst; isbt < csbt && ichLim > 0; ++isbt)
 	{
 		int cch;
 		ITsMutString * qtms = m_vpst[isbt].qtms;
@@ -171,35 +338,27 @@ void VwSimpleTxtSrc::CharAndPropsAt(int ichMin, OLECHAR * pch, ITsTextProps ** p
 	Assert(*ppttp == NULL);
 	AssertPtr(pch);
 	int csbt = m_vpst.Size();
-	for (int isbt = 0; isbt < csbt; ++isbt)
+	int isbt = StringIndexFromIch(ichMin, false);
+	if (isbt < csbt)
 	{
-		int cch;
+		ichMin -= m_vichStart[isbt];
 		ITsMutString * qtms = m_vpst[isbt].qtms;
 		if (qtms)
 		{
-			CheckHr(qtms->get_Length(&cch));
-			if (cch > ichMin)
-			{
-				// We have some relevant characters. Get the limit in this string
-				CheckHr(qtms->FetchChars(ichMin, ichMin + 1, pch));
-				TsRunInfo tri;
-				CheckHr(qtms->FetchRunInfoAt(ichMin, &tri, ppttp));
-				return;
-			}
+			// We have some relevant characters. Get the limit in this string
+			CheckHr(qtms->FetchChars(ichMin, ichMin + 1, pch));
+			TsRunInfo tri;
+			CheckHr(qtms->FetchRunInfoAt(ichMin, &tri, ppttp));
 		}
 		else
 		{
-			cch = 1; // Null stands for an embedded box, which we present as one Obj rep.
-			if (cch > ichMin)
-			{
-				*pch = 0xfffc; // Unicode object replacement char; No props stored in string.
-				// If cch > ichMin, we must be done with ichMin == 0.  The next step would
-				// cause ichMin to go negative, which would have bad side-effects!
-				return;
-			}
+			// Null stands for an embedded box, which we present as one Obj rep.
+			Assert(ichMin == 0);
+			*pch = 0xfffc; // Unicode object replacement char; No props stored in string.
 		}
-		ichMin -= cch;
+		return;
 	}
+	ichMin -= m_vichStart[csbt];
 	if (ichMin == 0)
 	{
 		// We're asking for info at the very end of the string, possibly an empty string.
@@ -226,6 +385,7 @@ void VwSimpleTxtSrc::AddString(ITsMutString * ptms, VwPropertyStore * pzvps,
 	IVwViewConstructor * pvc)
 {
 	m_vpst.Push(VpsTssRec(pzvps, ptms));
+	ClearIndexes();
 }
 
 
@@ -243,70 +403,57 @@ CachedProps * VwSimpleTxtSrc::GetCharPropInfo(int ich,
 	int * pichMin, int * pichLim, int * pisbt, int * pirun, ITsTextProps ** ppttp,
 	VwPropertyStore ** ppzvps)
 {
-	int cchPrev = 0;
-	int ichString = ich; // ich relative to current string
 	int csbt = m_vpst.Size();
 	Assert(*pirun == 0);
 	Assert(*ppttp == NULL);
 	CachedProps * pchrp;
-	// Note that we adjust ichString as we go so it is eventually relative to current str
-	for (int isbt = 0; isbt < csbt; ++isbt)
+	// Find the string the character is in. If it is exactly at the end of the last string,
+	// that string has the relevant character.
+	int isbt = StringIndexFromIch(ich, false);
+	if (isbt >= csbt && csbt > 0 && ich == m_vichStart[csbt])
+		isbt = csbt - 1;
+	if (isbt < csbt)
 	{
-		int cch;
+		int cchPrev = m_vichStart[isbt];
+		int ichString = ich - cchPrev; // ich relative to the string
 		ITsMutString * qtms = m_vpst[isbt].qtms;
+		VwPropertyStore * pzvps = m_vpst[isbt].qzvps;
+		if (m_qwsf)
+			pzvps->putref_WritingSystemFactory(m_qwsf);		// Just to be safe.
 		if (qtms)
-			CheckHr(qtms->get_Length(&cch));
+		{
+			ITsTextPropsPtr qttp;
+			TsRunInfo tri;
+			CheckHr(qtms->FetchRunInfoAt(ichString, &tri, &qttp));
+			*pichMin = tri.ichMin + cchPrev;
+			*pichLim = tri.ichLim + cchPrev;
+			// OK, given this ttp, get the corresponding LgCharRenderProps
+			pzvps = pzvps->PropertiesForTtp(qttp);
+			pchrp = pzvps->Chrp();
+			*pirun = tri.irun;
+			*ppttp = qttp.Detach();
+		}
 		else
-			cch = 1;
-		// If it is within this string or exactly at the end of the last string, we have the relevant character, so get the run info.
-		if (cch > ichString ||
-			(cch == ichString && isbt == csbt - 1))
 		{
-			VwPropertyStore * pzvps = m_vpst[isbt].qzvps;
-			if (m_qwsf)
-				pzvps->putref_WritingSystemFactory(m_qwsf);		// Just to be safe.
-			if (qtms)
-			{
-				ITsTextPropsPtr qttp;
-				TsRunInfo tri;
-				CheckHr(qtms->FetchRunInfoAt(ichString, &tri, &qttp));
-				*pichMin = tri.ichMin + cchPrev;
-				*pichLim = tri.ichLim + cchPrev;
-				// OK, given this ttp, get the corresponding LgCharRenderProps
-				pzvps = pzvps->PropertiesForTtp(qttp);
-				pchrp = pzvps->Chrp();
-				*pirun = tri.irun;
-				*ppttp = qttp.Detach();
-			}
-			else
-			{
-				// Not a real character in a real string, just a dummy. The run is one char
-				// at cchPrev.
-				pchrp = pzvps->Chrp();
-				*pichMin = cchPrev;
-				*pichLim = cchPrev + 1;
-				// *pirun = 0; // best approx we can do; leave it how the caller initialized it
-				// leave *ppttp null also.
-			}
-			// OPTIMIZE JohnT: See if subsequent runs have the same props, if so expand range.
-			// Ideally we should check for resolving to the same chrp, but
-			// it would be more efficient to just check for the same vps and ttp.
-			// That would catch most cases.
-			// Theoretically, we should also check earlier runs, but
-			// it does not matter for current clients, and we don't guarantee to find
-			// the largest possible range.
-			*pisbt = isbt;
-			if (ppzvps)
-			{
-				*ppzvps = pzvps;
-				AddRefObj(pzvps);
-			}
-			return pchrp;
+			// Not a real character in a real string, just a dummy. The run is one char
+			// at cchPrev.
+			pchrp = pzvps->Chrp();
+			*pichMin = cchPrev;
+			*pichLim = cchPrev + 1;
+			// *pirun = 0; // best approx we can do; leave it how the caller initialized it
+			// leave *ppttp null also.
 		}
-		ichString -= cch;
-		cchPrev += cch;
+		// The range is just this run; GetCharProps merges runs with the same properties
+		// (see CoalescedCharProps), but callers of this method want the run itself.
+		*pisbt = isbt;
+		if (ppzvps)
+		{
+			*ppzvps = pzvps;
+			AddRefObj(pzvps);
+		}
+		return pchrp;
 	}
-	// If we drop out the argument is too large
+	// If we get here the argument is too large
 
 	// Collect some info to track down problems (eg for TE-7714)
 	int cch = 0;
@@ -350,10 +497,20 @@ STDMETHODIMP VwSimpleTxtSrc::GetCharProps(int ich, LgCharRenderProps * pchrp,
 	ChkComArgPtrN(pichLim);
 	ChkComArgPtrN(pichMin);
 
-	int isbt = 0;
-	int irun = 0;
-	ITsTextPropsPtr qttp;
-	CachedProps * pchrp2 = GetCharPropInfo(ich, pichMin, pichLim, &isbt, &irun, &qttp);
+	CachedProps * pchrp2;
+	if (IsMapped())
+	{
+		// The ranges answered for the characters of substitute strings are not reliable
+		// enough to merge.
+		int isbt = 0;
+		int irun = 0;
+		ITsTextPropsPtr qttp;
+		pchrp2 = GetCharPropInfo(ich, pichMin, pichLim, &isbt, &irun, &qttp);
+	}
+	else
+	{
+		pchrp2 = CoalescedCharProps(ich, pichMin, pichLim);
+	}
 	if(pchrp2 != NULL)
 	{
 		// Copy the relevant part of the CachedProps
@@ -363,6 +520,82 @@ STDMETHODIMP VwSimpleTxtSrc::GetCharProps(int ich, LgCharRenderProps * pchrp,
 	END_COM_METHOD(g_fact, IID_IVwTextSource);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Get the properties of a particular character, and the largest range around it with the same
+	text properties, even if that crosses run and string boundaries, so renderers can make
+	fewer, longer segments. The ranges for the whole paragraph are worked out the first time
+	and kept in m_vcpr until the strings change.
+	Char indexes are relative to the list of rendered characters.
+----------------------------------------------------------------------------------------------*/
+CachedProps * VwSimpleTxtSrc::CoalescedCharProps(int ich, int * pichMin, int * pichLim)
+{
+	int cch = CchRen();
+	if (ich >= cch)
+	{
+		// At the very end (or beyond, which GetCharPropInfo reports); nothing to merge.
+		int isbt = 0;
+		int irun = 0;
+		ITsTextPropsPtr qttp;
+		return GetCharPropInfo(ich, pichMin, pichLim, &isbt, &irun, &qttp);
+	}
+	// If the styles have been recomputed the properties (and the pointers to them) may be
+	// different even though the strings are the same; and a store unlocked meanwhile may
+	// have freed the record a pointer refers to.
+	if (m_nChrpGeneration != VwPropertyStore::ChrpGeneration())
+		m_vcpr.Clear();
+	if (!m_vcpr.Size())
+	{
+		m_nChrpGeneration = VwPropertyStore::ChrpGeneration();
+		ITsTextPropsPtr qttpPrev; // nothing to merge with at the start
+		for (int ichRun = 0; ichRun < cch; )
+		{
+			int isbt = 0;
+			int irun = 0;
+			ITsTextPropsPtr qttp;
+			CharPropRange cpr;
+			cpr.pchrp = GetCharPropInfo(ichRun, &cpr.ichMin, &cpr.ichLim, &isbt, &irun, &qttp);
+			Assert(cpr.ichLim > ichRun);
+			cpr.ichMin = ichRun;
+			// Only runs with the very same text properties are merged (text props are shared,
+			// so comparing pointers is enough). Runs that merely render the same may differ in
+			// properties such as the named style or tags, and callers such as VwPattern treat
+			// each range as one run of the string. The character standing for an embedded box
+			// (which has no ttp) is kept as a range by itself, as it always was.
+			if (qttp && qttp == qttpPrev)
+			{
+				// Strings in different property stores may still resolve the same props
+				// differently.
+				CharPropRange & cprPrev = *(m_vcpr.Top());
+				if (cprPrev.pchrp == cpr.pchrp ||
+					!memcmp(cprPrev.pchrp, cpr.pchrp, isizeof(LgCharRenderProps)))
+				{
+					cprPrev.ichLim = cpr.ichLim;
+					ichRun = cpr.ichLim;
+					continue;
+				}
+			}
+			m_vcpr.Push(cpr);
+			qttpPrev = qttp;
+			ichRun = cpr.ichLim;
+		}
+	}
+	// Binary search for the range whose lim is the first one greater than ich.
+	int icprMin = 0;
+	int icprLim = m_vcpr.Size() - 1;
+	while (icprMin < icprLim)
+	{
+		int icprMid = (icprMin + icprLim) / 2;
+		if (m_vcpr[icprMid].ichLim > ich)
+			icprLim = icprMid;
+		else
+			icprMin = icprMid + 1;
+	}
+	CharPropRange & cpr = m_vcpr[icprMin];
+	*pichMin = cpr.ichMin;
+	*pichLim = cpr.ichLim;
+	return cpr.pchrp;
+}
+
 /*----------------------------------------------------------------------------------------------
 	Simlar, but doesn't need to be a COM method, and we don't care about the min.
 	char indexes are in rendered coords.
@@ -386,6 +619,59 @@ void VwSimpleTxtSrc::GetUnderlineInfo(int ich, int * punt,
 
 const int kmaxGuids = 1000;
 
+/*----------------------------------------------------------------------------------------------
+	Set *pprgotp to the display properties of the visible overlay tags of pttp, in the order
+	they occur in its ktptTags, and return how many there are. Unknown and hidden tags are
+	left out. The tags are looked up once per ttp and remembered until the overlay changes
+	(or our strings do).
+	The pointer is only good until the next call.
+----------------------------------------------------------------------------------------------*/
+int VwOverlayTxtSrc::OverlayTags(ITsTextProps * pttp, OverlayTagProps ** pprgotp)
+{
+	AssertPtr(pttp);
+	AssertPtr(pprgotp);
+	IVwOverlay * pvo = Overlay();
+	AssertPtr(pvo);
+	// An overlay we don't implement can't tell us when it changes, so we can't keep anything.
+	VwOverlay * pzvo = dynamic_cast<VwOverlay *>(pvo);
+	int nVersion = pzvo ? pzvo->Version() : 0;
+	if (!nVersion || nVersion != m_nOverlayVersion)
+	{
+		m_hmttpotr.Clear();
+		m_votp.Clear();
+		m_nOverlayVersion = nVersion;
+	}
+
+	OverlayTagRange otr;
+	if (!m_hmttpotr.Retrieve(pttp, &otr))
+	{
+		otr.iotpMin = m_votp.Size();
+		SmartBstr sbstrGuids;
+		CheckHr(pttp->GetStrPropValue(ktptTags, &sbstrGuids));
+		OLECHAR * prgchGuids = const_cast<OLECHAR *>(sbstrGuids.Chars());
+		int cguid = BstrLen(sbstrGuids) / kcchGuidRepLength;
+		OLECHAR * pchEndGuids = prgchGuids + cguid * kcchGuidRepLength; // ignore any surplus
+		for (; prgchGuids < pchEndGuids; prgchGuids += kcchGuidRepLength)
+		{
+			ComBool fHidden;
+			OverlayTagProps otp;
+			int cchAbbr;
+			int cchName;
+			CheckHr(pvo->GetDispTagInfo(prgchGuids, &fHidden, &otp.clrFore, &otp.clrBack,
+				&otp.clrUnder, &otp.unt,
+				NULL, 0, // Don't want the abbr at this point
+				&cchAbbr,
+				NULL, 0, &cchName));
+			if (!fHidden)
+				m_votp.Push(otp);
+		}
+		otr.iotpLim = m_votp.Size();
+		m_hmttpotr.Insert(pttp, otr);
+	}
+	*pprgotp = m_votp.Begin() + otr.iotpMin;
+	return otr.iotpLim - otr.iotpMin;
+}
+
 /*----------------------------------------------------------------------------------------------
 	Get the properties of a particular character and indicate the range over which they apply.
 	It is possible they also apply to a larger range.
@@ -400,53 +686,37 @@ STDMETHODIMP VwOverlayTxtSrc::GetCharProps(int ich, LgCharRenderProps * pchrp,
 	ChkComArgPtrN(pichMin);
 	ChkComArgPtrN(pichLim);
 
+	// Without an overlay the properties are just the underlying ones, which may be merged
+	// across runs.
+	if (!Overlay())
+		return VwSimpleTxtSrc::GetCharProps(ich, pchrp, pichMin, pichLim);
 	int isbt = 0;
 	int irun = 0;
 	ITsTextPropsPtr qttp;
 	CachedProps * pchrp2 = GetCharPropInfo(ich, pichMin, pichLim, &isbt, &irun, &qttp);
 	// Copy the relevant part of the CachedProps
 	CopyBytes(pchrp2, pchrp, isizeof(LgCharRenderProps));
-	// If we aren't doing overlays we are done; also we can't go any further if we have
-	// no props for the run (e.g., a grey box separator).
-	if (!Overlay() || !qttp)
+	// We can't go any further if we have no props for the run (e.g., a grey box separator).
+	if (!qttp)
 		return S_OK;
-	SmartBstr sbstrGuids;
-	CheckHr(qttp->GetStrPropValue(ktptTags, &sbstrGuids));
-	OLECHAR * prgchGuids = const_cast<OLECHAR *>(sbstrGuids.Chars());
-	int cguid = BstrLen(sbstrGuids) / kcchGuidRepLength;
-	OLECHAR * pchEndGuids = prgchGuids + cguid * kcchGuidRepLength; // ignore any surplus
-
-	bool fGotOne = false;
-
-	for (; prgchGuids < pchEndGuids; prgchGuids += kcchGuidRepLength)
-	{
-		ComBool fHidden;
-		COLORREF clrFore;
-		COLORREF clrBack;
-		COLORREF clrUnder;
-		int unt;
-		int cchAbbr;
-		int cchName;
-		CheckHr(Overlay()->GetDispTagInfo(prgchGuids, &fHidden, &clrFore, &clrBack, &clrUnder, &unt,
-			NULL, 0, // Don't want the abbr at this point
-			&cchAbbr,
-			NULL, 0, &cchName));
-		if (!fHidden)
+	OverlayTagProps * prgotp;
+	int cotp = OverlayTags(qttp, &prgotp);
+	for (int iotp = 0; iotp < cotp; iotp++)
+	{
+		OverlayTagProps & otp = prgotp[iotp];
+		if (iotp)
 		{
-			if (fGotOne)
-			{
-				// Merge the properties. We don't care about the underlining ones at this point.
-				VwOverlay::MergeOverlayProps1(&pchrp->clrFore, clrFore, &pchrp->clrBack, clrBack);
-			}
-			else
-			{
-				// First visible tag at this point. Just use its scheme, unless it is knNinch.
-				fGotOne = true;
-				if (clrFore != knNinch)
-					pchrp->clrFore = clrFore;
-				if (clrBack != knNinch)
-					pchrp->clrBack = clrBack;
-			}
+			// Merge the properties. We don't care about the underlining ones at this point.
+			VwOverlay::MergeOverlayProps1(&pchrp->clrFore, otp.clrFore, &pchrp->clrBack,
+				otp.clrBack);
+		}
+		else
+		{
+			// First visible tag at this point. Just use its scheme, unless it is knNinch.
+			if (otp.clrFore != knNinch)
+				pchrp->clrFore = otp.clrFore;
+			if (otp.clrBack != knNinch)
+				pchrp->clrBack = otp.clrBack;
 		}
 	}
 
@@ -503,28 +773,12 @@ void VwOverlayTxtSrc::GetUnderlineInfo(int ich, int * punt,
 		return;
 
 	// Apply any tagging.
-	SmartBstr sbstrGuids;
-	CheckHr(qttp->GetStrPropValue(ktptTags, &sbstrGuids));
-	OLECHAR * prgchGuids = const_cast<OLECHAR *>(sbstrGuids.Chars());
-	int cguid = BstrLen(sbstrGuids) / kcchGuidRepLength;
-	OLECHAR * pchEndGuids = prgchGuids + cguid * kcchGuidRepLength; // ignore any surplus
-
-	for (; prgchGuids < pchEndGuids; prgchGuids += kcchGuidRepLength)
+	OverlayTagProps * prgotp;
+	int cotp = OverlayTags(qttp, &prgotp);
+	for (int iotp = 0; iotp < cotp; iotp++)
 	{
-		ComBool fHidden;
-		COLORREF clrFore;
-		COLORREF clrBack;
-		COLORREF clrUnder;
-		int unt;
-		int cchAbbr;
-		int cchName;
-		CheckHr(Overlay()->GetDispTagInfo(prgchGuids, &fHidden, &clrFore, &clrBack, &clrUnder, &unt,
-			NULL, 0, // Don't want the abbr at this point
-			&cchAbbr,
-			NULL, 0, &cchName));
-		if (!fHidden)
-			// Merge the underlining-related properties.
-			VwOverlay::MergeOverlayProps2(pclrUnder, clrUnder, punt, unt);
+		// Merge the underlining-related properties.
+		VwOverlay::MergeOverlayProps2(pclrUnder, prgotp[iotp].clrUnder, punt, prgotp[iotp].unt);
 	}
 }
 
@@ -606,9 +860,24 @@ STDMETHODIMP VwSimpleTxtSrc::GetParaStringProp(int ich, int id, BSTR * pbstr, in
 int VwSimpleTxtSrc::IchStartString(int itss)
 {
 	Assert(itss <= m_vpst.Size());
-	int cchPrev = 0; // Haven't found any chars before itss yet.
-	for (int isbt = 0; isbt < itss; ++isbt)
+	EnsureStringOffsets();
+	return m_vichStart[itss];
+}
+
+/*----------------------------------------------------------------------------------------------
+	Rebuild m_vichStart, the cumulative offsets of the strings, if m_vpst has changed since
+	it was last built. Embedded boxes (null strings) count as one character.
+----------------------------------------------------------------------------------------------*/
+void VwSimpleTxtSrc::EnsureStringOffsets()
+{
+	int csbt = m_vpst.Size();
+	if (m_vichStart.Size() == csbt + 1)
+		return;
+	m_vichStart.Resize(csbt + 1);
+	int cchPrev = 0;
+	for (int isbt = 0; isbt < csbt; ++isbt)
 	{
+		m_vichStart[isbt] = cchPrev;
 		int cch;
 		ITsMutString * qtms = m_vpst[isbt].qtms;
 		if (qtms)
@@ -617,7 +886,24 @@ int VwSimpleTxtSrc::IchStartString(int itss)
 			cch = 1;
 		cchPrev += cch;
 	}
-	return cchPrev;
+	m_vichStart[csbt] = cchPrev;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Answer the index of the first string that contains the character at logical offset ich,
+	that is, whose limit is greater than ich (or, if fAssocPrev is true, at least ich, so an
+	ich at a boundary goes with the preceding string). Empty strings therefore never match
+	unless fAssocPrev is true. Answer the number of strings if there is no such string.
+----------------------------------------------------------------------------------------------*/
+int VwSimpleTxtSrc::StringIndexFromIch(int ich, bool fAssocPrev)
+{
+	EnsureStringOffsets();
+	// The limits of the strings are m_vichStart[1..csbt], which never decrease.
+	int * pichLimFirst = m_vichStart.Begin() + 1;
+	int * pichLimEnd = m_vichStart.End();
+	int * pichLim = fAssocPrev ? std::lower_bound(pichLimFirst, pichLimEnd, ich)
+		: std::upper_bound(pichLimFirst, pichLimEnd, ich);
+	return (int)(pichLim - pichLimFirst);
 }
 
 /*----------------------------------------------------------------------------------------------
@@ -629,10 +915,11 @@ void VwSimpleTxtSrc::ReplaceContents(int itssMin, int itssLim, VwTxtSrc *pts)
 {
 	// Do the replacement.
 	if (itssLim < 0)
-		itssLim = Vpst().Size();
-	VpsTssRec * pbtr = pts->Vpst().Begin();
-	int csbtNew = pts->Vpst().Size();
-	Vpst().Replace(itssMin, itssLim, pbtr, csbtNew);
+		itssLim = m_vpst.Size();
+	const VpsTssVec & vpstNew = pts->Vpst();
+	int csbtNew = vpstNew.Size();
+	m_vpst.Replace(itssMin, itssLim, csbtNew ? &vpstNew[0] : NULL, csbtNew);
+	ClearIndexes();
 	if (m_vpst.Size() == 0)
 		ThrowInternalError(E_UNEXPECTED, L"VwSimpleTxtSrc::ReplaceContents removed all para contents - connect report to LT-9233");
 }
@@ -653,33 +940,18 @@ void VwSimpleTxtSrc::StringFromIch(int ich, bool fAssocPrev, ITsString ** pptss,
 	AssertPtr(ppzvps);
 	AssertPtr(pitss);
 	Assert(ich >= 0);
-	int cchPrev = 0; // characters in strings before isbt
-	int isbt;
-	int cch;
-	for (isbt = 0; isbt < m_vpst.Size(); ++isbt)
+	int isbt = StringIndexFromIch(ich, fAssocPrev);
+	if (isbt >= m_vpst.Size())
 	{
-		ITsMutString * ptms = m_vpst[isbt].qtms;
-		if (ptms)
-			CheckHr(ptms->get_Length(&cch));
-		else
-			cch = 1; // embedded boxes have no tss and count as 1 char
-		if ((ich <= cchPrev + cch && fAssocPrev) || (ich < cchPrev + cch && !fAssocPrev))
-		{
-			// It's in this string!
-			goto Lgotit;
-		}
-		cchPrev += cch;
+		// The only valid reason for not finding a string is an ich that is the lim of the
+		// paragraph
+		Assert(m_vichStart[m_vpst.Size()] == ich);
+		isbt = m_vpst.Size() - 1; // the last string
 	}
-	// The only valid reason for dropping out of the loop is an ich that is the lim of the
-	// paragraph
-	Assert(cchPrev == ich);
-	isbt--; // makes it equal to the last string index
-	cchPrev -= cch; // back to before the last string
-Lgotit:
 	*pptss = m_vpst[isbt].qtms;
 	AddRefObj(*pptss);
-	*pichMin = cchPrev;
-	*pichLim = cchPrev + cch;
+	*pichMin = m_vichStart[isbt];
+	*pichLim = m_vichStart[isbt + 1];
 	*ppzvps = m_vpst[isbt].qzvps;
 	AddRefObj(*ppzvps);
 	*pitss = isbt;
@@ -733,14 +1005,149 @@ IVwOverlay * VwOverlayTxtSrc::Overlay()
 ----------------------------------------------------------------------------------------------*/
 int VwSimpleTxtSrc::CchTss(int ipst)
 {
-	ITsMutString * ptms = m_vpst[ipst].qtms;
-	if (!ptms)
-		return 1;
-	int cch;
-	CheckHr(ptms->get_Length(&cch));
-	return cch;
+	EnsureStringOffsets();
+	return m_vichStart[ipst + 1] - m_vichStart[ipst];
+}
+
+//:>********************************************************************************************
+//:>	VwSingleRunTxtSrc methods
+//:>********************************************************************************************
+
+/*----------------------------------------------------------------------------------------------
+	Answer whether the contents are a single string with a single run, and if so make sure
+	the characters and properties of the run are cached. The properties are got again if the
+	styles have been recomputed since.
+----------------------------------------------------------------------------------------------*/
+bool VwSingleRunTxtSrc::EnsureSingleRun()
+{
+	if (m_nSingleRun == 0)
+	{
+		m_nSingleRun = -1;
+		if (m_vpst.Size() != 1 || !m_vpst[0].qtms)
+			return false;
+		ITsMutString * qtms = m_vpst[0].qtms;
+		int crun;
+		CheckHr(qtms->get_RunCount(&crun));
+		if (crun != 1)
+			return false;
+		int cch;
+		CheckHr(qtms->get_Length(&cch));
+		m_vch.Resize(cch);
+		CheckHr(qtms->FetchChars(0, cch, m_vch.Begin()));
+		m_pchrpRun = NULL;
+		m_nSingleRun = 1;
+	}
+	if (m_nSingleRun < 0)
+		return false;
+	if (!m_pchrpRun || m_nChrpGenerationRun != VwPropertyStore::ChrpGeneration())
+	{
+		ITsTextPropsPtr qttp;
+		CheckHr(m_vpst[0].qtms->get_Properties(0, &qttp));
+		VwPropertyStore * pzvps = m_vpst[0].qzvps;
+		if (m_qwsf)
+			pzvps->putref_WritingSystemFactory(m_qwsf);
+		m_pzvpsRun = pzvps->PropertiesForTtp(qttp);
+		m_pchrpRun = m_pzvpsRun->Chrp();
+		m_nChrpGenerationRun = VwPropertyStore::ChrpGeneration();
+	}
+	return true;
+}
+
+STDMETHODIMP VwSingleRunTxtSrc::Fetch(int ichMin, int ichLim, OLECHAR * prgchBuf)
+{
+	BEGIN_COM_METHOD;
+	ChkComArrayArg(prgchBuf, ichLim - ichMin);
+
+	FetchLog(ichMin, ichLim, prgchBuf);
+
+	END_COM_METHOD(g_fact, IID_IVwTextSource);
+}
+
+STDMETHODIMP VwSingleRunTxtSrc::FetchSearch(int ichMin, int ichLim, OLECHAR * prgchBuf)
+{
+	BEGIN_COM_METHOD;
+	ChkComArrayArg(prgchBuf, ichLim - ichMin);
+
+	FetchLog(ichMin, ichLim, prgchBuf);
+
+	END_COM_METHOD(g_fact, IID_IVwTextSource);
+}
+
+/*----------------------------------------------------------------------------------------------
+	As in the superclass, characters beyond the end are left unchanged in prgchBuf.
+----------------------------------------------------------------------------------------------*/
+void VwSingleRunTxtSrc::FetchLog(int ichMin, int ichLim, OLECHAR * prgchBuf)
+{
+	if (!EnsureSingleRun())
+	{
+		SuperClass::FetchLog(ichMin, ichLim, prgchBuf);
+		return;
+	}
+	ichMin = std::max(ichMin, 0);
+	ichLim = std::min(ichLim, m_vch.Size());
+	if (ichLim > ichMin)
+		CopyItems(m_vch.Begin() + ichMin, prgchBuf, ichLim - ichMin);
+}
+
+int VwSingleRunTxtSrc::Cch()
+{
+	if (!EnsureSingleRun())
+		return SuperClass::Cch();
+	return m_vch.Size();
+}
+
+int VwSingleRunTxtSrc::CchRen()
+{
+	if (!EnsureSingleRun())
+		return SuperClass::CchRen();
+	return m_vch.Size();
+}
+
+int VwSingleRunTxtSrc::IchStartString(int itss)
+{
+	if (!EnsureSingleRun())
+		return SuperClass::IchStartString(itss);
+	Assert(itss == 0 || itss == 1);
+	return itss ? m_vch.Size() : 0;
+}
+
+/*----------------------------------------------------------------------------------------------
+	The one run covers the whole paragraph, including the position at the very end.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP VwSingleRunTxtSrc::GetCharProps(int ich, LgCharRenderProps * pchrp,
+	int * pichMin, int * pichLim)
+{
+	BEGIN_COM_METHOD;
+	ChkComArgPtrN(pchrp);
+	ChkComArgPtrN(pichLim);
+	ChkComArgPtrN(pichMin);
+
+	if (ich > Cch() || !EnsureSingleRun())
+		return SuperClass::GetCharProps(ich, pchrp, pichMin, pichLim);
+	*pichMin = 0;
+	*pichLim = m_vch.Size();
+	CopyBytes(m_pchrpRun, pchrp, isizeof(LgCharRenderProps));
+
+	END_COM_METHOD(g_fact, IID_IVwTextSource);
 }
 
+void VwSingleRunTxtSrc::GetUnderlineInfo(int ich, int * punt, COLORREF * pclrUnder,
+	int * pichLim)
+{
+	if (ich > Cch() || !EnsureSingleRun())
+	{
+		SuperClass::GetUnderlineInfo(ich, punt, pclrUnder, pichLim);
+		return;
+	}
+	AssertPtr(punt);
+	AssertPtr(pclrUnder);
+	AssertPtr(pichLim);
+	*punt = m_pchrpRun->m_unt;
+	*pclrUnder = m_pchrpRun->m_clrUnder;
+	if (*pclrUnder == (unsigned long) kclrTransparent)
+		*pclrUnder = m_pchrpRun->clrFore;
+	*pichLim = m_vch.Size();
+}
 
 //:>********************************************************************************************
 //:>	VwMappedTxtSrc methods
@@ -809,6 +1216,7 @@ STDMETHODIMP VwMappedTxtSrc::SetString(ITsString * ptss, IVwViewConstructor * pv
 	ChkComArgPtr(pwsf);
 
 	m_vpst.Clear();
+	ClearIndexes();
 	m_vtmi.Clear();
 	VwPropertyStorePtr qzvps;
 	qzvps.Attach(NewObj VwPropertyStore());
@@ -826,6 +1234,7 @@ void VwMappedTxtSrc::AddString(ITsMutString * ptms, VwPropertyStore * pzvps,
 	IVwViewConstructor * pvc)
 {
 	m_vpst.Push(VpsTssRec(pzvps, ptms));
+	ClearIndexes();
 	const OLECHAR * prgch;
 	int cch;
 	CheckHr(ptms->LockText(&prgch, &cch));
@@ -934,11 +1343,10 @@ STDMETHODIMP VwConcTxtSrc::LogToSearch(int ichlog, int * pichSearch)
 {
 	BEGIN_COM_METHOD;
 	ChkComOutPtr(pichSearch);
-	int cchSearchInitial;
+	EnsureTrimmedView();
 	int cchSearchFull;
 	CheckHr(SuperClass::LogToSearch(ichlog + m_cchDiscardInitial, &cchSearchFull));
-	CheckHr(SuperClass::LogToSearch(m_cchDiscardInitial, &cchSearchInitial));
-	*pichSearch = cchSearchFull - cchSearchInitial;
+	*pichSearch = cchSearchFull - m_cchDiscardInitialSearch;
 	END_COM_METHOD(g_fact, IID_IVwTextSource);
 }
 
@@ -995,11 +1403,9 @@ STDMETHODIMP VwConcTxtSrc::SearchToLog(int ichTarget, ComBool fAssocPrev, int *
 	BEGIN_COM_METHOD;
 	ChkComOutPtr(pichLog);
 
-	int cchSearchInitial;
-	CheckHr(SuperClass::LogToSearch(m_cchDiscardInitial, &cchSearchInitial));
-
+	EnsureTrimmedView();
 	int cchLog;
-	CheckHr(SuperClass::SearchToLog(ichTarget + cchSearchInitial, fAssocPrev, &cchLog));
+	CheckHr(SuperClass::SearchToLog(ichTarget + m_cchDiscardInitialSearch, fAssocPrev, &cchLog));
 	*pichLog = cchLog - m_cchDiscardInitial;
 	END_COM_METHOD(g_fact, IID_IVwTextSource);
 }
@@ -1363,6 +1769,47 @@ class MappedSearchFetcher : public MappedFetcher
 	}
 };
 
+/*----------------------------------------------------------------------------------------------
+	Copy the range ichMin to ichLim of the whole rendered (or, if fSearch, search) text into
+	prgchBuf. Making the substitutions means walking all the strings and the mapper, and
+	layout and searching fetch the same paragraph many times over, so the first call after
+	the contents change saves the whole text in vch, and later ones just copy from it.
+	As before, characters beyond the end of the text are left unchanged in prgchBuf.
+----------------------------------------------------------------------------------------------*/
+void VwMappedTxtSrc::FetchCached(Vector<OLECHAR> & vch, bool & fCached, bool fSearch,
+	int ichMin, int ichLim, OLECHAR * prgchBuf)
+{
+	if (fCached)
+	{
+		m_cFetchHit++;
+	}
+	else
+	{
+		m_cFetchMiss++;
+		// The full rendered length (not any trimmed length a subclass reports) is enough room
+		// for either kind of text, since search text only leaves things out.
+		int cchRen = VwMappedTxtSrc::LogToRen(VwSimpleTxtSrc::IchStartString(m_vpst.Size()));
+		vch.Resize(cchRen);
+		if (fSearch)
+		{
+			MappedSearchFetcher fetcher(0, cchRen, vch.Begin(), this);
+			CheckHr(fetcher.Run());
+			vch.Resize((int)(fetcher.pch - vch.Begin()));
+		}
+		else
+		{
+			MappedFetcher fetcher(0, cchRen, vch.Begin(), this);
+			CheckHr(fetcher.Run());
+			vch.Resize((int)(fetcher.pch - vch.Begin()));
+		}
+		fCached = true;
+	}
+	Assert(ichMin >= 0);
+	int ichLimCopy = std::min(ichLim, vch.Size());
+	if (ichLimCopy > ichMin)
+		CopyItems(vch.Begin() + ichMin, prgchBuf, ichLimCopy - ichMin);
+}
+
 /*----------------------------------------------------------------------------------------------
 	Get the specified range of text
 ----------------------------------------------------------------------------------------------*/
@@ -1371,8 +1818,7 @@ STDMETHODIMP VwMappedTxtSrc::Fetch(int ichrenMin, int ichrenLim, OLECHAR * prgch
 	BEGIN_COM_METHOD;
 	ChkComArrayArg(prgchBuf, ichrenLim - ichrenMin);
 
-	MappedFetcher fetcher(ichrenMin, ichrenLim, prgchBuf, this);
-	return fetcher.Run();
+	FetchCached(m_vchRen, m_fRenCached, false, ichrenMin, ichrenLim, prgchBuf);
 
 	END_COM_METHOD(g_fact, IID_IVwTextSource);
 }
@@ -1395,8 +1841,7 @@ STDMETHODIMP VwMappedTxtSrc::FetchSearch(int ichMin, int ichLim, OLECHAR * prgch
 	BEGIN_COM_METHOD;
 	ChkComArrayArg(prgchBuf, ichLim - ichMin);
 
-	MappedSearchFetcher fetcher(ichMin, ichLim, prgchBuf, this);
-	return fetcher.Run();
+	FetchCached(m_vchSearch, m_fSearchCached, true, ichMin, ichLim, prgchBuf);
 
 	END_COM_METHOD(g_fact, IID_IVwTextSource);
 }
@@ -1405,9 +1850,9 @@ STDMETHODIMP VwConcTxtSrc::FetchSearch(int ichMin, int ichLim, OLECHAR * prgchBu
 {
 	BEGIN_COM_METHOD;
 
-	int delta;
-	CheckHr(LogToSearch(m_cchDiscardInitial, &delta));
-	return SuperClass::FetchSearch(ichMin + delta, ichLim + delta, prgchBuf);
+	EnsureTrimmedView();
+	return SuperClass::FetchSearch(ichMin + m_cchDiscardInitialSearch,
+		ichLim + m_cchDiscardInitialSearch, prgchBuf);
 
 	END_COM_METHOD(g_fact, IID_IVwTextSource);
 }
@@ -1506,9 +1951,10 @@ void VwMappedTxtSrc::ReplaceContents(int itssMin, int itssLim, VwTxtSrc * pts)
 	}
 
 	// Do the actual replacement in m_vpst
-	VpsTssRec * pbtr = pts->Vpst().Begin();
-	int csbtNew = pts->Vpst().Size();
-	m_vpst.Replace(itssMin, itssLim, pbtr, csbtNew);
+	const VpsTssVec & vpstNew = pts->Vpst();
+	int csbtNew = vpstNew.Size();
+	m_vpst.Replace(itssMin, itssLim, csbtNew ? &vpstNew[0] : NULL, csbtNew);
+	ClearIndexes();
 	if (m_vpst.Size() == 0)
 		ThrowInternalError(E_UNEXPECTED, L"VwMappedTxtSrc::ReplaceContents removed all para contents - connect report to LT-9233");
 }
@@ -1703,6 +2149,7 @@ void VwConcTxtSrc::AdjustDiscards()
 	// Clear both of these by default; also allow us to get a true cch.
 	m_cchDiscardInitial = 0;
 	m_cchDiscardFinal = 0;
+	m_vichStartTrimmed.Clear();
 	int cch = Cch();
 	UChar32 uch32;
 	int ichStartBuf = 0; // doesn't matter, empty to start with
@@ -1776,9 +2223,75 @@ void VwConcTxtSrc::AdjustDiscards()
 	m_cchDiscardFinalRen = SuperClass::CchRen() - SuperClass::LogToRen(SuperClass::Cch() - m_cchDiscardFinal);
 	m_ichMinItemRen = SuperClass::LogToRen(m_ichMinItem);
 	m_ichLimItemRen = SuperClass::LogToRen(m_ichLimItem);
+	// Anything worked out above used the discards as they were then.
+	m_vichStartTrimmed.Clear();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Work out the offsets of the trimmed view from the discards, unless that is already done.
+	After that, the length, the string offsets, and the shifts applied to search positions
+	cost nothing.
+----------------------------------------------------------------------------------------------*/
+void VwConcTxtSrc::EnsureTrimmedView()
+{
+	if (m_vichStartTrimmed.Size())
+		return;
+	int cstr = CStrings();
+	int cchTrimmed = SuperClass::IchStartString(cstr) - m_cchDiscardInitial - m_cchDiscardFinal;
+	m_vichStartTrimmed.Resize(cstr + 1);
+	for (int itss = 0; itss <= cstr; itss++)
+	{
+		// Offset it suitably, but don't answer less than zero or more than the simulated length.
+		m_vichStartTrimmed[itss] = std::min(std::max(
+			SuperClass::IchStartString(itss) - m_cchDiscardInitial, 0), cchTrimmed);
+	}
+	m_cchTrimmedRen = SuperClass::LogToRen(cchTrimmed + m_cchDiscardInitial)
+		- m_cchDiscardInitialRen;
+	CheckHr(SuperClass::LogToSearch(m_cchDiscardInitial, &m_cchDiscardInitialSearch));
 }
 
 
+static bool OverrideLess(const DispPropOverride & dpo1, const DispPropOverride & dpo2)
+{
+	return dpo1.ichMin < dpo2.ichMin;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Set the overrides to apply. They may not overlap. Callers normally supply them in order;
+	if not, we sort them, since they are found by binary search.
+----------------------------------------------------------------------------------------------*/
+void VwOverrideTxtSrc::SetOverrides(PropOverrideVec & vdpOverrides)
+{
+	m_vdpOverrides = vdpOverrides;
+	for (int idp = 1; idp < m_vdpOverrides.Size(); idp++)
+	{
+		if (m_vdpOverrides[idp].ichMin < m_vdpOverrides[idp - 1].ichMin)
+		{
+			std::sort(m_vdpOverrides.Begin(), m_vdpOverrides.End(), OverrideLess);
+			break;
+		}
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Answer the index of the first override that ends after ich, or m_vdpOverrides.Size() if
+	there is none. That is the only override that can contain ich.
+----------------------------------------------------------------------------------------------*/
+int VwOverrideTxtSrc::FindOverride(int ich)
+{
+	int idpMin = 0;
+	int idpLim = m_vdpOverrides.Size();
+	while (idpMin < idpLim)
+	{
+		int idpMid = (idpMin + idpLim) / 2;
+		if (ich < m_vdpOverrides[idpMid].ichLim)
+			idpLim = idpMid;
+		else
+			idpMin = idpMid + 1;
+	}
+	return idpMin;
+}
+
 /*----------------------------------------------------------------------------------------------
 	Get the properties of a particular character and indicate the range over which they apply.
 	It is possible they also apply to a larger range.
@@ -1792,14 +2305,7 @@ STDMETHODIMP VwOverrideTxtSrc::GetCharProps(int ich, LgCharRenderProps * pchrp,
 	ChkComArgPtrN(pichLim);
 	ChkComArgPtrN(pichMin);
 
-	// Set idp to the largest index into m_vdpOverrides such that
-	// ich < m_vdpOverrides[idp].ichLim; or to m_vdpOverrides.Size().
-	int idp = 0;
-	for (; idp < m_vdpOverrides.Size(); idp++)
-	{
-		if (ich < m_vdpOverrides[idp].ichLim)
-			break;
-	}
+	int idp = FindOverride(ich);
 	if (idp < m_vdpOverrides.Size() && ich >= m_vdpOverrides[idp].ichMin)
 	{
 		CheckHr(m_qts->GetCharProps(ich, pchrp, pichMin, pichLim));
@@ -1823,20 +2329,56 @@ STDMETHODIMP VwOverrideTxtSrc::GetCharProps(int ich, LgCharRenderProps * pchrp,
 
 
 /*----------------------------------------------------------------------------------------------
-	Update the overrides to the given vector, answering true if there was a change in offsets
-	or underline color (spell checking always uses same value for other chrps).
-	Return true if any override offsets changed.
+	Update the overrides to the given (ordered) vector, answering true if there was a change in
+	offsets or properties (normally just the underline color).
+	Return true if any override changed. If so, and pichMinChanged and pichLimChanged
+	are not null, also return the range of (rendered) characters whose appearance may have
+	changed, that is, everything covered by an override in the old or new vector that is
+	not matched in the other; typically just the word being typed. Only that part of our
+	vector is replaced.
 ----------------------------------------------------------------------------------------------*/
-bool VwSpellingOverrideTxtSrc::UpdateOverrides(PropOverrideVec & vdpOverrides)
+bool VwSpellingOverrideTxtSrc::UpdateOverrides(PropOverrideVec & vdpOverrides,
+	int * pichMinChanged, int * pichLimChanged)
 {
-	bool fSame = m_vdpOverrides.Size() == vdpOverrides.Size();
-	for (int i = 0; fSame && i < vdpOverrides.Size(); i++)
+	int cdpOld = m_vdpOverrides.Size();
+	int cdpNew = vdpOverrides.Size();
+	// Skip the overrides that are the same at the start and end of both vectors.
+	int cdpPrefix = 0;
+	while (cdpPrefix < cdpOld && cdpPrefix < cdpNew
+		&& SameOverride(m_vdpOverrides[cdpPrefix], vdpOverrides[cdpPrefix]))
 	{
-		fSame = vdpOverrides[i].ichMin == m_vdpOverrides[i].ichMin
-			&& vdpOverrides[i].ichLim == m_vdpOverrides[i].ichLim
-			&& vdpOverrides[i].chrp.clrUnder == m_vdpOverrides[i].chrp.clrUnder;
+		cdpPrefix++;
+	}
+	int cdpSuffix = 0;
+	while (cdpSuffix < cdpOld - cdpPrefix && cdpSuffix < cdpNew - cdpPrefix
+		&& SameOverride(m_vdpOverrides[cdpOld - cdpSuffix - 1],
+			vdpOverrides[cdpNew - cdpSuffix - 1]))
+	{
+		cdpSuffix++;
+	}
+	bool fSame = cdpOld == cdpNew && cdpPrefix == cdpOld;
+	if (!fSame && pichMinChanged && pichLimChanged)
+	{
+		int ichMin = INT_MAX;
+		int ichLim = 0;
+		for (int idp = cdpPrefix; idp < cdpOld - cdpSuffix; idp++)
+		{
+			ichMin = Min(ichMin, m_vdpOverrides[idp].ichMin);
+			ichLim = Max(ichLim, m_vdpOverrides[idp].ichLim);
+		}
+		for (int idp = cdpPrefix; idp < cdpNew - cdpSuffix; idp++)
+		{
+			ichMin = Min(ichMin, vdpOverrides[idp].ichMin);
+			ichLim = Max(ichLim, vdpOverrides[idp].ichLim);
+		}
+		*pichMinChanged = ichMin;
+		*pichLimChanged = ichLim;
+	}
+	if (!fSame)
+	{
+		m_vdpOverrides.Replace(cdpPrefix, cdpOld - cdpSuffix, vdpOverrides.Begin() + cdpPrefix,
+			cdpNew - cdpPrefix - cdpSuffix);
 	}
-	m_vdpOverrides = vdpOverrides;
 	return !fSame;
 }
 
@@ -1882,14 +2424,7 @@ void VwOverrideTxtSrc::AdjustOverrideOffsets()
 void VwOverrideTxtSrc::GetUnderlineInfo(int ich, int * punt,
 	COLORREF * pclrUnder, int * pichLim)
 {
-	// Set idp to the largest index into m_vdpOverrides such that
-	// ich < m_vdpOverrides[idp].ichLim; or to m_vdpOverrides.Size().
-	int idp = 0;
-	for (; idp < m_vdpOverrides.Size(); idp++)
-	{
-		if (ich < m_vdpOverrides[idp].ichLim)
-			break;
-	}
+	int idp = FindOverride(ich);
 	if (idp < m_vdpOverrides.Size() && ich >= m_vdpOverrides[idp].ichMin)
 	{
 		// index passed is in an override range.
@@ -24,7 +24,7 @@ Last reviewed: Not yet.
 // JohnT: moved here from VwTextBoxes.h as this file uses it and needs to be included first.
 enum VwSourceType
 {
-	kvstNormal, kvstTagged, kvstMapped, kvstMappedTagged, kvstConc, kvstOverride
+	kvstNormal, kvstTagged, kvstMapped, kvstMappedTagged, kvstConc, kvstOverride, kvstSingleRun
 }; // Hungarian vst
 
 class VwMappedTxtSrc;
@@ -47,6 +47,37 @@ struct VpsTssRec
 };
 
 typedef Vector<VpsTssRec> VpsTssVec; // Hungarian vpst
+
+// Struct: RunPropsRec: the text props of one run of a paragraph, and the property store
+// computed from them, as reported by VwTextSelection::GetSelectionProps.
+struct RunPropsRec
+{
+	ITsTextPropsPtr qttp;
+	VwPropertyStorePtr qzvps;
+};
+
+typedef Vector<RunPropsRec> RunPropsVec; // Hungarian vrpr
+
+// Struct: DepObjRec: an ORC in a paragraph that links to a dependent object (such as a
+// footnote) which page layout must place on the same page.
+struct DepObjRec
+{
+	int ich; // logical offset of the ORC in the paragraph
+	GUID guid;
+};
+
+typedef Vector<DepObjRec> DepObjVec; // Hungarian vdor
+
+// Struct: CharPropRange: a range of rendered characters over which GetCharProps answers the
+// same LgCharRenderProps, possibly spanning several runs and strings.
+struct CharPropRange
+{
+	int ichMin;
+	int ichLim;
+	CachedProps * pchrp; // belongs to one of the property stores of the strings
+};
+
+typedef Vector<CharPropRange> CharPropRangeVec; // Hungarian vcpr
 /*----------------------------------------------------------------------------------------------
 	Class: VwTxtSrc
 	This class really just amounts to an interface definition: it specifies the functions
@@ -113,7 +144,9 @@ class VwTxtSrc : public IVwTextSource
 	virtual void StringAtIndex(int itss, ITsString ** pptss) = 0;
 	virtual void StyleAtIndex(int itss, VwPropertyStore ** ppzvps) = 0;
 	virtual void GetUnderlineInfo(int ich, int * punt, COLORREF * pclrUnder, int * pichLim) = 0;
-	virtual VpsTssVec & Vpst() = 0;
+	// The strings, for reading. Use EditVpst() to change them.
+	virtual const VpsTssVec & Vpst() = 0;
+	virtual VpsTssVec & EditVpst() = 0;
 	virtual void CharAndPropsAt(int ich, OLECHAR * pch, ITsTextProps ** ppttp) = 0;
 	virtual int LogToRen(int ichlog) = 0;
 	virtual int RenToLog(int ichren) = 0;
@@ -129,9 +162,22 @@ class VwTxtSrc : public IVwTextSource
 		int * pichMin, int * pichLim, int * pisbt, int * pirun, ITsTextProps ** ppttp,
 		VwPropertyStore ** ppzvps) = 0;
 
+	void CollectRunProps(int ichStart, int ichEnd, RunPropsVec & vrpr);
+	RunPropsVec & RunProps();
+	void GetDependentObjects(int ichMin, int ichLim, Vector<GUID> & vguid);
+
 protected:
 	// Member variables
 	long m_cref;
+	// Summary of the run props of the whole paragraph (see RunProps()), and the strings and
+	// styles it was computed from, used to tell whether it is still valid.
+	RunPropsVec m_vrpr;
+	VpsTssVec m_vpstRunProps;
+	// Index of the dependent object links in the paragraph, in order, and the strings it was
+	// computed from (see DependentObjects()).
+	DepObjVec m_vdor;
+	VpsTssVec m_vpstDepObjs;
+	DepObjVec & DependentObjects();
 	virtual int CchTss(int itss) = 0;
 };
 DEFINE_COM_PTR(VwTxtSrc);
@@ -210,10 +256,17 @@ class VwSimpleTxtSrc : public VwTxtSrc
 	virtual void StringAtIndex(int itss, ITsString ** pptss);
 	virtual void StyleAtIndex(int itss, VwPropertyStore ** ppzvps);
 	virtual void GetUnderlineInfo(int ich, int * punt, COLORREF * pclrUnder, int * pichLim);
-	virtual VpsTssVec & Vpst()
+	virtual const VpsTssVec & Vpst()
 	{
 		return m_vpst;
 	}
+	// For callers that change the strings (e.g., to add the dummy entry for an embedded box);
+	// the indexes built from them are discarded.
+	virtual VpsTssVec & EditVpst()
+	{
+		ClearIndexes();
+		return m_vpst;
+	}
 	virtual void CharAndPropsAt(int ich, OLECHAR * pch, ITsTextProps ** ppttp);
 
 	// convert between logical and rendered character indexes. Default conversion is trivial;
@@ -236,6 +289,7 @@ class VwSimpleTxtSrc : public VwTxtSrc
 	virtual void SetWritingSystemFactory(ILgWritingSystemFactory * pwsf)
 	{
 		m_qwsf = pwsf;
+		ClearIndexes();
 	}
 	virtual void GetWritingSystemFactory(ILgWritingSystemFactory ** ppwsf)
 	{
@@ -252,6 +306,22 @@ class VwSimpleTxtSrc : public VwTxtSrc
 	VpsTssVec m_vpst;
 	LgParaRenderProps m_parp;
 	ILgWritingSystemFactoryPtr m_qwsf;
+	// Logical offset of the start of each string in m_vpst, plus a final entry for the total
+	// length. Built on demand; empty when m_vpst has changed since it was last built.
+	IntVec m_vichStart;
+	// The ranges of equal text properties covering the whole paragraph, in order, as
+	// answered by GetCharProps. Built on demand; empty when m_vpst has changed.
+	CharPropRangeVec m_vcpr;
+	int m_nChrpGeneration; // VwPropertyStore::ChrpGeneration() when m_vcpr was made
+
+	virtual void ClearIndexes()
+	{
+		m_vichStart.Clear();
+		m_vcpr.Clear();
+	}
+	void EnsureStringOffsets();
+	int StringIndexFromIch(int ich, bool fAssocPrev);
+	CachedProps * CoalescedCharProps(int ich, int * pichMin, int * pichLim);
 
 	virtual CachedProps * GetCharPropInfo(int ich,
 		int * pichMin, int * pichLim, int * pisbt, int * pirun, ITsTextProps ** ppttp,
@@ -261,6 +331,59 @@ class VwSimpleTxtSrc : public VwTxtSrc
 
 DEFINE_COM_PTR(VwSimpleTxtSrc);
 
+/*----------------------------------------------------------------------------------------------
+	This class implements a simple text source for the commonest paragraph of all, the one
+	VwEnv makes to hold a single string with a single run (e.g., a cell in a browse view).
+	While it holds exactly that, it keeps the characters, the length, and the property store
+	and CachedProps of the run, so layout and drawing don't need to look in the string again.
+	If its contents change to anything else (e.g., by editing) it behaves exactly like its
+	superclass.
+	Hungarian: srts
+----------------------------------------------------------------------------------------------*/
+class VwSingleRunTxtSrc : public VwSimpleTxtSrc
+{
+	typedef VwSimpleTxtSrc SuperClass;
+public:
+	// IVwTextSource methods
+	STDMETHOD(Fetch)(int ichMin, int ichLim, OLECHAR * prgchBuf);
+	STDMETHOD(FetchSearch)(int ichMin, int ichLim, OLECHAR * prgchBuf);
+	STDMETHOD(GetCharProps)(int ich, LgCharRenderProps * pchrp, int * pichMin, int * pichLim);
+
+	virtual void FetchLog(int ichMin, int ichLim, OLECHAR * prgchBuf);
+	virtual int Cch();
+	virtual int CchRen();
+	virtual int IchStartString(int itss);
+	virtual void GetUnderlineInfo(int ich, int * punt, COLORREF * pclrUnder, int * pichLim);
+	virtual VwSourceType SourceType() {return kvstSingleRun;}
+
+	// True if the contents are currently a single string with a single run.
+	bool IsSingleRun()
+	{
+		return EnsureSingleRun();
+	}
+
+protected:
+	// Whether the contents are a single run: 0 if not yet worked out since they changed,
+	// 1 if they are, -1 if not. The other variables are valid only if it is 1.
+	int m_nSingleRun;
+	Vector<OLECHAR> m_vch;
+	VwPropertyStore * m_pzvpsRun; // kept alive by the one in m_vpst
+	CachedProps * m_pchrpRun; // belongs to m_pzvpsRun
+	int m_nChrpGenerationRun; // VwPropertyStore::ChrpGeneration() when m_pchrpRun was got
+
+	bool EnsureSingleRun();
+	virtual void ClearIndexes()
+	{
+		SuperClass::ClearIndexes();
+		m_nSingleRun = 0;
+		m_vch.Clear();
+		m_pzvpsRun = NULL;
+		m_pchrpRun = NULL;
+	}
+};
+
+DEFINE_COM_PTR(VwSingleRunTxtSrc);
+
 class VwOverlayTxtSrc : public VwSimpleTxtSrc
 {
 public:
@@ -273,10 +396,42 @@ class VwOverlayTxtSrc : public VwSimpleTxtSrc
 	}
 	virtual void GetUnderlineInfo(int ich, int * punt, COLORREF * pclrUnder, int * pichLim);
 	virtual bool DoesOverlays() {return true;}
+
+	// How one visible overlay tag wants text displayed.
+	struct OverlayTagProps // otp
+	{
+		COLORREF clrFore;
+		COLORREF clrBack;
+		COLORREF clrUnder;
+		int unt;
+	};
+	// The tags of one ttp are m_votp[iotpMin..iotpLim).
+	struct OverlayTagRange // otr
+	{
+		int iotpMin;
+		int iotpLim;
+	};
+	typedef Vector<OverlayTagProps> OverlayTagPropsVec; // votp
+	typedef HashMap<ITsTextProps *, OverlayTagRange> OverlayTagMap; // hmttpotr
+
 protected:
 	// It has a direct pointer to the root box for efficiency. May be null if not doing overlays.
 	VwRootBox * m_prootb;
+	// The visible overlay tags of each ttp we have been asked about, in the order they occur
+	// in its ktptTags. Valid only while the overlay has version m_nOverlayVersion and our
+	// strings (which keep the ttps alive) are unchanged.
+	OverlayTagMap m_hmttpotr;
+	OverlayTagPropsVec m_votp;
+	int m_nOverlayVersion;
+
 	virtual VwSourceType SourceType() {return kvstTagged;}
+	virtual void ClearIndexes()
+	{
+		VwSimpleTxtSrc::ClearIndexes();
+		m_hmttpotr.Clear();
+		m_votp.Clear();
+	}
+	int OverlayTags(ITsTextProps * pttp, OverlayTagProps ** pprgotp);
 };
 
 DEFINE_COM_PTR(VwOverlayTxtSrc);
@@ -364,9 +519,32 @@ class VwMappedTxtSrc : public VwOverlayTxtSrc, public IVwTxtSrcInit2
 	virtual bool IsMapped() {return true;}
 	bool OmitTmiFromSearch(int itmi);
 	static bool OmitOrcFromSearch(ITsString * ptss, int ich);
+	// How many calls to Fetch and FetchSearch were answered from the cached text, and how
+	// many had to build it.
+	int FetchHits() {return m_cFetchHit;}
+	int FetchMisses() {return m_cFetchMiss;}
 protected:
 	// member variables
 	TmiVec m_vtmi;
+	// The whole rendered text and the whole search text, with substitutions made, built by
+	// the first Fetch or FetchSearch after the contents change. Each is valid only if its
+	// flag is set (either may legitimately be empty).
+	Vector<OLECHAR> m_vchRen;
+	Vector<OLECHAR> m_vchSearch;
+	bool m_fRenCached;
+	bool m_fSearchCached;
+	int m_cFetchHit;
+	int m_cFetchMiss;
+
+	virtual void ClearIndexes()
+	{
+		SuperClass::ClearIndexes();
+		m_vchRen.Clear();
+		m_vchSearch.Clear();
+		m_fRenCached = m_fSearchCached = false;
+	}
+	void FetchCached(Vector<OLECHAR> & vch, bool & fCached, bool fSearch, int ichMin,
+		int ichLim, OLECHAR * prgchBuf);
 	int GetSourceTmi(int ichlog);
 	int GetRenderTmi(int ichren);
 	virtual CachedProps * GetCharPropInfo(int ich,
@@ -459,9 +637,13 @@ class VwConcTxtSrc : public VwMappedOverlayTxtSrc
 
 	virtual int IchStartString(int itss)
 	{
-		// Offset it suitably, but don't answer less than zero or more than the simulated length.
-		return std::min(std::max(SuperClass::IchStartString(itss) - m_cchDiscardInitial, 0),
-			SuperClass::IchStartString(CStrings()) - m_cchDiscardInitial - m_cchDiscardFinal);
+		EnsureTrimmedView();
+		return m_vichStartTrimmed[itss];
+	}
+	virtual int CchRen()
+	{
+		EnsureTrimmedView();
+		return m_cchTrimmedRen;
 	}
 	virtual void StringFromIch(int ich,	bool fAssocPrev, ITsString ** pptss,
 		int *pichMin, int * pichLim, VwPropertyStore ** ppzvps, int * pitss)
@@ -485,6 +667,20 @@ class VwConcTxtSrc : public VwMappedOverlayTxtSrc
 	int m_cchDiscardFinal;
 	int m_cchDiscardInitialRen; // similar, but rendered characters.
 	int m_cchDiscardFinalRen;
+	// The trimmed view, fixed once the discards are known: the start of each string (and the
+	// total length) in logical characters, the rendered length, and the number of search
+	// characters discarded at the start. m_vichStartTrimmed is empty when these need to be
+	// worked out again.
+	IntVec m_vichStartTrimmed;
+	int m_cchTrimmedRen;
+	int m_cchDiscardInitialSearch;
+
+	void EnsureTrimmedView();
+	virtual void ClearIndexes()
+	{
+		SuperClass::ClearIndexes();
+		m_vichStartTrimmed.Clear();
+	}
 
 	OLECHAR CharAt(OLECHAR * prgchBuf, int bufSize, int & ichStartBuf, int & cchBuf,
 		int cch, int ich, bool fForward);
@@ -560,7 +756,8 @@ class VwOverrideTxtSrc : public VwTxtSrc
 	virtual void StringAtIndex(int itss, ITsString ** pptss) {m_qts->StringAtIndex(itss, pptss);}
 	virtual void StyleAtIndex(int itss, VwPropertyStore ** ppzvps) {m_qts->StyleAtIndex(itss, ppzvps);}
 	virtual void GetUnderlineInfo(int ich, int * punt, COLORREF * pclrUnder, int * pichLim);
-	virtual VpsTssVec & Vpst() {return m_qts->Vpst();}
+	virtual const VpsTssVec & Vpst() {return m_qts->Vpst();}
+	virtual VpsTssVec & EditVpst() {return m_qts->EditVpst();}
 	virtual void CharAndPropsAt(int ich, OLECHAR * pch, ITsTextProps ** ppttp)
 		{m_qts->CharAndPropsAt(ich, pch, ppttp);}
 	virtual int LogToRen(int ichlog) {return m_qts->LogToRen(ichlog);}
@@ -576,17 +773,17 @@ class VwOverrideTxtSrc : public VwTxtSrc
 	virtual bool IsMapped() {return m_qts->IsMapped();}
 	virtual bool DoesOverlays() {return m_qts->DoesOverlays();}
 	virtual void AdjustOverrideOffsets();
-	void SetOverrides(PropOverrideVec & vdpOverrides)
-	{
-		m_vdpOverrides = vdpOverrides;
-	}
+	void SetOverrides(PropOverrideVec & vdpOverrides);
 	VwTxtSrc * EmbeddedSrc()
 	{
 		return m_qts;
 	}
 protected:
 	VwTxtSrcPtr m_qts;
+	// The overrides, which may not overlap, ordered by position so they can be found by
+	// binary search.
 	PropOverrideVec m_vdpOverrides;
+	int FindOverride(int ich);
 	// This one is the whole point of the class!
 	virtual CachedProps * GetCharPropInfo(int ich,
 		int * pichMin, int * pichLim, int * pisbt, int * pirun, ITsTextProps ** ppttp,
@@ -604,7 +801,16 @@ class VwSpellingOverrideTxtSrc : public VwOverrideTxtSrc
 	VwSpellingOverrideTxtSrc(VwTxtSrc * pts) : VwOverrideTxtSrc(pts)
 	{
 	}
-	bool UpdateOverrides(PropOverrideVec & vdpOverrides);
+	bool UpdateOverrides(PropOverrideVec & vdpOverrides, int * pichMinChanged = NULL,
+		int * pichLimChanged = NULL);
+protected:
+	// Apart from the underline, the chrp is that of the run, so it only differs if the run's
+	// properties changed; we keep the old override only if nothing differs.
+	static bool SameOverride(DispPropOverride & dpo1, DispPropOverride & dpo2)
+	{
+		return dpo1.ichMin == dpo2.ichMin && dpo1.ichLim == dpo2.ichLim
+			&& !memcmp(&dpo1.chrp, &dpo2.chrp, isizeof(LgCharRenderProps));
+	}
 };
 
 // Marker class which allows us to distinguish override text sources used for IME Display Attrs
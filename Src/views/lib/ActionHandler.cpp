@@ -34,6 +34,7 @@ ActionHandler::ActionHandler()
 	m_iuactCurr = -1;
 	m_iCurrSeq = -1;
 	m_fStartedNext = false;
+	m_cbMax = 0;
 	ModuleEntry::ModuleAddRef();
 }
 
@@ -88,6 +89,10 @@ STDMETHODIMP ActionHandler::QueryInterface(REFIID iid, void ** ppv)
 		*ppv = static_cast<IUnknown *>(static_cast<IActionHandler *>(this));
 	else if (iid == IID_IActionHandler)
 		*ppv = static_cast<IActionHandler *>(this);
+	else if (iid == IID_IUndoStackMemory)
+		*ppv = static_cast<IUndoStackMemory *>(this);
+	else if (&iid == &CLSID_ActionHandler)	// Trick to find out whether it is our own class.
+		*ppv = static_cast<ActionHandler *>(this);
 	else
 		return E_NOINTERFACE;
 
@@ -302,6 +307,7 @@ STDMETHODIMP ActionHandler::EndOuterUndoTask()
 		return S_OK;
 
 	CleanUpEmptyTasks();
+	EnforceMemoryLimit();
 
 	m_nDepth = 0;
 	m_fStartedNext = false;
@@ -1416,6 +1422,122 @@ STDMETHODIMP ActionHandler::get_RedoableSequenceCount(int * pcAct)
 }
 
 
+//:>********************************************************************************************
+//:>	ActionHandler - memory accounting
+//:>********************************************************************************************
+
+/*----------------------------------------------------------------------------------------------
+	Return the approximate memory held by one action.
+----------------------------------------------------------------------------------------------*/
+int ActionHandler::ActionSize(IUndoAction * puact)
+{
+	IUndoActionSizePtr quas;
+	if (FAILED(puact->QueryInterface(IID_IUndoActionSize, (void **)&quas)))
+		return kcbDefaultAction;
+	return quas->SizeInBytes();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the approximate number of bytes held by all the actions on the stack, both undoable
+	and redoable.
+----------------------------------------------------------------------------------------------*/
+int ActionHandler::MemoryUsed()
+{
+	int cb = 0;
+	for (int iuact = 0; iuact < m_vquact.Size(); iuact++)
+		cb += ActionSize(m_vquact[iuact]);
+	return cb;
+}
+
+/*----------------------------------------------------------------------------------------------
+	${IUndoStackMemory#MemoryUsed}
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP ActionHandler::get_MemoryUsed(int * pcb)
+{
+	BEGIN_COM_METHOD;
+	ChkComOutPtr(pcb);
+	*pcb = MemoryUsed();
+	END_COM_METHOD(g_factActh, IID_IUndoStackMemory);
+}
+
+/*----------------------------------------------------------------------------------------------
+	${IUndoStackMemory#MemoryLimit}
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP ActionHandler::get_MemoryLimit(int * pcbMax)
+{
+	BEGIN_COM_METHOD;
+	ChkComOutPtr(pcbMax);
+	*pcbMax = m_cbMax;
+	END_COM_METHOD(g_factActh, IID_IUndoStackMemory);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Set the approximate number of bytes the undo stack may hold; zero means no limit. The
+	limit is applied whenever an outer task ends.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP ActionHandler::put_MemoryLimit(int cbMax)
+{
+	BEGIN_COM_METHOD;
+	if (cbMax < 0)
+		ThrowHr(WarnHr(E_INVALIDARG));
+	m_cbMax = cbMax;
+	END_COM_METHOD(g_factActh, IID_IUndoStackMemory);
+}
+
+/*----------------------------------------------------------------------------------------------
+	If the stack holds more than m_cbMax bytes, commit and drop the oldest sequences until it
+	doesn't. The most recent undoable sequence is always kept, so the last thing the user did
+	can still be undone however big it is. Nothing is dropped while there are marks, because
+	they refer to positions in the stack that a field editor will collapse or discard.
+----------------------------------------------------------------------------------------------*/
+void ActionHandler::EnforceMemoryLimit()
+{
+	if (!m_cbMax || m_viMarks.Size() || m_fUndoOrRedoInProgress)
+		return;
+	int cb = MemoryUsed();
+	int cseqDrop = 0;
+	int iuactLim = 0;
+	while (cb > m_cbMax && cseqDrop < m_iCurrSeq)
+	{
+		int iuactLimSeq = m_viSeqStart[cseqDrop + 1];
+		for (int iuact = iuactLim; iuact < iuactLimSeq; iuact++)
+		{
+			cb -= ActionSize(m_vquact[iuact]);
+			// As in Commit(), there is nothing useful to do if this fails.
+			IgnoreHr(m_vquact[iuact]->Commit());
+		}
+		iuactLim = iuactLimSeq;
+		cseqDrop++;
+	}
+	if (!cseqDrop)
+		return;
+
+	m_vquact.Replace(0, iuactLim, NULL, 0);
+	m_viSeqStart.Replace(0, cseqDrop, NULL, 0);
+	m_vstuUndo.Replace(0, cseqDrop, NULL, 0);
+	m_vstuRedo.Replace(0, cseqDrop, NULL, 0);
+	for (int iseq = 0; iseq < m_viSeqStart.Size(); iseq++)
+		m_viSeqStart[iseq] -= iuactLim;
+	m_iCurrSeq -= cseqDrop;
+	m_iuactCurr -= iuactLim;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return true if puact is the most recent action of a task that is still open, so that a
+	further change made as part of the same task may be merged into it instead of being
+	added as a separate action.
+----------------------------------------------------------------------------------------------*/
+bool ActionHandler::IsLastActionOfOpenTask(IUndoAction * puact)
+{
+	if (m_nDepth <= 0 || m_fStartedNext || m_fUndoOrRedoInProgress || m_iCurrSeq < 0)
+		return false;
+	if (m_iuactCurr < 0 || m_iuactCurr != m_vquact.Size() - 1)
+		return false; // something has been undone
+	if (m_viSeqStart[m_iCurrSeq] > m_iuactCurr)
+		return false; // the current sequence is empty
+	return m_vquact[m_iuactCurr].Ptr() == puact;
+}
+
 // Explicit instantiation
 #include <Vector_i.cpp>
 template class Vector<IUndoActionPtr>;
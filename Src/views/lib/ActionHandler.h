@@ -16,12 +16,52 @@ Last reviewed: never
 
 class ActionHandler;
 
+/*----------------------------------------------------------------------------------------------
+	IUndoActionSize is an internal interface implemented by undo actions that can report
+	roughly how much memory they hold, so that ActionHandler can measure the undo stack and
+	keep it within a memory limit. Actions that don't implement it are counted as
+	ActionHandler::kcbDefaultAction bytes.
+	Hungarian: uas
+----------------------------------------------------------------------------------------------*/
+interface IUndoActionSize : public IUnknown
+{
+public:
+	STDMETHOD_(int, SizeInBytes)() = 0;
+};
+
+interface __declspec(uuid("8BCA8940-9B4C-47B2-9670-9157D58D9443")) IUndoActionSize;
+#define IID_IUndoActionSize __uuidof(IUndoActionSize)
+DEFINE_COM_PTR(IUndoActionSize);
+
+/*----------------------------------------------------------------------------------------------
+	IUndoStackMemory is an internal interface through which the owner of an ActionHandler can
+	find out roughly how much memory the undo stack holds, and give it a budget. IActionHandler
+	itself is defined outside the Views code, so clients QueryInterface for this one.
+	Hungarian: usm
+----------------------------------------------------------------------------------------------*/
+interface IUndoStackMemory : public IUnknown
+{
+public:
+	// The approximate number of bytes held by all the actions on the stack, both undoable
+	// and redoable.
+	STDMETHOD(get_MemoryUsed)(int * pcb) = 0;
+	// The approximate number of bytes the stack may hold; zero (the default) means no limit.
+	// The limit is applied whenever an outer task ends, by committing and dropping the
+	// oldest sequences.
+	STDMETHOD(get_MemoryLimit)(int * pcbMax) = 0;
+	STDMETHOD(put_MemoryLimit)(int cbMax) = 0;
+};
+
+interface __declspec(uuid("EDB1C3D8-6B89-4941-82F3-16FDE7488379")) IUndoStackMemory;
+#define IID_IUndoStackMemory __uuidof(IUndoStackMemory)
+DEFINE_COM_PTR(IUndoStackMemory);
+
 /*----------------------------------------------------------------------------------------------
 	Cross-Reference: ${IActionHandler}
 
 	@h3{Hungarian: acth}
 ----------------------------------------------------------------------------------------------*/
-class ActionHandler : public IActionHandler
+class ActionHandler : public IActionHandler, public IUndoStackMemory
 {
 public:
 	ActionHandler();
@@ -67,6 +107,16 @@ class ActionHandler : public IActionHandler
 	STDMETHOD(get_IsUndoOrRedoInProgress)(ComBool * pfInProgress);
 	STDMETHOD(get_SuppressSelections)(ComBool * pfSupressSel);
 
+	// IUndoStackMemory
+	STDMETHOD(get_MemoryUsed)(int * pcb);
+	STDMETHOD(get_MemoryLimit)(int * pcbMax);
+	STDMETHOD(put_MemoryLimit)(int cbMax);
+
+	// Not part of any interface. Use QueryInterface(CLSID_ActionHandler) to find out whether
+	// an IActionHandler is this implementation.
+	enum { kcbDefaultAction = 64 };
+	bool IsLastActionOfOpenTask(IUndoAction * puact);
+
 protected:
 	int m_cref;
 
@@ -129,12 +179,19 @@ class ActionHandler : public IActionHandler
 	// recording any new actions.
 	bool m_fUndoOrRedoInProgress;
 
+	// If non-zero, the approximate number of bytes the actions on the stack may hold. When a
+	// task ends with the stack over the limit, the oldest sequences are committed and dropped.
+	int m_cbMax;
+
 	// private methods:
 	void AddActionAux(IUndoAction * puact);
 	void CleanUpRedoActions(bool fForce);
 	void CleanUpEmptyTasks();
 	void EmptyStack();
 	void CleanUpMarks();
+	int ActionSize(IUndoAction * puact);
+	int MemoryUsed();
+	void EnforceMemoryLimit();
 
 	HRESULT CallUndo(UndoResult * pures, bool & fRedoable, bool fForDataChange);
 	HRESULT CallRedo(UndoResult * pures, bool fForDataChange, int iSeqToRedo, int iLastRedoAct);
@@ -68,6 +68,7 @@ void VwCacheDa::ClearCriticalMaps()
 ----------------------------------------------------------------------------------------------*/
 VwCacheDa::~VwCacheDa()
 {
+	DetachSnapshots();
 	ClearCriticalMaps();
 }
 
@@ -195,7 +196,11 @@ STDMETHODIMP VwCacheDa::CacheObjProp(HVO hvo, PropTag tag, HVO val)
 	// object at all.
 	Assert(hvo != 0);
 	ObjPropRec oprKey(hvo, tag);
-	m_hmoprobj.Insert(oprKey, val, true); // allow overwrites
+	{
+		CacheSnapshotLock csl(this);
+		SaveObjPropForSnapshots(oprKey);
+		m_hmoprobj.Insert(oprKey, val, true); // allow overwrites
+	}
 	// REVIEW JohnT (TomB): Do we always want to store the owner of the "val" object in the
 	// cache? I was doing this only when calling this function from DoInsert, but I
 	// discovered that I also needed it when ReplaceAux was called from other places, so
@@ -287,6 +292,8 @@ STDMETHODIMP VwCacheDa::CacheVecProp(HVO hvo, PropTag tag, HVO rghvo[], const in
 	os.m_prghvo = NewObj HVO[chvo];
 	CopyItems(rghvo, os.m_prghvo, chvo);
 
+	CacheSnapshotLock csl(this);
+	SaveVecPropForSnapshots(oprKey);
 	ObjSeq osOld;
 	if (m_hmoprsobj.Retrieve(oprKey, &osOld))
 	{
@@ -373,6 +380,8 @@ STDMETHODIMP VwCacheDa::CacheIntProp(HVO hvo, PropTag tag, int val)
 	// object at all.
 	Assert(hvo != 0);
 	ObjPropRec oprKey(hvo, tag);
+	CacheSnapshotLock csl(this);
+	SaveIntPropForSnapshots(oprKey);
 	m_hmoprn.Insert(oprKey, val, true); // allow overwrites
 
 	END_COM_METHOD(g_fact, IID_IVwCacheDa);
@@ -391,6 +400,8 @@ STDMETHODIMP VwCacheDa::CacheBooleanProp(HVO hvo, PropTag tag, ComBool f)
 	Assert(hvo != 0);
 	ObjPropRec oprKey(hvo, tag);
 	int val = f;
+	CacheSnapshotLock csl(this);
+	SaveIntPropForSnapshots(oprKey);
 	m_hmoprn.Insert(oprKey, val, true); // allow overwrites
 
 	END_COM_METHOD(g_fact, IID_IVwCacheDa);
@@ -408,6 +419,8 @@ STDMETHODIMP VwCacheDa::CacheStringAlt(HVO hvo, PropTag tag, int ws, ITsString *
 	// object at all.
 	Assert(hvo != 0);
 	ObjPropEncRec opreKey(hvo, tag, ws);
+	CacheSnapshotLock csl(this);
+	SaveStringAltForSnapshots(opreKey);
 	m_hmopertss.Insert(opreKey, ptss, true);
 
 	END_COM_METHOD(g_fact, IID_IVwCacheDa);
@@ -429,6 +442,8 @@ STDMETHODIMP VwCacheDa::CacheStringProp(HVO hvo, PropTag tag, ITsString * ptss)
 	// object at all.
 	Assert(hvo != 0);
 	ObjPropRec oprKey(hvo, tag);
+	CacheSnapshotLock csl(this);
+	SaveStringPropForSnapshots(oprKey);
 	m_hmoprtss.Insert(oprKey, ptss, true); // allow overwrites
 
 	END_COM_METHOD(g_fact, IID_IVwCacheDa);
@@ -515,7 +530,10 @@ STDMETHODIMP VwCacheDa::get_ObjectProp(HVO hvo, PropTag tag, HVO * phvo)
 		return S_FALSE; // Not in cache, nor virtual, but may just be empty or not loaded.
 	case kvhrUseAndRemove:
 		if (m_hmoprobj.Retrieve(oprKey, phvo)) // Whatever's in the cache is it (0 if not found)
+		{
+			CacheSnapshotLock csl(this);
 			m_hmoprobj.Delete(oprKey); // But if it is found we have to remove it.
+		}
 		return S_OK;
 	case kvhrUse:
 		m_hmoprobj.Retrieve(oprKey, phvo); // Whatever is now in the cache is it (0 if not found)
@@ -562,8 +580,11 @@ STDMETHODIMP VwCacheDa::get_VecItem(HVO hvo, PropTag tag, int index, HVO * phvo)
 			if ((uint) index >= (uint) (os.m_cobj)) // Have to repeat this to delete after.
 				ThrowInternalError(E_INVALIDARG);
 			*phvo = os.m_prghvo[index];
-			ClearObjSeq(os);
-			m_hmoprsobj.Delete(oprKey); // This is really inefficient, hope doesn't happen much!
+			{
+				CacheSnapshotLock csl(this);
+				ClearObjSeq(os);
+				m_hmoprsobj.Delete(oprKey); // This is really inefficient, hope doesn't happen much!
+			}
 			return S_OK;
 		case kvhrUse:
 			m_hmoprsobj.Retrieve(oprKey, &os);	// should be in cache now.
@@ -598,8 +619,11 @@ STDMETHODIMP VwCacheDa::get_VecSize(HVO hvo, PropTag tag, int * pchvo)
 			if (!m_hmoprsobj.Retrieve(oprKey, &os))
 				return S_OK; // empty virtual property, length 0 (but treat as present).
 			*pchvo = os.m_cobj;
-			ClearObjSeq(os);
-			m_hmoprsobj.Delete(oprKey); // This is really inefficient, hope doesn't happen much!
+			{
+				CacheSnapshotLock csl(this);
+				ClearObjSeq(os);
+				m_hmoprsobj.Delete(oprKey); // This is really inefficient, hope doesn't happen much!
+			}
 			return S_OK;
 		case kvhrUse:
 			m_hmoprsobj.Retrieve(oprKey, &os);	// should be in cache now.
@@ -643,8 +667,11 @@ STDMETHODIMP VwCacheDa::VecProp(HVO hvo, PropTag tag, int chvoMax, int * pchvo,
 				return E_INVALIDARG;
 			CopyItems(os.m_prghvo, prghvo, os.m_cobj);
 			*pchvo = os.m_cobj;
-			ClearObjSeq(os);
-			m_hmoprsobj.Delete(oprKey); // This is really inefficient, hope doesn't happen much!
+			{
+				CacheSnapshotLock csl(this);
+				ClearObjSeq(os);
+				m_hmoprsobj.Delete(oprKey); // This is really inefficient, hope doesn't happen much!
+			}
 			return S_OK;
 		case kvhrUse:
 			break; // Carry on as if we'd found in the first place.
@@ -854,7 +881,10 @@ STDMETHODIMP VwCacheDa::get_IntProp(HVO hvo, PropTag tag, int * pn)
 		return S_FALSE; // Not in cache, nor virtual, but may just be empty or not loaded.
 	case kvhrUseAndRemove:
 		if (m_hmoprn.Retrieve(oprKey, pn)) // Whatever's in the cache is it (0 if not found)
+		{
+			CacheSnapshotLock csl(this);
 			m_hmoprn.Delete(oprKey); // But if it is found we have to remove it.
+		}
 		return S_OK;
 	case kvhrUse:
 		m_hmoprn.Retrieve(oprKey, pn); // Whatever is now in the cache is it (0 if not found)
@@ -902,7 +932,10 @@ STDMETHODIMP VwCacheDa::get_MultiStringAlt(HVO hvo, PropTag tag, int ws, ITsStri
 			break;
 		case kvhrUseAndRemove:
 			if (m_hmopertss.Retrieve(opreKey, qtss)) // Whatever's in the cache is it
+			{
+				CacheSnapshotLock csl(this);
 				m_hmopertss.Delete(opreKey); // But if it is found we have to remove it.
+			}
 			break;
 		case kvhrUse:
 			m_hmopertss.Retrieve(opreKey, qtss); // Whatever is now in the cache is it
@@ -946,7 +979,10 @@ STDMETHODIMP VwCacheDa::get_StringProp(HVO hvo, PropTag tag, ITsString ** pptss)
 			break;
 		case kvhrUseAndRemove:
 			if (m_hmoprtss.Retrieve(oprKey, qtss)) // Whatever's in the cache is it
+			{
+				CacheSnapshotLock csl(this);
 				m_hmoprtss.Delete(oprKey); // But if it is found we have to remove it.
+			}
 			break;
 		case kvhrUse:
 			m_hmoprtss.Retrieve(oprKey, qtss); // Whatever is now in the cache is it
@@ -1457,6 +1493,7 @@ void VwCacheDa::MoveOwnedObject(HVO hvoSrcOwner, PropTag tagSrc, int ihvoStart,
 		ThrowInternalError(E_INVALIDARG);
 	}
 
+	CacheSnapshotLock csl(this);
 	ObjPropRec oprSrcKey(hvoSrcOwner, tagSrc);
 	//  Create a new ObjSeq record and copy the records over appropriately.
 	if (hvoSrcOwner == hvoDstOwner && tagSrc == tagDst)
@@ -1510,6 +1547,7 @@ void VwCacheDa::MoveOwnedObject(HVO hvoSrcOwner, PropTag tagSrc, int ihvoStart,
 		}
 
 		//  Delete the old ObjSeq record and replace it with the new one.
+		SaveVecPropForSnapshots(oprSrcKey);
 		m_hmoprsobj.Insert(oprSrcKey, osRep, true);
 	}
 	else
@@ -1524,24 +1562,32 @@ void VwCacheDa::MoveOwnedObject(HVO hvoSrcOwner, PropTag tagSrc, int ihvoStart,
 				ObjPropRec opr(hvo, kflidCmObject_Owner);
 				HVO hvoOwn;
 				if (m_hmoprobj.Retrieve(opr, &hvoOwn))
+				{
+					SaveObjPropForSnapshots(opr);
 					m_hmoprobj.Insert(opr, hvoDstOwner, true);
+				}
 			}
 			if (tagSrc != tagDst)
 			{
 				ObjPropRec opr(hvo, kflidCmObject_OwnFlid);
 				int flid;
 				if (m_hmoprn.Retrieve(opr, &flid))
+				{
+					SaveIntPropForSnapshots(opr);
 					m_hmoprn.Insert(opr, tagDst, true);
+				}
 			}
 		}
 
 		ObjPropRec oprDstKey(hvoDstOwner, tagDst);
 		if (iDstType == kcptOwningAtom)
 		{
+			SaveObjPropForSnapshots(oprDstKey);
 			m_hmoprobj.Insert(oprDstKey, prghvo[ihvoStart], true);
 		}
 		else
 		{
+			SaveVecPropForSnapshots(oprDstKey);
 			ObjSeq osDst;
 			ObjSeq osRep;
 			if (m_hmoprsobj.Retrieve(oprDstKey, &osDst))
@@ -1584,10 +1630,12 @@ void VwCacheDa::MoveOwnedObject(HVO hvoSrcOwner, PropTag tagSrc, int ihvoStart,
 
 		if (iSrcType == kcptOwningAtom)
 		{
+			SaveObjPropForSnapshots(oprSrcKey);
 			m_hmoprobj.Delete(oprSrcKey);
 		}
 		else
 		{
+			SaveVecPropForSnapshots(oprSrcKey);
 			if (cobj > chvoMoved)
 			{
 				//  Close up the gap left in the Src sequence (ie. replace it with a new one)
@@ -1867,6 +1915,8 @@ HRESULT VwCacheDa::ReplaceAux(HVO hvoObj, PropTag tag, int ihvoMin, int ihvoLim,
 	MoveItems(os.m_prghvo, osRep.m_prghvo, ihvoMin);
 	MoveItems(prghvo, osRep.m_prghvo + ihvoMin, chvoIns);
 	MoveItems(os.m_prghvo + ihvoLim, osRep.m_prghvo + ihvoMin + chvoIns, os.m_cobj - ihvoLim);
+	CacheSnapshotLock csl(this);
+	SaveVecPropForSnapshots(oprKey);
 	m_hmoprsobj.Insert(oprKey, osRep, true);
 
 	// REVIEW JohnT (TomB): I think this is the right thing to do, but I'm not sure if it's
@@ -1908,6 +1958,8 @@ STDMETHODIMP VwCacheDa::SetObjProp(HVO hvo, PropTag tag, HVO hvoObj)
 void VwCacheDa::SetObjPropVal(HVO hvo, PropTag tag, HVO hvoObj)
 {
 	ObjPropRec oprKey(hvo, tag);
+	CacheSnapshotLock csl(this);
+	SaveObjPropForSnapshots(oprKey);
 	m_hmoprobj.Insert(oprKey, hvoObj, true); // allow overwrites
 	m_soprMods.Insert(oprKey);
 	InformNowDirty();
@@ -1978,6 +2030,8 @@ void VwCacheDa::DeleteObjOwnerCore(HVO hvoOwner, HVO hvoObj, PropTag tag, int ih
 	if (ihvo == -2)
 	{
 		// atomic property
+		CacheSnapshotLock csl(this);
+		SaveObjPropForSnapshots(oprKey);
 		m_hmoprobj.Delete(oprKey);
 	}
 	else
@@ -2080,6 +2134,7 @@ void VwCacheDa::RemoveCachedProperties(HVO hvoDeleted, Set<HVO> & sethvoDel,
 	if (hvoDeleted == 0)
 		return;
 
+	CacheSnapshotLock csl(this);
 	sethvoDel.Insert(hvoDeleted);
 
 	Vector<ObjPropRec> voprDelAtomic;
@@ -2205,6 +2260,7 @@ void VwCacheDa::RemoveCachedProperties(HVO hvoDeleted, Set<HVO> & sethvoDel,
 		{
 			// Delete the reference stored in the loop above.  (Deleting it inside that loop
 			// would invalidate the iterator.)
+			SaveObjPropForSnapshots(voprDelAtomic[i]);
 			m_hmoprobj.Delete(voprDelAtomic[i]);
 		}
 	}
@@ -2214,6 +2270,7 @@ void VwCacheDa::RemoveCachedProperties(HVO hvoDeleted, Set<HVO> & sethvoDel,
 	{
 		for (int i = 0; i < voprDelColl.Size(); ++i)
 		{
+			SaveVecPropForSnapshots(voprDelColl[i]);
 			m_hmoprsobj.Delete(voprDelColl[i]);
 		}
 	}
@@ -2264,7 +2321,10 @@ void VwCacheDa::RemoveCachedProperties(HVO hvoDeleted, Set<HVO> & sethvoDel,
 				voprDel.Push(oprKey);
 		}
 		for (int i = 0; i < voprDel.Size(); ++i)
+		{
+			SaveIntPropForSnapshots(voprDel[i]);
 			m_hmoprn.Delete(voprDel[i]);
+		}
 	}
 	// Remove relevant cached int64/SilTime properties.
 	if (m_hmoprlln.Size() != 0)
@@ -2306,7 +2366,10 @@ void VwCacheDa::RemoveCachedProperties(HVO hvoDeleted, Set<HVO> & sethvoDel,
 				voperDel.Push(operKey);
 		}
 		for (int i = 0; i < voperDel.Size(); ++i)
+		{
+			SaveStringAltForSnapshots(voperDel[i]);
 			m_hmopertss.Delete(voperDel[i]);
+		}
 	}
 	// Remove relevant cached binary blob properties.
 	if (m_hmoprsta.Size() != 0)
@@ -2334,7 +2397,10 @@ void VwCacheDa::RemoveCachedProperties(HVO hvoDeleted, Set<HVO> & sethvoDel,
 				voprDel.Push(oprKey);
 		}
 		for (int i = 0; i < voprDel.Size(); ++i)
+		{
+			SaveStringPropForSnapshots(voprDel[i]);
 			m_hmoprtss.Delete(voprDel[i]);
+		}
 	}
 	// Remove relevant cached Unicode properties.
 	if (m_hmoprstu.Size() != 0)
@@ -2432,6 +2498,8 @@ void VwCacheDa::SetIntVal(HVO hvo, PropTag tag, int n)
 	Assert(hvo != 0);
 	ObjPropRec oprKey(hvo, tag);
 	m_soprMods.Insert(oprKey);
+	CacheSnapshotLock csl(this);
+	SaveIntPropForSnapshots(oprKey);
 	m_hmoprn.Insert(oprKey, n, true); // allow overwrites
 	InformNowDirty();
 }
@@ -2486,7 +2554,11 @@ void VwCacheDa::SetMultiStringAltVal(HVO hvo, PropTag tag, int ws, ITsString * p
 	int cchOld = 0;
 	if (m_hmopertss.Retrieve(opreKey, qtssOld))
 		CheckHr(qtssOld->get_Length(&cchOld));
-	m_hmopertss.Insert(opreKey, ptss, true); // allow overwrites
+	{
+		CacheSnapshotLock csl(this);
+		SaveStringAltForSnapshots(opreKey);
+		m_hmopertss.Insert(opreKey, ptss, true); // allow overwrites
+	}
 	InformNowDirty();
 	int cchNew;
 	CheckHr(ptss->get_Length(&cchNew));
@@ -2518,7 +2590,11 @@ void VwCacheDa::SetStringVal(HVO hvo, PropTag tag, ITsString * ptss)
 	int cchOld = 0;
 	if (m_hmoprtss.Retrieve(oprKey, qtssOld))
 		CheckHr(qtssOld->get_Length(&cchOld));
-	m_hmoprtss.Insert(oprKey, ptss, true); // allow overwrites
+	{
+		CacheSnapshotLock csl(this);
+		SaveStringPropForSnapshots(oprKey);
+		m_hmoprtss.Insert(oprKey, ptss, true); // allow overwrites
+	}
 	InformNowDirty();
 	int cchNew;
 	CheckHr(ptss->get_Length(&cchNew));
@@ -2885,18 +2961,53 @@ void VwCacheDa::ResumePropChanges()
 	if (!m_nSuppressPropChangesLevel)
 	{
 		m_shvoNewObjectsWhileSuppressed.Clear();
-		for (int i = 0; i < m_vPropChangeds.Size(); i++)
+		// Let root boxes handle all the queued changes as one batch, so each property is
+		// regenerated, and each view laid out, only once.
+		Vector<IVwRootBoxPtr> vqrootb;
+		if (m_vPropChangeds.Size() > 1)
 		{
-			PropChangedInfo pci = m_vPropChangeds[i];
+#ifdef TRY_HASH_SET
+			for (m_vvncNew_cIter = m_vvncNew.begin(); m_vvncNew_cIter != m_vvncNew.end(); m_vvncNew_cIter++)
+			{
+				IVwRootBoxPtr qrootb;
+				if (SUCCEEDED((*m_vvncNew_cIter)->QueryInterface(IID_IVwRootBox, (void **)&qrootb)))
+					vqrootb.Push(qrootb);
+			}
+#else
+			for (int irootb = 0; irootb < m_vvnc.Size(); irootb++)
+			{
+				IVwRootBoxPtr qrootb;
+				if (SUCCEEDED(m_vvnc[irootb]->QueryInterface(IID_IVwRootBox, (void **)&qrootb)))
+					vqrootb.Push(qrootb);
+			}
+#endif
+		}
+		for (int irootb = 0; irootb < vqrootb.Size(); irootb++)
+			CheckHr(vqrootb[irootb]->BeginPropChangedBatch());
+		try
+		{
+			for (int i = 0; i < m_vPropChangeds.Size(); i++)
+			{
+				PropChangedInfo pci = m_vPropChangeds[i];
 
-			ComBool fIsValid;
-			CheckHr(get_IsValidObject(pci.hvo, &fIsValid));
-			if (!fIsValid)
-				continue;
+				ComBool fIsValid;
+				CheckHr(get_IsValidObject(pci.hvo, &fIsValid));
+				if (!fIsValid)
+					continue;
 
-			CheckHr(PropChanged(pci.pnchng, pci.pct, pci.hvo, pci.tag, pci.ivMin, pci.cvIns, pci.cvDel));
+				CheckHr(PropChanged(pci.pnchng, pci.pct, pci.hvo, pci.tag, pci.ivMin, pci.cvIns, pci.cvDel));
+			}
+		}
+		catch(...)
+		{
+			m_vPropChangeds.Clear();
+			for (int irootb = 0; irootb < vqrootb.Size(); irootb++)
+				vqrootb[irootb]->EndPropChangedBatch();
+			throw;
 		}
 		m_vPropChangeds.Clear();
+		for (int irootb = 0; irootb < vqrootb.Size(); irootb++)
+			CheckHr(vqrootb[irootb]->EndPropChangedBatch());
 	}
 }
 
@@ -3084,6 +3195,10 @@ STDMETHODIMP VwCacheDa::ClearVirtualProperties()
 	if (!m_qmdc)
 		return E_FAIL; // can't implement without a metadatacache to tell which are virtual
 
+	// Rare enough that snapshots may as well save everything rather than just the virtuals.
+	CacheSnapshotLock csl(this);
+	SaveAllForSnapshots();
+
 	ClearVirtuals(m_hmoprn, m_qmdc);
 	ClearVirtuals(m_hmoprguid, m_qmdc);
 	// ClearVirtuals(m_hmoguidobj, m_qmdc); - can't have any virtuals in it
@@ -3410,6 +3525,9 @@ STDMETHODIMP VwCacheDa::ClearAllData()
 	//m_hvoNext = 100000000;
 	//m_hvoNextDummy = -1000000;
 
+	CacheSnapshotLock csl(this);
+	SaveAllForSnapshots();
+
 	//	Clear the hash maps that store atomic and collection/sequence REFERENCE information.
 	m_hmoprobj.Clear(); // Done
 
@@ -3686,6 +3804,307 @@ WriteVirtualResult VwCacheDa::TryVirtualAtomic(HVO hvo, PropTag tag, HVO newVal)
 	CheckHr(qvh->get_ComputeEveryTime(&fComputeEveryTime));
 	return fComputeEveryTime ? kwvDone : kwvCache;
 }
+//:>********************************************************************************************
+//:>	Snapshots.
+//:>********************************************************************************************
+
+/*----------------------------------------------------------------------------------------------
+	Take a snapshot of the data now in the cache (see VwCacheSnapshot). This must be called on
+	the thread that owns the cache.
+----------------------------------------------------------------------------------------------*/
+void VwCacheDa::TakeSnapshot(VwCacheSnapshot ** ppcsnap)
+{
+	AssertPtr(ppcsnap);
+	Assert(!*ppcsnap);
+
+	if (!m_qcsnl)
+		m_qcsnl.Attach(NewObj CacheSnapshotLink(this));
+	VwCacheSnapshot * pcsnap = NewObj VwCacheSnapshot(this);
+	LOCK(m_qcsnl->m_mutx)
+	{
+		m_vpcsnap.Push(pcsnap);
+	}
+	*ppcsnap = pcsnap;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Stop saving old values for a snapshot that is going away. This may be called on any thread,
+	holding m_qcsnl->m_mutx.
+----------------------------------------------------------------------------------------------*/
+void VwCacheDa::RemoveSnapshot(VwCacheSnapshot * pcsnap)
+{
+	for (int icsnap = 0; icsnap < m_vpcsnap.Size(); icsnap++)
+	{
+		if (m_vpcsnap[icsnap] == pcsnap)
+		{
+			m_vpcsnap.Delete(icsnap);
+			break;
+		}
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Called as the cache is destroyed: give each snapshot still in use every value it hasn't
+	saved yet, so that it can go on answering without the cache, and cut the snapshots' link
+	back to it.
+----------------------------------------------------------------------------------------------*/
+void VwCacheDa::DetachSnapshots()
+{
+	if (!m_qcsnl)
+		return;
+	LOCK(m_qcsnl->m_mutx)
+	{
+		SaveAllForSnapshots();
+		m_vpcsnap.Clear();
+		m_qcsnl->m_pcda = NULL;
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	The following methods are called, holding a CacheSnapshotLock, just before the value of the
+	specified property is changed or removed. Each snapshot that doesn't already have an old
+	value for the property gets the present one.
+----------------------------------------------------------------------------------------------*/
+void VwCacheDa::SaveObjPropForSnapshots(ObjPropRec & opr)
+{
+	if (!m_vpcsnap.Size())
+		return;
+	HVO hvo = 0;
+	m_hmoprobj.Retrieve(opr, &hvo);
+	for (int icsnap = 0; icsnap < m_vpcsnap.Size(); icsnap++)
+	{
+		int ihsnd;
+		if (!m_vpcsnap[icsnap]->m_hmoprobj.GetIndex(opr, &ihsnd))
+			m_vpcsnap[icsnap]->m_hmoprobj.Insert(opr, hvo);
+	}
+}
+
+void VwCacheDa::SaveVecPropForSnapshots(ObjPropRec & opr)
+{
+	if (!m_vpcsnap.Size())
+		return;
+	ObjSeq os;
+	m_hmoprsobj.Retrieve(opr, &os);
+	for (int icsnap = 0; icsnap < m_vpcsnap.Size(); icsnap++)
+	{
+		ObjPropSeqMap & hmoprsobj = m_vpcsnap[icsnap]->m_hmoprsobj;
+		int ihsnd;
+		if (hmoprsobj.GetIndex(opr, &ihsnd))
+			continue;
+		ObjSeq osSaved;
+		if (os.m_cobj)
+		{
+			osSaved.m_cobj = os.m_cobj;
+			osSaved.m_prghvo = NewObj HVO[os.m_cobj];
+			CopyItems(os.m_prghvo, osSaved.m_prghvo, os.m_cobj);
+		}
+		hmoprsobj.Insert(opr, osSaved);
+	}
+}
+
+void VwCacheDa::SaveIntPropForSnapshots(ObjPropRec & opr)
+{
+	if (!m_vpcsnap.Size())
+		return;
+	int n = 0;
+	m_hmoprn.Retrieve(opr, &n);
+	for (int icsnap = 0; icsnap < m_vpcsnap.Size(); icsnap++)
+	{
+		int ihsnd;
+		if (!m_vpcsnap[icsnap]->m_hmoprn.GetIndex(opr, &ihsnd))
+			m_vpcsnap[icsnap]->m_hmoprn.Insert(opr, n);
+	}
+}
+
+void VwCacheDa::SaveStringPropForSnapshots(ObjPropRec & opr)
+{
+	if (!m_vpcsnap.Size())
+		return;
+	ITsStringPtr qtss;
+	m_hmoprtss.Retrieve(opr, qtss);
+	for (int icsnap = 0; icsnap < m_vpcsnap.Size(); icsnap++)
+	{
+		int ihsnd;
+		if (!m_vpcsnap[icsnap]->m_hmoprtss.GetIndex(opr, &ihsnd))
+			m_vpcsnap[icsnap]->m_hmoprtss.Insert(opr, qtss);
+	}
+}
+
+void VwCacheDa::SaveStringAltForSnapshots(ObjPropEncRec & opre)
+{
+	if (!m_vpcsnap.Size())
+		return;
+	ITsStringPtr qtss;
+	m_hmopertss.Retrieve(opre, qtss);
+	for (int icsnap = 0; icsnap < m_vpcsnap.Size(); icsnap++)
+	{
+		int ihsnd;
+		if (!m_vpcsnap[icsnap]->m_hmopertss.GetIndex(opre, &ihsnd))
+			m_vpcsnap[icsnap]->m_hmopertss.Insert(opre, qtss);
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Save every property snapshots cover, before the whole cache is cleared.
+----------------------------------------------------------------------------------------------*/
+void VwCacheDa::SaveAllForSnapshots()
+{
+	if (!m_vpcsnap.Size())
+		return;
+	ObjPropObjMap::iterator itobj;
+	for (itobj = m_hmoprobj.Begin(); itobj != m_hmoprobj.End(); ++itobj)
+	{
+		ObjPropRec opr = itobj->GetKey();
+		SaveObjPropForSnapshots(opr);
+	}
+	ObjPropSeqMap::iterator itsobj;
+	for (itsobj = m_hmoprsobj.Begin(); itsobj != m_hmoprsobj.End(); ++itsobj)
+	{
+		ObjPropRec opr = itsobj->GetKey();
+		SaveVecPropForSnapshots(opr);
+	}
+	ObjPropIntMap::iterator itn;
+	for (itn = m_hmoprn.Begin(); itn != m_hmoprn.End(); ++itn)
+	{
+		ObjPropRec opr = itn->GetKey();
+		SaveIntPropForSnapshots(opr);
+	}
+	ObjPropTssMap::iterator ittss;
+	for (ittss = m_hmoprtss.Begin(); ittss != m_hmoprtss.End(); ++ittss)
+	{
+		ObjPropRec opr = ittss->GetKey();
+		SaveStringPropForSnapshots(opr);
+	}
+	ObjPropEncTssMap::iterator itetss;
+	for (itetss = m_hmopertss.Begin(); itetss != m_hmopertss.End(); ++itetss)
+	{
+		ObjPropEncRec opre = itetss->GetKey();
+		SaveStringAltForSnapshots(opre);
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Constructor; see VwCacheDa::TakeSnapshot.
+----------------------------------------------------------------------------------------------*/
+VwCacheSnapshot::VwCacheSnapshot(VwCacheDa * pcda)
+{
+	m_qcsnl = pcda->m_qcsnl;
+}
+
+VwCacheSnapshot::~VwCacheSnapshot()
+{
+	LOCK(m_qcsnl->m_mutx)
+	{
+		if (m_qcsnl->m_pcda)
+			m_qcsnl->m_pcda->RemoveSnapshot(this);
+	}
+	ObjPropSeqMap::iterator it;
+	for (it = m_hmoprsobj.Begin(); it != m_hmoprsobj.End(); ++it)
+		ClearObjSeq(it.GetValue());
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the value an atomic object property had when the snapshot was taken, or 0 if it
+	wasn't cached.
+----------------------------------------------------------------------------------------------*/
+HVO VwCacheSnapshot::ObjProp(HVO hvo, PropTag tag)
+{
+	ObjPropRec oprKey(hvo, tag);
+	HVO hvoVal = 0;
+	LOCK(m_qcsnl->m_mutx)
+	{
+		if (!m_hmoprobj.Retrieve(oprKey, &hvoVal) && m_qcsnl->m_pcda)
+			m_qcsnl->m_pcda->m_hmoprobj.Retrieve(oprKey, &hvoVal);
+	}
+	return hvoVal;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the size a sequence property had when the snapshot was taken (0 if it wasn't
+	cached).
+----------------------------------------------------------------------------------------------*/
+int VwCacheSnapshot::VecSize(HVO hvo, PropTag tag)
+{
+	ObjPropRec oprKey(hvo, tag);
+	ObjSeq os;
+	LOCK(m_qcsnl->m_mutx)
+	{
+		if (!m_hmoprsobj.Retrieve(oprKey, &os) && m_qcsnl->m_pcda)
+			m_qcsnl->m_pcda->m_hmoprsobj.Retrieve(oprKey, &os);
+	}
+	return os.m_cobj;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get the items a sequence property had when the snapshot was taken.
+----------------------------------------------------------------------------------------------*/
+void VwCacheSnapshot::VecProp(HVO hvo, PropTag tag, HvoVec & vhvo)
+{
+	ObjPropRec oprKey(hvo, tag);
+	vhvo.Clear();
+	LOCK(m_qcsnl->m_mutx)
+	{
+		// The array must be copied before the lock is released; the cache may replace it.
+		ObjSeq os;
+		if (!m_hmoprsobj.Retrieve(oprKey, &os) && m_qcsnl->m_pcda)
+			m_qcsnl->m_pcda->m_hmoprsobj.Retrieve(oprKey, &os);
+		vhvo.Replace(0, 0, os.m_prghvo, os.m_cobj);
+	}
+}
+
+/*----------------------------------------------------------------------------------------------
+	Return the value an integer property had when the snapshot was taken, or 0 if it wasn't
+	cached.
+----------------------------------------------------------------------------------------------*/
+int VwCacheSnapshot::IntProp(HVO hvo, PropTag tag)
+{
+	ObjPropRec oprKey(hvo, tag);
+	int n = 0;
+	LOCK(m_qcsnl->m_mutx)
+	{
+		if (!m_hmoprn.Retrieve(oprKey, &n) && m_qcsnl->m_pcda)
+			m_qcsnl->m_pcda->m_hmoprn.Retrieve(oprKey, &n);
+	}
+	return n;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get the value a string property had when the snapshot was taken. *pptss is set to null if
+	it wasn't cached (rather than to an empty string, which would need the writing system
+	factory, which belongs to the cache's thread).
+----------------------------------------------------------------------------------------------*/
+void VwCacheSnapshot::StringProp(HVO hvo, PropTag tag, ITsString ** pptss)
+{
+	AssertPtr(pptss);
+	Assert(!*pptss);
+	ObjPropRec oprKey(hvo, tag);
+	ITsStringPtr qtss;
+	LOCK(m_qcsnl->m_mutx)
+	{
+		if (!m_hmoprtss.Retrieve(oprKey, qtss) && m_qcsnl->m_pcda)
+			m_qcsnl->m_pcda->m_hmoprtss.Retrieve(oprKey, qtss);
+	}
+	*pptss = qtss.Detach();
+}
+
+/*----------------------------------------------------------------------------------------------
+	Get the value a multistring alternative had when the snapshot was taken, or null as for
+	StringProp.
+----------------------------------------------------------------------------------------------*/
+void VwCacheSnapshot::MultiStringAlt(HVO hvo, PropTag tag, int ws, ITsString ** pptss)
+{
+	AssertPtr(pptss);
+	Assert(!*pptss);
+	ObjPropEncRec opreKey(hvo, tag, ws);
+	ITsStringPtr qtss;
+	LOCK(m_qcsnl->m_mutx)
+	{
+		if (!m_hmopertss.Retrieve(opreKey, qtss) && m_qcsnl->m_pcda)
+			m_qcsnl->m_pcda->m_hmopertss.Retrieve(opreKey, qtss);
+	}
+	*pptss = qtss.Detach();
+}
+
 // Explicit instantiation of hashmap classes
 #include "HashMap_i.cpp"
 #include "ComHashMap_i.cpp"
@@ -3708,3 +4127,5 @@ template class Set<HVO>; // HvoSet; // Hungarian shvo
 template class HashMap<ObjPropRec, SeqExtra>; // ObjPropExtraMap; // Hungarian hmoprsx
 template class ComHashMap<PropTag, IVwVirtualHandler>; // TagVhMap; // Hungarian hmtagvp
 template class ComHashMapStrUni<IVwVirtualHandler>; // StrVhMap; // Hungarian hmstuvh
+template class Vector<IVwRootBoxPtr>; // ResumePropChanges
+template class Vector<VwCacheSnapshot *>; // m_vpcsnap
@@ -216,6 +216,30 @@ typedef Set<HVO> HvoSet; // Hungarian shvo
 typedef Set<ObjPropRec> ObjPropSet; // Hungarian sopr
 typedef Set<ObjPropEncRec> ObjPropEncSet; // Hungarian soper
 
+class VwCacheSnapshot;
+class VwCacheDa;
+
+/*----------------------------------------------------------------------------------------------
+	What a VwCacheDa shares with its snapshots: the mutex that guards the snapshots and the
+	parts of the cache they read, and a pointer back to the cache, which the cache clears as it
+	is destroyed. Snapshots hold this rather than the cache itself, so that releasing the last
+	snapshot on another thread can never destroy the cache there.
+
+	@h3{Hungarian: csnl}
+----------------------------------------------------------------------------------------------*/
+class CacheSnapshotLink : public GenRefObj
+{
+public:
+	CacheSnapshotLink(VwCacheDa * pcda)
+	{
+		m_pcda = pcda;
+	}
+
+	Mutex m_mutx;
+	VwCacheDa * m_pcda; // Not counted; null once the cache has been destroyed.
+};
+typedef GenSmartPtr<CacheSnapshotLink> CacheSnapshotLinkPtr;
+
 /*----------------------------------------------------------------------------------------------
 	A data cache that can be used for storing and retrieving object property information.
 
@@ -226,6 +250,8 @@ typedef Set<ObjPropEncRec> ObjPropEncSet; // Hungarian soper
 class VwCacheDa : public VwBaseDataAccess, public IVwCacheDa
 {
 	friend class TestViews::TestVwTextStore;
+	friend class VwCacheSnapshot;
+	friend class CacheSnapshotLock;
 public:
 	typedef VwBaseDataAccess SuperClass;
 
@@ -433,6 +459,9 @@ class VwCacheDa : public VwBaseDataAccess, public IVwCacheDa
 	STDMETHOD(get_TsStrFactory)(ITsStrFactory ** pptsf);
 	STDMETHOD(putref_TsStrFactory)(ITsStrFactory * ptsf);
 
+	// Not part of IVwCacheDa; see VwCacheSnapshot.
+	void TakeSnapshot(VwCacheSnapshot ** ppcsnap);
+
 protected:
 	HVO m_hvoNext;
 	ITsStrFactoryPtr m_qtsf;
@@ -515,6 +544,24 @@ class VwCacheDa : public VwBaseDataAccess, public IVwCacheDa
 	int m_nSuppressPropChangesLevel; // Number of calls to SuppressPropChanges without
 									 // matching ResumePropChanges.
 
+	//:>****************************************************************************************
+	//:>	Copy-on-write support for snapshots (see VwCacheSnapshot). Before changing a property
+	//:>	a snapshot covers, hold a CacheSnapshotLock and call the matching Save method.
+	//:>****************************************************************************************
+	// The snapshots still in use. Once the first snapshot has been taken, this and the maps
+	// snapshots cover are guarded by m_qcsnl->m_mutx.
+	Vector<VwCacheSnapshot *> m_vpcsnap;
+	CacheSnapshotLinkPtr m_qcsnl; // Made by the first TakeSnapshot, on the cache's thread.
+
+	void RemoveSnapshot(VwCacheSnapshot * pcsnap);
+	void DetachSnapshots();
+	void SaveObjPropForSnapshots(ObjPropRec & opr);
+	void SaveVecPropForSnapshots(ObjPropRec & opr);
+	void SaveIntPropForSnapshots(ObjPropRec & opr);
+	void SaveStringPropForSnapshots(ObjPropRec & opr);
+	void SaveStringAltForSnapshots(ObjPropEncRec & opre);
+	void SaveAllForSnapshots();
+
 	//:>****************************************************************************************
 	//:>	Other methods
 	//:>****************************************************************************************
@@ -568,4 +615,82 @@ class VwCacheDa : public VwBaseDataAccess, public IVwCacheDa
 };
 
 DEFINE_COM_PTR(VwCacheDa);
+
+
+/*----------------------------------------------------------------------------------------------
+	A read-only view of the data in a VwCacheDa as it was when the snapshot was taken, which
+	background work can read on another thread while the cache goes on changing. Taking one
+	copies nothing: the first time the cache changes a property afterwards, it saves the old
+	value in every snapshot that doesn't have one yet, and a snapshot reads whatever it hasn't
+	saved from the live cache, holding the cache's snapshot mutex.
+
+	Snapshots cover atomic and sequence object properties, integers, strings and multistring
+	alternatives. They don't load anything: virtual properties and properties a subclass would
+	load lazily are seen only as far as they were in the cache. Take snapshots on the thread
+	that owns the cache; they may be read and released on any thread. A snapshot does not keep
+	its cache alive: if the cache is destroyed first, it hands each snapshot every value it
+	hasn't saved yet. The cache has to save old values for as long as a snapshot exists, so
+	release snapshots as soon as the work that needs them is done.
+
+	@h3{Hungarian: csnap}
+----------------------------------------------------------------------------------------------*/
+class VwCacheSnapshot : public GenRefObj
+{
+	friend class VwCacheDa;
+
+public:
+	~VwCacheSnapshot();
+
+	HVO ObjProp(HVO hvo, PropTag tag);
+	int VecSize(HVO hvo, PropTag tag);
+	void VecProp(HVO hvo, PropTag tag, HvoVec & vhvo);
+	int IntProp(HVO hvo, PropTag tag);
+	void StringProp(HVO hvo, PropTag tag, ITsString ** pptss);
+	void MultiStringAlt(HVO hvo, PropTag tag, int ws, ITsString ** pptss);
+
+protected:
+	VwCacheSnapshot(VwCacheDa * pcda);
+
+	CacheSnapshotLinkPtr m_qcsnl;
+
+	// The values, at the time of the snapshot, of the properties the cache has changed since.
+	// A property that wasn't cached then is saved as zero, an empty sequence, or a null
+	// string, which is also how the snapshot answers for it. The arrays of the sequences
+	// belong to the snapshot.
+	ObjPropObjMap m_hmoprobj;
+	ObjPropSeqMap m_hmoprsobj;
+	ObjPropIntMap m_hmoprn;
+	ObjPropTssMap m_hmoprtss;
+	ObjPropEncTssMap m_hmopertss;
+};
+typedef GenSmartPtr<VwCacheSnapshot> VwCacheSnapshotPtr;
+
+
+/*----------------------------------------------------------------------------------------------
+	Held by VwCacheDa while it changes properties that snapshots may be reading. It locks the
+	mutex the cache shares with its snapshots once the cache has taken one, so a cache that
+	never does pays nothing. Only the cache's own thread sets m_qcsnl, so that test needs no
+	lock there; m_vpcsnap itself is only looked at holding the mutex.
+
+	@h3{Hungarian: csl}
+----------------------------------------------------------------------------------------------*/
+class CacheSnapshotLock
+{
+public:
+	CacheSnapshotLock(VwCacheDa * pcda)
+	{
+		m_pmutx = pcda->m_qcsnl ? &pcda->m_qcsnl->m_mutx : NULL;
+		if (m_pmutx)
+			m_pmutx->Lock();
+	}
+	~CacheSnapshotLock()
+	{
+		if (m_pmutx)
+			m_pmutx->Unlock();
+	}
+
+protected:
+	Mutex * m_pmutx;
+};
+
 #endif // VwCacheDa_INCLUDED
@@ -91,9 +91,11 @@ STDMETHODIMP VwUndoAction::QueryInterface(REFIID iid, void ** ppv)
 		*ppv = static_cast<IUnknown *>(static_cast<IUndoAction *>(this));
 	else if (iid == IID_IUndoAction)
 		*ppv = static_cast<IUndoAction *>(this);
+	else if (iid == IID_IUndoActionSize)
+		*ppv = static_cast<IUndoActionSize *>(this);
 	else if (iid == IID_ISupportErrorInfo)
 	{
-		*ppv = NewObj CSupportErrorInfo(this, IID_IUndoAction);
+		*ppv = NewObj CSupportErrorInfo(static_cast<IUndoAction *>(this), IID_IUndoAction);
 		return NOERROR;
 	}
 	else
@@ -126,6 +128,15 @@ STDMETHODIMP_(UCOMINT32) VwUndoAction::Release(void)
 	return 0;
 }
 
+/*----------------------------------------------------------------------------------------------
+	Return roughly how many bytes this action holds. Subclasses that keep variable-sized data
+	should add it in.
+----------------------------------------------------------------------------------------------*/
+STDMETHODIMP_(int) VwUndoAction::SizeInBytes()
+{
+	return isizeof(VwUndoAction);
+}
+
 /*----------------------------------------------------------------------------------------------
 	Undo an action. Should only be called for subclasses.
 ----------------------------------------------------------------------------------------------*/
@@ -411,7 +422,11 @@ STDMETHODIMP VwUndoDeleteAction::Undo(ComBool fRefreshPending, ComBool * pfSucce
 	{
 		// atomic property
 		ObjPropRec oprKey(m_hvoObj, m_tag);
-		m_puda->m_hmoprobj.Insert(oprKey, m_hvoDeleted, true);
+		{
+			CacheSnapshotLock csl(m_puda);
+			m_puda->SaveObjPropForSnapshots(oprKey);
+			m_puda->m_hmoprobj.Insert(oprKey, m_hvoDeleted, true);
+		}
 		if (!fRefreshPending)
 			CheckHr(m_puda->PropChanged(NULL, kpctNotifyAll, m_hvoObj, m_tag, 0, 0, 0));
 	}
@@ -1091,9 +1106,7 @@ STDMETHODIMP VwUndoDa::SetString(HVO hvo, PropTag tag, ITsString * ptss)
 	// Set up an undo-action with the previous value.
 	ITsStringPtr qtssOld;
 	CheckHr(get_StringProp(hvo, tag, &qtssOld));
-	VwUndoActionPtr quact;
-	quact.Attach(NewObj VwUndoSetStringAction(this, hvo, tag, -1, qtssOld));
-	RecordUndoAction(quact);
+	RecordSetStringAction(hvo, tag, -1, qtssOld, ptss);
 
 	return SuperSetString(hvo, tag, ptss);
 
@@ -1109,21 +1122,213 @@ STDMETHODIMP VwUndoDa::SetMultiStringAlt(HVO hvo, PropTag tag, int ws, ITsString
 	// Set up an undo-action with the previous value.
 	ITsStringPtr qtssOld;
 	CheckHr(get_MultiStringAlt(hvo, tag, ws, &qtssOld));
-	VwUndoActionPtr quact;
-	quact.Attach(NewObj VwUndoSetStringAction(this, hvo, tag, ws, qtssOld));
-	RecordUndoAction(quact);
+	RecordSetStringAction(hvo, tag, ws, qtssOld, ptss);
 
 	return SuperSetMultiStringAlt(hvo, tag, ws, ptss);
 
 	END_COM_METHOD(g_factDa, IID_ISilDataAccess);
 }
 
+/*----------------------------------------------------------------------------------------------
+	Record the change of a string property (or one alternative of a multistring, if ws is not
+	-1) from ptssOld to ptssNew. Typing produces a long series of small changes to the same
+	string; when this change continues the previous one within the same open task, it is
+	merged into the action already on the stack rather than recorded as another one.
+----------------------------------------------------------------------------------------------*/
+void VwUndoDa::RecordSetStringAction(HVO hvo, PropTag tag, int ws, ITsString * ptssOld,
+	ITsString * ptssNew)
+{
+	VwUndoSetStringAction * puactLast = m_quactLastString;
+	if (puactLast && puactLast->m_hvoObj == hvo && puactLast->m_tag == tag &&
+		puactLast->m_ws == ws && !puactLast->m_fStateUndone)
+	{
+		ComSmartPtr<ActionHandler> qacth;
+		if (m_qacth &&
+			SUCCEEDED(m_qacth->QueryInterface(CLSID_ActionHandler, (void **)&qacth)) &&
+			qacth->IsLastActionOfOpenTask(puactLast) &&
+			puactLast->Merge(ptssOld, ptssNew))
+		{
+			return;
+		}
+	}
+
+	ComSmartPtr<VwUndoSetStringAction> quact;
+	quact.Attach(NewObj VwUndoSetStringAction(this, hvo, tag, ws, ptssOld, ptssNew));
+	RecordUndoAction(quact);
+	m_quactLastString = quact;
+}
+
 VwUndoSetStringAction::VwUndoSetStringAction(VwUndoDa * puda, HVO hvoObj, PropTag tag,
-	int ws, ITsString * ptss)
+	int ws, ITsString * ptssOld, ITsString * ptssNew)
 	: VwUndoAction(puda, hvoObj, tag)
 {
 	m_ws = ws;
-	m_qtssOther = ptss;
+	SetDelta(ptssOld, ptssNew);
+}
+
+/*----------------------------------------------------------------------------------------------
+	Find the smallest range that differs between the two strings, comparing both characters
+	and run properties: replacing the *pcchB characters at *pich in ptssB with the *pcchA
+	characters at *pich in ptssA gives a string equal to ptssA. Return false if the strings
+	can't be compared that way, or if either is empty (an empty string's only property is
+	the writing system of its empty run, which a splice would not preserve).
+----------------------------------------------------------------------------------------------*/
+bool VwUndoSetStringAction::FindSplice(ITsString * ptssA, ITsString * ptssB, int * pich,
+	int * pcchA, int * pcchB)
+{
+	AssertPtr(pich);
+	AssertPtr(pcchA);
+	AssertPtr(pcchB);
+	if (!ptssA || !ptssB)
+		return false;
+	ITsStringRawPtr qtssrA;
+	ITsStringRawPtr qtssrB;
+	if (FAILED(ptssA->QueryInterface(IID_ITsStringRaw, (void **)&qtssrA)) ||
+		FAILED(ptssB->QueryInterface(IID_ITsStringRaw, (void **)&qtssrB)))
+	{
+		return false;
+	}
+	const OLECHAR * prgchA;
+	const OLECHAR * prgchB;
+	const TxtRun * prgrunA;
+	const TxtRun * prgrunB;
+	int cchA, cchB, crunA, crunB;
+	CheckHr(qtssrA->GetRawPtrs(&prgchA, &cchA, &prgrunA, &crunA));
+	CheckHr(qtssrB->GetRawPtrs(&prgchB, &cchB, &prgrunB, &crunB));
+	if (!cchA || !cchB)
+		return false;
+
+	// Common prefix.
+	int cchMin = min(cchA, cchB);
+	int ich = 0;
+	int irunA = 0;
+	int irunB = 0;
+	for (; ich < cchMin; ich++)
+	{
+		while (prgrunA[irunA].IchLim() <= ich)
+			irunA++;
+		while (prgrunB[irunB].IchLim() <= ich)
+			irunB++;
+		if (prgchA[ich] != prgchB[ich] || !prgrunA[irunA].PropsEqual(prgrunB[irunB]))
+			break;
+	}
+
+	// Common suffix, not overlapping the prefix.
+	int dich = 0;
+	irunA = crunA - 1;
+	irunB = crunB - 1;
+	for (; dich < cchMin - ich; dich++)
+	{
+		int ichA = cchA - 1 - dich;
+		int ichB = cchB - 1 - dich;
+		while (irunA > 0 && prgrunA[irunA - 1].IchLim() > ichA)
+			irunA--;
+		while (irunB > 0 && prgrunB[irunB - 1].IchLim() > ichB)
+			irunB--;
+		if (prgchA[ichA] != prgchB[ichB] || !prgrunA[irunA].PropsEqual(prgrunB[irunB]))
+			break;
+	}
+
+	*pich = ich;
+	*pcchA = cchA - ich - dich;
+	*pcchB = cchB - ich - dich;
+	return true;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Record what it takes to turn ptssCur, the value the property now has (or is about to
+	have), back into ptssOther.
+----------------------------------------------------------------------------------------------*/
+void VwUndoSetStringAction::SetDelta(ITsString * ptssOther, ITsString * ptssCur)
+{
+	int cchOther;
+	m_qtssCur.Clear();
+	if (!FindSplice(ptssOther, ptssCur, &m_ich, &cchOther, &m_cchCur))
+	{
+		m_ich = -1;
+		m_cchCur = 0;
+		m_qtssOther = ptssOther;
+		return;
+	}
+	m_qtssOther.Clear();
+	CheckHr(ptssOther->GetSubstring(m_ich, m_ich + cchOther, &m_qtssOther));
+	CheckHr(ptssCur->GetSubstring(m_ich, m_ich + m_cchCur, &m_qtssCur));
+}
+
+/*----------------------------------------------------------------------------------------------
+	Apply the stored change to ptssCur, producing the other value of the property. Return
+	false if ptssCur doesn't have the text (and properties) the change replaces, which means
+	something else has modified the property in the meantime.
+----------------------------------------------------------------------------------------------*/
+bool VwUndoSetStringAction::ApplyDelta(ITsString * ptssCur, ITsString ** pptssNext)
+{
+	AssertPtr(pptssNext);
+	Assert(!*pptssNext);
+	if (m_ich < 0)
+	{
+		*pptssNext = m_qtssOther;
+		AddRefObj(*pptssNext);
+		return true;
+	}
+	if (!ptssCur)
+		return false;
+	int cchCur;
+	CheckHr(ptssCur->get_Length(&cchCur));
+	if (m_ich + m_cchCur > cchCur)
+		return false;
+	if (m_cchCur)
+	{
+		ITsStringPtr qtssSeg;
+		CheckHr(ptssCur->GetSubstring(m_ich, m_ich + m_cchCur, &qtssSeg));
+		ComBool fEqual;
+		CheckHr(qtssSeg->Equals(m_qtssCur, &fEqual));
+		if (!fEqual)
+			return false;
+	}
+	ITsStrBldrPtr qtsb;
+	CheckHr(ptssCur->GetBldr(&qtsb));
+	CheckHr(qtsb->ReplaceTsString(m_ich, m_ich + m_cchCur, m_qtssOther));
+	CheckHr(qtsb->GetString(pptssNext));
+	return true;
+}
+
+/*----------------------------------------------------------------------------------------------
+	Fold a further change of the property, from ptssCur to ptssNew, into this action, so that
+	undoing it restores the value from before both changes. Return false, leaving the action
+	as it was, if the new change doesn't touch the range this one covers; typing somewhere
+	else should be undone separately.
+----------------------------------------------------------------------------------------------*/
+bool VwUndoSetStringAction::Merge(ITsString * ptssCur, ITsString * ptssNew)
+{
+	Assert(!m_fStateUndone);
+	if (m_ich < 0)
+		return false;
+	int ich, cchCur, cchNew;
+	if (!FindSplice(ptssNew, ptssCur, &ich, &cchNew, &cchCur))
+		return false;
+	if (ich > m_ich + m_cchCur || ich + cchCur < m_ich)
+		return false;
+	ITsStringPtr qtssOrig;
+	if (!ApplyDelta(ptssCur, &qtssOrig))
+		return false;
+	SetDelta(qtssOrig, ptssNew);
+	return true;
+}
+
+STDMETHODIMP_(int) VwUndoSetStringAction::SizeInBytes()
+{
+	int cb = isizeof(VwUndoSetStringAction);
+	ITsString * rgptss[2] = { m_qtssOther, m_qtssCur };
+	for (int iptss = 0; iptss < 2; iptss++)
+	{
+		if (!rgptss[iptss])
+			continue;
+		int cch, crun;
+		CheckHr(rgptss[iptss]->get_Length(&cch));
+		CheckHr(rgptss[iptss]->get_RunCount(&crun));
+		cb += cch * isizeof(OLECHAR) + crun * isizeof(TxtRun);
+	}
+	return cb;
 }
 
 STDMETHODIMP VwUndoSetStringAction::Undo(ComBool fRefreshPending, ComBool * pfSuccess)
@@ -1149,30 +1354,49 @@ HRESULT VwUndoSetStringAction::UndoRedo(bool fUndo, ComBool * pfSuccess, ComBool
 	ChkComOutPtr(pfSuccess);
 	Assert(m_fStateUndone == !fUndo);
 
-	ITsStringPtr qtssNext = m_qtssOther;
-
-	HRESULT hr;
+	ITsStringPtr qtssCur;
 	if (m_ws == -1)
+		CheckHr(m_puda->get_StringProp(m_hvoObj, m_tag, &qtssCur));
+	else
+		CheckHr(m_puda->get_MultiStringAlt(m_hvoObj, m_tag, m_ws, &qtssCur));
+	ITsStringPtr qtssNext;
+	if (!ApplyDelta(qtssCur, &qtssNext))
+		return S_OK; // *pfSuccess is false.
+
+	// The segment we are about to replace is what it takes to get back again.
+	int ich = m_ich;
+	int cchDel = 0;
+	int cchIns = 0;
+	if (m_ich < 0)
 	{
-		CheckHr(m_puda->get_StringProp(m_hvoObj, m_tag, &m_qtssOther));
-		hr = m_puda->SuperSetString(m_hvoObj, m_tag, qtssNext);
+		m_qtssOther = qtssCur;
+		if (qtssNext)
+			CheckHr(qtssNext->get_Length(&cchIns));
+		if (qtssCur)
+			CheckHr(qtssCur->get_Length(&cchDel));
 	}
 	else
 	{
-		CheckHr(m_puda->get_MultiStringAlt(m_hvoObj, m_tag, m_ws, &m_qtssOther));
-		hr = m_puda->SuperSetMultiStringAlt(m_hvoObj, m_tag, m_ws, qtssNext);
+		cchDel = m_cchCur;
+		CheckHr(m_qtssOther->get_Length(&cchIns));
+		m_cchCur = cchIns;
+		ITsStringPtr qtssT = m_qtssOther;
+		m_qtssOther = m_qtssCur;
+		m_qtssCur = qtssT;
 	}
-	int cchNext;
-	CheckHr(qtssNext->get_Length(&cchNext));
-	int cchOther;
-	CheckHr(qtssNext->get_Length(&cchOther));
+
+	HRESULT hr;
+	if (m_ws == -1)
+		hr = m_puda->SuperSetString(m_hvoObj, m_tag, qtssNext);
+	else
+		hr = m_puda->SuperSetMultiStringAlt(m_hvoObj, m_tag, m_ws, qtssNext);
 	// Note that for a MS property, specs call for passing the ws in the 'insert' parameter
-	// to indicate which alternative changed. Otherwise we pass zero indicating the first
-	// character (may have) changed.
+	// to indicate which alternative changed. Otherwise we pass the start of the range that
+	// changed, or zero if we don't know it.
 	if (!fRefreshPending)
 	{
 		CheckHr(m_puda->PropChanged(NULL, kpctNotifyAll, m_hvoObj, m_tag,
-			(m_ws == -1 ? 0 : m_ws), cchNext, cchOther));
+			(m_ws == -1 ? max(ich, 0) : m_ws), cchIns, cchDel));
 	}
 
 	m_fStateUndone = fUndo;
@@ -17,6 +17,7 @@ Last reviewed: never
 #define UndoAction_INCLUDED
 
 class VwUndoAction;
+class VwUndoSetStringAction;
 class AfStylesheet;
 typedef ComSmartPtr<AfStylesheet> AfStylesheetPtr;
 
@@ -147,9 +148,14 @@ class VwUndoDa : public VwCacheDa
 protected:
 	// member variables:
 	IActionHandlerPtr m_qacth;
+	// The most recent string action we recorded; a following change to the same string in
+	// the same task may be merged into it.
+	ComSmartPtr<VwUndoSetStringAction> m_quactLastString;
 
 	// private methods:
 	void RecordUndoAction(VwUndoAction * puact);
+	void RecordSetStringAction(HVO hvo, PropTag tag, int ws, ITsString * ptssOld,
+		ITsString * ptssNew);
 };
 DEFINE_COM_PTR(VwUndoDa);
 
@@ -158,7 +164,7 @@ DEFINE_COM_PTR(VwUndoDa);
 	UndoAction is an abstract class. Each subclass knows how to undo a specific kind of
 	change to an ISilDataAccess.
 ----------------------------------------------------------------------------------------------*/
-class VwUndoAction : public IUndoAction
+class VwUndoAction : public IUndoAction, public IUndoActionSize
 {
 	friend class VwUndoDa;
 
@@ -177,6 +183,9 @@ class VwUndoAction : public IUndoAction
 	STDMETHOD(get_IsRedoable)(ComBool * pfRet);
 	STDMETHOD(put_SuppressNotification)(ComBool fSuppress);
 
+	// IUndoActionSize
+	STDMETHOD_(int, SizeInBytes)();
+
 protected:
 	int m_cref;	// Standard reference count variable.
 
@@ -386,6 +395,12 @@ DEFINE_COM_PTR(VwUndoSetGuidAction);
 
 /*----------------------------------------------------------------------------------------------
 	Undoes a SetString or SetMultiStringAlt operation.
+
+	Rather than the whole of the other value, the action normally stores only the part of it
+	that differs from the current value: replacing the m_cchCur characters at m_ich in the
+	current value, which should be m_qtssCur, with m_qtssOther gives the other value. Each undo
+	or redo swaps the two segments. When no such splice can be worked out, m_ich is -1 and
+	m_qtssOther is the whole other value.
 ----------------------------------------------------------------------------------------------*/
 class VwUndoSetStringAction : public VwUndoAction
 {
@@ -394,15 +409,27 @@ class VwUndoSetStringAction : public VwUndoAction
 	friend class VwUndoDa;
 
 public:
-	VwUndoSetStringAction(VwUndoDa * puda, HVO hvo, PropTag tag, int ws, ITsString * ptss);
+	VwUndoSetStringAction(VwUndoDa * puda, HVO hvo, PropTag tag, int ws, ITsString * ptssOld,
+		ITsString * ptssNew);
 
 	STDMETHOD(Undo)(ComBool fRefreshPending, ComBool * pfSuccess);
 	STDMETHOD(Redo)(ComBool fRefreshPending, ComBool * pfSuccess);
+	STDMETHOD_(int, SizeInBytes)();
+
+	bool Merge(ITsString * ptssCur, ITsString * ptssNew);
+
+	static bool FindSplice(ITsString * ptssA, ITsString * ptssB, int * pich, int * pcchA,
+		int * pcchB);
 
 protected:
 	ITsStringPtr m_qtssOther;
+	ITsStringPtr m_qtssCur; // Null if m_ich is -1.
 	int m_ws;
+	int m_ich;
+	int m_cchCur;
 
+	void SetDelta(ITsString * ptssOther, ITsString * ptssCur);
+	bool ApplyDelta(ITsString * ptssCur, ITsString ** pptssNext);
 	HRESULT UndoRedo(bool fUndo, ComBool * pfSuccess, ComBool fRefreshPending);
 };
 DEFINE_COM_PTR(VwUndoSetStringAction);